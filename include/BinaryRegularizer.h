@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BINARY_REGULARIZER_H
+#define BINARY_REGULARIZER_H
+
+#include <vector>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "SpatialHash.h"
+
+namespace NBodySim {
+	template <class T> class BinaryRegularizer;
+	namespace BinaryRegularizerSpace {
+		/**
+		 * stepsPerOrbit is the number of steps an orbit needs to be followed by the integrator, bound pairs with a shorter
+		 * period are regularized
+		 */
+		const FloatingType stepsPerOrbit = 100;
+		/**
+		 * isolationFactor is how many apocenter distances every other particle must be from a pair for the pair to be
+		 * treated as unperturbed
+		 */
+		const FloatingType isolationFactor = 10;
+	}
+}
+
+/**
+ * @brief Advances tight, isolated binaries analytically while the rest of the system is integrated normally.
+ *
+ * Mutually nearest, bound pairs whose period is too short for the step are replaced during the step by a single body at
+ * their center of mass carrying their total mass. The integrator moves that body with the rest of the system and the
+ * relative orbit of the pair is advanced along its exact Kepler orbit, so a hard binary no longer forces the step down.
+ * The pair is split back into its two particles before step returns, so callers of getParticle always see both bodies.
+ * A pair is dissolved as soon as it becomes unbound or another particle comes near it.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ * @see Kepler
+ */
+template <class T>
+class NBodySim::BinaryRegularizer {
+private:
+	/**
+	 * isRegularizable returns whether particles i and j form a bound pair with no other particle near it
+	 *
+	 * @param system is the set of particles
+	 * @param G is the gravitation constant of the system
+	 * @param i is the index of the first particle
+	 * @param j is the index of the second particle
+	 * @param period receives the orbital period of the pair when it is bound
+	 * @return true if the pair is bound and isolated
+	 */
+	bool isRegularizable(std::vector<NBodySim::Particle<T> > & system, T G, size_t i, size_t j, T * period);
+
+	/**
+	 * isIsolated returns whether every particle but i and j is at least reach from center, searching the cells of grid
+	 * that cover the reach when there are fewer of them than particles
+	 *
+	 * @param system is the set of particles
+	 * @param i is the index of the first particle of the pair
+	 * @param j is the index of the second particle of the pair
+	 * @param center is the center of mass of the pair
+	 * @param reach is the distance every other particle must keep
+	 * @return true if no other particle is within reach
+	 */
+	bool isIsolated(std::vector<NBodySim::Particle<T> > & system, size_t i, size_t j, const NBodySim::ThreeVector<T> & center, T reach);
+
+	/**
+	 * findNearest fills nearest with the nearest free particle of every free particle when it is closer than widest,
+	 * searching the neighbouring cells of grid, and with the number of particles otherwise
+	 *
+	 * @param system is the set of particles
+	 * @param widest is the cell size of grid, the widest separation a pair can be regularized at
+	 */
+	void findNearest(std::vector<NBodySim::Particle<T> > & system, T widest);
+
+protected:
+	/**
+	 * first and second hold the indices of the particles of every regularized pair
+	 */
+	std::vector<size_t> first;
+	std::vector<size_t> second;
+
+	/**
+	 * firstMass and secondMass hold the masses of the particles of every pair while the pair is combined
+	 */
+	std::vector<T> firstMass;
+	std::vector<T> secondMass;
+
+	/**
+	 * relativePos and relativeVel hold the position and velocity of first relative to second while the pair is combined
+	 */
+	std::vector<NBodySim::ThreeVector<T> > relativePos;
+	std::vector<NBodySim::ThreeVector<T> > relativeVel;
+
+	/**
+	 * paired indicates a particle belongs to a regularized pair
+	 */
+	std::vector<bool> paired;
+
+	/**
+	 * nearest holds the index of the nearest particle to every particle, used to find mutually nearest pairs
+	 */
+	std::vector<size_t> nearest;
+
+	/**
+	 * grid bins the particles at every update into cells as wide as the widest pair that can be regularized, gridBuilt
+	 * indicates it holds them, there is no such width when the gravitation, the masses or the step are not positive
+	 */
+	NBodySim::SpatialHash<T> grid;
+	bool gridBuilt;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	BinaryRegularizer(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~BinaryRegularizer(void);
+
+	/**
+	 * reset dissolves every pair, it must be called when particles are added or removed
+	 */
+	void reset(void);
+
+	/**
+	 * update dissolves pairs that are no longer bound and isolated, then regularizes new tight pairs
+	 *
+	 * @param system is the set of particles
+	 * @param G is the gravitation constant of the system
+	 * @param deltaT is the length of the coming step
+	 * @return true if any pair was formed or dissolved
+	 */
+	bool update(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT);
+
+	/**
+	 * combine replaces every pair by a body at its center of mass, the first particle carries the total mass and the
+	 * second is left massless at the same place
+	 *
+	 * @param system is the set of particles
+	 */
+	void combine(std::vector<NBodySim::Particle<T> > & system);
+
+	/**
+	 * split advances the relative orbit of every pair by deltaT and places both particles about the center of mass the
+	 * integrator moved the first particle to
+	 *
+	 * @param system is the set of particles
+	 * @param G is the gravitation constant of the system
+	 * @param deltaT is the length of the step
+	 */
+	void split(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT);
+
+	/**
+	 * numPairs returns the number of regularized pairs
+	 *
+	 * @return the number of regularized pairs
+	 */
+	size_t numPairs(void);
+};
+
+#endif // BINARY_REGULARIZER_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COLLISION_DETECTOR_H
+#define COLLISION_DETECTOR_H
+
+#include <vector>
+#include <cstdint>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "SpatialHash.h"
+
+namespace NBodySim {
+	template <class T> class CollisionDetector;
+}
+
+/**
+ * @brief Finds overlapping particles with a uniform grid spatial hash and merges them.
+ *
+ * Every step the particles are binned into cubic cells two maximum radii wide, so two particles can only overlap when
+ * they are in the same or neighbouring cells. The cells are hashed into buckets filled with a counting sort, which keeps
+ * the whole pass linear in the number of particles.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ * @see SpatialHash
+ */
+template <class T>
+class NBodySim::CollisionDetector {
+private:
+	/**
+	 * merge combines particle j into particle i conserving mass, momentum and volume
+	 *
+	 * @param i is the particle that survives, it keeps its name
+	 * @param j is the particle that is absorbed
+	 */
+	void merge(NBodySim::Particle<T> & i, NBodySim::Particle<T> & j);
+
+protected:
+	/**
+	 * grid bins the particles into cells two maximum radii wide
+	 */
+	NBodySim::SpatialHash<T> grid;
+
+	/**
+	 * absorbed indicates a particle was merged into another one during this pass
+	 */
+	std::vector<bool> absorbed;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	CollisionDetector(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~CollisionDetector(void);
+
+	/**
+	 * resolve merges every pair of overlapping particles, the absorbed particles are left in system for the caller to remove
+	 *
+	 * @param system is the set of particles to check
+	 * @param removedIds is filled with the ids of the absorbed particles, highest first
+	 * @return the number of particles absorbed
+	 */
+	size_t resolve(std::vector<NBodySim::Particle<T> > & system, std::vector<size_t> & removedIds);
+};
+
+#endif // COLLISION_DETECTOR_H
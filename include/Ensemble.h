@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+#include "TaskScheduler.h"
+
+namespace NBodySim {
+	template <class T> class Ensemble;
+	namespace EnsembleSpace {
+		/**
+		 * laneWidth is how many replicas are stepped side by side, each in one lane of the innermost loops
+		 */
+		const size_t laneWidth = 8;
+		/**
+		 * defaultPerturbation is the relative spread of the positions and velocities of the replicas
+		 */
+		const FloatingType defaultPerturbation = 1e-8;
+	}
+}
+
+/**
+ * @brief Steps many perturbed copies of one small system at once, for Monte Carlo studies of its stability.
+ *
+ * The replicas are packed in blocks of laneWidth, and every property of a particle is stored for all the replicas of a
+ * block side by side, so the loops over the replicas of a block are vectorized by the compiler. Every replica is
+ * stepped with the same symplectic Euler direct summation as NBodySystem, so an unperturbed replica follows the
+ * system exactly. Blocks are independent and are shared out to threads whole, for every step at once.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::Ensemble {
+private:
+	/**
+	 * index returns where the property of a particle in a lane of a block is stored
+	 *
+	 * @param block is the block of replicas
+	 * @param particle is the index of the particle
+	 * @return the index into the property arrays of the first lane
+	 */
+	size_t index(size_t block, size_t particle);
+
+	/**
+	 * energy calculates the total energy of every replica of a block
+	 *
+	 * @param block is the block of replicas
+	 * @param out receives the energy of every lane
+	 */
+	void energy(size_t block, T * out);
+
+	/**
+	 * stepBlock advances every replica of a block by a number of steps
+	 *
+	 * @param block is the block of replicas
+	 * @param numSteps is the number of steps
+	 * @param deltaT is the length of every step
+	 */
+	template <NBodySim::forcePrecision P>
+	void stepBlock(size_t block, size_t numSteps, T deltaT);
+
+protected:
+	/**
+	 * nameIds holds the name id of every particle, shared by the replicas
+	 */
+	std::vector<uint32_t> nameIds;
+
+	/**
+	 * posX to velZ hold the position and velocity of every particle of every replica, block by block, then particle by
+	 * particle, then lane by lane
+	 */
+	std::vector<T> posX;
+	std::vector<T> posY;
+	std::vector<T> posZ;
+	std::vector<T> velX;
+	std::vector<T> velY;
+	std::vector<T> velZ;
+
+	/**
+	 * masses holds the mass of every particle and gm G times it, the masses are the same in every replica
+	 */
+	std::vector<T> masses;
+	std::vector<T> gm;
+
+	/**
+	 * G is the gravitation constant of the system
+	 */
+	T G;
+
+	/**
+	 * numParticles is the number of particles of every replica, replicaCount the number of replicas and numBlocks the
+	 * number of blocks, the lanes of the last block past the last replica hold copies of its first lane
+	 */
+	size_t numParticles;
+	size_t replicaCount;
+	size_t numBlocks;
+
+	/**
+	 * precision is how the inverse cube of the distance between particles is calculated
+	 */
+	NBodySim::forcePrecision precision;
+
+	/**
+	 * initialEnergy, finalEnergy and closestApproach hold the summary of every replica
+	 */
+	std::vector<T> initialEnergy;
+	std::vector<T> finalEnergy;
+	std::vector<T> closestApproach;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	Ensemble(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~Ensemble(void);
+
+	/**
+	 * generate makes replicas of a system, each position and velocity coordinate of every replica but the first is scaled
+	 * by a normally distributed factor of mean 1
+	 *
+	 * @param scenario is the system to copy
+	 * @param numReplicas is the number of replicas
+	 * @param perturbation is the standard deviation of the factors, 0 leaves every replica an exact copy
+	 * @param seed selects the perturbations, replica r always gets the same perturbation for the same seed
+	 */
+	void generate(NBodySim::NBodySystem<T> & scenario, size_t numReplicas, T perturbation, unsigned seed);
+
+	/**
+	 * setForcePrecision sets how the inverse cube of the distance between particles is calculated
+	 *
+	 * @param newPrecision is the precision of the force calculation
+	 */
+	void setForcePrecision(NBodySim::forcePrecision newPrecision);
+
+	/**
+	 * run advances every replica by a number of steps
+	 *
+	 * @param numSteps is the number of steps
+	 * @param deltaT is the length of every step
+	 * @param scheduler shares the blocks out to threads, NULL to step them on the calling thread
+	 */
+	void run(size_t numSteps, T deltaT, NBodySim::TaskScheduler * scheduler);
+
+	/**
+	 * numReplicas returns the number of replicas
+	 *
+	 * @return the number of replicas
+	 */
+	size_t numReplicas(void);
+
+	/**
+	 * getParticle returns a particle of a replica
+	 *
+	 * @param replica is the index of the replica
+	 * @param particle is the index of the particle
+	 * @return the particle
+	 */
+	NBodySim::Particle<T> getParticle(size_t replica, size_t particle);
+
+	/**
+	 * getEnergyError returns how far the energy of a replica drifted over the runs so far
+	 *
+	 * @param replica is the index of the replica
+	 * @return the change of the total energy relative to its magnitude at generation
+	 */
+	T getEnergyError(size_t replica);
+
+	/**
+	 * getClosestApproach returns the smallest distance between two particles of a replica at the start of any step
+	 *
+	 * @param replica is the index of the replica
+	 * @return the closest approach in meters
+	 */
+	T getClosestApproach(size_t replica);
+
+	/**
+	 * writeSummary writes one line per replica with its index, relative energy error and closest approach
+	 *
+	 * @param out is the stream to write to
+	 */
+	void writeSummary(std::ostream & out);
+};
+
+#endif // ENSEMBLE_H
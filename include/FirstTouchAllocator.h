@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef FIRST_TOUCH_ALLOCATOR_H
+#define FIRST_TOUCH_ALLOCATOR_H
+
+#include <memory>
+#include <utility>
+
+namespace NBodySim {
+	template <class T> class FirstTouchAllocator;
+}
+
+/**
+ * @brief An allocator that leaves new elements of plain types unwritten, so the pages they occupy are placed on the NUMA
+ * node of the thread that first writes them rather than the thread that resized the container.
+ *
+ * The member templates must be seen wherever a container is instantiated, so unlike the other templates of the
+ * simulation this one is defined in its header.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::FirstTouchAllocator : public std::allocator<T> {
+public:
+	template <class U> struct rebind {
+		typedef NBodySim::FirstTouchAllocator<U> other;
+	};
+
+	/**
+	 * Default constructor
+	 */
+	FirstTouchAllocator(void){
+
+	}
+
+	/**
+	 * Converting constructor, the allocator holds no state
+	 */
+	template <class U> FirstTouchAllocator(const NBodySim::FirstTouchAllocator<U> & other){
+
+	}
+
+	/**
+	 * construct default initializes an element, which leaves a plain type unwritten
+	 *
+	 * @param element is the memory of the element
+	 */
+	template <class U> void construct(U * element){
+		::new(static_cast<void *>(element)) U;
+	}
+
+	/**
+	 * construct builds an element from arguments
+	 *
+	 * @param element is the memory of the element
+	 * @param args are passed to the constructor of the element
+	 */
+	template <class U, class... Args> void construct(U * element, Args &&... args){
+		::new(static_cast<void *>(element)) U(std::forward<Args>(args)...);
+	}
+};
+
+#endif // FIRST_TOUCH_ALLOCATOR_H
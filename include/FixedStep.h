@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FIXED_STEP_H
+#define FIXED_STEP_H
+
+#include <cstddef>
+#include <utility>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <size_t N> class PairList;
+	template <class T, size_t N, NBodySim::forcePrecision P> class FixedStep;
+	namespace FixedStepSpace {
+		/**
+		 * maxParticles is the largest system size that gets a compile time specialized step
+		 */
+		const size_t maxParticles = 32;
+
+		/**
+		 * stepFunction is the signature shared by every FixedStep<T, N, P>::step
+		 */
+		template <class T> using stepFunction = void (*)(NBodySim::Particle<T> * system, T G, T deltaT);
+
+		/**
+		 * lookup returns the specialized step function for a system of numParticles particles
+		 *
+		 * @param numParticles the number of particles in the system
+		 * @param precision is how the inverse cube of the distance between particles is calculated
+		 * @return the step function for numParticles, or NULL if numParticles is 0 or greater than maxParticles
+		 */
+		template <class T> stepFunction<T> lookup(size_t numParticles, NBodySim::forcePrecision precision);
+	}
+}
+
+/**
+ * @brief A compile time table of every unordered pair (i, j), i < j, of N particles.
+ *
+ * @author W.A. Garrett Weaver
+ */
+template <size_t N>
+class NBodySim::PairList {
+public:
+	/**
+	 * numPairs is the number of unordered pairs in a system of N particles
+	 */
+	static constexpr size_t numPairs = (N * (N - 1)) / 2;
+
+	/**
+	 * first holds the lower index of each pair, the extra element keeps the array non empty when N is 1
+	 */
+	size_t first[numPairs + 1];
+
+	/**
+	 * second holds the higher index of each pair
+	 */
+	size_t second[numPairs + 1];
+
+	/**
+	 * Constructor which fills in the pair table, evaluated at compile time
+	 */
+	constexpr PairList(void) : first(), second() {
+		size_t k = 0;
+		for(size_t i = 0; i < N; i++){
+			for(size_t j = i + 1; j < N; j++){
+				first[k] = i;
+				second[k] = j;
+				k++;
+			}
+		}
+	}
+};
+
+/**
+ * @brief Steps a system of exactly N particles with a fully unrolled pair loop.
+ *
+ * The particle state is copied into fixed size arrays so the compiler can keep it in registers and
+ * every pair interaction is expanded at compile time, each pair being evaluated once and applied to both bodies.
+ * P selects how the inverse cube of the distance is calculated.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ * @see InverseCube
+ */
+template <class T, size_t N, NBodySim::forcePrecision P>
+class NBodySim::FixedStep {
+private:
+	/**
+	 * pairs is the compile time list of particle pairs
+	 */
+	static constexpr NBodySim::PairList<N> pairs = NBodySim::PairList<N>();
+
+	/**
+	 * interact adds the acceleration particles I and J exert on each other to acc
+	 *
+	 * @param pos is the position of every particle, indexed by axis then particle
+	 * @param gm is the gravitation constant multiplied by the mass of every particle
+	 * @param acc is the acceleration of every particle, indexed by axis then particle
+	 */
+	template <size_t I, size_t J>
+	static void interact(const T (&pos)[3][N], const T (&gm)[N], T (&acc)[3][N]);
+
+	/**
+	 * accumulate calls interact for every pair in the pair list
+	 *
+	 * @param pos is the position of every particle, indexed by axis then particle
+	 * @param gm is the gravitation constant multiplied by the mass of every particle
+	 * @param acc is the acceleration of every particle, indexed by axis then particle
+	 */
+	template <size_t... K>
+	static void accumulate(const T (&pos)[3][N], const T (&gm)[N], T (&acc)[3][N], std::index_sequence<K...>);
+
+public:
+	/**
+	 * step calculates new positions and velocities of exactly N particles
+	 *
+	 * @param system is a pointer to the first of N contiguous particles
+	 * @param G is the gravitation constant of the system
+	 * @param deltaT is a floating point number of the amount of time that passes till the next step
+	 */
+	static void step(NBodySim::Particle<T> * system, T G, T deltaT);
+};
+
+#endif // FIXED_STEP_H
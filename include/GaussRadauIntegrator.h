@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GAUSS_RADAU_INTEGRATOR_H
+#define GAUSS_RADAU_INTEGRATOR_H
+
+#include <vector>
+#include <functional>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <class T> class GaussRadauIntegrator;
+	namespace GaussRadauIntegratorSpace {
+		/**
+		 * defaultTolerance is the error tolerance epsilon used when none is set
+		 */
+		const FloatingType defaultTolerance = 1e-9;
+		/**
+		 * numNodes is the number of Gauss-Radau nodes in a substep, including the start of the substep
+		 */
+		const unsigned numNodes = 8;
+		/**
+		 * maxIterations bounds the predictor-corrector iterations of one substep
+		 */
+		const unsigned maxIterations = 12;
+		/**
+		 * safetyFactor is how much a substep may shrink before it is rejected, and the inverse of how much it may grow
+		 */
+		const FloatingType safetyFactor = 0.25;
+		/**
+		 * maxSubsteps bounds the number of substeps one call to step may take, so a close encounter can not stall the simulation
+		 */
+		const size_t maxSubsteps = 1000000;
+	}
+}
+
+/**
+ * @brief Advances a system with the fifteenth order Gauss-Radau predictor-corrector scheme of IAS15.
+ *
+ * The acceleration of every particle over a substep is approximated by a seventh degree polynomial fitted at the
+ * Gauss-Radau spacings, and the positions and velocities are integrated from that polynomial. The size of the highest
+ * coefficient relative to the acceleration sets the next substep, so a call to step advances the system by exactly
+ * deltaT with as few force evaluations as the error tolerance allows. Forces come from the caller, so the integrator
+ * shares the force calculation of the system.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::GaussRadauIntegrator {
+public:
+	/**
+	 * accelerationFunction fills the second vector with the acceleration of every particle at the positions in the first
+	 */
+	typedef std::function<void(const std::vector<NBodySim::ThreeVector<T> > &, std::vector<NBodySim::ThreeVector<T> > &)> accelerationFunction;
+
+private:
+	/**
+	 * evaluate calculates the acceleration of every particle at positions into out, flattened to x, y, z triples
+	 *
+	 * @param positions is the position of every particle, flattened to x, y, z triples
+	 * @param out receives the acceleration of every particle
+	 * @param accelerations calculates the accelerations
+	 */
+	void evaluate(const std::vector<T> & positions, std::vector<T> & out, const accelerationFunction & accelerations);
+
+	/**
+	 * bToG sets the divided differences g from the polynomial coefficients b
+	 */
+	void bToG(void);
+
+	/**
+	 * scaleB rescales the polynomial coefficients b to a substep ratio times as long
+	 *
+	 * @param ratio is the length of the new substep over the length b was fitted for
+	 * @param extrapolate is true to expand the polynomial about the end of the substep, for the next substep, false to keep the start
+	 */
+	void scaleB(T ratio, bool extrapolate);
+
+	/**
+	 * nodes holds the Gauss-Radau spacings as fractions of a substep
+	 */
+	T nodes[NBodySim::GaussRadauIntegratorSpace::numNodes];
+
+	/**
+	 * basis holds basis[n][j], the coefficient of h^j in h (h - nodes[1]) ... (h - nodes[n - 1])
+	 */
+	T basis[NBodySim::GaussRadauIntegratorSpace::numNodes][NBodySim::GaussRadauIntegratorSpace::numNodes];
+
+protected:
+	/**
+	 * pos and vel hold the state of every particle, flattened to x, y, z triples, with their compensated summation errors
+	 */
+	std::vector<T> pos;
+	std::vector<T> vel;
+	std::vector<T> posError;
+	std::vector<T> velError;
+
+	/**
+	 * acc holds the acceleration of every particle at the start of a substep
+	 */
+	std::vector<T> acc;
+
+	/**
+	 * predictedPos and nodeAcc hold the position and acceleration of every particle at a node of the substep
+	 */
+	std::vector<T> predictedPos;
+	std::vector<T> nodeAcc;
+
+	/**
+	 * b holds the polynomial coefficients of the acceleration over the substep, b[k] multiplies h^(k + 1)
+	 */
+	std::vector<T> b[NBodySim::GaussRadauIntegratorSpace::numNodes - 1];
+
+	/**
+	 * g holds the divided differences of the acceleration at the nodes, g[k] multiplies basis[k + 1]
+	 */
+	std::vector<T> g[NBodySim::GaussRadauIntegratorSpace::numNodes - 1];
+
+	/**
+	 * vectorPos and vectorAcc pass positions and accelerations to the acceleration function
+	 */
+	std::vector<NBodySim::ThreeVector<T> > vectorPos;
+	std::vector<NBodySim::ThreeVector<T> > vectorAcc;
+
+	/**
+	 * tolerance is the error tolerance epsilon, smaller values take shorter substeps
+	 */
+	T tolerance;
+
+	/**
+	 * timestep is the length of the next substep
+	 */
+	T timestep;
+
+	/**
+	 * initialized indicates b, the summation errors and timestep are valid for the particles in the system
+	 */
+	bool initialized;
+
+	/**
+	 * evaluations counts the calls to the acceleration function
+	 */
+	size_t evaluations;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	GaussRadauIntegrator(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~GaussRadauIntegrator(void);
+
+	/**
+	 * reset discards the stored polynomial and substep, it must be called when particles are changed outside of step
+	 */
+	void reset(void);
+
+	/**
+	 * setTolerance sets the error tolerance
+	 *
+	 * @param epsilon is the error tolerance, smaller values take shorter substeps
+	 */
+	void setTolerance(T epsilon);
+
+	/**
+	 * getTolerance returns the error tolerance
+	 *
+	 * @return the error tolerance
+	 */
+	T getTolerance(void);
+
+	/**
+	 * getEvaluations returns how many times the accelerations have been calculated
+	 *
+	 * @return the number of force evaluations since construction
+	 */
+	size_t getEvaluations(void);
+
+	/**
+	 * step advances every particle in system by deltaT
+	 *
+	 * @param system is the set of particles to advance
+	 * @param deltaT is a floating point number of the amount of time that passes till the next step
+	 * @param accelerations calculates the acceleration of every particle from their positions
+	 */
+	void step(std::vector<NBodySim::Particle<T> > & system, T deltaT, const accelerationFunction & accelerations);
+};
+
+#endif // GAUSS_RADAU_INTEGRATOR_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HERMITE_INTEGRATOR_H
+#define HERMITE_INTEGRATOR_H
+
+#include <vector>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <class T> class HermiteIntegrator;
+	namespace HermiteIntegratorSpace {
+		/**
+		 * defaultAccuracy is the Aarseth accuracy parameter eta used when none is set
+		 */
+		const FloatingType defaultAccuracy = 0.02;
+		/**
+		 * maxSubsteps bounds the number of substeps one call to step may take, so a close encounter can not stall the simulation
+		 */
+		const size_t maxSubsteps = 1000000;
+	}
+}
+
+/**
+ * @brief Advances a system with the fourth order Hermite predictor-corrector scheme.
+ *
+ * Acceleration and jerk are calculated together in one pass over every pair. A call to step advances the system by exactly
+ * deltaT using as many shared substeps as the Aarseth criterion asks for, so the caller may use a step much longer than
+ * the symplectic Euler integrator would tolerate.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::HermiteIntegrator {
+private:
+	/**
+	 * evaluate calculates the acceleration and jerk of every particle from the given positions and velocities
+	 *
+	 * @param pos is the position of every particle
+	 * @param vel is the velocity of every particle
+	 * @param acc receives the acceleration of every particle
+	 * @param jerk receives the jerk of every particle
+	 */
+	void evaluate(const std::vector<NBodySim::ThreeVector<T> > & pos, const std::vector<NBodySim::ThreeVector<T> > & vel, std::vector<NBodySim::ThreeVector<T> > & acc, std::vector<NBodySim::ThreeVector<T> > & jerk);
+
+	/**
+	 * initialTimestep returns the substep length to start with, eta * min(|a| / |j|)
+	 *
+	 * @return the initial substep length, 0 if no particle is accelerating
+	 */
+	T initialTimestep(void);
+
+protected:
+	/**
+	 * gm holds the gravitation constant multiplied by the mass of every particle
+	 */
+	std::vector<T> gm;
+
+	/**
+	 * pos, vel, acc and jerk hold the state of every particle at the start of a substep
+	 */
+	std::vector<NBodySim::ThreeVector<T> > pos;
+	std::vector<NBodySim::ThreeVector<T> > vel;
+	std::vector<NBodySim::ThreeVector<T> > acc;
+	std::vector<NBodySim::ThreeVector<T> > jerk;
+
+	/**
+	 * predictedPos, predictedVel, newAcc and newJerk hold the state of every particle at the end of a substep
+	 */
+	std::vector<NBodySim::ThreeVector<T> > predictedPos;
+	std::vector<NBodySim::ThreeVector<T> > predictedVel;
+	std::vector<NBodySim::ThreeVector<T> > newAcc;
+	std::vector<NBodySim::ThreeVector<T> > newJerk;
+
+	/**
+	 * accuracy is the Aarseth accuracy parameter eta, smaller values take shorter substeps
+	 */
+	T accuracy;
+
+	/**
+	 * timestep is the length of the next substep
+	 */
+	T timestep;
+
+	/**
+	 * initialized indicates acc, jerk and timestep are valid for the particles in the system
+	 */
+	bool initialized;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	HermiteIntegrator(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~HermiteIntegrator(void);
+
+	/**
+	 * reset discards the stored accelerations and jerks, it must be called when particles are changed outside of step
+	 */
+	void reset(void);
+
+	/**
+	 * setAccuracy sets the Aarseth accuracy parameter
+	 *
+	 * @param eta is the accuracy parameter, smaller values take shorter substeps
+	 */
+	void setAccuracy(T eta);
+
+	/**
+	 * getAccuracy returns the Aarseth accuracy parameter
+	 *
+	 * @return the accuracy parameter
+	 */
+	T getAccuracy(void);
+
+	/**
+	 * step advances every particle in system by deltaT
+	 *
+	 * @param system is the set of particles to advance
+	 * @param G is the gravitation constant of the system
+	 * @param deltaT is a floating point number of the amount of time that passes till the next step
+	 */
+	void step(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT);
+};
+
+#endif // HERMITE_INTEGRATOR_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INVERSE_CUBE_H
+#define INVERSE_CUBE_H
+
+#include <cmath>
+#include <limits>
+#include <cstddef>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#include "NBodyTypes.h"
+
+namespace NBodySim {
+	template <class T, NBodySim::forcePrecision P> class InverseCube;
+}
+
+/**
+ * @brief Calculates r^-3 from r^2 at the accuracy level P.
+ *
+ * Unlike the rest of the project the methods are defined in this header, they sit inside every pair loop and must be inlined.
+ *
+ * @author W.A. Garrett Weaver
+ * @see forcePrecision
+ */
+template <class T, NBodySim::forcePrecision P>
+class NBodySim::InverseCube {
+private:
+	/**
+	 * refinements is the number of Newton-Raphson iterations applied to the reciprocal square root estimate
+	 */
+	static const unsigned refinements = (P == NBodySim::FAST) ? 1 : 2;
+
+	/**
+	 * estimate returns an approximation of 1 / sqrt(x) with a relative error below 2^-11
+	 *
+	 * @param x is a positive number inside the range of a normal float
+	 * @return the approximate reciprocal square root of x
+	 */
+	static T estimate(T x){
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		return static_cast<T>(_mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(static_cast<float>(x)))));
+#else
+		// Without a hardware estimate start from the exact value, the refinements then leave it unchanged
+		return 1 / std::sqrt(x);
+#endif
+	}
+
+public:
+	/**
+	 * calculate returns the inverse cube of a distance given the square of the distance
+	 *
+	 * @param distanceSquared is the square of the distance between two particles, it must not be 0
+	 * @return 1 / distance^3
+	 */
+	static T calculate(T distanceSquared){
+		T y;
+
+		// The estimate is done in single precision, use the exact path for distances a float can not hold
+		if(P == NBodySim::ACCURATE || distanceSquared > std::numeric_limits<float>::max() || distanceSquared < std::numeric_limits<float>::min()){
+			return 1 / (distanceSquared * std::sqrt(distanceSquared));
+		}
+
+		y = estimate(distanceSquared);
+		for(unsigned i = 0; i < refinements; i++){
+			y = y * (static_cast<T>(1.5) - (static_cast<T>(0.5) * distanceSquared) * (y * y));
+		}
+		return y * y * y;
+	}
+
+	/**
+	 * calculate fills inverseCube with the inverse cube of every distance in distanceSquared
+	 *
+	 * @param distanceSquared is an array of count squared distances, a distance of 0 produces 0
+	 * @param inverseCube is an array of count elements that receives 1 / distance^3
+	 * @param count is the number of distances
+	 */
+	static void calculate(const T * distanceSquared, T * inverseCube, size_t count){
+		size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		i = calculatePairs(distanceSquared, inverseCube, count);
+#endif
+		for(; i < count; i++){
+			inverseCube[i] = (distanceSquared[i] == 0) ? 0 : calculate(distanceSquared[i]);
+		}
+	}
+
+private:
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	/**
+	 * calculatePairs works through distanceSquared two doubles at a time with SSE2
+	 *
+	 * @param distanceSquared is an array of count squared distances, a distance of 0 produces 0
+	 * @param inverseCube is an array of count elements that receives 1 / distance^3
+	 * @param count is the number of distances
+	 * @return the number of distances calculated, the caller finishes the rest
+	 */
+	static size_t calculatePairs(const double * distanceSquared, double * inverseCube, size_t count){
+		const __m128d one = _mm_set1_pd(1.0);
+		const __m128d threeHalves = _mm_set1_pd(1.5);
+		const __m128d half = _mm_set1_pd(0.5);
+		const __m128d floatMin = _mm_set1_pd(std::numeric_limits<float>::min());
+		const __m128d floatMax = _mm_set1_pd(std::numeric_limits<float>::max());
+		__m128d x;
+		__m128d y;
+		__m128d inRange;
+		size_t i;
+
+		for(i = 0; i + 2 <= count; i += 2){
+			x = _mm_loadu_pd(distanceSquared + i);
+			if(P == NBodySim::ACCURATE){
+				y = _mm_div_pd(one, _mm_mul_pd(x, _mm_sqrt_pd(x)));
+				// Zero distances divide by zero, mask them out
+				y = _mm_and_pd(_mm_cmpneq_pd(x, _mm_setzero_pd()), y);
+			}
+			else{
+				inRange = _mm_and_pd(_mm_cmpge_pd(x, floatMin), _mm_cmple_pd(x, floatMax));
+				y = _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(x)));
+				for(unsigned k = 0; k < refinements; k++){
+					y = _mm_mul_pd(y, _mm_sub_pd(threeHalves, _mm_mul_pd(_mm_mul_pd(half, x), _mm_mul_pd(y, y))));
+				}
+				y = _mm_and_pd(inRange, _mm_mul_pd(y, _mm_mul_pd(y, y)));
+				// Distances a float can not hold fall back to the scalar path, zero distances stay 0
+				if(_mm_movemask_pd(inRange) != 3){
+					_mm_storeu_pd(inverseCube + i, y);
+					for(size_t k = i; k < i + 2; k++){
+						if(distanceSquared[k] != 0 && inverseCube[k] == 0){
+							inverseCube[k] = calculate(distanceSquared[k]);
+						}
+					}
+					continue;
+				}
+			}
+			_mm_storeu_pd(inverseCube + i, y);
+		}
+		return i;
+	}
+
+	/**
+	 * calculatePairs handles every type other than double, it leaves all the work to the scalar loop
+	 *
+	 * @return 0, no distances were calculated
+	 */
+	template <class U>
+	static size_t calculatePairs(const U *, U *, size_t){
+		return 0;
+	}
+#endif
+};
+
+#endif // INVERSE_CUBE_H
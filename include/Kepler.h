@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include "NBodyTypes.h"
+
+namespace NBodySim {
+	template <class T> class Kepler;
+	namespace KeplerSpace {
+		/**
+		 * maxIterations bounds the iterations of the universal Kepler equation solver
+		 */
+		const unsigned maxIterations = 50;
+	}
+}
+
+/**
+ * @brief Moves a body along its exact two body orbit about a point mass.
+ *
+ * The universal Kepler equation is solved with Stumpff functions, so elliptic, parabolic and hyperbolic orbits are handled alike.
+ *
+ * @author W.A. Garrett Weaver
+ * @see WisdomHolmanIntegrator
+ */
+template <class T>
+class NBodySim::Kepler {
+private:
+	/**
+	 * stumpff calculates the Stumpff functions c2(z) and c3(z)
+	 *
+	 * @param z is alpha times the square of the universal anomaly
+	 * @param c2 receives (1 - cos(sqrt(z))) / z
+	 * @param c3 receives (sqrt(z) - sin(sqrt(z))) / sqrt(z)^3
+	 */
+	static void stumpff(T z, T * c2, T * c3);
+
+public:
+	/**
+	 * drift moves a body along its Kepler orbit about a point mass
+	 *
+	 * @param mu is the gravitation constant multiplied by the central mass
+	 * @param pos is the position relative to the central mass, updated in place
+	 * @param vel is the velocity relative to the central mass, updated in place
+	 * @param dt is the time to advance
+	 */
+	static void drift(T mu, NBodySim::ThreeVector<T> * pos, NBodySim::ThreeVector<T> * vel, T dt);
+};
+
+#endif // KEPLER_H
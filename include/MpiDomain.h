@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef MPI_DOMAIN_H
+#define MPI_DOMAIN_H
+
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <functional>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+
+namespace NBodySim {
+	template <class T> class MpiDomain;
+}
+
+/**
+ * @brief Spreads a simulation over the processes of an MPI job, each process stepping one stretch of a space filling curve.
+ *
+ * The first process reads the scenario, numbers the particles along a Morton or Hilbert curve and scatters every process
+ * one contiguous run of those ids, so every process steps particles near each other in space and the other processes
+ * never hold more than their share of the particles. The direct summation needs every particle as a source, so during each step the
+ * processes broadcast their sources one block at a time, in id order, and every process adds each block to the
+ * accelerations of its particles before the next one takes its place. The next block travels while the current one is
+ * summed, so a process holds its own sources and two blocks, never all of them. Summing the blocks in id order carries
+ * every target sum through the sources in the order a single process would, so a distributed run gives the same result
+ * as a single process stepping them in curve order. Snapshots are gathered on the first process, back in the order
+ * the particles were given.
+ *
+ * Only this class includes the MPI headers; it is built by make mpi and make mpitest.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::MpiDomain {
+private:
+	/**
+	 * exchange replaces the sources of this process with the sources of every process in turn, block by block in id
+	 * order, calling sumBlock once each block is in place
+	 *
+	 * @param x is the x position of every source
+	 * @param y is the y position of every source
+	 * @param z is the z position of every source
+	 * @param gm is the gravitation constant times the mass of every source
+	 * @param sumBlock adds the forces of the sources in place to the accelerations
+	 */
+	void exchange(typename NBodySim::NBodySystem<T>::sourceArray & x, typename NBodySim::NBodySystem<T>::sourceArray & y, typename NBodySim::NBodySystem<T>::sourceArray & z, typename NBodySim::NBodySystem<T>::sourceArray & gm, const std::function<void(void)> & sumBlock);
+
+	/**
+	 * pack writes the position, velocity, mass and radius of a particle to values
+	 *
+	 * @param p is the particle
+	 * @param values receives the state of the particle
+	 */
+	static void pack(const NBodySim::Particle<T> & p, T * values);
+
+	/**
+	 * unpack sets the position, velocity, mass and radius of a particle from values written by pack
+	 *
+	 * @param values is the state of the particle
+	 * @param p is the particle
+	 */
+	static void unpack(const T * values, NBodySim::Particle<T> & p);
+
+protected:
+	/**
+	 * rank is the index of this process and numRanks the number of processes
+	 */
+	int rank;
+	int numRanks;
+
+	/**
+	 * counts and displacements hold the number of particles of every process and the id of its first particle
+	 */
+	std::vector<int> counts;
+	std::vector<int> displacements;
+
+	/**
+	 * nameIds holds the name id of every particle in the order they were given, kept by the first process to label
+	 * gathered snapshots
+	 */
+	std::vector<uint32_t> nameIds;
+
+	/**
+	 * curveOrder holds, for every id, the index the particle was given at, kept by the first process
+	 */
+	std::vector<size_t> curveOrder;
+
+	/**
+	 * sendBuffer and receiveBuffer hold the packed particles of a collective operation
+	 */
+	std::vector<T> sendBuffer;
+	std::vector<T> receiveBuffer;
+
+	/**
+	 * blockBuffers hold the packed sources of the block being summed and of the block arriving during an exchange
+	 */
+	std::vector<T> blockBuffers[2];
+
+public:
+	/**
+	 * constructor which reads the rank and size of MPI_COMM_WORLD, MPI must already be initialized
+	 */
+	MpiDomain(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~MpiDomain(void);
+
+	/**
+	 * getRank returns the index of this process
+	 *
+	 * @return the rank of this process
+	 */
+	int getRank(void);
+
+	/**
+	 * getNumRanks returns the number of processes
+	 *
+	 * @return the number of processes
+	 */
+	int getNumRanks(void);
+
+	/**
+	 * cut shares the particle ids out to the processes in equal contiguous runs, which scatter makes runs of the curve
+	 *
+	 * @param numParticles is the number of particles of the simulation
+	 */
+	void cut(size_t numParticles);
+
+	/**
+	 * getFirst returns the id of the first particle of this process, after cut
+	 *
+	 * @return the first id of this process
+	 */
+	size_t getFirst(void);
+
+	/**
+	 * getCount returns the number of particles of this process, after cut
+	 *
+	 * @return the number of particles of this process
+	 */
+	size_t getCount(void);
+
+	/**
+	 * scatter numbers the particles along a curve and sends every process its run of them, every process must call it
+	 * after cut
+	 *
+	 * @param all is every particle, only read on the first process
+	 * @param mine receives the particles of this process in id order
+	 * @param curve is the curve the particles are numbered along
+	 */
+	void scatter(const std::vector<NBodySim::Particle<T> > & all, std::vector<NBodySim::Particle<T> > & mine, NBodySim::curveType curve);
+
+	/**
+	 * decompose adds the particles of this process to local and connects local to the other processes
+	 *
+	 * @param mine is the run of particles of this process in id order, as scatter leaves it
+	 * @param local is an empty system which receives the particles of this process
+	 */
+	void decompose(const std::vector<NBodySim::Particle<T> > & mine, NBodySim::NBodySystem<T> & local);
+
+	/**
+	 * gather collects every particle on the first process, every process must call it
+	 *
+	 * @param local is the system of this process
+	 * @param all receives every particle in the order given to scatter on the first process and is left empty on the others
+	 */
+	void gather(NBodySim::NBodySystem<T> & local, std::vector<NBodySim::Particle<T> > & all);
+};
+
+#endif // MPI_DOMAIN_H
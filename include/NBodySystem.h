@@ -23,13 +23,66 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <istream>
+#include <ostream>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
 
 #include "NBodyTypes.h"
 #include "Particle.h"
+#include "FixedStep.h"
+#include "HermiteIntegrator.h"
+#include "WisdomHolmanIntegrator.h"
+#include "GaussRadauIntegrator.h"
+#include "CollisionDetector.h"
+#include "BinaryRegularizer.h"
+#include "TaskScheduler.h"
+#include "SpaceFillingCurve.h"
+#include "FirstTouchAllocator.h"
+
+namespace rapidxml {
+	template <class Ch> class xml_node;
+}
 
 namespace NBodySim {
 	template <class T> class NBodySystem;
 	namespace NBodySystemSpace {
+		/**
+		 * chunkLength is how many source particles the direct summation handles at once, sized to stay in L1 cache
+		 */
+		const size_t chunkLength = 64;
+		/**
+		 * taskLength is how many target particles make up one task when the direct summation is shared out to threads
+		 */
+		const size_t taskLength = 64;
+		/**
+		 * defaultImbalanceThreshold is the ratio of the busiest thread's work to the mean above which the cost balanced
+		 * partition is redrawn
+		 */
+		const FloatingType defaultImbalanceThreshold = 1.05;
+		/**
+		 * defaultL1CacheSize is the L1 data cache size, in bytes, assumed when the operating system can not report it
+		 */
+		const size_t defaultL1CacheSize = 32768;
+		/**
+		 * defaultL2CacheSize is the L2 cache size, in bytes, assumed when the operating system can not report it
+		 */
+		const size_t defaultL2CacheSize = 262144;
+		/**
+		 * parallelParseLength is the length of xml text, in bytes, from which parse splits the particles over the threads
+		 */
+		const size_t parallelParseLength = 1048576;
+		/**
+		 * parseChunkLength is the smallest length of xml text, in bytes, a thread parses at once
+		 */
+		const size_t parseChunkLength = 262144;
+		/**
+		 * hashBasis and hashPrime are the offset basis and prime of the 64 bit FNV-1a hash stateHash folds the state into
+		 */
+		const uint64_t hashBasis = 0xcbf29ce484222325ULL;
+		const uint64_t hashPrime = 0x100000001b3ULL;
 		const unsigned particleAttributeListLength = 8;
 		const char particleAttributeList [][NBodySim::NBodySystemSpace::particleAttributeListLength] = {"posX", "posY", "posZ", "velX", "velY", "velZ", "mass", "name"};
 		/**
@@ -67,7 +120,15 @@ namespace NBodySim {
 			/**
 			 * Index of NAME
 			 */
-			NAME = 7
+			NAME = 7,
+			/**
+			 * Index of the optional radius, which is not in the particle attribute list
+			 */
+			RADIUS = 8,
+			/**
+			 * Index of an attribute the parser does not know
+			 */
+			UNKNOWN_ATTRIBUTE = 9
 		} particleAttributeIndexes;
 		/**
 		 * List of errors the parse method can have
@@ -128,9 +189,51 @@ namespace NBodySim {
 			/**
 			 * No NAME attribute provided
 			 */
-			NO_NAME
+			NO_NAME,
+			/**
+			 * A row of a column file has too few columns or a value that is not a number
+			 */
+			BAD_ROW,
+			/**
+			 * appendParticles, commitParticles or cancelParticles was called without a call to beginParticles first
+			 */
+			NOT_INGESTING,
+			/**
+			 * A bulk setter was given a different number of values than there are particles
+			 */
+			WRONG_LENGTH
 		} error;
 	}
+	
+	/**
+	 * @brief A read only view of the particles of a system in index order, which copies nothing and checks no bounds.
+	 *
+	 * The view is valid until particles are added or removed, or the system steps.
+	 */
+	template <class T> struct ParticleView {
+		const NBodySim::Particle<T> * particles; /**< The storage of the system, in storage order */
+		const size_t * slots;                    /**< The position in storage of the particle with every index */
+		size_t length;                           /**< The number of particles */
+		
+		/**
+		 * size returns the number of particles
+		 *
+		 * @return the number of particles
+		 */
+		size_t size(void) const {
+			return length;
+		}
+		
+		/**
+		 * operator[] returns the particle with an index
+		 *
+		 * @param index is the index of the particle, below size()
+		 * @return the particle
+		 */
+		const NBodySim::Particle<T> & operator[](size_t index) const {
+			return particles[slots[index]];
+		}
+	};
 }
 
 
@@ -143,17 +246,404 @@ namespace NBodySim {
  */
 template <class T>
 class NBodySim::NBodySystem {
+public:
+	/**
+	 * sourceArray holds one property of every source particle of the direct summation
+	 */
+	typedef std::vector<T, NBodySim::FirstTouchAllocator<T> > sourceArray;
+	
+	/**
+	 * exchangeFunction receives the x, y, z and gravitation constant times mass of the particles of this process in id
+	 * order and replaces them in turn with those of every block of particles of the simulation, in id order, calling the
+	 * last argument once each block is in place to add its forces
+	 */
+	typedef std::function<void(sourceArray &, sourceArray &, sourceArray &, sourceArray &, const std::function<void(void)> &)> exchangeFunction;
+	
 private:
+	/**
+	 * defaultTargetTileLength returns the number of target particles whose positions and accelerations fill half of the L2 cache
+	 *
+	 * @return the target tile length used when none is configured
+	 */
+	static size_t defaultTargetTileLength(void);
+	
+	/**
+	 * defaultSourceTileLength returns the number of source particles whose positions and masses fill half of the L1 cache
+	 *
+	 * @return the source tile length used when none is configured
+	 */
+	static size_t defaultSourceTileLength(void);
 	
 protected:
 	/**
 	 * system is set of all particles, where the order doesn't matter, but a vector was used anyways.
 	 */
 	std::vector<NBodySim::Particle<T> > system;
+	
+	/**
+	 * parseErrorLine is the line of the element the last parse failed at, 0 if it succeeded or failed outside an element
+	 */
+	size_t parseErrorLine;
+	
+	/**
+	 * slotOf holds the position in system of the particle with every id, ids run from 0 to the number of particles in
+	 * the order particles were added, whatever order system is stored in
+	 */
+	std::vector<size_t> slotOf;
+	
+	/**
+	 * nameIndex holds the index of the first particle with every name id, built by findParticle when nameIndexValid is
+	 * false and dropped whenever particles are added or removed
+	 */
+	std::unordered_map<uint32_t, size_t> nameIndex;
+	bool nameIndexValid;
+	
+	/**
+	 * reorderInterval is the number of steps between sorts of system along reorderCurve, 0 never sorts
+	 */
+	size_t reorderInterval;
+	size_t stepsSinceReorder;
+	
+	/**
+	 * ingesting is true between beginParticles and commitParticles or cancelParticles, ingestFirst is the number of
+	 * particles the system had at beginParticles
+	 */
+	bool ingesting;
+	size_t ingestFirst;
+	NBodySim::curveType reorderCurve;
+	
+	/**
+	 * curve sorts the particles along a space filling curve, permutation and reordered hold its result
+	 */
+	NBodySim::SpaceFillingCurve<T> curve;
+	std::vector<size_t> permutation;
+	std::vector<NBodySim::Particle<T> > reordered;
+	
 	/**
 	 * G is the gravitation constant for the objects system
 	 */
 	FloatingType G;
+	
+	/**
+	 * sourceX, sourceY and sourceZ hold the position of every particle at the start of a step, first written by the
+	 * threads that own their targets
+	 */
+	sourceArray sourceX;
+	sourceArray sourceY;
+	sourceArray sourceZ;
+	
+	/**
+	 * sourceGM holds the gravitation constant multiplied by the mass of every particle at the start of a step
+	 */
+	sourceArray sourceGM;
+	
+	/**
+	 * sourceExchange completes the sources with the particles of other processes, empty when this process holds them all
+	 */
+	exchangeFunction sourceExchange;
+	
+	/**
+	 * targetIndex holds the position of every particle among the sources, empty when the sources are the particles in
+	 * order
+	 */
+	std::vector<size_t> targetIndex;
+	
+	/**
+	 * exchangeTargetX, exchangeTargetY and exchangeTargetZ hold the position of every particle of this process, laid out
+	 * as the sources, while the sources are the blocks of an exchange
+	 */
+	sourceArray exchangeTargetX;
+	sourceArray exchangeTargetY;
+	sourceArray exchangeTargetZ;
+	
+	/**
+	 * exchanging indicates the sources are a block of an exchange, blocksSummed is the number of blocks of the step
+	 * already added to the accelerations
+	 */
+	bool exchanging;
+	size_t blocksSummed;
+	
+	/**
+	 * replicaX, replicaY, replicaZ and replicaGM hold a copy of the source arrays on every NUMA node but the first, so
+	 * the force calculation on every node reads only local memory
+	 */
+	std::vector<sourceArray> replicaX;
+	std::vector<sourceArray> replicaY;
+	std::vector<sourceArray> replicaZ;
+	std::vector<sourceArray> replicaGM;
+	
+	/**
+	 * accelerationX, accelerationY and accelerationZ accumulate the acceleration of every particle during a step, each
+	 * target is first written by the thread summing it
+	 */
+	sourceArray accelerationX;
+	sourceArray accelerationY;
+	sourceArray accelerationZ;
+	
+	/**
+	 * compensationX, compensationY and compensationZ carry the low order bits the compensated summation of every target
+	 * has lost so far, only used in deterministic mode
+	 */
+	sourceArray compensationX;
+	sourceArray compensationY;
+	sourceArray compensationZ;
+	
+	/**
+	 * deterministic indicates whether every source is summed in id order with compensated summation
+	 */
+	bool deterministic;
+	
+	/**
+	 * targetTileLength is how many target particles share one pass over each source tile
+	 */
+	size_t targetTileLength;
+	
+	/**
+	 * sourceTileLength is how many source particles are held in cache while a target tile is summed against them
+	 */
+	size_t sourceTileLength;
+	
+	/**
+	 * precision is how the inverse cube of the distance between particles is calculated
+	 */
+	NBodySim::forcePrecision precision;
+	
+	/**
+	 * integrator is how the system is advanced through time
+	 */
+	NBodySim::integratorType integrator;
+	
+	/**
+	 * hermite holds the accelerations and jerks carried between steps by the Hermite integrator
+	 */
+	NBodySim::HermiteIntegrator<T> hermite;
+	
+	/**
+	 * wisdomHolman advances the system when the Wisdom-Holman integrator is selected
+	 */
+	NBodySim::WisdomHolmanIntegrator<T> wisdomHolman;
+	
+	/**
+	 * gaussRadau holds the acceleration polynomial and substep carried between steps by the Gauss-Radau integrator
+	 */
+	NBodySim::GaussRadauIntegrator<T> gaussRadau;
+	
+	/**
+	 * collisionsEnabled indicates whether overlapping particles are merged after every step
+	 */
+	bool collisionsEnabled;
+	
+	/**
+	 * collisions finds and merges overlapping particles
+	 */
+	NBodySim::CollisionDetector<T> collisions;
+	
+	/**
+	 * mergedIds holds the ids of the particles absorbed by the last collision pass, kept to reuse its memory
+	 */
+	std::vector<size_t> mergedIds;
+	
+	/**
+	 * regularizationEnabled indicates whether tight binaries are advanced analytically
+	 */
+	bool regularizationEnabled;
+	
+	/**
+	 * regularizer finds tight binaries and advances their internal orbits
+	 */
+	NBodySim::BinaryRegularizer<T> regularizer;
+	
+	/**
+	 * scheduler shares the force calculation out to threads, empty when the system is stepped by the calling thread alone
+	 */
+	std::shared_ptr<NBodySim::TaskScheduler> scheduler;
+	
+	/**
+	 * costBalancingEnabled indicates whether the force calculation is partitioned by measured cost instead of by stealing
+	 */
+	bool costBalancingEnabled;
+	
+	/**
+	 * imbalanceThreshold is the imbalance ratio above which the partition is redrawn from the latest costs
+	 */
+	T imbalanceThreshold;
+	
+	/**
+	 * imbalance is the ratio of the busiest thread's work to the mean work of the threads in the last force calculation
+	 */
+	T imbalance;
+	
+	/**
+	 * particleCost holds the time, in seconds, the last force calculation spent on every target particle
+	 */
+	std::vector<double> particleCost;
+	
+	/**
+	 * partition holds the first target particle of every thread followed by the number of particles
+	 */
+	std::vector<size_t> partition;
+	
+	/**
+	 * fixedKernelEnabled indicates whether small systems may be stepped by a compile time specialized kernel
+	 */
+	bool fixedKernelEnabled;
+	
+	/**
+	 * fixedStep is the specialized step function for the current number of particles, NULL when none applies
+	 */
+	NBodySim::FixedStepSpace::stepFunction<T> fixedStep;
+	
+	/**
+	 * selectKernel picks the step kernel for the current number of particles, called whenever the particles change outside of step
+	 */
+	void selectKernel(void);
+	
+	/**
+	 * removeId removes the particle with an id in constant time, the particle with the highest id takes over its id and
+	 * slot, and the particle stored last fills the slot that one leaves
+	 *
+	 * @param id is the id of the particle to remove
+	 */
+	void removeId(size_t id);
+	
+	/**
+	 * accelerateTargets sums the acceleration of the target particles in [targetStart, targetEnd) from every source particle
+	 *
+	 * @param targetStart is the first target particle
+	 * @param targetEnd is one past the last target particle
+	 * @param node is the NUMA node of the calling thread, whose copy of the sources is read
+	 * @tparam C is true to sum with Kahan compensation
+	 */
+	template <NBodySim::forcePrecision P, bool C>
+	void accelerateTargets(size_t targetStart, size_t targetEnd, unsigned node);
+	
+	/**
+	 * accelerateRange calls accelerateTargets with compensation in deterministic mode and without it otherwise
+	 *
+	 * @param targetStart is the first target particle
+	 * @param targetEnd is one past the last target particle
+	 * @param node is the NUMA node of the calling thread, whose copy of the sources is read
+	 */
+	template <NBodySim::forcePrecision P>
+	void accelerateRange(size_t targetStart, size_t targetEnd, unsigned node);
+	
+	/**
+	 * hashParticle folds the bits of the position, velocity and mass of a particle into a hash
+	 *
+	 * @param hash is the hash so far
+	 * @param p is the particle
+	 * @return the new hash
+	 */
+	static uint64_t hashParticle(uint64_t hash, const NBodySim::Particle<T> & p);
+	
+	/**
+	 * shareOut calls body on equal, contiguous ranges of [0, numParticles) on every thread, the same ranges the force
+	 * calculation starts every thread with, so the arrays body first writes are local to the threads that read them
+	 *
+	 * @param numParticles is the number of particles
+	 * @param body is called once per range
+	 */
+	void shareOut(size_t numParticles, const NBodySim::TaskScheduler::rangeFunction & body);
+	
+	/**
+	 * replicate copies the source arrays to every NUMA node but the first, on a thread of that node
+	 */
+	void replicate(void);
+	
+	/**
+	 * accelerate sums the acceleration of every source particle into accelerationX, accelerationY and accelerationZ,
+	 * tile by tile so each source tile is read from memory once per target tile instead of once per target particle
+	 */
+	template <NBodySim::forcePrecision P>
+	void accelerate(void);
+	
+	/**
+	 * accelerateBalanced sums the acceleration of every particle with each thread given one contiguous range of targets of
+	 * equal cost, recording the cost of every target for the next call
+	 */
+	template <NBodySim::forcePrecision P>
+	void accelerateBalanced(void);
+	
+	/**
+	 * partitionByCost cuts the targets into one contiguous range per thread of equal summed cost from a prefix sum of
+	 * particleCost
+	 */
+	void partitionByCost(void);
+	
+	/**
+	 * accelerations calculates the acceleration of every particle as if it were at the given position
+	 *
+	 * @param positions is the position of every particle
+	 * @param out receives the acceleration of every particle
+	 */
+	void accelerations(const std::vector<NBodySim::ThreeVector<T> > & positions, std::vector<NBodySim::ThreeVector<T> > & out);
+	
+	/**
+	 * stepDirect calculates new positions and velocities with one symplectic Euler step from the accelerations summed by accelerate
+	 *
+	 * @param deltaT is a floating point number of the amount of time that passes till the next step
+	 */
+	template <NBodySim::forcePrecision P>
+	void stepDirect(T deltaT);
+	
+	/**
+	 * attributeIndex returns which attribute of a particle a name is
+	 *
+	 * @param name is the name of the attribute, not terminated
+	 * @param length is the length of the name
+	 * @return the index of the attribute in the particle attribute list, RADIUS or UNKNOWN_ATTRIBUTE
+	 */
+	static unsigned attributeIndex(const char * name, size_t length);
+	
+	/**
+	 * parseNumber converts the text of an attribute to a number, text which is not a number gives 0 as atof does
+	 *
+	 * @param first is the first character of the text
+	 * @param last is one past the last character of the text
+	 * @return the number
+	 */
+	static T parseNumber(const char * first, const char * last);
+	
+	/**
+	 * parseParticles appends a particle for every element from node to its last sibling, stopping at the first element
+	 * missing an attribute
+	 *
+	 * @param node is the first particle element
+	 * @param out receives the particles
+	 * @param failed receives the element missing an attribute, if any
+	 * @return SUCCESS or the error of the element missing an attribute
+	 */
+	static NBodySim::NBodySystemSpace::error parseParticles(rapidxml::xml_node<char> * node, std::vector<NBodySim::Particle<T> > & out, rapidxml::xml_node<char> ** failed);
+	
+	/**
+	 * parseChunks parses the particles of a large scenario on every thread, each thread parsing a run of particle
+	 * elements split at tag boundaries, in the same order and with the same errors as parsing it on one thread
+	 *
+	 * @param xmlText is the xml text of the scenario
+	 * @param result receives the result of the parse
+	 * @return false, having added nothing, if the text holds anything but particles in its system, such as comments, so
+	 * it must be parsed on one thread
+	 */
+	bool parseChunks(const std::string & xmlText, NBodySim::NBodySystemSpace::error * result);
+	
+	/**
+	 * splitColumns splits a line of a column file into its fields, a field may be quoted to hold the delimiter
+	 *
+	 * @param line is the line to split
+	 * @param delimiter is the character between fields, 0 for runs of spaces and tabs
+	 * @param fields receives the fields, the strings already in it are reused
+	 * @return the number of fields
+	 */
+	static size_t splitColumns(const std::string & line, char delimiter, std::vector<std::string> & fields);
+	
+	/**
+	 * readNumber converts a field of a column file to a number
+	 *
+	 * @param field is the field, spaces around the number are allowed
+	 * @param value receives the number
+	 * @return false if the field is not exactly one number
+	 */
+	static bool readNumber(const std::string & field, T * value);
 public:
 	/**
 	 * Default constructor
@@ -173,13 +663,106 @@ public:
 	void addParticle(NBodySim::Particle<T> p);
 	
 	/**
-	 * getParticle returns a particle based on its index
+	 * beginParticles starts loading particles in batches with appendParticles, the system must not be stepped or
+	 * changed otherwise until commitParticles or cancelParticles
+	 *
+	 * @param expected is the number of particles that will be appended if it is known, their storage is allocated at once
+	 * so it is never copied to grow while they arrive, 0 if unknown
+	 */
+	void beginParticles(size_t expected = 0);
+	
+	/**
+	 * appendParticles adds a batch of particles, numbered after those already in the system, the caller may reuse the
+	 * batch as soon as this returns so only one batch need be held at a time
+	 *
+	 * @param batch is the first particle of the batch
+	 * @param count is the number of particles in the batch
+	 * @return SUCCESS or NOT_INGESTING
+	 */
+	NBodySim::NBodySystemSpace::error appendParticles(const NBodySim::Particle<T> * batch, size_t count);
+	
+	/**
+	 * commitParticles finishes loading the particles appended since beginParticles and readies the system to step
+	 *
+	 * @return SUCCESS, NO_PARTICLES if none were appended or NOT_INGESTING
+	 */
+	NBodySim::NBodySystemSpace::error commitParticles(void);
+	
+	/**
+	 * cancelParticles removes the particles appended since beginParticles, for a reader that fails part way
+	 *
+	 * @return SUCCESS or NOT_INGESTING
+	 */
+	NBodySim::NBodySystemSpace::error cancelParticles(void);
+	
+	/**
+	 * getParticle returns a particle based on its index, which is its id and does not change when the storage is reordered
 	 *
 	 * @param index the index of the particle to return
 	 * @return the particle specified by the index
 	 */
 	NBodySim::Particle<T> getParticle(size_t index);
 	
+	/**
+	 * copyParticles copies every particle in index order, assigning over the particles already in out so a reused vector
+	 * allocates nothing once it has held a system of this size
+	 *
+	 * @param out receives the particles
+	 */
+	void copyParticles(std::vector<NBodySim::Particle<T> > & out);
+	
+	/**
+	 * viewParticles returns a view of the particles in index order without copying them
+	 *
+	 * @return the view, valid until particles are added or removed or the system steps
+	 */
+	NBodySim::ParticleView<T> viewParticles(void);
+	
+	/**
+	 * getPositions copies the position of every particle in index order, reusing the storage of out
+	 *
+	 * @param out receives the positions
+	 */
+	void getPositions(std::vector<NBodySim::ThreeVector<T> > & out);
+	
+	/**
+	 * getVelocities copies the velocity of every particle in index order, reusing the storage of out
+	 *
+	 * @param out receives the velocities
+	 */
+	void getVelocities(std::vector<NBodySim::ThreeVector<T> > & out);
+	
+	/**
+	 * getMasses copies the mass of every particle in index order, reusing the storage of out
+	 *
+	 * @param out receives the masses
+	 */
+	void getMasses(std::vector<T> & out);
+	
+	/**
+	 * setPositions sets the position of every particle, the integrators start over from the new state
+	 *
+	 * @param positions holds one position per particle in index order
+	 * @return SUCCESS or WRONG_LENGTH, in which case nothing is changed
+	 */
+	NBodySim::NBodySystemSpace::error setPositions(const std::vector<NBodySim::ThreeVector<T> > & positions);
+	
+	/**
+	 * setVelocities sets the velocity of every particle, the integrators start over from the new state
+	 *
+	 * @param velocities holds one velocity per particle in index order
+	 * @return SUCCESS or WRONG_LENGTH, in which case nothing is changed
+	 */
+	NBodySim::NBodySystemSpace::error setVelocities(const std::vector<NBodySim::ThreeVector<T> > & velocities);
+	
+	/**
+	 * setMasses sets the mass of every particle, the integrators start over from the new state
+	 *
+	 * @param masses holds one mass per particle in index order
+	 * @return SUCCESS or WRONG_LENGTH, in which case nothing is changed
+	 */
+	NBodySim::NBodySystemSpace::error setMasses(const std::vector<T> & masses);
+	
 	/**
 	 * numParticles returns the number of particles in the simulation
 	 *
@@ -188,11 +771,21 @@ public:
 	size_t numParticles(void);
 	
 	/**
-	 * removeParticle removes a particle from the simulation based on its index
+	 * findParticle returns the index of the first particle with a name
+	 *
+	 * @param name is the name to look for
+	 * @return the index of the particle, the number of particles if none has the name
+	 */
+	size_t findParticle(std::string name);
+	
+	/**
+	 * removeParticle removes a particle from the simulation based on its index in constant time, the particle of the
+	 * highest index takes over the removed index and the others keep theirs
 	 *
 	 * @param index is the index of the particle to be removed
+	 * @return INDEX_EXCEEDED if there is no particle with the index, SUCCESS otherwise
 	 */
-	void removeParticle(size_t index);
+	NBodySim::NBodySystemSpace::error removeParticle(size_t index);
 	
 	/**
 	 * step calculates new positions and velocities of the particles in the system
@@ -202,13 +795,52 @@ public:
 	void step(T deltaT);
 	
 	/**
-	 * parse takes in a string containing xml text of a system scenario and creates particle instances in this class
+	 * parse takes in a string containing xml text of a system scenario and creates particle instances in this class, a
+	 * large scenario is parsed on the threads set with setNumThreads
 	 *
 	 * @param xmlText is a string containing valid xml
 	 * @return 0 on success
 	 */
 	NBodySim::NBodySystemSpace::error parse(std::string xmlText);
 	
+	/**
+	 * parseColumns reads particles from a column file, one particle per row, read a line at a time
+	 *
+	 * The first line which is not a comment names the columns, with the names of the xml attributes, in any order. posX to
+	 * mass are required, particles are named by their index if there is no name column, other columns are ignored. The
+	 * columns are separated by commas if the header holds one and by spaces and tabs otherwise. Lines starting with # are
+	 * comments, except that "# G value" sets the gravitation constant.
+	 *
+	 * @param in is the stream to read
+	 * @return SUCCESS, the error of a missing column, NO_PARTICLES or BAD_ROW
+	 */
+	NBodySim::NBodySystemSpace::error parseColumns(std::istream & in);
+	
+	/**
+	 * writeColumns writes particles as a column file parseColumns can read back exactly
+	 *
+	 * @param out is the stream to write to
+	 * @param particles are the particles to write
+	 * @param delimiter separates the columns, ',' for csv or ' ' for whitespace delimited columns
+	 * @param header is true to write the header line first
+	 */
+	static void writeColumns(std::ostream & out, const std::vector<NBodySim::Particle<T> > & particles, char delimiter, bool header = true);
+	
+	/**
+	 * writeColumns writes the gravitation constant and every particle as a column file
+	 *
+	 * @param out is the stream to write to
+	 * @param delimiter separates the columns, ',' for csv or ' ' for whitespace delimited columns
+	 */
+	void writeColumns(std::ostream & out, char delimiter = ',');
+	
+	/**
+	 * getParseErrorLine returns the line of the element or row the last call to parse or parseColumns failed at
+	 *
+	 * @return the line, counted from 1, or 0 if the parse succeeded or the error belongs to no element or row
+	 */
+	size_t getParseErrorLine(void);
+	
 	/**
 	 * setGravitation constant sets the systems gravitation constant
 	 *
@@ -223,6 +855,247 @@ public:
 	 */
 	T getGravitation(void);
 	
+	/**
+	 * energy returns the total kinetic and potential energy of the system
+	 *
+	 * @return the energy of the system
+	 */
+	T energy(void);
+	
+	/**
+	 * setFixedKernel enables or disables the specialized kernel used for systems of at most FixedStepSpace::maxParticles particles
+	 *
+	 * @param enable is true to use the specialized kernel when the system is small enough, it is enabled by default
+	 */
+	void setFixedKernel(bool enable);
+	
+	/**
+	 * setForcePrecision sets how the inverse cube of the distance between particles is calculated
+	 *
+	 * @param newPrecision is the accuracy level used by step, ACCURATE by default
+	 */
+	void setForcePrecision(NBodySim::forcePrecision newPrecision);
+	
+	/**
+	 * getForcePrecision returns how the inverse cube of the distance between particles is calculated
+	 *
+	 * @return the accuracy level used by step
+	 */
+	NBodySim::forcePrecision getForcePrecision(void);
+	
+	/**
+	 * setTileLengths sets the tile sizes of the direct summation, a length of 0 sizes the tile from the cache sizes of the machine
+	 *
+	 * @param targetLength is how many target particles share one pass over each source tile
+	 * @param sourceLength is how many source particles are held in cache while a target tile is summed against them
+	 */
+	void setTileLengths(size_t targetLength, size_t sourceLength);
+	
+	/**
+	 * setIntegrator sets how the system is advanced through time
+	 *
+	 * @param newIntegrator is the integrator used by step, SYMPLECTIC_EULER by default
+	 */
+	void setIntegrator(NBodySim::integratorType newIntegrator);
+	
+	/**
+	 * getIntegrator returns how the system is advanced through time
+	 *
+	 * @return the integrator used by step
+	 */
+	NBodySim::integratorType getIntegrator(void);
+	
+	/**
+	 * setErrorTolerance sets the error tolerance of the Gauss-Radau integrator
+	 *
+	 * @param epsilon is the tolerance on the highest coefficient of the acceleration polynomial relative to the acceleration
+	 */
+	void setErrorTolerance(T epsilon);
+	
+	/**
+	 * setNumThreads sets how many threads share the force calculation, the result does not depend on it
+	 *
+	 * Pinned threads are spread over the NUMA nodes, and every node but the first keeps its own copy of the particle
+	 * positions and masses for the force calculation.
+	 *
+	 * @param threads is the number of threads including the one calling step, 0 uses one per hardware thread, 1 by default
+	 * @param pin is true to bind every thread, including the one calling step, to a CPU
+	 */
+	void setNumThreads(unsigned threads, bool pin = false);
+	
+	/**
+	 * getNumThreads returns how many threads share the force calculation
+	 *
+	 * @return the number of threads including the one calling step
+	 */
+	unsigned getNumThreads(void);
+	
+	/**
+	 * getNumNodes returns the number of NUMA nodes the threads sharing the force calculation run on
+	 *
+	 * @return the number of nodes, 1 when the threads are not pinned
+	 */
+	unsigned getNumNodes(void);
+	
+	/**
+	 * setCostBalancing chooses how the force calculation is shared between threads
+	 *
+	 * With cost balancing every particle's share of the force calculation is timed, and each thread is handed one
+	 * contiguous range of particles of equal total cost from the previous step. The ranges are redrawn whenever the
+	 * busiest thread does more than threshold times the mean work. Without it, idle threads steal small tasks from busy ones.
+	 *
+	 * @param enable is true to partition by cost, it is disabled by default
+	 * @param threshold is the largest tolerated ratio of the busiest thread's work to the mean
+	 */
+	void setCostBalancing(bool enable, T threshold = NBodySim::NBodySystemSpace::defaultImbalanceThreshold);
+	
+	/**
+	 * getCostBalancing returns whether the force calculation is partitioned by cost
+	 *
+	 * @return true if cost balancing is enabled
+	 */
+	bool getCostBalancing(void);
+	
+	/**
+	 * getImbalance returns the ratio of the busiest thread's work to the mean work of the threads in the last cost balanced
+	 * force calculation, 1 is a perfect balance
+	 *
+	 * @return the imbalance ratio, 1 when cost balancing is disabled or there is one thread
+	 */
+	T getImbalance(void);
+	
+	/**
+	 * setSourceExchange lets the particles of this process feel the particles held by other processes
+	 *
+	 * The symplectic Euler step gathers the sources of this process by id, hands them to exchange and adds the forces of
+	 * every block exchange puts in their place to the acceleration of each of its particles, in the order of the blocks.
+	 * The other integrators, the specialized small kernels, collisions and regularization only see the particles of this
+	 * process.
+	 *
+	 * @param exchange completes the sources, an empty function keeps the system to itself
+	 */
+	void setSourceExchange(exchangeFunction exchange);
+	
+	/**
+	 * setReorderInterval sets how often the particles are sorted in memory along a space filling curve, so particles
+	 * near in space are near in memory. Particle indices are unaffected, but the integrator history is restarted as when
+	 * a particle is added.
+	 *
+	 * @param steps is the number of steps between sorts, 0 never sorts and is the default
+	 * @param curveIn is the curve to sort along
+	 */
+	void setReorderInterval(size_t steps, NBodySim::curveType curveIn = NBodySim::HILBERT);
+	
+	/**
+	 * getReorderInterval returns the number of steps between sorts along the space filling curve
+	 *
+	 * @return the number of steps between sorts, 0 when the particles are never sorted
+	 */
+	size_t getReorderInterval(void);
+	
+	/**
+	 * reorder sorts the particles in memory along the space filling curve now
+	 */
+	void reorder(void);
+	
+	/**
+	 * setRegularization enables or disables analytic advancement of tight, isolated binaries
+	 *
+	 * Each such pair moves through the integrator as one body at its center of mass while its internal orbit follows
+	 * the exact two body solution. Both particles of the pair are always in place when step returns.
+	 *
+	 * @param enable is true to regularize tight binaries, it is disabled by default
+	 */
+	void setRegularization(bool enable);
+	
+	/**
+	 * getRegularization returns whether tight binaries are advanced analytically
+	 *
+	 * @return true if regularization is enabled
+	 */
+	bool getRegularization(void);
+	
+	/**
+	 * numRegularizedPairs returns how many pairs were regularized during the last step
+	 *
+	 * @return the number of regularized pairs
+	 */
+	size_t numRegularizedPairs(void);
+	
+	/**
+	 * setCollisions enables or disables merging of overlapping particles after every step
+	 *
+	 * Merged particles are removed as removeParticle does, the particle of the highest index takes over the index of each,
+	 * so indices may change after a step.
+	 *
+	 * @param enable is true to merge particles whose radii overlap, it is disabled by default
+	 */
+	void setCollisions(bool enable);
+	
+	/**
+	 * getCollisions returns whether overlapping particles are merged after every step
+	 *
+	 * @return true if collisions are enabled
+	 */
+	bool getCollisions(void);
+	
+	/**
+	 * setTimestepAccuracy sets the accuracy parameter of the integrators which choose their own substeps
+	 *
+	 * @param eta is the Aarseth accuracy parameter of the Hermite integrator, smaller values take shorter substeps
+	 */
+	void setTimestepAccuracy(T eta);
+	
+	/**
+	 * setDeterministic makes the symplectic Euler step give the same bits whatever the threads, tiles, balancing or order
+	 * of the particles in memory
+	 *
+	 * The sum over the sources already runs in the same order on any number of threads. In deterministic mode the sources
+	 * are also laid out by particle id, so sorting the particles along a curve no longer changes the order, and every sum
+	 * carries a Kahan compensation, so the rounding of a long sum depends little on the order. The specialized small
+	 * kernels are not used. The other integrators step on one thread but in the order of the particles in memory.
+	 *
+	 * @param enable is true for deterministic sums, it is disabled by default
+	 */
+	void setDeterministic(bool enable);
+	
+	/**
+	 * getDeterministic returns whether the sums are deterministic
+	 *
+	 * @return true in deterministic mode
+	 */
+	bool getDeterministic(void);
+	
+	/**
+	 * stateHash returns a hash of the exact bits of the position, velocity and mass of every particle in index order,
+	 * so two runs are compared by comparing their hashes
+	 *
+	 * @return the hash
+	 */
+	uint64_t stateHash(void);
+	
+	/**
+	 * stateHash returns the hash of particles in their order, equal to the hash of a system holding them in index order
+	 *
+	 * @param particles are the particles
+	 * @return the hash
+	 */
+	static uint64_t stateHash(const std::vector<NBodySim::Particle<T> > & particles);
+	
+	/**
+	 * getTargetTileLength returns how many target particles share one pass over each source tile
+	 *
+	 * @return the target tile length
+	 */
+	size_t getTargetTileLength(void);
+	
+	/**
+	 * getSourceTileLength returns how many source particles are held in cache while a target tile is summed against them
+	 *
+	 * @return the source tile length
+	 */
+	size_t getSourceTileLength(void);
+	
 	/**
 	 * errorToString takes an error code and returns it in human readable format
 	 *
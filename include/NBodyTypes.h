@@ -37,6 +37,65 @@ namespace NBodySim{
 	
 	// Set up our types
 	typedef double FloatingType;
+	
+	/**
+	 * How the inverse cube of the distance between two particles is calculated
+	 */
+	typedef enum {
+		/**
+		 * Full precision square root and division
+		 */
+		ACCURATE = 0,
+		/**
+		 * Hardware reciprocal square root estimate followed by two Newton-Raphson refinements
+		 */
+		REFINED,
+		/**
+		 * Hardware reciprocal square root estimate followed by one Newton-Raphson refinement
+		 */
+		FAST
+	} forcePrecision;
+	
+	/**
+	 * Number of values in forcePrecision
+	 */
+	const unsigned numForcePrecisions = 3;
+	
+	/**
+	 * How the system is advanced through time
+	 */
+	typedef enum {
+		/**
+		 * Update velocities from the accelerations, then positions from the new velocities, once per step
+		 */
+		SYMPLECTIC_EULER = 0,
+		/**
+		 * Fourth order Hermite predictor-corrector with shared substeps chosen by the Aarseth criterion
+		 */
+		HERMITE,
+		/**
+		 * Wisdom-Holman map in democratic heliocentric coordinates, for systems dominated by one central mass
+		 */
+		WISDOM_HOLMAN,
+		/**
+		 * Fifteenth order Gauss-Radau predictor-corrector, IAS15, with substeps chosen from an error tolerance
+		 */
+		GAUSS_RADAU
+	} integratorType;
+	
+	/**
+	 * Which space filling curve particles are sorted along
+	 */
+	typedef enum {
+		/**
+		 * Z order, the bits of the three coordinates interleaved
+		 */
+		MORTON = 0,
+		/**
+		 * Hilbert curve, consecutive cells are always neighbours
+		 */
+		HILBERT
+	} curveType;
 }
 
 #endif // N_BODY_TYPES_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include <boost/thread.hpp>
+
+namespace NBodySim {
+	class NameTable;
+	namespace NameTableSpace {
+		/**
+		 * emptyName is the id of the empty name, which is never stored
+		 */
+		const uint32_t emptyName = 0;
+		/**
+		 * generatedName marks the id of a name generated from a particle's index, the index is in the lower bits and the
+		 * name is only made into a string when it is asked for
+		 */
+		const uint32_t generatedName = 0x80000000u;
+	}
+}
+
+/**
+ * @brief Stores every particle name once and hands out 32 bit ids for them.
+ *
+ * Particles carry the id of their name instead of the name, so copying a particle copies no string and comparing names
+ * compares ids. The same name always has the same id, ids are never reused and names are kept until the program exits.
+ * The empty name and names generated from an index are not stored, so particles with them cost nothing in the table.
+ * The table is shared by every system of the program and may be used from any thread.
+ *
+ * @author W.A. Garrett Weaver
+ * @see Particle
+ */
+class NBodySim::NameTable {
+private:
+	/**
+	 * names holds the stored names, the name with id i at i - 1, a deque so stored names never move
+	 */
+	std::deque<std::string> names;
+
+	/**
+	 * ids holds the id of every stored name
+	 */
+	std::unordered_map<std::string, uint32_t> ids;
+
+	/**
+	 * tableMutex guards names and ids
+	 */
+	boost::mutex tableMutex;
+
+	/**
+	 * instance returns the table shared by the program
+	 *
+	 * @return the table
+	 */
+	static NBodySim::NameTable & instance(void);
+
+public:
+	/**
+	 * intern returns the id of a name, storing the name if it is new
+	 *
+	 * @param name is the name
+	 * @return the id of the name
+	 */
+	static uint32_t intern(const std::string & name);
+
+	/**
+	 * find returns the id of a name without storing it
+	 *
+	 * @param name is the name
+	 * @param id receives the id of the name
+	 * @return true if the name is empty or stored
+	 */
+	static bool find(const std::string & name, uint32_t * id);
+
+	/**
+	 * generated returns the id of the name made of a particle's index
+	 *
+	 * @param index is the index, below generatedName
+	 * @return the id
+	 */
+	static uint32_t generated(size_t index);
+
+	/**
+	 * findGenerated returns the id a name has as a name generated from an index
+	 *
+	 * @param name is the name
+	 * @param id receives the id
+	 * @return true if the name is an index written as generated names are, decimal without leading zeros
+	 */
+	static bool findGenerated(const std::string & name, uint32_t * id);
+
+	/**
+	 * name returns the name with an id
+	 *
+	 * @param id is the id
+	 * @return the name, empty if the id was never handed out
+	 */
+	static std::string name(uint32_t id);
+
+	/**
+	 * size returns the number of stored names
+	 *
+	 * @return the number of names
+	 */
+	static size_t size(void);
+};
+
+#endif // NAME_TABLE_H
@@ -22,6 +22,8 @@
 #define PARTICLE_H
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
 #include "NBodyTypes.h"
 
@@ -56,9 +58,20 @@ protected:
 	T mass;
 	
 	/**
-	 * name is the string that holds what the particle is named
+	 * radius holds the floating point radius of the particle in meters, particles with a radius of 0 never collide
 	 */
-	std::string name;
+	T radius;
+	
+	/**
+	 * nameId is the id of the particle's name in the NameTable, so copying a particle copies no string
+	 */
+	uint32_t nameId;
+	
+	/**
+	 * id is the index the owning system reports the particle under, it stays with the particle when the system reorders
+	 * its storage
+	 */
+	uint32_t id;
 	
 	/**
 	 * particle is a method that all the versions of the constructors call to maintain consistancy
@@ -114,28 +127,49 @@ public:
 	 *
 	 * @return the position of the particle as a ThreeVector
 	 */
-	NBodySim::ThreeVector <T> getPos(void);
+	NBodySim::ThreeVector <T> getPos(void) const;
 	
 	/**
 	* Returns of the velocity of the particle as a ThreeVector
 	*
 	* @return the position of the particle as a ThreeVector
 	*/
-	NBodySim::ThreeVector <T> getVel(void);
+	NBodySim::ThreeVector <T> getVel(void) const;
 	
 	/**
 	* Returns of the mass of the particle as a ThreeVector
 	*
 	* @return the position of the particle as a ThreeVector
 	*/
-	T getMass(void);
+	T getMass(void) const;
 	
 	/**
 	 * Returns of the name of the particle as a string
 	 *
 	 * @return the name of the particle as a string
 	 */
-	std::string getName(void);
+	std::string getName(void) const;
+	
+	/**
+	 * Returns the id of the name of the particle in the NameTable
+	 *
+	 * @return the id of the name
+	 */
+	uint32_t getNameId(void) const;
+	
+	/**
+	 * Returns the radius of the particle
+	 *
+	 * @return the radius of the particle in meters
+	 */
+	T getRadius(void) const;
+	
+	/**
+	 * Returns the id of the particle
+	 *
+	 * @return the index the owning system reports the particle under
+	 */
+	size_t getId(void) const;
 	
 	/**
 	 * Sets the position of the particle with ThreeVector
@@ -206,6 +240,27 @@ public:
 	 * @param nameIn is the new name of the particle
 	 */
 	void setName(std::string nameIn);
+	
+	/**
+	 * Sets the name of the particle by its id in the NameTable, which copies no string
+	 *
+	 * @param newNameId is the id of the new name
+	 */
+	void setNameId(uint32_t newNameId);
+	
+	/**
+	 * Sets the radius of the particle with a floating point number
+	 *
+	 * @param newRadius is the new radius of the particle in meters
+	 */
+	void setRadius(T newRadius);
+	
+	/**
+	 * Sets the id of the particle, done by the system that owns it
+	 *
+	 * @param newId is the index the owning system reports the particle under
+	 */
+	void setId(size_t newId);
 };
 
 #endif //PARTICLE_H
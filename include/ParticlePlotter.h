@@ -98,6 +98,6 @@ public:
 	 * @param particle is a particle that shall be plotted 
 	 * @return a vector of dimension 2 representing the projected point on the plane
 	 */
-	boost::numeric::ublas::vector<T> calculateProjection(NBodySim::Particle<T> particle);
+	boost::numeric::ublas::vector<T> calculateProjection(const NBodySim::Particle<T> & particle);
 };
 #endif //PARTICLE_PLOTTER_H
\ No newline at end of file
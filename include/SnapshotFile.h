@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SNAPSHOT_FILE_H
+#define SNAPSHOT_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <functional>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <class T> class SnapshotFile;
+	namespace SnapshotFileSpace {
+		/**
+		 * magicLength is the length of the magic string at the start of every snapshot file
+		 */
+		const size_t magicLength = 8;
+		/**
+		 * magic identifies a snapshot file
+		 */
+		const char magic[magicLength + 1] = "NBODYSNP";
+		/**
+		 * byteOrderMark is written in the byte order of the writer, a reader with another byte order sees it reversed
+		 */
+		const uint32_t byteOrderMark = 0x01020304;
+		/**
+		 * version is the version of the format
+		 */
+		const uint32_t version = 1;
+		/**
+		 * columnNameLength is the length of the space for a column name in the column table, including its terminator
+		 */
+		const size_t columnNameLength = 24;
+		/**
+		 * headerLength is the length of the fixed part of the header, the column table follows it
+		 */
+		const size_t headerLength = 56;
+		/**
+		 * columnEntryLength is the length of one entry of the column table
+		 */
+		const size_t columnEntryLength = 48;
+		/**
+		 * columnAlignment is the alignment of every column in the file, a page, so a mapped column is aligned in memory
+		 */
+		const size_t columnAlignment = 4096;
+		/**
+		 * Types of the columns
+		 */
+		typedef enum {
+			/**
+			 * 64 bit IEEE floating point numbers
+			 */
+			FLOAT64 = 0,
+			/**
+			 * 64 bit unsigned integers
+			 */
+			UINT64 = 1,
+			/**
+			 * Bytes, the names of the particles end to end
+			 */
+			BYTES = 2
+		} columnType;
+		/**
+		 * List of errors the snapshot file methods can have
+		 */
+		typedef enum {
+			/**
+			 * Success
+			 */
+			SUCCESS = 0,
+			/**
+			 * The file could not be opened
+			 */
+			COULD_NOT_OPEN,
+			/**
+			 * The file could not be written completely
+			 */
+			COULD_NOT_WRITE,
+			/**
+			 * The file does not start with the magic string or is shorter than its header says
+			 */
+			NOT_A_SNAPSHOT,
+			/**
+			 * The file was written by a machine of another byte order or a newer version
+			 */
+			UNSUPPORTED,
+			/**
+			 * The file has no column of the name asked for, or it is of another type
+			 */
+			NO_COLUMN,
+			/**
+			 * The range of particles asked for goes past the last particle
+			 */
+			OUT_OF_RANGE,
+			/**
+			 * The file could not be mapped into memory
+			 */
+			COULD_NOT_MAP
+		} error;
+	}
+}
+
+/**
+ * @brief Writes and reads snapshots of a system in a self describing columnar file.
+ *
+ * The header holds the number of particles, the step, time and gravitation constant, and a table giving the name, type
+ * and offset of every column. Every column holds one value per particle and starts on a page boundary, so a reader seeks
+ * straight to a column, or to a range of particles within it, or maps the file and uses a column in place. The columns
+ * are posX, posY, posZ, velX, velY, velZ, mass and radius as FLOAT64, id as UINT64, and the names as nameOffsets, N + 1
+ * UINT64 offsets of every name into nameData, the BYTES of the names end to end. Readers find columns by name, so
+ * columns may be added in later versions without breaking them.
+ *
+ * @author W.A. Garrett Weaver
+ * @see StepPipeline
+ */
+template <class T>
+class NBodySim::SnapshotFile {
+public:
+	/**
+	 * sinkFunction receives the bytes of a snapshot file in order, it returns false if they could not be written
+	 */
+	typedef std::function<bool(const char *, size_t)> sinkFunction;
+
+private:
+	/**
+	 * Column is an entry of the column table
+	 */
+	struct Column {
+		std::string name;   /**< Name of the column */
+		uint32_t type;      /**< Type of the column, a columnType */
+		uint32_t width;     /**< Length of an element in bytes */
+		uint64_t offset;    /**< Offset of the column from the start of the file */
+		uint64_t length;    /**< Length of the column in bytes */
+	};
+
+	/**
+	 * find returns the column with a name and type
+	 *
+	 * @param name is the name of the column
+	 * @param type is the type the column must have
+	 * @return the column or NULL if there is none
+	 */
+	const Column * find(const std::string & name, NBodySim::SnapshotFileSpace::columnType type);
+
+	/**
+	 * readRange reads the elements of a range of particles from a column
+	 *
+	 * @param column is the column
+	 * @param first is the first particle
+	 * @param count is the number of particles
+	 * @param out receives count elements of the column's width
+	 * @return SUCCESS, OUT_OF_RANGE or NOT_A_SNAPSHOT if the file is too short
+	 */
+	NBodySim::SnapshotFileSpace::error readRange(const Column * column, size_t first, size_t count, void * out);
+
+protected:
+	/**
+	 * file is the open snapshot file, fileName its path
+	 */
+	std::ifstream file;
+	std::string fileName;
+
+	/**
+	 * columns is the column table of the open file
+	 */
+	std::vector<Column> columns;
+
+	/**
+	 * particleCount, step, time and G are the header of the open file
+	 */
+	size_t particleCount;
+	size_t step;
+	T time;
+	T G;
+
+	/**
+	 * mapping is the address the file is mapped at and mappingLength its length, NULL and 0 when it is not mapped
+	 */
+	void * mapping;
+	size_t mappingLength;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	SnapshotFile(void);
+
+	/**
+	 * Destructor, unmaps and closes the file
+	 */
+	virtual ~SnapshotFile(void);
+
+	/**
+	 * write writes a snapshot file
+	 *
+	 * @param fileName is the path of the file, which is replaced if it exists
+	 * @param particles are the particles of the snapshot
+	 * @param step is the number of steps taken when the snapshot was captured
+	 * @param time is the simulated time when the snapshot was captured
+	 * @param G is the gravitation constant of the system
+	 * @return SUCCESS, COULD_NOT_OPEN or COULD_NOT_WRITE
+	 */
+	static NBodySim::SnapshotFileSpace::error write(const std::string & fileName, const std::vector<NBodySim::Particle<T> > & particles, size_t step, T time, T G);
+
+	/**
+	 * write hands the bytes of a snapshot file to a sink, for writers with their own way to the disk
+	 *
+	 * @param sink receives the bytes from the start of the file to its end
+	 * @param particles are the particles of the snapshot
+	 * @param step is the number of steps taken when the snapshot was captured
+	 * @param time is the simulated time when the snapshot was captured
+	 * @param G is the gravitation constant of the system
+	 * @return SUCCESS or COULD_NOT_WRITE if the sink failed
+	 */
+	static NBodySim::SnapshotFileSpace::error write(sinkFunction sink, const std::vector<NBodySim::Particle<T> > & particles, size_t step, T time, T G);
+
+	/**
+	 * open opens a snapshot file and reads its header and column table
+	 *
+	 * @param fileNameIn is the path of the file
+	 * @return SUCCESS, COULD_NOT_OPEN, NOT_A_SNAPSHOT or UNSUPPORTED
+	 */
+	NBodySim::SnapshotFileSpace::error open(const std::string & fileNameIn);
+
+	/**
+	 * numParticles returns the number of particles of the open file
+	 *
+	 * @return the number of particles
+	 */
+	size_t numParticles(void);
+
+	/**
+	 * getStep returns the number of steps taken when the snapshot was captured
+	 *
+	 * @return the step
+	 */
+	size_t getStep(void);
+
+	/**
+	 * getTime returns the simulated time when the snapshot was captured
+	 *
+	 * @return the time in seconds
+	 */
+	T getTime(void);
+
+	/**
+	 * getGravitation returns the gravitation constant of the system
+	 *
+	 * @return the gravitation constant
+	 */
+	T getGravitation(void);
+
+	/**
+	 * columnNames returns the names of the columns of the open file
+	 *
+	 * @return the names in the order of the column table
+	 */
+	std::vector<std::string> columnNames(void);
+
+	/**
+	 * readColumn reads a FLOAT64 column for a range of particles
+	 *
+	 * @param name is the name of the column
+	 * @param first is the first particle
+	 * @param count is the number of particles
+	 * @param out receives the values
+	 * @return SUCCESS, NO_COLUMN, OUT_OF_RANGE or NOT_A_SNAPSHOT
+	 */
+	NBodySim::SnapshotFileSpace::error readColumn(const std::string & name, size_t first, size_t count, std::vector<T> & out);
+
+	/**
+	 * readNames reads the names of a range of particles
+	 *
+	 * @param first is the first particle
+	 * @param count is the number of particles
+	 * @param out receives the names
+	 * @return SUCCESS, NO_COLUMN, OUT_OF_RANGE or NOT_A_SNAPSHOT
+	 */
+	NBodySim::SnapshotFileSpace::error readNames(size_t first, size_t count, std::vector<std::string> & out);
+
+	/**
+	 * readParticles reads a range of particles with every property
+	 *
+	 * @param first is the first particle
+	 * @param count is the number of particles
+	 * @param out receives the particles
+	 * @return SUCCESS, NO_COLUMN, OUT_OF_RANGE or NOT_A_SNAPSHOT
+	 */
+	NBodySim::SnapshotFileSpace::error readParticles(size_t first, size_t count, std::vector<NBodySim::Particle<T> > & out);
+
+	/**
+	 * map maps the open file into memory read only, only on systems with mmap
+	 *
+	 * @return SUCCESS or COULD_NOT_MAP
+	 */
+	NBodySim::SnapshotFileSpace::error map(void);
+
+	/**
+	 * mappedColumn returns a FLOAT64 column of the mapped file in place
+	 *
+	 * @param name is the name of the column
+	 * @return the first value of the column, NULL if the file is not mapped or has no such column
+	 */
+	const double * mappedColumn(const std::string & name);
+
+	/**
+	 * errorToString converts an error to a message
+	 *
+	 * @param errorCode is the error
+	 * @return the message
+	 */
+	static std::string errorToString(NBodySim::SnapshotFileSpace::error errorCode);
+};
+
+#endif // SNAPSHOT_FILE_H
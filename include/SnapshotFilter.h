@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SNAPSHOT_FILTER_H
+#define SNAPSHOT_FILTER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <class T> class SnapshotFilter;
+	namespace SnapshotFilterSpace {
+		/**
+		 * particlesPerCell is the mean number of particles in a cell of the grid the region is looked up in
+		 */
+		const size_t particlesPerCell = 8;
+		/**
+		 * maxCellsPerAxis bounds the grid, so its cell table stays small next to the particles
+		 */
+		const size_t maxCellsPerAxis = 128;
+		/**
+		 * Shapes of the region of interest
+		 */
+		typedef enum {
+			/**
+			 * Every position is in the region
+			 */
+			NO_REGION = 0,
+			/**
+			 * An axis aligned box
+			 */
+			BOX,
+			/**
+			 * A sphere
+			 */
+			SPHERE
+		} regionType;
+	}
+}
+
+/**
+ * @brief Selects the particles of a snapshot worth writing, so writers touch only them.
+ *
+ * A particle is selected if it passes every filter that is set: it lies in the region of interest, a box or a sphere, it
+ * is every k-th particle, it falls in a deterministic random fraction, and its name matches a pattern. Every k-th
+ * particle is enumerated directly. The random fraction hashes the index of a particle with a seed, so the same particles
+ * are chosen in every snapshot and every run. Names are matched once per interned name.
+ *
+ * Finding the particles in the region takes one pass over the snapshot. When several regions are looked up in the same
+ * snapshot, buildIndex sorts its particles into a uniform grid first, after which cells wholly inside a region are taken
+ * without testing their particles and cells wholly outside it are never visited. Building the grid costs a few passes
+ * over the particles, so it does not pay for a single region. The grid only knows where the particles were when it was
+ * built, so it serves select until dropIndex is called and is dropped by apply, which writers call once per snapshot in
+ * buffers that are reused for the next one.
+ *
+ * @author W.A. Garrett Weaver
+ * @see StepPipeline
+ */
+template <class T>
+class NBodySim::SnapshotFilter {
+private:
+	/**
+	 * inRegion tells whether a position lies in the region
+	 *
+	 * @param position is the position
+	 * @return true if it is in the region
+	 */
+	bool inRegion(const NBodySim::ThreeVector<T> & position);
+
+	/**
+	 * cellIndex returns the cell a coordinate falls in along one axis
+	 *
+	 * @param axis is the axis
+	 * @param coordinate is the coordinate
+	 * @return the cell, clamped to the grid
+	 */
+	size_t cellIndex(unsigned axis, T coordinate);
+
+	/**
+	 * cellOverlap tells how the particles of a cell of the grid overlap the region
+	 *
+	 * @param cell is the index of the cell
+	 * @return 0 if the cell is wholly outside, 1 if it overlaps the boundary and 2 if it is wholly inside
+	 */
+	int cellOverlap(size_t cell);
+
+	/**
+	 * passes tells whether a particle passes the filters other than the region
+	 *
+	 * @param particles are the particles
+	 * @param index is the index of the particle
+	 * @return true if the particle passes
+	 */
+	bool passes(const std::vector<NBodySim::Particle<T> > & particles, size_t index);
+
+	/**
+	 * hashIndex mixes an index with the seed into a number uniform in [0, 1)
+	 *
+	 * @param index is the index
+	 * @return the number
+	 */
+	double hashIndex(size_t index);
+
+protected:
+	/**
+	 * region is the shape of the region, low and high the corners of the box, center and radius the sphere
+	 */
+	NBodySim::SnapshotFilterSpace::regionType region;
+	NBodySim::ThreeVector<T> low;
+	NBodySim::ThreeVector<T> high;
+	NBodySim::ThreeVector<T> center;
+	T radius;
+
+	/**
+	 * stride selects every stride-th particle, 1 selects all
+	 */
+	size_t stride;
+
+	/**
+	 * fraction is the share of particles selected at random and seed the seed of the choice
+	 */
+	double fraction;
+	uint64_t seed;
+
+	/**
+	 * namePattern is the pattern names must match, empty matches every name, nameMatches caches the match of every name id
+	 */
+	std::string namePattern;
+	std::unordered_map<uint32_t, bool> nameMatches;
+
+	/**
+	 * The grid: its lower corner, cell size and number of cells along every axis, and the particles of cell c at
+	 * cellParticles[cellStart[c]] to cellParticles[cellStart[c + 1]]. cellBounds holds the smallest and then the largest
+	 * coordinates of the particles in every cell, six per cell, which decide whether a cell is wholly in the region.
+	 */
+	T gridLow[3];
+	T cellSize[3];
+	size_t cellsPerAxis;
+	std::vector<size_t> cellStart;
+	std::vector<size_t> cellParticles;
+	std::vector<size_t> cellOf;
+	std::vector<T> cellBounds;
+
+	/**
+	 * indexedParticles and indexedLength are the particles the grid was built for, NULL and 0 when there is none
+	 */
+	const NBodySim::Particle<T> * indexedParticles;
+	size_t indexedLength;
+
+public:
+	/**
+	 * Default constructor, selects every particle
+	 */
+	SnapshotFilter(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~SnapshotFilter(void);
+
+	/**
+	 * setBox sets the region to an axis aligned box
+	 *
+	 * @param lowIn is the corner with the smallest coordinates
+	 * @param highIn is the corner with the largest coordinates
+	 */
+	void setBox(NBodySim::ThreeVector<T> lowIn, NBodySim::ThreeVector<T> highIn);
+
+	/**
+	 * setSphere sets the region to a sphere
+	 *
+	 * @param centerIn is the center of the sphere
+	 * @param radiusIn is the radius of the sphere
+	 */
+	void setSphere(NBodySim::ThreeVector<T> centerIn, T radiusIn);
+
+	/**
+	 * setStride selects every k-th particle, starting with the first
+	 *
+	 * @param k is the number of particles between selected ones, 1 selects all
+	 */
+	void setStride(size_t k);
+
+	/**
+	 * setFraction selects a deterministic random share of the particles
+	 *
+	 * @param fractionIn is the share to select, from 0 to 1
+	 * @param seedIn is the seed of the choice
+	 */
+	void setFraction(double fractionIn, uint64_t seedIn);
+
+	/**
+	 * setNamePattern selects particles whose name matches a pattern, where * matches any run of characters and ? any one
+	 *
+	 * @param pattern is the pattern, empty matches every name
+	 */
+	void setNamePattern(const std::string & pattern);
+
+	/**
+	 * selectsAll tells whether no filter is set
+	 *
+	 * @return true if every particle is selected
+	 */
+	bool selectsAll(void);
+
+	/**
+	 * buildIndex sorts particles into a grid over their bounding box, which select uses for them until it is built again,
+	 * dropped by dropIndex or used by apply
+	 *
+	 * @param particles are the particles, which must not change or move while the grid is used
+	 */
+	void buildIndex(const std::vector<NBodySim::Particle<T> > & particles);
+
+	/**
+	 * dropIndex forgets the grid, so select tests the particles again, it must be called before the particles the grid
+	 * was built for change
+	 */
+	void dropIndex(void);
+
+	/**
+	 * select finds the particles that pass every filter
+	 *
+	 * @param particles are the particles of a snapshot, in index order
+	 * @param selected receives the indices of the selected particles in ascending order
+	 */
+	void select(const std::vector<NBodySim::Particle<T> > & particles, std::vector<size_t> & selected);
+
+	/**
+	 * apply copies the particles that pass every filter, and drops the grid once it has served them
+	 *
+	 * @param particles are the particles of a snapshot, in index order
+	 * @param out receives the selected particles in index order
+	 */
+	void apply(const std::vector<NBodySim::Particle<T> > & particles, std::vector<NBodySim::Particle<T> > & out);
+
+	/**
+	 * matchName tells whether a name matches a pattern, where * matches any run of characters and ? any one
+	 *
+	 * @param name is the name
+	 * @param pattern is the pattern
+	 * @return true if it matches
+	 */
+	static bool matchName(const std::string & name, const std::string & pattern);
+};
+
+#endif // SNAPSHOT_FILTER_H
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <boost/thread.hpp>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "SnapshotFile.h"
+
+namespace NBodySim {
+	template <class T> class SnapshotWriter;
+	namespace SnapshotWriterSpace {
+		/**
+		 * blockLength is the alignment direct writes need of their buffers, offsets and lengths, a page
+		 */
+		const size_t blockLength = 4096;
+		/**
+		 * defaultBufferLength is the length of one write buffer, large enough for the disk to stream
+		 */
+		const size_t defaultBufferLength = 4 << 20;
+		/**
+		 * defaultNumBuffers is the number of write buffers, one being filled while the others are written
+		 */
+		const size_t defaultNumBuffers = 4;
+	}
+}
+
+/**
+ * @brief Writes snapshot files through a ring of aligned buffers written out by a thread of its own.
+ *
+ * The caller lays the file out into one buffer while the buffers filled before it are written with pwrite by the
+ * writer's thread, so turning particles into bytes overlaps the disk. The buffers are allocated once, aligned to a page,
+ * and reused for every file. Where the system allows it the file is opened for direct writes, which skip the page cache
+ * so a large checkpoint does not push out the pages the simulation uses; the last buffer is padded to a block and the
+ * file cut back to its length. Where direct writes are refused the file is written through the page cache and its pages
+ * are dropped once they are on the disk. Systems without pwrite fall back to SnapshotFile::write. The files are the
+ * same as those of SnapshotFile::write.
+ *
+ * @author W.A. Garrett Weaver
+ * @see SnapshotFile
+ * @see StepPipeline
+ */
+template <class T>
+class NBodySim::SnapshotWriter {
+private:
+	/**
+	 * Request is a filled buffer waiting for the writer's thread
+	 */
+	struct Request {
+		int file;        /**< Descriptor of the file */
+		size_t buffer;   /**< Index of the buffer */
+		size_t offset;   /**< Offset in the file to write the buffer at */
+		size_t length;   /**< Number of bytes to write */
+	};
+
+	/**
+	 * ioLoop writes the queued buffers until the writer is destroyed
+	 */
+	void ioLoop(void);
+
+	/**
+	 * acquire waits for a free buffer and takes it
+	 *
+	 * @return the index of the buffer
+	 */
+	size_t acquire(void);
+
+	/**
+	 * submit queues a buffer to be written
+	 *
+	 * @param request is the buffer and where it goes
+	 */
+	void submit(const Request & request);
+
+	/**
+	 * drain waits until every queued buffer has been written
+	 */
+	void drain(void);
+
+protected:
+	/**
+	 * storage holds the buffers, buffers points to each of them aligned to blockLength and bufferLength is their length
+	 */
+	std::vector<char> storage;
+	std::vector<char *> buffers;
+	size_t bufferLength;
+
+	/**
+	 * freeBuffers holds the buffers not being filled or written and requests the ones waiting to be written, both
+	 * guarded by writerMutex
+	 */
+	std::deque<size_t> freeBuffers;
+	std::deque<Request> requests;
+
+	/**
+	 * writerMutex guards the queues and flags, submitted wakes the writer's thread and completed the caller
+	 */
+	boost::mutex writerMutex;
+	boost::condition_variable submitted;
+	boost::condition_variable completed;
+
+	/**
+	 * fileMutex lets one file be written at a time
+	 */
+	boost::mutex fileMutex;
+
+	/**
+	 * ioThread is the writer's thread
+	 */
+	boost::thread ioThread;
+
+	/**
+	 * closing tells the writer's thread to return, failed is set when a write of the current file failed and direct
+	 * when the current file is written directly, all guarded by writerMutex
+	 */
+	bool closing;
+	bool failed;
+	bool direct;
+
+public:
+	/**
+	 * Constructor, allocates the buffers and starts the writer's thread
+	 *
+	 * @param bufferLengthIn is the length of one buffer, rounded up to a multiple of blockLength
+	 * @param numBuffers is the number of buffers, at least two are used
+	 */
+	SnapshotWriter(size_t bufferLengthIn = NBodySim::SnapshotWriterSpace::defaultBufferLength, size_t numBuffers = NBodySim::SnapshotWriterSpace::defaultNumBuffers);
+
+	/**
+	 * Destructor, stops the writer's thread
+	 */
+	virtual ~SnapshotWriter(void);
+
+	/**
+	 * write writes a snapshot file and returns once all of it has been written
+	 *
+	 * @param fileName is the path of the file, which is replaced if it exists
+	 * @param particles are the particles of the snapshot
+	 * @param step is the number of steps taken when the snapshot was captured
+	 * @param time is the simulated time when the snapshot was captured
+	 * @param G is the gravitation constant of the system
+	 * @return SUCCESS, COULD_NOT_OPEN or COULD_NOT_WRITE
+	 */
+	NBodySim::SnapshotFileSpace::error write(const std::string & fileName, const std::vector<NBodySim::Particle<T> > & particles, size_t step, T time, T G);
+
+	/**
+	 * isDirect tells whether the last file written skipped the page cache
+	 *
+	 * @return true if it was written directly
+	 */
+	bool isDirect(void);
+};
+
+#endif // SNAPSHOT_WRITER_H
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SPACE_FILLING_CURVE_H
+#define SPACE_FILLING_CURVE_H
+
+#include <vector>
+#include <cstdint>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "TaskScheduler.h"
+
+namespace NBodySim {
+	template <class T> class SpaceFillingCurve;
+	namespace SpaceFillingCurveSpace {
+		/**
+		 * bitsPerAxis is how many bits of every coordinate go into a key, three of them fill 63 bits
+		 */
+		const unsigned bitsPerAxis = 21;
+		/**
+		 * radixBits is how many bits of the key every pass of the radix sort orders by
+		 */
+		const unsigned radixBits = 8;
+		/**
+		 * blockLength is how many keys one task of the radix sort counts and scatters
+		 */
+		const size_t blockLength = 16384;
+	}
+}
+
+/**
+ * @brief Orders particles along a Morton or Hilbert curve so that particles near in space are near in memory.
+ *
+ * The bounding cube of the particles is cut into a grid of 2^21 cells per axis and every particle gets the index of
+ * its cell along the curve. The keys are sorted by a stable least significant digit radix sort whose counting and
+ * scattering are shared out to threads block by block, so the order does not depend on the number of threads.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::SpaceFillingCurve {
+private:
+	/**
+	 * spread moves the low 21 bits of a coordinate to every third bit of the result
+	 *
+	 * @param coordinate is the coordinate to spread
+	 * @return the spread bits
+	 */
+	static uint64_t spread(uint32_t coordinate);
+
+	/**
+	 * radixSort sorts keys in ascending order, stably, carrying indices along
+	 *
+	 * @param scheduler shares the passes out to threads, NULL to sort on the calling thread
+	 */
+	void radixSort(NBodySim::TaskScheduler * scheduler);
+
+protected:
+	/**
+	 * keys and indices hold the key of every particle and its index in the system, sorted together
+	 */
+	std::vector<uint64_t> keys;
+	std::vector<size_t> indices;
+
+	/**
+	 * keyBuffer and indexBuffer receive every pass of the radix sort
+	 */
+	std::vector<uint64_t> keyBuffer;
+	std::vector<size_t> indexBuffer;
+
+	/**
+	 * counts holds how many keys of every block have every digit, block by block
+	 */
+	std::vector<size_t> counts;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	SpaceFillingCurve(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~SpaceFillingCurve(void);
+
+	/**
+	 * key returns the index along a curve of the cell at the given integer coordinates
+	 *
+	 * @param x is the cell along the x axis, below 2^21
+	 * @param y is the cell along the y axis, below 2^21
+	 * @param z is the cell along the z axis, below 2^21
+	 * @param curve is the curve to index along
+	 * @return the 63 bit index of the cell
+	 */
+	static uint64_t key(uint32_t x, uint32_t y, uint32_t z, NBodySim::curveType curve);
+
+	/**
+	 * order finds the order of the particles along a curve
+	 *
+	 * @param system is the set of particles
+	 * @param curve is the curve to order along
+	 * @param scheduler shares the work out to threads, NULL to work on the calling thread
+	 * @param permutation receives, for every position along the curve, the index of the particle in system
+	 */
+	void order(const std::vector<NBodySim::Particle<T> > & system, NBodySim::curveType curve, NBodySim::TaskScheduler * scheduler, std::vector<size_t> & permutation);
+};
+
+#endif // SPACE_FILLING_CURVE_H
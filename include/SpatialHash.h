@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <vector>
+#include <cstdint>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <class T> class SpatialHash;
+}
+
+/**
+ * @brief Bins particles into a uniform grid of cubic cells hashed into buckets, for finding the particles near a point.
+ *
+ * Cells are hashed into a table with one bucket per particle and the buckets are filled with a counting sort, which
+ * keeps building the grid linear in the number of particles. Several cells may share a bucket, so the particles of a
+ * bucket are only candidates and the caller checks their distance.
+ *
+ * @author W.A. Garrett Weaver
+ * @see CollisionDetector
+ * @see BinaryRegularizer
+ */
+template <class T>
+class NBodySim::SpatialHash {
+protected:
+	/**
+	 * cellSize is the edge length of a grid cell
+	 */
+	T cellSize;
+
+	/**
+	 * bucketMask selects a bucket from a cell hash, the number of buckets is a power of two
+	 */
+	size_t bucketMask;
+
+	/**
+	 * bucket holds the bucket of every particle
+	 */
+	std::vector<size_t> bucket;
+
+	/**
+	 * bucketStart holds the index in sorted of the first particle of every bucket, followed by the number of particles
+	 */
+	std::vector<size_t> bucketStart;
+
+	/**
+	 * sorted holds the particle indices ordered by bucket
+	 */
+	std::vector<size_t> sorted;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	SpatialHash(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~SpatialHash(void);
+
+	/**
+	 * build bins every particle of system into cells of the given size
+	 *
+	 * @param system is the set of particles
+	 * @param cellSizeIn is the edge length of a cell, greater than 0
+	 */
+	void build(const std::vector<NBodySim::Particle<T> > & system, T cellSizeIn);
+
+	/**
+	 * getCellSize returns the edge length of a cell of the last build
+	 *
+	 * @return the cell size
+	 */
+	T getCellSize(void);
+
+	/**
+	 * cellOf returns the integer coordinate of the cell containing a position along one axis, clamped to 2^62 cells
+	 * either side of the origin, and the lowest cell for a position that is not a number
+	 *
+	 * @param position is the position along the axis
+	 * @return the cell coordinate
+	 */
+	int64_t cellOf(T position);
+
+	/**
+	 * hashCell returns the bucket of the cell at the given coordinates
+	 *
+	 * @param x is the cell coordinate along x
+	 * @param y is the cell coordinate along y
+	 * @param z is the cell coordinate along z
+	 * @return the bucket index, less than the number of buckets
+	 */
+	size_t hashCell(int64_t x, int64_t y, int64_t z);
+
+	/**
+	 * bucketBegin and bucketEnd return the range of indices into the sorted particles held by a bucket
+	 *
+	 * @param b is the bucket
+	 * @return the first index, or one past the last
+	 */
+	size_t bucketBegin(size_t b);
+	size_t bucketEnd(size_t b);
+
+	/**
+	 * particleAt returns the index in system of a sorted particle
+	 *
+	 * @param k is the index among the sorted particles
+	 * @return the particle index
+	 */
+	size_t particleAt(size_t k);
+};
+
+#endif // SPATIAL_HASH_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef STEP_PIPELINE_H
+#define STEP_PIPELINE_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include <boost/thread.hpp>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+
+namespace NBodySim {
+	template <class T> struct Snapshot;
+	template <class T> class StepPipeline;
+	namespace StepPipelineSpace {
+		/**
+		 * defaultDepth is the number of snapshot buffers, the number of snapshots that may be in flight at once
+		 */
+		const size_t defaultDepth = 3;
+	}
+}
+
+/**
+ * @brief The state of a system after a step, as handed to the stages of a StepPipeline.
+ */
+template <class T>
+struct NBodySim::Snapshot {
+	size_t step;                                   /**< Number of steps taken when the snapshot was captured */
+	T time;                                        /**< Simulated time in seconds when the snapshot was captured */
+	std::vector<NBodySim::Particle<T> > particles; /**< Every particle in index order */
+};
+
+/**
+ * @brief Steps a system while output and analysis of earlier steps run on other threads.
+ *
+ * Every interval steps the state of the system is copied into one of a fixed number of snapshot buffers and handed to
+ * every stage, each of which has its own thread and sees the snapshots in order. A stage may be given an interval of its
+ * own, a step due to several stages is copied once for all of them. The next step starts as soon as the copy
+ * is made, so the stages cost the stepping thread only the copy. A buffer goes back to the pool when the last stage is
+ * done with it, so nothing is allocated once every buffer has been used. When every buffer is still in use the stepping
+ * thread waits, which bounds the memory and the lag of the stages, and counts a stall.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+template <class T>
+class NBodySim::StepPipeline {
+public:
+	/**
+	 * stageFunction is a consumer of snapshots, it must not keep a reference to the snapshot after it returns
+	 */
+	typedef std::function<void(const NBodySim::Snapshot<T> &)> stageFunction;
+
+private:
+	/**
+	 * stageLoop runs a stage on every snapshot published to it until the pipeline is destroyed
+	 *
+	 * @param stage is the index of the stage
+	 * @param body is the stage
+	 */
+	void stageLoop(size_t stage, stageFunction body);
+
+	/**
+	 * publish copies the state of the system into a free buffer and queues it to every stage in dueStages
+	 */
+	void publish(void);
+
+protected:
+	/**
+	 * system is the system being stepped
+	 */
+	NBodySim::NBodySystem<T> * system;
+
+	/**
+	 * interval is the number of steps between snapshots of the stages added without an interval of their own
+	 */
+	size_t interval;
+
+	/**
+	 * stepCount is the number of steps taken and time the simulated time they covered
+	 */
+	size_t stepCount;
+	T time;
+
+	/**
+	 * buffers holds the snapshots, pending the number of stages yet to finish with each and freeBuffers the ones no
+	 * stage holds, all guarded by pipelineMutex
+	 */
+	std::vector<NBodySim::Snapshot<T> > buffers;
+	std::vector<size_t> pending;
+	std::deque<size_t> freeBuffers;
+
+	/**
+	 * queues holds the buffers waiting for every stage, guarded by pipelineMutex
+	 */
+	std::vector<std::deque<size_t> > queues;
+	
+	/**
+	 * intervals holds the number of steps between the snapshots of every stage, guarded by pipelineMutex, and dueStages
+	 * the stages the current step is published to, used by the stepping thread alone
+	 */
+	std::vector<size_t> intervals;
+	std::vector<size_t> dueStages;
+
+	/**
+	 * stages holds a thread for every stage
+	 */
+	boost::thread_group stages;
+
+	/**
+	 * pipelineMutex guards the buffers and queues, published wakes the stages and released the stepping thread
+	 */
+	boost::mutex pipelineMutex;
+	boost::condition_variable published;
+	boost::condition_variable released;
+
+	/**
+	 * closing tells the stages to finish their queues and return
+	 */
+	bool closing;
+
+	/**
+	 * stalls is the number of snapshots the stepping thread had to wait for a free buffer for
+	 */
+	size_t stalls;
+
+public:
+	/**
+	 * Constructor
+	 *
+	 * @param systemIn is the system to step, it must outlive the pipeline
+	 * @param intervalIn is the number of steps between snapshots, 0 is taken as 1
+	 * @param depth is the number of snapshot buffers, 0 is taken as 1
+	 */
+	StepPipeline(NBodySim::NBodySystem<T> * systemIn, size_t intervalIn = 1, size_t depth = NBodySim::StepPipelineSpace::defaultDepth);
+
+	/**
+	 * Destructor, waits for the stages to finish every snapshot already published
+	 */
+	virtual ~StepPipeline(void);
+
+	/**
+	 * addStage starts a thread which calls a stage on every snapshot published to it from now on
+	 *
+	 * @param body is the stage
+	 * @param stageInterval is the number of steps between the snapshots of this stage, 0 uses the pipeline's interval
+	 */
+	void addStage(stageFunction body, size_t stageInterval = 0);
+
+	/**
+	 * step steps the system and publishes a snapshot to the stages whose interval has passed
+	 *
+	 * @param deltaT is the length of the step in seconds
+	 */
+	void step(T deltaT);
+
+	/**
+	 * flush waits until every stage is done with every snapshot published so far
+	 */
+	void flush(void);
+
+	/**
+	 * getStepCount returns the number of steps taken through the pipeline
+	 *
+	 * @return the number of steps
+	 */
+	size_t getStepCount(void);
+
+	/**
+	 * getStalls returns how many snapshots had to wait for a stage to free a buffer
+	 *
+	 * @return the number of stalls
+	 */
+	size_t getStalls(void);
+
+	/**
+	 * numStages returns the number of stages
+	 *
+	 * @return the number of stages
+	 */
+	size_t numStages(void);
+};
+
+#endif // STEP_PIPELINE_H
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <string>
+
+#include <boost/thread.hpp>
+
+namespace NBodySim {
+	class TaskScheduler;
+}
+
+/**
+ * @brief Runs loops over index ranges on a fixed pool of threads, balancing uneven work by stealing.
+ *
+ * A loop is cut into chunks of a given grain and every thread starts with an equal, contiguous share of the chunks in its
+ * own deque. A thread takes chunks from the front of its own deque and, once it runs dry, steals from the back of the
+ * other threads' deques, so threads whose particles are cheap help the ones whose particles are expensive. The thread
+ * that calls a loop works on it as thread 0 and returns once every chunk is done.
+ *
+ * The threads may be pinned to CPUs, in which case they are spread over the NUMA nodes in contiguous blocks, so the
+ * first threads, which start with the first indices of every loop, share a node. Pinning is only done on Linux, the
+ * nodes are read from sysfs.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ */
+class NBodySim::TaskScheduler {
+public:
+	/**
+	 * rangeFunction is the body of a loop, called with the first index of a chunk and one past its last index
+	 */
+	typedef std::function<void(size_t, size_t)> rangeFunction;
+
+	/**
+	 * threadRangeFunction is the body of a loop which also receives the index of the thread running the chunk
+	 */
+	typedef std::function<void(size_t, size_t, unsigned)> threadRangeFunction;
+
+private:
+	/**
+	 * workerLoop waits for loops and works on them until the scheduler is destroyed
+	 *
+	 * @param thread is the index of the worker, from 1 to the number of threads minus one
+	 */
+	void workerLoop(unsigned thread);
+
+	/**
+	 * work runs chunks of the current loop, first from the own deque of thread and then stolen from the others
+	 *
+	 * @param thread is the index of the thread doing the work
+	 */
+	void work(unsigned thread);
+
+	/**
+	 * run hands the chunks in the deques to every thread and returns once they are all done
+	 *
+	 * @param body is the body of the loop
+	 * @param steal is true to let idle threads take chunks from the others
+	 */
+	void run(const threadRangeFunction & body, bool steal);
+
+	/**
+	 * readNodes reads the CPUs of every online NUMA node, falling back to one node holding every hardware thread
+	 *
+	 * @param nodes receives the CPUs of every node
+	 */
+	static void readNodes(std::vector<std::vector<unsigned> > & nodes);
+
+	/**
+	 * parseList parses a sysfs list such as 0-3,8-11
+	 *
+	 * @param list is the text of the list
+	 * @param values receives every value of the list
+	 */
+	static void parseList(const std::string & list, std::vector<unsigned> & values);
+
+	/**
+	 * pin binds the calling thread to a CPU
+	 *
+	 * @param cpu is the CPU to run on
+	 */
+	static void pin(unsigned cpu);
+
+	/**
+	 * pop takes a chunk from a deque, from the front for its owner and from the back for a thief
+	 *
+	 * @param owner is the index of the deque
+	 * @param back is true to take from the back
+	 * @param chunk receives the chunk
+	 * @return true if the deque was not empty
+	 */
+	bool pop(unsigned owner, bool back, std::pair<size_t, size_t> * chunk);
+
+protected:
+	/**
+	 * numThreads is the number of threads including the calling thread, declared first so the deques can be sized from it
+	 */
+	unsigned numThreads;
+
+	/**
+	 * workers holds the threads beside the calling thread
+	 */
+	boost::thread_group workers;
+
+	/**
+	 * deques holds the chunks waiting in every thread, guarded by the mutex of the same index
+	 */
+	std::vector<std::deque<std::pair<size_t, size_t> > > deques;
+	std::vector<boost::mutex> dequeMutexes;
+
+	/**
+	 * loopMutex lets one loop run at a time, wakeMutex and wake signal the workers that a loop started or the pool is closing
+	 */
+	boost::mutex loopMutex;
+	boost::mutex wakeMutex;
+	boost::condition_variable wake;
+	boost::condition_variable done;
+
+	/**
+	 * body is the loop being run, stealing indicates whether idle threads may take chunks of the other threads
+	 */
+	const threadRangeFunction * body;
+	bool stealing;
+
+	/**
+	 * pinned indicates the threads are bound to CPUs, cpuOfThread and nodeOfThread give the CPU and NUMA node of each
+	 */
+	bool pinned;
+	std::vector<unsigned> cpuOfThread;
+	std::vector<unsigned> nodeOfThread;
+	unsigned numNodes;
+
+	/**
+	 * pinnedCaller is the thread last pinned as thread 0, the thread calling the loops may change between loops
+	 */
+	boost::thread::id pinnedCaller;
+
+	/**
+	 * generation counts the loops started, so a worker can tell a new loop from the one it finished
+	 */
+	size_t generation;
+
+	/**
+	 * remaining counts the chunks of the current loop not yet finished, busy counts the workers still in the loop
+	 */
+	std::atomic<size_t> remaining;
+	size_t busy;
+
+	/**
+	 * closing tells the workers to return
+	 */
+	bool closing;
+
+public:
+	/**
+	 * constructor which starts the pool
+	 *
+	 * @param threads is the number of threads including the calling thread, 0 uses one per hardware thread
+	 * @param pinThreads is true to bind every thread, including the one calling the loops, to a CPU
+	 */
+	TaskScheduler(unsigned threads, bool pinThreads = false);
+
+	/**
+	 * Destructor, stops and joins the worker threads
+	 */
+	virtual ~TaskScheduler(void);
+
+	/**
+	 * getNumThreads returns the number of threads including the calling thread
+	 *
+	 * @return the number of threads
+	 */
+	unsigned getNumThreads(void);
+
+	/**
+	 * getPinned returns whether the threads are bound to CPUs
+	 *
+	 * @return true if the threads are pinned
+	 */
+	bool getPinned(void);
+
+	/**
+	 * getNumNodes returns the number of NUMA nodes the threads are spread over
+	 *
+	 * @return the number of nodes holding at least one thread, 1 when the threads are not pinned
+	 */
+	unsigned getNumNodes(void);
+
+	/**
+	 * getThreadNode returns the NUMA node a thread runs on
+	 *
+	 * @param thread is the index of the thread
+	 * @return the node of the thread, counted from 0 over the nodes holding threads, 0 when the threads are not pinned
+	 */
+	unsigned getThreadNode(unsigned thread);
+
+	/**
+	 * parallelFor calls body on chunks of at most grain indices covering [begin, end), balancing the chunks by stealing
+	 *
+	 * @param begin is the first index
+	 * @param end is one past the last index
+	 * @param grain is the largest number of indices in a chunk, 0 is treated as 1
+	 * @param body is called once per chunk, possibly from several threads at once
+	 */
+	void parallelFor(size_t begin, size_t end, size_t grain, const rangeFunction & body);
+
+	/**
+	 * parallelFor calls body on chunks of at most grain indices covering [begin, end) with the index of the thread
+	 * running each chunk, balancing the chunks by stealing
+	 *
+	 * @param begin is the first index
+	 * @param end is one past the last index
+	 * @param grain is the largest number of indices in a chunk, 0 is treated as 1
+	 * @param body is called once per chunk, possibly from several threads at once
+	 */
+	void parallelFor(size_t begin, size_t end, size_t grain, const threadRangeFunction & body);
+
+	/**
+	 * parallelForStatic calls body once per thread on equal, contiguous shares of [begin, end) without stealing
+	 *
+	 * @param begin is the first index
+	 * @param end is one past the last index
+	 * @param body is called once per thread
+	 */
+	void parallelForStatic(size_t begin, size_t end, const rangeFunction & body);
+
+	/**
+	 * parallelForRanges calls body once per thread on the range [bounds[thread], bounds[thread + 1]) without stealing, so
+	 * a caller that knows the cost of its indices can hand every thread an equal share of the work
+	 *
+	 * @param bounds holds one more entry than there are threads, in ascending order, any other number of ranges is run
+	 * one after another on the calling thread
+	 * @param body is called once per non empty range
+	 */
+	void parallelForRanges(const std::vector<size_t> & bounds, const rangeFunction & body);
+
+	/**
+	 * parallelForRanges calls body once per thread on the range [bounds[thread], bounds[thread + 1]) with the index of
+	 * the thread, without stealing
+	 *
+	 * @param bounds holds one more entry than there are threads, in ascending order, any other number of ranges is run
+	 * one after another on the calling thread
+	 * @param body is called once per non empty range
+	 */
+	void parallelForRanges(const std::vector<size_t> & bounds, const threadRangeFunction & body);
+
+	/**
+	 * parallelForThreads calls body exactly once on every thread, so memory it first writes lands on the node of the
+	 * thread
+	 *
+	 * @param body is called with the index of the thread it runs on
+	 */
+	void parallelForThreads(const std::function<void(unsigned)> & body);
+};
+
+#endif // TASK_SCHEDULER_H
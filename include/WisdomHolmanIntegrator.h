@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef WISDOM_HOLMAN_INTEGRATOR_H
+#define WISDOM_HOLMAN_INTEGRATOR_H
+
+#include <vector>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+
+namespace NBodySim {
+	template <class T> class WisdomHolmanIntegrator;
+}
+
+/**
+ * @brief Advances a system dominated by one central mass with the Wisdom-Holman symplectic map.
+ *
+ * The system is split in democratic heliocentric coordinates: positions relative to the central body and barycentric velocities.
+ * Each step kicks the planets with their mutual attraction, shifts them by the motion of the central body and moves them along
+ * exact Kepler orbits about the central mass, so the step may be a sizeable fraction of the shortest orbital period.
+ * The most massive particle is taken as the central body.
+ *
+ * @author W.A. Garrett Weaver
+ * @see NBodySystem
+ * @see Kepler
+ */
+template <class T>
+class NBodySim::WisdomHolmanIntegrator {
+private:
+	/**
+	 * interactionKick changes the velocity of every planet by the attraction of the other planets over dt
+	 *
+	 * @param dt is the length of the kick
+	 */
+	void interactionKick(T dt);
+
+	/**
+	 * jump shifts every planet by the motion of the central body over dt
+	 *
+	 * @param dt is the length of the shift
+	 */
+	void jump(T dt);
+
+protected:
+	/**
+	 * gm holds the gravitation constant multiplied by the mass of every planet
+	 */
+	std::vector<T> gm;
+
+	/**
+	 * mass holds the mass of every planet
+	 */
+	std::vector<T> mass;
+
+	/**
+	 * pos holds the position of every planet relative to the central body
+	 */
+	std::vector<NBodySim::ThreeVector<T> > pos;
+
+	/**
+	 * vel holds the velocity of every planet relative to the barycenter
+	 */
+	std::vector<NBodySim::ThreeVector<T> > vel;
+
+	/**
+	 * centralMass is the mass of the central body
+	 */
+	T centralMass;
+
+public:
+	/**
+	 * Default constructor
+	 */
+	WisdomHolmanIntegrator(void);
+
+	/**
+	 * Destructor
+	 */
+	virtual ~WisdomHolmanIntegrator(void);
+
+	/**
+	 * step advances every particle in system by deltaT
+	 *
+	 * @param system is the set of particles to advance
+	 * @param G is the gravitation constant of the system
+	 * @param deltaT is a floating point number of the amount of time that passes till the next step
+	 */
+	void step(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT);
+};
+
+#endif // WISDOM_HOLMAN_INTEGRATOR_H
@@ -38,6 +38,7 @@
 #include "NBodyTypes.h"
 #include "Particle.h"
 #include "NBodySystem.h"
+#include "StepPipeline.h"
 
 /**
  * @brief timingFunction pulls a semaphore high every interval for as long as quitTiming is false
@@ -51,7 +52,8 @@
 void * timingFunction(NBodySim::FloatingType interval, unsigned numSems, boost::interprocess::interprocess_semaphore ** timingSems, volatile bool * quitTiming);
 
 /**
- * @brief workThread calculates new positions and velocities for the particle vector till program close
+ * @brief workThread calculates new positions and velocities for the particle vector till program close, each step shares
+ * its force calculation out to the threads set with NBodySystem::setNumThreads
  *
  * @param stepSize the amount of time for each simulation step in seconds
  * @param timingSem a pointer to a semaphore used to tell the function when to procede with the next step
@@ -62,4 +64,18 @@ void * timingFunction(NBodySim::FloatingType interval, unsigned numSems, boost::
  */
 void * workThread(NBodySim::FloatingType stepSize, boost::interprocess::interprocess_semaphore * timingSem, volatile bool * quitTiming, NBodySim::NBodySystem<NBodySim::FloatingType> * solarSystem, volatile size_t * stepsPerTime);
 
+/**
+ * @brief pipelineWorkThread steps a system through a pipeline till program close, so the stages of the pipeline write and
+ * analyse snapshots of earlier steps while the later steps are calculated
+ *
+ * @param stepSize the amount of time for each simulation step in seconds
+ * @param timingSem a pointer to a semaphore used to tell the function when to procede with the next step
+ * @param quitTiming a bool used to indicate if the thread should continue
+ * @param pipeline a pointer to the pipeline stepping the system
+ * @param stepsPerTime a pointer to an int indicating how many time steps should occur per timingSem post
+ * @param stepMutex a pointer to a mutex held through every step, so another thread holding it may read the system
+ * @return A null pointer
+ */
+void * pipelineWorkThread(NBodySim::FloatingType stepSize, boost::interprocess::interprocess_semaphore * timingSem, volatile bool * quitTiming, NBodySim::StepPipeline<NBodySim::FloatingType> * pipeline, volatile size_t * stepsPerTime, boost::mutex * stepMutex);
+
 #endif //THREADS_H
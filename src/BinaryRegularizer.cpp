@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "Kepler.h"
+#include "SpatialHash.h"
+#include "BinaryRegularizer.h"
+
+template <class T>
+NBodySim::BinaryRegularizer<T>::BinaryRegularizer(void){
+	gridBuilt = false;
+}
+
+template <class T>
+NBodySim::BinaryRegularizer<T>::~BinaryRegularizer(void){
+
+}
+
+template <class T>
+void NBodySim::BinaryRegularizer<T>::reset(void){
+	first.clear();
+	second.clear();
+	firstMass.clear();
+	secondMass.clear();
+	relativePos.clear();
+	relativeVel.clear();
+	paired.clear();
+}
+
+template <class T>
+size_t NBodySim::BinaryRegularizer<T>::numPairs(void){
+	return first.size();
+}
+
+template <class T>
+bool NBodySim::BinaryRegularizer<T>::isRegularizable(std::vector<NBodySim::Particle<T> > & system, T G, size_t i, size_t j, T * period){
+	T mass = system[i].getMass() + system[j].getMass();
+	T mu = G * mass;
+	NBodySim::ThreeVector<T> r;
+	NBodySim::ThreeVector<T> v;
+	NBodySim::ThreeVector<T> center;
+	T distance;
+	T energy;
+	T semiMajorAxis;
+	T angularMomentumSquared;
+	T eccentricity;
+
+	if(mass <= 0 || mu <= 0){
+		return false;
+	}
+	r.x = system[i].getPos().x - system[j].getPos().x;
+	r.y = system[i].getPos().y - system[j].getPos().y;
+	r.z = system[i].getPos().z - system[j].getPos().z;
+	v.x = system[i].getVel().x - system[j].getVel().x;
+	v.y = system[i].getVel().y - system[j].getVel().y;
+	v.z = system[i].getVel().z - system[j].getVel().z;
+	distance = std::sqrt(r.x * r.x + r.y * r.y + r.z * r.z);
+	if(distance == 0){
+		return false;
+	}
+
+	// Specific orbital energy of the relative motion, negative when the pair is bound
+	energy = (v.x * v.x + v.y * v.y + v.z * v.z) / 2 - mu / distance;
+	if(energy >= 0){
+		return false;
+	}
+	semiMajorAxis = -mu / (2 * energy);
+	angularMomentumSquared = (r.y * v.z - r.z * v.y) * (r.y * v.z - r.z * v.y) + (r.z * v.x - r.x * v.z) * (r.z * v.x - r.x * v.z) + (r.x * v.y - r.y * v.x) * (r.x * v.y - r.y * v.x);
+	eccentricity = std::sqrt(std::max(static_cast<T>(0), 1 + 2 * energy * angularMomentumSquared / (mu * mu)));
+	*period = 2 * M_PI * std::sqrt(semiMajorAxis * semiMajorAxis * semiMajorAxis / mu);
+
+	// Every other particle must stay well outside the apocenter, or its tide would change the orbit
+	center.x = (system[i].getMass() * system[i].getPos().x + system[j].getMass() * system[j].getPos().x) / mass;
+	center.y = (system[i].getMass() * system[i].getPos().y + system[j].getMass() * system[j].getPos().y) / mass;
+	center.z = (system[i].getMass() * system[i].getPos().z + system[j].getMass() * system[j].getPos().z) / mass;
+	return isIsolated(system, i, j, center, NBodySim::BinaryRegularizerSpace::isolationFactor * semiMajorAxis * (1 + eccentricity));
+}
+
+template <class T>
+bool NBodySim::BinaryRegularizer<T>::isIsolated(std::vector<NBodySim::Particle<T> > & system, size_t i, size_t j, const NBodySim::ThreeVector<T> & center, T reach){
+	size_t numParticles = system.size();
+	NBodySim::ThreeVector<T> dr;
+	int64_t span;
+	int64_t x;
+	int64_t y;
+	int64_t z;
+	size_t b;
+	size_t k;
+
+	// The cells covering the reach are searched only when there are fewer of them than particles
+	if(gridBuilt && 2 * std::ceil(reach / grid.getCellSize()) + 1 <= std::cbrt(static_cast<T>(numParticles))){
+		span = static_cast<int64_t>(std::ceil(reach / grid.getCellSize()));
+		x = grid.cellOf(center.x);
+		y = grid.cellOf(center.y);
+		z = grid.cellOf(center.z);
+		for(int64_t dx = -span; dx <= span; dx++){
+			for(int64_t dy = -span; dy <= span; dy++){
+				for(int64_t dz = -span; dz <= span; dz++){
+					b = grid.hashCell(x + dx, y + dy, z + dz);
+					for(size_t n = grid.bucketBegin(b); n < grid.bucketEnd(b); n++){
+						k = grid.particleAt(n);
+						if(k == i || k == j){
+							continue;
+						}
+						dr.x = system[k].getPos().x - center.x;
+						dr.y = system[k].getPos().y - center.y;
+						dr.z = system[k].getPos().z - center.z;
+						if(dr.x * dr.x + dr.y * dr.y + dr.z * dr.z < reach * reach){
+							return false;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	for(k = 0; k < numParticles; k++){
+		if(k == i || k == j){
+			continue;
+		}
+		dr.x = system[k].getPos().x - center.x;
+		dr.y = system[k].getPos().y - center.y;
+		dr.z = system[k].getPos().z - center.z;
+		if(dr.x * dr.x + dr.y * dr.y + dr.z * dr.z < reach * reach){
+			return false;
+		}
+	}
+	return true;
+}
+
+template <class T>
+void NBodySim::BinaryRegularizer<T>::findNearest(std::vector<NBodySim::Particle<T> > & system, T widest){
+	size_t numParticles = system.size();
+	NBodySim::ThreeVector<T> dr;
+	T minimum;
+	T distanceSquared;
+	int64_t x;
+	int64_t y;
+	int64_t z;
+	size_t b;
+	size_t j;
+
+	nearest.assign(numParticles, numParticles);
+	if(!gridBuilt){
+		return;
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		if(paired[i]){
+			continue;
+		}
+		// A particle further than widest could not be regularized with i, so the neighbouring cells hold every candidate
+		minimum = widest * widest;
+		x = grid.cellOf(system[i].getPos().x);
+		y = grid.cellOf(system[i].getPos().y);
+		z = grid.cellOf(system[i].getPos().z);
+		for(int64_t dx = -1; dx <= 1; dx++){
+			for(int64_t dy = -1; dy <= 1; dy++){
+				for(int64_t dz = -1; dz <= 1; dz++){
+					b = grid.hashCell(x + dx, y + dy, z + dz);
+					for(size_t k = grid.bucketBegin(b); k < grid.bucketEnd(b); k++){
+						j = grid.particleAt(k);
+						if(j == i || paired[j]){
+							continue;
+						}
+						dr.x = system[j].getPos().x - system[i].getPos().x;
+						dr.y = system[j].getPos().y - system[i].getPos().y;
+						dr.z = system[j].getPos().z - system[i].getPos().z;
+						distanceSquared = dr.x * dr.x + dr.y * dr.y + dr.z * dr.z;
+						// Ties go to the lower index, whatever order the cells are visited in
+						if(distanceSquared < minimum || (distanceSquared == minimum && j < nearest[i])){
+							minimum = distanceSquared;
+							nearest[i] = j;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template <class T>
+bool NBodySim::BinaryRegularizer<T>::update(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT){
+	size_t numParticles = system.size();
+	bool changed = false;
+	T period;
+	T longestPeriod = NBodySim::BinaryRegularizerSpace::stepsPerOrbit * deltaT;
+	T maxMass = 0;
+	T widest;
+
+	if(paired.size() != numParticles){
+		changed = !first.empty();
+		reset();
+		paired.assign(numParticles, false);
+	}
+
+	// A pair with a period below the longest is at most twice the semi-major axis of the heaviest such pair apart
+	for(size_t i = 0; i < numParticles; i++){
+		maxMass = std::max(maxMass, system[i].getMass());
+	}
+	widest = 2 * std::cbrt(G * 2 * maxMass * longestPeriod * longestPeriod / (4 * M_PI * M_PI));
+	gridBuilt = widest > 0 && widest < std::numeric_limits<T>::infinity();
+	if(gridBuilt){
+		grid.build(system, widest);
+	}
+
+	// Dissolve pairs that became unbound or perturbed, swap removing them from the back
+	for(size_t p = first.size(); p > 0; p--){
+		if(!isRegularizable(system, G, first[p - 1], second[p - 1], &period)){
+			paired[first[p - 1]] = false;
+			paired[second[p - 1]] = false;
+			first[p - 1] = first.back();
+			second[p - 1] = second.back();
+			first.pop_back();
+			second.pop_back();
+			changed = true;
+		}
+	}
+
+	findNearest(system, widest);
+
+	// Regularize mutually nearest pairs whose orbit is too short for the step
+	for(size_t i = 0; i < numParticles; i++){
+		size_t j = nearest[i];
+		if(paired[i] || j == numParticles || j < i || nearest[j] != i){
+			continue;
+		}
+		if(isRegularizable(system, G, i, j, &period) && period < NBodySim::BinaryRegularizerSpace::stepsPerOrbit * deltaT){
+			first.push_back(i);
+			second.push_back(j);
+			paired[i] = true;
+			paired[j] = true;
+			changed = true;
+		}
+	}
+
+	firstMass.resize(first.size());
+	secondMass.resize(first.size());
+	relativePos.resize(first.size());
+	relativeVel.resize(first.size());
+	return changed;
+}
+
+template <class T>
+void NBodySim::BinaryRegularizer<T>::combine(std::vector<NBodySim::Particle<T> > & system){
+	NBodySim::ThreeVector<T> center;
+	NBodySim::ThreeVector<T> centerVel;
+	T mass;
+
+	for(size_t p = 0; p < first.size(); p++){
+		NBodySim::Particle<T> & a = system[first[p]];
+		NBodySim::Particle<T> & b = system[second[p]];
+		firstMass[p] = a.getMass();
+		secondMass[p] = b.getMass();
+		mass = firstMass[p] + secondMass[p];
+		relativePos[p].x = a.getPos().x - b.getPos().x;
+		relativePos[p].y = a.getPos().y - b.getPos().y;
+		relativePos[p].z = a.getPos().z - b.getPos().z;
+		relativeVel[p].x = a.getVel().x - b.getVel().x;
+		relativeVel[p].y = a.getVel().y - b.getVel().y;
+		relativeVel[p].z = a.getVel().z - b.getVel().z;
+		center.x = (firstMass[p] * a.getPos().x + secondMass[p] * b.getPos().x) / mass;
+		center.y = (firstMass[p] * a.getPos().y + secondMass[p] * b.getPos().y) / mass;
+		center.z = (firstMass[p] * a.getPos().z + secondMass[p] * b.getPos().z) / mass;
+		centerVel.x = (firstMass[p] * a.getVel().x + secondMass[p] * b.getVel().x) / mass;
+		centerVel.y = (firstMass[p] * a.getVel().y + secondMass[p] * b.getVel().y) / mass;
+		centerVel.z = (firstMass[p] * a.getVel().z + secondMass[p] * b.getVel().z) / mass;
+		// The massless second particle sits on the first, where the inverse cube of the zero distance is 0
+		a.setPos(center);
+		a.setVel(centerVel);
+		a.setMass(mass);
+		b.setPos(center);
+		b.setVel(centerVel);
+		b.setMass(0);
+	}
+}
+
+template <class T>
+void NBodySim::BinaryRegularizer<T>::split(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT){
+	NBodySim::ThreeVector<T> center;
+	NBodySim::ThreeVector<T> centerVel;
+	NBodySim::ThreeVector<T> pos;
+	NBodySim::ThreeVector<T> vel;
+	T mass;
+
+	for(size_t p = 0; p < first.size(); p++){
+		NBodySim::Particle<T> & a = system[first[p]];
+		NBodySim::Particle<T> & b = system[second[p]];
+		mass = firstMass[p] + secondMass[p];
+		center = a.getPos();
+		centerVel = a.getVel();
+		NBodySim::Kepler<T>::drift(G * mass, &relativePos[p], &relativeVel[p], deltaT);
+
+		pos.x = center.x + secondMass[p] / mass * relativePos[p].x;
+		pos.y = center.y + secondMass[p] / mass * relativePos[p].y;
+		pos.z = center.z + secondMass[p] / mass * relativePos[p].z;
+		vel.x = centerVel.x + secondMass[p] / mass * relativeVel[p].x;
+		vel.y = centerVel.y + secondMass[p] / mass * relativeVel[p].y;
+		vel.z = centerVel.z + secondMass[p] / mass * relativeVel[p].z;
+		a.setPos(pos);
+		a.setVel(vel);
+		a.setMass(firstMass[p]);
+
+		pos.x = center.x - firstMass[p] / mass * relativePos[p].x;
+		pos.y = center.y - firstMass[p] / mass * relativePos[p].y;
+		pos.z = center.z - firstMass[p] / mass * relativePos[p].z;
+		vel.x = centerVel.x - firstMass[p] / mass * relativeVel[p].x;
+		vel.y = centerVel.y - firstMass[p] / mass * relativeVel[p].y;
+		vel.z = centerVel.z - firstMass[p] / mass * relativeVel[p].z;
+		b.setPos(pos);
+		b.setVel(vel);
+		b.setMass(secondMass[p]);
+	}
+}
+
+template class NBodySim::BinaryRegularizer<NBodySim::FloatingType>;
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "SpatialHash.h"
+#include "CollisionDetector.h"
+
+template <class T>
+NBodySim::CollisionDetector<T>::CollisionDetector(void){
+
+}
+
+template <class T>
+NBodySim::CollisionDetector<T>::~CollisionDetector(void){
+
+}
+
+template <class T>
+void NBodySim::CollisionDetector<T>::merge(NBodySim::Particle<T> & i, NBodySim::Particle<T> & j){
+	T mass = i.getMass() + j.getMass();
+	T weightI = (mass > 0) ? i.getMass() / mass : 0.5;
+	T weightJ = 1 - weightI;
+	NBodySim::ThreeVector<T> pos;
+	NBodySim::ThreeVector<T> vel;
+
+	// The merged body sits at the center of mass and moves with the total momentum
+	pos.x = weightI * i.getPos().x + weightJ * j.getPos().x;
+	pos.y = weightI * i.getPos().y + weightJ * j.getPos().y;
+	pos.z = weightI * i.getPos().z + weightJ * j.getPos().z;
+	vel.x = weightI * i.getVel().x + weightJ * j.getVel().x;
+	vel.y = weightI * i.getVel().y + weightJ * j.getVel().y;
+	vel.z = weightI * i.getVel().z + weightJ * j.getVel().z;
+	i.setPos(pos);
+	i.setVel(vel);
+	i.setRadius(std::cbrt(i.getRadius() * i.getRadius() * i.getRadius() + j.getRadius() * j.getRadius() * j.getRadius()));
+	if(j.getMass() > i.getMass()){
+		i.setNameId(j.getNameId());
+	}
+	i.setMass(mass);
+}
+
+template <class T>
+size_t NBodySim::CollisionDetector<T>::resolve(std::vector<NBodySim::Particle<T> > & system, std::vector<size_t> & removedIds){
+	size_t numParticles = system.size();
+	size_t b;
+	size_t j;
+	T maxRadius = 0;
+	T reach;
+	int64_t x;
+	int64_t y;
+	int64_t z;
+	NBodySim::ThreeVector<T> dr;
+
+	for(size_t i = 0; i < numParticles; i++){
+		if(system[i].getRadius() > maxRadius){
+			maxRadius = system[i].getRadius();
+		}
+	}
+	removedIds.clear();
+	if(numParticles < 2 || maxRadius <= 0){
+		return 0;
+	}
+
+	// Two overlapping particles are at most two maximum radii apart, so they share a cell or are in neighbouring cells
+	grid.build(system, 2 * maxRadius);
+
+	absorbed.assign(numParticles, false);
+	for(size_t i = 0; i < numParticles; i++){
+		if(absorbed[i] || system[i].getRadius() <= 0){
+			continue;
+		}
+		x = grid.cellOf(system[i].getPos().x);
+		y = grid.cellOf(system[i].getPos().y);
+		z = grid.cellOf(system[i].getPos().z);
+		for(int64_t dx = -1; dx <= 1; dx++){
+			for(int64_t dy = -1; dy <= 1; dy++){
+				for(int64_t dz = -1; dz <= 1; dz++){
+					b = grid.hashCell(x + dx, y + dy, z + dz);
+					for(size_t k = grid.bucketBegin(b); k < grid.bucketEnd(b); k++){
+						// Each pair is checked once, from its lower index, hash collisions may list a particle twice
+						j = grid.particleAt(k);
+						if(j <= i || absorbed[j] || system[j].getRadius() <= 0){
+							continue;
+						}
+						dr.x = system[j].getPos().x - system[i].getPos().x;
+						dr.y = system[j].getPos().y - system[i].getPos().y;
+						dr.z = system[j].getPos().z - system[i].getPos().z;
+						reach = system[i].getRadius() + system[j].getRadius();
+						if(dr.x * dr.x + dr.y * dr.y + dr.z * dr.z < reach * reach){
+							merge(system[i], system[j]);
+							absorbed[j] = true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for(size_t i = 0; i < numParticles; i++){
+		if(absorbed[i]){
+			removedIds.push_back(system[i].getId());
+		}
+	}
+	// Removing the highest id first means the particle moved into each freed id is never one still to be removed
+	std::sort(removedIds.begin(), removedIds.end(), std::greater<size_t>());
+	return removedIds.size();
+}
+
+template class NBodySim::CollisionDetector<NBodySim::FloatingType>;
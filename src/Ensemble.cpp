@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include "Ensemble.h"
+#include "InverseCube.h"
+
+template <class T>
+NBodySim::Ensemble<T>::Ensemble(void){
+	G = 6.67408e-11;
+	numParticles = 0;
+	replicaCount = 0;
+	numBlocks = 0;
+	precision = NBodySim::ACCURATE;
+}
+
+template <class T>
+NBodySim::Ensemble<T>::~Ensemble(void){
+}
+
+template <class T>
+size_t NBodySim::Ensemble<T>::index(size_t block, size_t particle){
+	return (block * numParticles + particle) * NBodySim::EnsembleSpace::laneWidth;
+}
+
+template <class T>
+void NBodySim::Ensemble<T>::generate(NBodySim::NBodySystem<T> & scenario, size_t numReplicas, T perturbation, unsigned seed){
+	const size_t W = NBodySim::EnsembleSpace::laneWidth;
+	size_t replica;
+	size_t base;
+	NBodySim::ThreeVector<T> position;
+	NBodySim::ThreeVector<T> velocity;
+
+	G = scenario.getGravitation();
+	numParticles = scenario.numParticles();
+	replicaCount = numReplicas;
+	numBlocks = (numReplicas + W - 1) / W;
+
+	nameIds.resize(numParticles);
+	masses.resize(numParticles);
+	gm.resize(numParticles);
+	NBodySim::ParticleView<T> particles = scenario.viewParticles();
+	for(size_t i = 0; i < numParticles; i++){
+		nameIds[i] = particles[i].getNameId();
+		masses[i] = particles[i].getMass();
+		gm[i] = G * masses[i];
+	}
+
+	posX.assign(numBlocks * numParticles * W, 0);
+	posY.assign(numBlocks * numParticles * W, 0);
+	posZ.assign(numBlocks * numParticles * W, 0);
+	velX.assign(numBlocks * numParticles * W, 0);
+	velY.assign(numBlocks * numParticles * W, 0);
+	velZ.assign(numBlocks * numParticles * W, 0);
+	for(size_t block = 0; block < numBlocks; block++){
+		for(size_t lane = 0; lane < W; lane++){
+			// Lanes past the last replica repeat the first lane of their block, so they stay as well behaved as it
+			replica = block * W + ((block * W + lane < numReplicas) ? lane : 0);
+			for(size_t i = 0; i < numParticles; i++){
+				position = particles[i].getPos();
+				velocity = particles[i].getVel();
+				base = index(block, i) + lane;
+				posX[base] = position.x;
+				posY[base] = position.y;
+				posZ[base] = position.z;
+				velX[base] = velocity.x;
+				velY[base] = velocity.y;
+				velZ[base] = velocity.z;
+			}
+			// The first replica is the scenario itself, the reference the others are compared to, and without a spread
+			// every replica is
+			if(replica == 0 || perturbation <= 0){
+				continue;
+			}
+			// Every replica draws from its own generator, so its perturbation does not depend on how many there are
+			std::mt19937 generator(seed + static_cast<unsigned>(replica));
+			std::normal_distribution<T> factor(1, perturbation);
+			for(size_t i = 0; i < numParticles; i++){
+				base = index(block, i) + lane;
+				posX[base] *= factor(generator);
+				posY[base] *= factor(generator);
+				posZ[base] *= factor(generator);
+				velX[base] *= factor(generator);
+				velY[base] *= factor(generator);
+				velZ[base] *= factor(generator);
+			}
+		}
+	}
+
+	initialEnergy.assign(numBlocks * W, 0);
+	finalEnergy.assign(numBlocks * W, 0);
+	closestApproach.assign(numBlocks * W, std::numeric_limits<T>::infinity());
+	for(size_t block = 0; block < numBlocks; block++){
+		energy(block, &initialEnergy[block * W]);
+		energy(block, &finalEnergy[block * W]);
+	}
+}
+
+template <class T>
+void NBodySim::Ensemble<T>::setForcePrecision(NBodySim::forcePrecision newPrecision){
+	precision = newPrecision;
+}
+
+template <class T>
+void NBodySim::Ensemble<T>::energy(size_t block, T * out){
+	const size_t W = NBodySim::EnsembleSpace::laneWidth;
+	T kinetic[NBodySim::EnsembleSpace::laneWidth];
+	T potential[NBodySim::EnsembleSpace::laneWidth];
+	T dx;
+	T dy;
+	T dz;
+	size_t a;
+	size_t b;
+
+	for(size_t lane = 0; lane < W; lane++){
+		kinetic[lane] = 0;
+		potential[lane] = 0;
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		a = index(block, i);
+		for(size_t lane = 0; lane < W; lane++){
+			kinetic[lane] += masses[i] * (velX[a + lane] * velX[a + lane] + velY[a + lane] * velY[a + lane] + velZ[a + lane] * velZ[a + lane]) / 2;
+		}
+		for(size_t j = i + 1; j < numParticles; j++){
+			b = index(block, j);
+			for(size_t lane = 0; lane < W; lane++){
+				dx = posX[b + lane] - posX[a + lane];
+				dy = posY[b + lane] - posY[a + lane];
+				dz = posZ[b + lane] - posZ[a + lane];
+				potential[lane] -= G * masses[i] * masses[j] / std::sqrt(dx * dx + dy * dy + dz * dz);
+			}
+		}
+	}
+	for(size_t lane = 0; lane < W; lane++){
+		out[lane] = kinetic[lane] + potential[lane];
+	}
+}
+
+template <class T>
+template <NBodySim::forcePrecision P>
+void NBodySim::Ensemble<T>::stepBlock(size_t block, size_t numSteps, T deltaT){
+	const size_t W = NBodySim::EnsembleSpace::laneWidth;
+	std::vector<T> accelerationX(numParticles * W);
+	std::vector<T> accelerationY(numParticles * W);
+	std::vector<T> accelerationZ(numParticles * W);
+	T distanceX[NBodySim::EnsembleSpace::laneWidth];
+	T distanceY[NBodySim::EnsembleSpace::laneWidth];
+	T distanceZ[NBodySim::EnsembleSpace::laneWidth];
+	T distanceSquared[NBodySim::EnsembleSpace::laneWidth];
+	T inverseCube[NBodySim::EnsembleSpace::laneWidth];
+	T sumX[NBodySim::EnsembleSpace::laneWidth];
+	T sumY[NBodySim::EnsembleSpace::laneWidth];
+	T sumZ[NBodySim::EnsembleSpace::laneWidth];
+	T closest[NBodySim::EnsembleSpace::laneWidth];
+	T scale;
+	T * x = &posX[index(block, 0)];
+	T * y = &posY[index(block, 0)];
+	T * z = &posZ[index(block, 0)];
+	T * vx = &velX[index(block, 0)];
+	T * vy = &velY[index(block, 0)];
+	T * vz = &velZ[index(block, 0)];
+	size_t a;
+	size_t b;
+
+	for(size_t lane = 0; lane < W; lane++){
+		closest[lane] = closestApproach[block * W + lane] * closestApproach[block * W + lane];
+	}
+	for(size_t step = 0; step < numSteps; step++){
+		// The same sums in the same order as NBodySystem, one replica per lane instead of one source per element
+		for(size_t i = 0; i < numParticles; i++){
+			a = i * W;
+			for(size_t lane = 0; lane < W; lane++){
+				sumX[lane] = 0;
+				sumY[lane] = 0;
+				sumZ[lane] = 0;
+			}
+			for(size_t j = 0; j < numParticles; j++){
+				b = j * W;
+				for(size_t lane = 0; lane < W; lane++){
+					distanceX[lane] = x[b + lane] - x[a + lane];
+					distanceY[lane] = y[b + lane] - y[a + lane];
+					distanceZ[lane] = z[b + lane] - z[a + lane];
+					distanceSquared[lane] = distanceX[lane] * distanceX[lane] + distanceY[lane] * distanceY[lane] + distanceZ[lane] * distanceZ[lane];
+				}
+				if(j != i){
+					for(size_t lane = 0; lane < W; lane++){
+						closest[lane] = std::min(closest[lane], distanceSquared[lane]);
+					}
+				}
+				NBodySim::InverseCube<T, P>::calculate(distanceSquared, inverseCube, W);
+				for(size_t lane = 0; lane < W; lane++){
+					scale = gm[j] * inverseCube[lane];
+					sumX[lane] += scale * distanceX[lane];
+					sumY[lane] += scale * distanceY[lane];
+					sumZ[lane] += scale * distanceZ[lane];
+				}
+			}
+			for(size_t lane = 0; lane < W; lane++){
+				accelerationX[a + lane] = sumX[lane];
+				accelerationY[a + lane] = sumY[lane];
+				accelerationZ[a + lane] = sumZ[lane];
+			}
+		}
+		// Calculate new velocities first, then new positions from the new velocities
+		for(size_t k = 0; k < numParticles * W; k++){
+			vx[k] += accelerationX[k] * deltaT;
+			vy[k] += accelerationY[k] * deltaT;
+			vz[k] += accelerationZ[k] * deltaT;
+			x[k] += vx[k] * deltaT;
+			y[k] += vy[k] * deltaT;
+			z[k] += vz[k] * deltaT;
+		}
+	}
+	for(size_t lane = 0; lane < W; lane++){
+		closestApproach[block * W + lane] = std::sqrt(closest[lane]);
+	}
+	energy(block, &finalEnergy[block * W]);
+}
+
+template <class T>
+void NBodySim::Ensemble<T>::run(size_t numSteps, T deltaT, NBodySim::TaskScheduler * scheduler){
+	NBodySim::TaskScheduler::rangeFunction body = [this, numSteps, deltaT](size_t first, size_t last){
+		for(size_t block = first; block < last; block++){
+			switch(precision){
+				case NBodySim::REFINED: stepBlock<NBodySim::REFINED>(block, numSteps, deltaT); break;
+				case NBodySim::FAST: stepBlock<NBodySim::FAST>(block, numSteps, deltaT); break;
+				default: stepBlock<NBodySim::ACCURATE>(block, numSteps, deltaT); break;
+			}
+		}
+	};
+
+	// Replicas never interact, so every block runs all its steps in one task and threads only meet at the end
+	if(scheduler){
+		scheduler->parallelFor(0, numBlocks, 1, body);
+	}
+	else{
+		body(0, numBlocks);
+	}
+}
+
+template <class T>
+size_t NBodySim::Ensemble<T>::numReplicas(void){
+	return replicaCount;
+}
+
+template <class T>
+NBodySim::Particle<T> NBodySim::Ensemble<T>::getParticle(size_t replica, size_t particle){
+	size_t base = index(replica / NBodySim::EnsembleSpace::laneWidth, particle) + replica % NBodySim::EnsembleSpace::laneWidth;
+
+	NBodySim::Particle<T> p(posX.at(base), posY.at(base), posZ.at(base), velX.at(base), velY.at(base), velZ.at(base), masses.at(particle), "");
+	p.setNameId(nameIds.at(particle));
+	return p;
+}
+
+template <class T>
+T NBodySim::Ensemble<T>::getEnergyError(size_t replica){
+	return (finalEnergy.at(replica) - initialEnergy.at(replica)) / std::abs(initialEnergy.at(replica));
+}
+
+template <class T>
+T NBodySim::Ensemble<T>::getClosestApproach(size_t replica){
+	return closestApproach.at(replica);
+}
+
+template <class T>
+void NBodySim::Ensemble<T>::writeSummary(std::ostream & out){
+	out << "# replica energyError closestApproach" << std::endl;
+	for(size_t replica = 0; replica < replicaCount; replica++){
+		out << replica << " " << getEnergyError(replica) << " " << getClosestApproach(replica) << std::endl;
+	}
+}
+
+template class NBodySim::Ensemble<NBodySim::FloatingType>;
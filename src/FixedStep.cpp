@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstddef>
+#include <cmath>
+#include <utility>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "InverseCube.h"
+#include "FixedStep.h"
+
+template <class T, size_t N, NBodySim::forcePrecision P>
+constexpr NBodySim::PairList<N> NBodySim::FixedStep<T, N, P>::pairs;
+
+template <class T, size_t N, NBodySim::forcePrecision P>
+template <size_t I, size_t J>
+void NBodySim::FixedStep<T, N, P>::interact(const T (&pos)[3][N], const T (&gm)[N], T (&acc)[3][N]){
+	T dx = pos[0][J] - pos[0][I];
+	T dy = pos[1][J] - pos[1][I];
+	T dz = pos[2][J] - pos[2][I];
+	T distanceSquared = dx * dx + dy * dy + dz * dz;
+	T inverseCube;
+
+	// Coincident particles exert no force on each other, same as NBodySystem::step
+	if(distanceSquared == 0){
+		return;
+	}
+	inverseCube = NBodySim::InverseCube<T, P>::calculate(distanceSquared);
+
+	acc[0][I] += gm[J] * inverseCube * dx;
+	acc[1][I] += gm[J] * inverseCube * dy;
+	acc[2][I] += gm[J] * inverseCube * dz;
+	acc[0][J] -= gm[I] * inverseCube * dx;
+	acc[1][J] -= gm[I] * inverseCube * dy;
+	acc[2][J] -= gm[I] * inverseCube * dz;
+}
+
+template <class T, size_t N, NBodySim::forcePrecision P>
+template <size_t... K>
+void NBodySim::FixedStep<T, N, P>::accumulate(const T (&pos)[3][N], const T (&gm)[N], T (&acc)[3][N], std::index_sequence<K...>){
+	// Expands to one interact call per pair, the pair indices are template arguments
+	int expand[] = {0, (interact<pairs.first[K], pairs.second[K]>(pos, gm, acc), 0)...};
+	(void)expand;
+}
+
+template <class T, size_t N, NBodySim::forcePrecision P>
+void NBodySim::FixedStep<T, N, P>::step(NBodySim::Particle<T> * system, T G, T deltaT){
+	T pos[3][N];
+	T vel[3][N];
+	T gm[N];
+	T acc[3][N] = {};
+	NBodySim::ThreeVector <T> v;
+
+	for(size_t i = 0; i < N; i++){
+		v = system[i].getPos();
+		pos[0][i] = v.x;
+		pos[1][i] = v.y;
+		pos[2][i] = v.z;
+		v = system[i].getVel();
+		vel[0][i] = v.x;
+		vel[1][i] = v.y;
+		vel[2][i] = v.z;
+		gm[i] = G * system[i].getMass();
+	}
+
+	accumulate(pos, gm, acc, std::make_index_sequence<NBodySim::PairList<N>::numPairs>());
+
+	// Update velocity from the accumulated acceleration, then position from the new velocity
+	for(size_t i = 0; i < N; i++){
+		v.x = vel[0][i] + acc[0][i] * deltaT;
+		v.y = vel[1][i] + acc[1][i] * deltaT;
+		v.z = vel[2][i] + acc[2][i] * deltaT;
+		system[i].setVel(v);
+		v.x = pos[0][i] + v.x * deltaT;
+		v.y = pos[1][i] + v.y * deltaT;
+		v.z = pos[2][i] + v.z * deltaT;
+		system[i].setPos(v);
+	}
+}
+
+namespace NBodySim {
+	namespace FixedStepSpace {
+		/**
+		 * @brief Table of FixedStep<T, N, P>::step indexed by P then N, filled once on first use.
+		 */
+		template <class T>
+		class StepTable {
+		private:
+			/**
+			 * fill stores FixedStep<T, N + 1, P>::step at index N + 1 of entries[P] for every N in the sequence
+			 */
+			template <NBodySim::forcePrecision P, size_t... N>
+			void fill(std::index_sequence<N...>){
+				int expand[] = {0, (entries[P][N + 1] = &NBodySim::FixedStep<T, N + 1, P>::step, 0)...};
+				(void)expand;
+			}
+		public:
+			/**
+			 * entries holds the step function for each system size, entry 0 is NULL
+			 */
+			NBodySim::FixedStepSpace::stepFunction<T> entries[NBodySim::numForcePrecisions][NBodySim::FixedStepSpace::maxParticles + 1];
+
+			/**
+			 * Default constructor
+			 */
+			StepTable(void) : entries() {
+				fill<NBodySim::ACCURATE>(std::make_index_sequence<NBodySim::FixedStepSpace::maxParticles>());
+				fill<NBodySim::REFINED>(std::make_index_sequence<NBodySim::FixedStepSpace::maxParticles>());
+				fill<NBodySim::FAST>(std::make_index_sequence<NBodySim::FixedStepSpace::maxParticles>());
+			}
+		};
+	}
+}
+
+template <class T>
+NBodySim::FixedStepSpace::stepFunction<T> NBodySim::FixedStepSpace::lookup(size_t numParticles, NBodySim::forcePrecision precision){
+	static const NBodySim::FixedStepSpace::StepTable<T> table;
+
+	if(numParticles > NBodySim::FixedStepSpace::maxParticles || precision >= NBodySim::numForcePrecisions){
+		return NULL;
+	}
+	return table.entries[precision][numParticles];
+}
+
+template NBodySim::FixedStepSpace::stepFunction<NBodySim::FloatingType> NBodySim::FixedStepSpace::lookup<NBodySim::FloatingType>(size_t numParticles, NBodySim::forcePrecision precision);
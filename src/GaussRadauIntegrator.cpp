@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "GaussRadauIntegrator.h"
+
+template <class T>
+NBodySim::GaussRadauIntegrator<T>::GaussRadauIntegrator(void){
+	const unsigned numNodes = NBodySim::GaussRadauIntegratorSpace::numNodes;
+	// Spacings of the Gauss-Radau quadrature on [0, 1] with a node fixed at 0
+	const T spacings[numNodes] = {0.0, 0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648,
+		0.547153626330555383001448554766, 0.734210177215410531523210605558, 0.885320946839095768090359771030, 0.977520613561287501891174488626};
+
+	for(unsigned n = 0; n < numNodes; n++){
+		nodes[n] = spacings[n];
+	}
+
+	// Expand the Newton basis h (h - nodes[1]) ... (h - nodes[n - 1]) into powers of h, one factor at a time
+	for(unsigned n = 0; n < numNodes; n++){
+		for(unsigned j = 0; j < numNodes; j++){
+			basis[n][j] = 0;
+		}
+	}
+	basis[1][1] = 1;
+	for(unsigned n = 2; n < numNodes; n++){
+		for(unsigned j = 1; j <= n; j++){
+			basis[n][j] = basis[n - 1][j - 1] - nodes[n - 1] * basis[n - 1][j];
+		}
+	}
+
+	tolerance = NBodySim::GaussRadauIntegratorSpace::defaultTolerance;
+	timestep = 0;
+	initialized = false;
+	evaluations = 0;
+}
+
+template <class T>
+NBodySim::GaussRadauIntegrator<T>::~GaussRadauIntegrator(void){
+
+}
+
+template <class T>
+void NBodySim::GaussRadauIntegrator<T>::reset(void){
+	initialized = false;
+}
+
+template <class T>
+void NBodySim::GaussRadauIntegrator<T>::setTolerance(T epsilon){
+	tolerance = epsilon;
+	initialized = false;
+}
+
+template <class T>
+T NBodySim::GaussRadauIntegrator<T>::getTolerance(void){
+	return tolerance;
+}
+
+template <class T>
+size_t NBodySim::GaussRadauIntegrator<T>::getEvaluations(void){
+	return evaluations;
+}
+
+template <class T>
+void NBodySim::GaussRadauIntegrator<T>::evaluate(const std::vector<T> & positions, std::vector<T> & out, const accelerationFunction & accelerations){
+	size_t numParticles = vectorPos.size();
+
+	for(size_t i = 0; i < numParticles; i++){
+		vectorPos[i].x = positions[3 * i];
+		vectorPos[i].y = positions[3 * i + 1];
+		vectorPos[i].z = positions[3 * i + 2];
+	}
+	accelerations(vectorPos, vectorAcc);
+	for(size_t i = 0; i < numParticles; i++){
+		out[3 * i] = vectorAcc[i].x;
+		out[3 * i + 1] = vectorAcc[i].y;
+		out[3 * i + 2] = vectorAcc[i].z;
+	}
+	evaluations++;
+}
+
+template <class T>
+void NBodySim::GaussRadauIntegrator<T>::bToG(void){
+	const unsigned numCoefficients = NBodySim::GaussRadauIntegratorSpace::numNodes - 1;
+	T value;
+
+	// The leading coefficient of every basis polynomial is 1, so g follows from b by back substitution
+	for(size_t k = 0; k < pos.size(); k++){
+		for(unsigned n = numCoefficients; n > 0; n--){
+			value = b[n - 1][k];
+			for(unsigned m = n + 1; m <= numCoefficients; m++){
+				value -= basis[m][n] * g[m - 1][k];
+			}
+			g[n - 1][k] = value;
+		}
+	}
+}
+
+template <class T>
+void NBodySim::GaussRadauIntegrator<T>::scaleB(T ratio, bool extrapolate){
+	const unsigned numCoefficients = NBodySim::GaussRadauIntegratorSpace::numNodes - 1;
+	T power;
+	T binomial;
+	T value;
+
+	for(size_t k = 0; k < pos.size(); k++){
+		power = ratio;
+		for(unsigned n = 1; n <= numCoefficients; n++){
+			if(extrapolate){
+				// Coefficient of s^n in the old polynomial at h = 1 + ratio * s, the sum of C(j, n) b[j - 1] over j >= n
+				value = 0;
+				binomial = 1;
+				for(unsigned j = n; j <= numCoefficients; j++){
+					value += binomial * b[j - 1][k];
+					binomial = binomial * (j + 1) / (j + 1 - n);
+				}
+				b[n - 1][k] = power * value;
+			}
+			else{
+				b[n - 1][k] *= power;
+			}
+			power *= ratio;
+		}
+	}
+}
+
+template <class T>
+void NBodySim::GaussRadauIntegrator<T>::step(std::vector<NBodySim::Particle<T> > & system, T deltaT, const accelerationFunction & accelerations){
+	const unsigned numNodes = NBodySim::GaussRadauIntegratorSpace::numNodes;
+	const unsigned numCoefficients = numNodes - 1;
+	size_t numParticles = system.size();
+	size_t length = 3 * numParticles;
+	bool fresh = !initialized || pos.size() != length;
+	T remaining = deltaT;
+	T fittedFor;
+	T dt;
+	T h;
+	T value;
+	T change;
+	T maxChange;
+	T maxCoefficient;
+	T maxAcc;
+	T error;
+	T previousError;
+	T newTimestep;
+	T y;
+	T sum;
+	NBodySim::ThreeVector<T> p;
+	NBodySim::ThreeVector<T> v;
+
+	if(numParticles == 0){
+		return;
+	}
+
+	if(fresh){
+		pos.resize(length);
+		vel.resize(length);
+		posError.assign(length, 0);
+		velError.assign(length, 0);
+		acc.resize(length);
+		predictedPos.resize(length);
+		nodeAcc.resize(length);
+		for(unsigned n = 0; n < numCoefficients; n++){
+			b[n].assign(length, 0);
+			g[n].assign(length, 0);
+		}
+		vectorPos.resize(numParticles);
+		vectorAcc.resize(numParticles);
+		timestep = deltaT;
+		initialized = true;
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		p = system[i].getPos();
+		v = system[i].getVel();
+		pos[3 * i] = p.x;
+		pos[3 * i + 1] = p.y;
+		pos[3 * i + 2] = p.z;
+		vel[3 * i] = v.x;
+		vel[3 * i + 1] = v.y;
+		vel[3 * i + 2] = v.z;
+	}
+	evaluate(pos, acc, accelerations);
+
+	fittedFor = timestep;
+	for(size_t substep = 0; remaining > 0 && substep < NBodySim::GaussRadauIntegratorSpace::maxSubsteps; substep++){
+		dt = (timestep <= 0 || timestep >= remaining || substep + 1 == NBodySim::GaussRadauIntegratorSpace::maxSubsteps) ? remaining : timestep;
+		// b was predicted for a substep of fittedFor, rescale it when the substep is cut short
+		if(dt != fittedFor && fittedFor != 0){
+			scaleB(dt / fittedFor, false);
+		}
+		fittedFor = dt;
+		bToG();
+
+		// Iterate the predictor-corrector until the highest coefficient stops changing
+		previousError = 0;
+		for(unsigned iteration = 0; iteration < NBodySim::GaussRadauIntegratorSpace::maxIterations; iteration++){
+			maxChange = 0;
+			maxAcc = 0;
+			for(unsigned n = 1; n < numNodes; n++){
+				h = nodes[n];
+				// Position at the node from the integral of the acceleration polynomial, evaluated by Horner's rule
+				for(size_t k = 0; k < length; k++){
+					value = b[6][k] / 72;
+					value = value * h + b[5][k] / 56;
+					value = value * h + b[4][k] / 42;
+					value = value * h + b[3][k] / 30;
+					value = value * h + b[2][k] / 20;
+					value = value * h + b[1][k] / 12;
+					value = value * h + b[0][k] / 6;
+					value = value * h + acc[k] / 2;
+					predictedPos[k] = pos[k] + h * dt * (vel[k] + h * dt * value);
+				}
+				evaluate(predictedPos, nodeAcc, accelerations);
+
+				// Newton divided difference at this node, then fold the change of g into b
+				for(size_t k = 0; k < length; k++){
+					value = (nodeAcc[k] - acc[k]) / h;
+					for(unsigned m = 1; m < n; m++){
+						value = (value - g[m - 1][k]) / (h - nodes[m]);
+					}
+					change = value - g[n - 1][k];
+					g[n - 1][k] = value;
+					for(unsigned j = 1; j <= n; j++){
+						b[j - 1][k] += basis[n][j] * change;
+					}
+					if(n == numCoefficients){
+						maxChange = std::max(maxChange, std::fabs(change));
+						maxAcc = std::max(maxAcc, std::fabs(nodeAcc[k]));
+					}
+				}
+			}
+			error = (maxAcc > 0) ? maxChange / maxAcc : 0;
+			// Converged to round off, or the corrections stopped shrinking
+			if(error < 1e-16 || (iteration > 1 && error >= previousError)){
+				break;
+			}
+			previousError = error;
+		}
+
+		// The size of the highest coefficient relative to the acceleration estimates the error of the substep
+		maxCoefficient = 0;
+		maxAcc = 0;
+		for(size_t k = 0; k < length; k++){
+			maxCoefficient = std::max(maxCoefficient, std::fabs(b[6][k]));
+			maxAcc = std::max(maxAcc, std::fabs(nodeAcc[k]));
+		}
+		error = (maxAcc > 0) ? maxCoefficient / maxAcc : 0;
+		if(error > 0 && std::isfinite(error)){
+			newTimestep = dt * std::pow(tolerance / error, 1.0 / 7);
+		}
+		else{
+			newTimestep = dt / NBodySim::GaussRadauIntegratorSpace::safetyFactor;
+		}
+
+		if(newTimestep < NBodySim::GaussRadauIntegratorSpace::safetyFactor * dt && substep + 1 < NBodySim::GaussRadauIntegratorSpace::maxSubsteps){
+			// Reject the substep and retry from the same start with the shorter substep
+			scaleB(newTimestep / dt, false);
+			fittedFor = newTimestep;
+			timestep = newTimestep;
+			continue;
+		}
+		newTimestep = std::min(newTimestep, dt / NBodySim::GaussRadauIntegratorSpace::safetyFactor);
+
+		// Advance to the end of the substep with compensated summation, so round off does not build up over many substeps
+		for(size_t k = 0; k < length; k++){
+			value = acc[k] / 2 + b[0][k] / 6 + b[1][k] / 12 + b[2][k] / 20 + b[3][k] / 30 + b[4][k] / 42 + b[5][k] / 56 + b[6][k] / 72;
+			y = dt * vel[k] + dt * dt * value - posError[k];
+			sum = pos[k] + y;
+			posError[k] = (sum - pos[k]) - y;
+			pos[k] = sum;
+			value = acc[k] + b[0][k] / 2 + b[1][k] / 3 + b[2][k] / 4 + b[3][k] / 5 + b[4][k] / 6 + b[5][k] / 7 + b[6][k] / 8;
+			y = dt * value - velError[k];
+			sum = vel[k] + y;
+			velError[k] = (sum - vel[k]) - y;
+			vel[k] = sum;
+		}
+		remaining -= dt;
+		evaluate(pos, acc, accelerations);
+
+		// Predict the polynomial of the next substep by extrapolating this one
+		scaleB(newTimestep / dt, true);
+		fittedFor = newTimestep;
+		timestep = newTimestep;
+	}
+
+	for(size_t i = 0; i < numParticles; i++){
+		p.x = pos[3 * i];
+		p.y = pos[3 * i + 1];
+		p.z = pos[3 * i + 2];
+		v.x = vel[3 * i];
+		v.y = vel[3 * i + 1];
+		v.z = vel[3 * i + 2];
+		system[i].setPos(p);
+		system[i].setVel(v);
+	}
+}
+
+template class NBodySim::GaussRadauIntegrator<NBodySim::FloatingType>;
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "HermiteIntegrator.h"
+
+template <class T>
+NBodySim::HermiteIntegrator<T>::HermiteIntegrator(void){
+	accuracy = NBodySim::HermiteIntegratorSpace::defaultAccuracy;
+	timestep = 0;
+	initialized = false;
+}
+
+template <class T>
+NBodySim::HermiteIntegrator<T>::~HermiteIntegrator(void){
+
+}
+
+template <class T>
+void NBodySim::HermiteIntegrator<T>::reset(void){
+	initialized = false;
+}
+
+template <class T>
+void NBodySim::HermiteIntegrator<T>::setAccuracy(T eta){
+	accuracy = eta;
+	initialized = false;
+}
+
+template <class T>
+T NBodySim::HermiteIntegrator<T>::getAccuracy(void){
+	return accuracy;
+}
+
+template <class T>
+void NBodySim::HermiteIntegrator<T>::evaluate(const std::vector<NBodySim::ThreeVector<T> > & pos, const std::vector<NBodySim::ThreeVector<T> > & vel, std::vector<NBodySim::ThreeVector<T> > & acc, std::vector<NBodySim::ThreeVector<T> > & jerk){
+	size_t numParticles = pos.size();
+	NBodySim::ThreeVector<T> dr;
+	NBodySim::ThreeVector<T> dv;
+	T distanceSquared;
+	T inverseCube;
+	T rv;
+
+	for(size_t i = 0; i < numParticles; i++){
+		acc[i].x = acc[i].y = acc[i].z = 0;
+		jerk[i].x = jerk[i].y = jerk[i].z = 0;
+	}
+
+	// Each pair is visited once and applied to both particles
+	for(size_t i = 0; i < numParticles; i++){
+		for(size_t j = i + 1; j < numParticles; j++){
+			dr.x = pos[j].x - pos[i].x;
+			dr.y = pos[j].y - pos[i].y;
+			dr.z = pos[j].z - pos[i].z;
+			dv.x = vel[j].x - vel[i].x;
+			dv.y = vel[j].y - vel[i].y;
+			dv.z = vel[j].z - vel[i].z;
+			distanceSquared = dr.x * dr.x + dr.y * dr.y + dr.z * dr.z;
+			if(distanceSquared == 0){
+				continue;
+			}
+			inverseCube = 1 / (distanceSquared * std::sqrt(distanceSquared));
+			// jerk = G * m * (dv / r^3 - 3 * (dr . dv) * dr / r^5)
+			rv = 3 * (dr.x * dv.x + dr.y * dv.y + dr.z * dv.z) / distanceSquared;
+
+			acc[i].x += gm[j] * inverseCube * dr.x;
+			acc[i].y += gm[j] * inverseCube * dr.y;
+			acc[i].z += gm[j] * inverseCube * dr.z;
+			acc[j].x -= gm[i] * inverseCube * dr.x;
+			acc[j].y -= gm[i] * inverseCube * dr.y;
+			acc[j].z -= gm[i] * inverseCube * dr.z;
+
+			jerk[i].x += gm[j] * inverseCube * (dv.x - rv * dr.x);
+			jerk[i].y += gm[j] * inverseCube * (dv.y - rv * dr.y);
+			jerk[i].z += gm[j] * inverseCube * (dv.z - rv * dr.z);
+			jerk[j].x -= gm[i] * inverseCube * (dv.x - rv * dr.x);
+			jerk[j].y -= gm[i] * inverseCube * (dv.y - rv * dr.y);
+			jerk[j].z -= gm[i] * inverseCube * (dv.z - rv * dr.z);
+		}
+	}
+}
+
+template <class T>
+T NBodySim::HermiteIntegrator<T>::initialTimestep(void){
+	T minimum = std::numeric_limits<T>::max();
+	T a;
+	T j;
+
+	for(size_t i = 0; i < acc.size(); i++){
+		a = std::sqrt(acc[i].x * acc[i].x + acc[i].y * acc[i].y + acc[i].z * acc[i].z);
+		j = std::sqrt(jerk[i].x * jerk[i].x + jerk[i].y * jerk[i].y + jerk[i].z * jerk[i].z);
+		if(j > 0 && a / j < minimum){
+			minimum = a / j;
+		}
+	}
+	return (minimum == std::numeric_limits<T>::max()) ? 0 : accuracy * minimum;
+}
+
+template <class T>
+void NBodySim::HermiteIntegrator<T>::step(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT){
+	size_t numParticles = system.size();
+	bool fresh = !initialized || gm.size() != numParticles;
+	T remaining = deltaT;
+	T dt;
+	T dt2;
+	T dt3;
+	T criterion;
+	T minimum;
+	NBodySim::ThreeVector<T> oldVel;
+	NBodySim::ThreeVector<T> snap;
+	NBodySim::ThreeVector<T> crackle;
+	NBodySim::ThreeVector<T> endSnap;
+	T a;
+	T j;
+	T s;
+	T c;
+
+	if(fresh){
+		gm.resize(numParticles);
+		pos.resize(numParticles);
+		vel.resize(numParticles);
+		acc.resize(numParticles);
+		jerk.resize(numParticles);
+		predictedPos.resize(numParticles);
+		predictedVel.resize(numParticles);
+		newAcc.resize(numParticles);
+		newJerk.resize(numParticles);
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		gm[i] = G * system[i].getMass();
+		pos[i] = system[i].getPos();
+		vel[i] = system[i].getVel();
+	}
+	if(fresh){
+		evaluate(pos, vel, acc, jerk);
+		timestep = initialTimestep();
+		initialized = true;
+	}
+
+	for(size_t substep = 0; remaining > 0 && substep < NBodySim::HermiteIntegratorSpace::maxSubsteps; substep++){
+		// Nothing is accelerating, or the substep is longer than what is left, finish in one substep
+		dt = (timestep <= 0 || timestep >= remaining) ? remaining : timestep;
+		// The last substep allowed takes whatever time is left
+		if(substep + 1 == NBodySim::HermiteIntegratorSpace::maxSubsteps){
+			dt = remaining;
+		}
+		dt2 = dt * dt;
+		dt3 = dt2 * dt;
+
+		// Predict with the Taylor series through the jerk
+		for(size_t i = 0; i < numParticles; i++){
+			predictedPos[i].x = pos[i].x + vel[i].x * dt + acc[i].x * dt2 / 2 + jerk[i].x * dt3 / 6;
+			predictedPos[i].y = pos[i].y + vel[i].y * dt + acc[i].y * dt2 / 2 + jerk[i].y * dt3 / 6;
+			predictedPos[i].z = pos[i].z + vel[i].z * dt + acc[i].z * dt2 / 2 + jerk[i].z * dt3 / 6;
+			predictedVel[i].x = vel[i].x + acc[i].x * dt + jerk[i].x * dt2 / 2;
+			predictedVel[i].y = vel[i].y + acc[i].y * dt + jerk[i].y * dt2 / 2;
+			predictedVel[i].z = vel[i].z + acc[i].z * dt + jerk[i].z * dt2 / 2;
+		}
+
+		evaluate(predictedPos, predictedVel, newAcc, newJerk);
+
+		minimum = std::numeric_limits<T>::max();
+		for(size_t i = 0; i < numParticles; i++){
+			// Correct the velocity first, then the position from the corrected velocity
+			oldVel = vel[i];
+			vel[i].x = vel[i].x + (acc[i].x + newAcc[i].x) * dt / 2 + (jerk[i].x - newJerk[i].x) * dt2 / 12;
+			vel[i].y = vel[i].y + (acc[i].y + newAcc[i].y) * dt / 2 + (jerk[i].y - newJerk[i].y) * dt2 / 12;
+			vel[i].z = vel[i].z + (acc[i].z + newAcc[i].z) * dt / 2 + (jerk[i].z - newJerk[i].z) * dt2 / 12;
+			pos[i].x = pos[i].x + (oldVel.x + vel[i].x) * dt / 2 + (acc[i].x - newAcc[i].x) * dt2 / 12;
+			pos[i].y = pos[i].y + (oldVel.y + vel[i].y) * dt / 2 + (acc[i].y - newAcc[i].y) * dt2 / 12;
+			pos[i].z = pos[i].z + (oldVel.z + vel[i].z) * dt / 2 + (acc[i].z - newAcc[i].z) * dt2 / 12;
+
+			// Second and third derivatives of the acceleration from the Hermite interpolant, snap is taken at the start of the substep
+			snap.x = (-6 * (acc[i].x - newAcc[i].x) - dt * (4 * jerk[i].x + 2 * newJerk[i].x)) / dt2;
+			snap.y = (-6 * (acc[i].y - newAcc[i].y) - dt * (4 * jerk[i].y + 2 * newJerk[i].y)) / dt2;
+			snap.z = (-6 * (acc[i].z - newAcc[i].z) - dt * (4 * jerk[i].z + 2 * newJerk[i].z)) / dt2;
+			crackle.x = (12 * (acc[i].x - newAcc[i].x) + 6 * dt * (jerk[i].x + newJerk[i].x)) / dt3;
+			crackle.y = (12 * (acc[i].y - newAcc[i].y) + 6 * dt * (jerk[i].y + newJerk[i].y)) / dt3;
+			crackle.z = (12 * (acc[i].z - newAcc[i].z) + 6 * dt * (jerk[i].z + newJerk[i].z)) / dt3;
+			endSnap.x = snap.x + crackle.x * dt;
+			endSnap.y = snap.y + crackle.y * dt;
+			endSnap.z = snap.z + crackle.z * dt;
+
+			// Aarseth criterion at the end of the substep: sqrt(eta * (|a||a''| + |a'|^2) / (|a'||a'''| + |a''|^2))
+			a = std::sqrt(newAcc[i].x * newAcc[i].x + newAcc[i].y * newAcc[i].y + newAcc[i].z * newAcc[i].z);
+			j = std::sqrt(newJerk[i].x * newJerk[i].x + newJerk[i].y * newJerk[i].y + newJerk[i].z * newJerk[i].z);
+			s = std::sqrt(endSnap.x * endSnap.x + endSnap.y * endSnap.y + endSnap.z * endSnap.z);
+			c = std::sqrt(crackle.x * crackle.x + crackle.y * crackle.y + crackle.z * crackle.z);
+			if(j * c + s * s > 0){
+				criterion = std::sqrt(accuracy * (a * s + j * j) / (j * c + s * s));
+				if(criterion < minimum){
+					minimum = criterion;
+				}
+			}
+
+			acc[i] = newAcc[i];
+			jerk[i] = newJerk[i];
+		}
+		timestep = (minimum == std::numeric_limits<T>::max()) ? 0 : minimum;
+		remaining -= dt;
+	}
+
+	for(size_t i = 0; i < numParticles; i++){
+		system[i].setPos(pos[i]);
+		system[i].setVel(vel[i]);
+	}
+}
+
+template class NBodySim::HermiteIntegrator<NBodySim::FloatingType>;
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+
+#include "NBodyTypes.h"
+#include "Kepler.h"
+
+template <class T>
+void NBodySim::Kepler<T>::stumpff(T z, T * c2, T * c3){
+	T root;
+
+	// Use the series near 0, where the closed forms lose all their precision to cancellation
+	if(std::fabs(z) < 1e-3){
+		*c2 = 1.0 / 2 - z * (1.0 / 24 - z * (1.0 / 720 - z / 40320));
+		*c3 = 1.0 / 6 - z * (1.0 / 120 - z * (1.0 / 5040 - z / 362880));
+	}
+	else if(z > 0){
+		root = std::sqrt(z);
+		*c2 = (1 - std::cos(root)) / z;
+		*c3 = (root - std::sin(root)) / (z * root);
+	}
+	else{
+		root = std::sqrt(-z);
+		*c2 = (std::cosh(root) - 1) / -z;
+		*c3 = (std::sinh(root) - root) / (-z * root);
+	}
+}
+
+template <class T>
+void NBodySim::Kepler<T>::drift(T mu, NBodySim::ThreeVector<T> * pos, NBodySim::ThreeVector<T> * vel, T dt){
+	const T order = 5;
+	T r0 = std::sqrt(pos->x * pos->x + pos->y * pos->y + pos->z * pos->z);
+	T v0Squared = vel->x * vel->x + vel->y * vel->y + vel->z * vel->z;
+	T sqrtMu = std::sqrt(mu);
+	T sigma = (pos->x * vel->x + pos->y * vel->y + pos->z * vel->z) / sqrtMu;
+	// alpha is the inverse of the semi-major axis, negative for hyperbolic orbits
+	T alpha = 2 / r0 - v0Squared / mu;
+	T chi;
+	T z;
+	T c2;
+	T c3;
+	T f;
+	T df;
+	T ddf;
+	T delta;
+	T r;
+	T lagrangeF;
+	T lagrangeG;
+	T lagrangeFDot;
+	T lagrangeGDot;
+	NBodySim::ThreeVector<T> newPos;
+
+	if(r0 == 0 || mu <= 0){
+		pos->x += vel->x * dt;
+		pos->y += vel->y * dt;
+		pos->z += vel->z * dt;
+		return;
+	}
+
+	// Solve the universal Kepler equation for the universal anomaly chi with the Laguerre-Conway iteration
+	chi = (alpha > 0) ? sqrtMu * dt * alpha : sqrtMu * dt / r0;
+	for(unsigned i = 0; i < NBodySim::KeplerSpace::maxIterations; i++){
+		z = alpha * chi * chi;
+		stumpff(z, &c2, &c3);
+		f = sigma * chi * chi * c2 + (1 - alpha * r0) * chi * chi * chi * c3 + r0 * chi - sqrtMu * dt;
+		df = sigma * chi * (1 - z * c3) + (1 - alpha * r0) * chi * chi * c2 + r0;
+		ddf = sigma * (1 - z * c2) + (1 - alpha * r0) * chi * (1 - z * c3);
+		delta = order * f / (df + ((df < 0) ? -1 : 1) * std::sqrt(std::fabs((order - 1) * (order - 1) * df * df - order * (order - 1) * f * ddf)));
+		chi -= delta;
+		if(std::fabs(delta) <= 1e-15 * std::fabs(chi)){
+			break;
+		}
+	}
+
+	z = alpha * chi * chi;
+	stumpff(z, &c2, &c3);
+	lagrangeF = 1 - chi * chi * c2 / r0;
+	lagrangeG = dt - chi * chi * chi * c3 / sqrtMu;
+	newPos.x = lagrangeF * pos->x + lagrangeG * vel->x;
+	newPos.y = lagrangeF * pos->y + lagrangeG * vel->y;
+	newPos.z = lagrangeF * pos->z + lagrangeG * vel->z;
+	r = std::sqrt(newPos.x * newPos.x + newPos.y * newPos.y + newPos.z * newPos.z);
+	lagrangeFDot = sqrtMu * chi * (z * c3 - 1) / (r * r0);
+	lagrangeGDot = 1 - chi * chi * c2 / r;
+
+	vel->x = lagrangeFDot * pos->x + lagrangeGDot * vel->x;
+	vel->y = lagrangeFDot * pos->y + lagrangeGDot * vel->y;
+	vel->z = lagrangeFDot * pos->z + lagrangeGDot * vel->z;
+	*pos = newPos;
+}
+
+template class NBodySim::Kepler<NBodySim::FloatingType>;
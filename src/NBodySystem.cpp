@@ -22,20 +22,54 @@
 #include <cstdlib>
 #include <string>
 #include <vector>
+#include <memory>
 #include <cmath>
+#include <algorithm>
 #include <fstream>
 #include <streambuf>
+#include <numeric>
+#include <chrono>
+#include <charconv>
+#include <atomic>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "rapidxml.hpp"
 
 #include "NBodyTypes.h"
 #include "Particle.h"
+#include "NameTable.h"
+#include "InverseCube.h"
+#include "FixedStep.h"
+#include "TaskScheduler.h"
 #include "NBodySystem.h"
 
 template <class T>
 NBodySim::NBodySystem<T>::NBodySystem(void){
 	// Initialize G to be our universe's gravitation constant.
 	G = 6.67408e-11;
+	precision = NBodySim::ACCURATE;
+	integrator = NBodySim::SYMPLECTIC_EULER;
+	collisionsEnabled = false;
+	regularizationEnabled = false;
+	costBalancingEnabled = false;
+	imbalanceThreshold = NBodySim::NBodySystemSpace::defaultImbalanceThreshold;
+	imbalance = 1;
+	reorderInterval = 0;
+	stepsSinceReorder = 0;
+	reorderCurve = NBodySim::HILBERT;
+	targetTileLength = defaultTargetTileLength();
+	sourceTileLength = defaultSourceTileLength();
+	fixedKernelEnabled = true;
+	fixedStep = NULL;
+	parseErrorLine = 0;
+	ingesting = false;
+	ingestFirst = 0;
+	nameIndexValid = false;
+	deterministic = false;
+	exchanging = false;
+	blocksSummed = 0;
 }
 
 template <class T>
@@ -45,12 +79,136 @@ NBodySim::NBodySystem<T>::~NBodySystem(void){
 
 template <class T>
 void NBodySim::NBodySystem<T>::addParticle(NBodySim::Particle<T> p){
+	p.setId(system.size());
+	slotOf.push_back(system.size());
 	system.push_back(p);
+	selectKernel();
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::beginParticles(size_t expected){
+	ingesting = true;
+	ingestFirst = system.size();
+	system.reserve(system.size() + expected);
+	slotOf.reserve(slotOf.size() + expected);
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::appendParticles(const NBodySim::Particle<T> * batch, size_t count){
+	if(!ingesting){
+		return NBodySim::NBodySystemSpace::NOT_INGESTING;
+	}
+	// The kernel is chosen once at commit instead of after every particle as addParticle does
+	for(size_t i = 0; i < count; i++){
+		slotOf.push_back(system.size());
+		system.push_back(batch[i]);
+		system.back().setId(slotOf.size() - 1);
+	}
+	return NBodySim::NBodySystemSpace::SUCCESS;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::commitParticles(void){
+	if(!ingesting){
+		return NBodySim::NBodySystemSpace::NOT_INGESTING;
+	}
+	ingesting = false;
+	selectKernel();
+	return (system.size() > ingestFirst) ? NBodySim::NBodySystemSpace::SUCCESS : NBodySim::NBodySystemSpace::NO_PARTICLES;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::cancelParticles(void){
+	if(!ingesting){
+		return NBodySim::NBodySystemSpace::NOT_INGESTING;
+	}
+	ingesting = false;
+	system.resize(ingestFirst);
+	slotOf.resize(ingestFirst);
+	return NBodySim::NBodySystemSpace::SUCCESS;
 }
 
 template <class T>
 NBodySim::Particle<T> NBodySim::NBodySystem<T>::getParticle(size_t index){
-	return system.at(index);
+	return system.at(slotOf.at(index));
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::copyParticles(std::vector<NBodySim::Particle<T> > & out){
+	out.resize(system.size());
+	for(size_t i = 0; i < system.size(); i++){
+		out[i] = system[slotOf[i]];
+	}
+}
+
+template <class T>
+NBodySim::ParticleView<T> NBodySim::NBodySystem<T>::viewParticles(void){
+	NBodySim::ParticleView<T> view;
+	view.particles = system.data();
+	view.slots = slotOf.data();
+	view.length = system.size();
+	return view;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::getPositions(std::vector<NBodySim::ThreeVector<T> > & out){
+	out.resize(system.size());
+	for(size_t i = 0; i < system.size(); i++){
+		out[i] = system[slotOf[i]].getPos();
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::getVelocities(std::vector<NBodySim::ThreeVector<T> > & out){
+	out.resize(system.size());
+	for(size_t i = 0; i < system.size(); i++){
+		out[i] = system[slotOf[i]].getVel();
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::getMasses(std::vector<T> & out){
+	out.resize(system.size());
+	for(size_t i = 0; i < system.size(); i++){
+		out[i] = system[slotOf[i]].getMass();
+	}
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::setPositions(const std::vector<NBodySim::ThreeVector<T> > & positions){
+	if(positions.size() != system.size()){
+		return NBodySim::NBodySystemSpace::WRONG_LENGTH;
+	}
+	for(size_t i = 0; i < system.size(); i++){
+		system[slotOf[i]].setPos(positions[i]);
+	}
+	// Integrators keep state derived from the old positions, the kernel is chosen again to reset them
+	selectKernel();
+	return NBodySim::NBodySystemSpace::SUCCESS;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::setVelocities(const std::vector<NBodySim::ThreeVector<T> > & velocities){
+	if(velocities.size() != system.size()){
+		return NBodySim::NBodySystemSpace::WRONG_LENGTH;
+	}
+	for(size_t i = 0; i < system.size(); i++){
+		system[slotOf[i]].setVel(velocities[i]);
+	}
+	selectKernel();
+	return NBodySim::NBodySystemSpace::SUCCESS;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::setMasses(const std::vector<T> & masses){
+	if(masses.size() != system.size()){
+		return NBodySim::NBodySystemSpace::WRONG_LENGTH;
+	}
+	for(size_t i = 0; i < system.size(); i++){
+		system[slotOf[i]].setMass(masses[i]);
+	}
+	selectKernel();
+	return NBodySim::NBodySystemSpace::SUCCESS;
 }
 
 template <class T>
@@ -59,45 +217,443 @@ size_t NBodySim::NBodySystem<T>::numParticles(void){
 }
 
 template <class T>
-void NBodySim::NBodySystem<T>::removeParticle(size_t index){
-	system.erase(system.begin() + index);
+size_t NBodySim::NBodySystem<T>::findParticle(std::string name){
+	std::unordered_map<uint32_t, size_t>::iterator found;
+	size_t index = system.size();
+	uint32_t nameId;
+	
+	if(!nameIndexValid){
+		nameIndex.clear();
+		for(size_t i = 0; i < slotOf.size(); i++){
+			nameIndex.emplace(system[slotOf[i]].getNameId(), i);
+		}
+		nameIndexValid = true;
+	}
+	// A name that was never stored belongs to no particle, but a number may also be the generated name of an index
+	if(NBodySim::NameTable::find(name, &nameId) && (found = nameIndex.find(nameId)) != nameIndex.end()){
+		index = found->second;
+	}
+	if(NBodySim::NameTable::findGenerated(name, &nameId) && (found = nameIndex.find(nameId)) != nameIndex.end()){
+		index = std::min(index, found->second);
+	}
+	return index;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::removeParticle(size_t index){
+	if(index >= slotOf.size()){
+		return NBodySim::NBodySystemSpace::INDEX_EXCEEDED;
+	}
+	removeId(index);
+	selectKernel();
+	return NBodySim::NBodySystemSpace::SUCCESS;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::removeId(size_t id){
+	size_t lastId = slotOf.size() - 1;
+	size_t lastSlot = system.size() - 1;
+	size_t vacated = slotOf[id];
+	
+	nameIndexValid = false;
+	// The particle of the highest id takes over the freed id and slot
+	if(id != lastId){
+		size_t slot = vacated;
+		vacated = slotOf[lastId];
+		system[slot] = system[vacated];
+		system[slot].setId(id);
+		slotOf[id] = slot;
+	}
+	// The particle stored last fills the slot that is left, unless it is the one left
+	if(vacated != lastSlot){
+		system[vacated] = system[lastSlot];
+		slotOf[system[vacated].getId()] = vacated;
+	}
+	system.pop_back();
+	slotOf.pop_back();
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::reorder(void){
+	size_t numParticles = system.size();
+	std::vector<double> cost;
+	
+	curve.order(system, reorderCurve, scheduler.get(), permutation);
+	reordered.resize(numParticles);
+	for(size_t slot = 0; slot < numParticles; slot++){
+		reordered[slot] = system[permutation[slot]];
+		slotOf[reordered[slot].getId()] = slot;
+	}
+	system.swap(reordered);
+	
+	// The measured costs move with their particles, so the cost balanced partition stays meaningful
+	if(particleCost.size() == numParticles){
+		cost.resize(numParticles);
+		for(size_t slot = 0; slot < numParticles; slot++){
+			cost[slot] = particleCost[permutation[slot]];
+		}
+		particleCost.swap(cost);
+	}
+	hermite.reset();
+	gaussRadau.reset();
+	regularizer.reset();
+	stepsSinceReorder = 0;
 }
 
 template <class T>
 void NBodySim::NBodySystem<T>::step(T deltaT){
-	std::vector<NBodySim::Particle<T> > systemCopy = system;
-	NBodySim::ThreeVector <T> distanceComponent;
-	T distance;
-	T acceleration;
-	NBodySim::ThreeVector <T> newPosition;
-	NBodySim::ThreeVector <T> newVelocity;
-	
-	for(size_t i = 0; i < systemCopy.size(); i++){
-		// Calculate new position of particle first from current velocity
-		newPosition = system.at(i).getPos();
-		newVelocity = system.at(i).getVel();
-		// Sum forces on body from all bodys to obtain new velocity of paricle
-		for(size_t j = 0; j < systemCopy.size(); j++){
-			distanceComponent.x = systemCopy.at(j).getPos().x - systemCopy.at(i).getPos().x;
-			distanceComponent.y = systemCopy.at(j).getPos().y - systemCopy.at(i).getPos().y;
-			distanceComponent.z = systemCopy.at(j).getPos().z - systemCopy.at(i).getPos().z;
-			
-			distance = std::sqrt(std::pow(distanceComponent.x, 2) + std::pow(distanceComponent.y, 2) + std::pow(distanceComponent.z, 2));
-			
-			acceleration = (distance != 0.0f) ? (G * system.at(j).getMass()) / (std::pow(distanceComponent.x, 2) + std::pow(distanceComponent.y, 2) + std::pow(distanceComponent.z, 2)) : 0;
-			
-			newVelocity.x += (distance != 0.0f) ? ((acceleration) * deltaT) * (distanceComponent.x / distance) : 0;
-			newVelocity.y += (distance != 0.0f) ? ((acceleration) * deltaT) * (distanceComponent.y / distance) : 0;
-			newVelocity.z += (distance != 0.0f) ? ((acceleration) * deltaT) * (distanceComponent.z / distance) : 0;
+	if(reorderInterval > 0 && ++stepsSinceReorder >= reorderInterval){
+		reorder();
+	}
+	
+	// Tight pairs travel through the step as one body at their center of mass
+	if(regularizationEnabled){
+		if(regularizer.update(system, G, deltaT)){
+			hermite.reset();
+			gaussRadau.reset();
+		}
+		regularizer.combine(system);
+	}
+	
+	if(integrator == NBodySim::HERMITE){
+		hermite.step(system, G, deltaT);
+	}
+	else if(integrator == NBodySim::WISDOM_HOLMAN){
+		wisdomHolman.step(system, G, deltaT);
+	}
+	else if(integrator == NBodySim::GAUSS_RADAU){
+		gaussRadau.step(system, deltaT, [this](const std::vector<NBodySim::ThreeVector<T> > & positions, std::vector<NBodySim::ThreeVector<T> > & out){
+			accelerations(positions, out);
+		});
+	}
+	else if(fixedStep != NULL){
+		fixedStep(&system[0], G, deltaT);
+	}
+	else{
+		switch(precision){
+			case NBodySim::REFINED: stepDirect<NBodySim::REFINED>(deltaT); break;
+			case NBodySim::FAST: stepDirect<NBodySim::FAST>(deltaT); break;
+			default: stepDirect<NBodySim::ACCURATE>(deltaT); break;
 		}
-		system[i].setVel(newVelocity);
-		newPosition.x += newVelocity.x * deltaT;
-		newPosition.y += newVelocity.y * deltaT;
-		newPosition.z += newVelocity.z * deltaT;
-		system[i].setPos(newPosition);
+	}
+	
+	if(regularizationEnabled){
+		regularizer.split(system, G, deltaT);
+	}
+	
+	// Merging changes the number of particles, so the kernel and the integrator state must follow
+	if(collisionsEnabled && collisions.resolve(system, mergedIds) > 0){
+		for(size_t i = 0; i < mergedIds.size(); i++){
+			removeId(mergedIds[i]);
+		}
+		selectKernel();
 	}
 }
 
+template <class T>
+template <NBodySim::forcePrecision P, bool C>
+void NBodySim::NBodySystem<T>::accelerateTargets(size_t targetStart, size_t targetEnd, unsigned node){
+	size_t numSources = sourceX.size();
+	const T * positionX = (node == 0) ? sourceX.data() : replicaX[node].data();
+	const T * positionY = (node == 0) ? sourceY.data() : replicaY[node].data();
+	const T * positionZ = (node == 0) ? sourceZ.data() : replicaZ[node].data();
+	const T * gm = (node == 0) ? sourceGM.data() : replicaGM[node].data();
+	T distanceX[NBodySim::NBodySystemSpace::chunkLength];
+	T distanceY[NBodySim::NBodySystemSpace::chunkLength];
+	T distanceZ[NBodySim::NBodySystemSpace::chunkLength];
+	T distanceSquared[NBodySim::NBodySystemSpace::chunkLength];
+	T inverseCube[NBodySim::NBodySystemSpace::chunkLength];
+	size_t sourceEnd;
+	size_t chunkLength;
+	size_t self;
+	T targetX;
+	T targetY;
+	T targetZ;
+	T scale;
+	T sumX;
+	T sumY;
+	T sumZ;
+	T lostX = 0;
+	T lostY = 0;
+	T lostZ = 0;
+	T term;
+	T total;
+	// Targets are the first sources unless the sources are the blocks of an exchange with other processes
+	const T * targetsX = exchanging ? exchangeTargetX.data() : positionX;
+	const T * targetsY = exchanging ? exchangeTargetY.data() : positionY;
+	const T * targetsZ = exchanging ? exchangeTargetZ.data() : positionZ;
+	
+	// The first write of every target, by the thread that sums it, places its page on that thread's node, later blocks
+	// of an exchange add to it
+	if(blocksSummed == 0){
+		for(size_t i = targetStart; i < targetEnd; i++){
+			accelerationX[i] = 0;
+			accelerationY[i] = 0;
+			accelerationZ[i] = 0;
+			if(C){
+				compensationX[i] = 0;
+				compensationY[i] = 0;
+				compensationZ[i] = 0;
+			}
+		}
+	}
+	
+	// Each source tile stays in L1 cache while every target of the range is summed against it
+	for(size_t sourceStart = 0; sourceStart < numSources; sourceStart += sourceTileLength){
+		sourceEnd = std::min(sourceStart + sourceTileLength, numSources);
+		for(size_t i = targetStart; i < targetEnd; i++){
+			self = targetIndex.empty() ? i : targetIndex[i];
+			targetX = targetsX[self];
+			targetY = targetsY[self];
+			targetZ = targetsZ[self];
+			sumX = accelerationX[i];
+			sumY = accelerationY[i];
+			sumZ = accelerationZ[i];
+			if(C){
+				lostX = compensationX[i];
+				lostY = compensationY[i];
+				lostZ = compensationZ[i];
+			}
+			for(size_t start = sourceStart; start < sourceEnd; start += NBodySim::NBodySystemSpace::chunkLength){
+				chunkLength = std::min(NBodySim::NBodySystemSpace::chunkLength, sourceEnd - start);
+				for(size_t k = 0; k < chunkLength; k++){
+					distanceX[k] = positionX[start + k] - targetX;
+					distanceY[k] = positionY[start + k] - targetY;
+					distanceZ[k] = positionZ[start + k] - targetZ;
+					distanceSquared[k] = distanceX[k] * distanceX[k] + distanceY[k] * distanceY[k] + distanceZ[k] * distanceZ[k];
+				}
+				// The inverse cube of a zero distance is 0, so a particle exerts no force on itself
+				NBodySim::InverseCube<T, P>::calculate(distanceSquared, inverseCube, chunkLength);
+				// G * m / r^2 along the unit vector d / r, folded into G * m * d / r^3
+				for(size_t k = 0; k < chunkLength; k++){
+					scale = gm[start + k] * inverseCube[k];
+					if(C){
+						// Kahan summation, each term is corrected by what the sum lost when the previous one was added
+						term = scale * distanceX[k] - lostX;
+						total = sumX + term;
+						lostX = (total - sumX) - term;
+						sumX = total;
+						term = scale * distanceY[k] - lostY;
+						total = sumY + term;
+						lostY = (total - sumY) - term;
+						sumY = total;
+						term = scale * distanceZ[k] - lostZ;
+						total = sumZ + term;
+						lostZ = (total - sumZ) - term;
+						sumZ = total;
+					}
+					else{
+						sumX += scale * distanceX[k];
+						sumY += scale * distanceY[k];
+						sumZ += scale * distanceZ[k];
+					}
+				}
+			}
+			accelerationX[i] = sumX;
+			accelerationY[i] = sumY;
+			accelerationZ[i] = sumZ;
+			if(C){
+				compensationX[i] = lostX;
+				compensationY[i] = lostY;
+				compensationZ[i] = lostZ;
+			}
+		}
+	}
+}
+
+template <class T>
+template <NBodySim::forcePrecision P>
+void NBodySim::NBodySystem<T>::accelerateRange(size_t targetStart, size_t targetEnd, unsigned node){
+	if(deterministic){
+		accelerateTargets<P, true>(targetStart, targetEnd, node);
+	}
+	else{
+		accelerateTargets<P, false>(targetStart, targetEnd, node);
+	}
+}
+
+template <class T>
+template <NBodySim::forcePrecision P>
+void NBodySim::NBodySystem<T>::accelerate(void){
+	size_t numParticles = system.size();
+	size_t targetEnd;
+	
+	accelerationX.resize(numParticles);
+	accelerationY.resize(numParticles);
+	accelerationZ.resize(numParticles);
+	if(deterministic){
+		compensationX.resize(numParticles);
+		compensationY.resize(numParticles);
+		compensationZ.resize(numParticles);
+	}
+	replicate();
+	if(scheduler && costBalancingEnabled){
+		accelerateBalanced<P>();
+		return;
+	}
+	
+	// Sum forces on each body from all bodys to obtain new velocity of paricle. The target tile stays in L2 cache for the whole
+	// pass over the sources. Its targets are shared out to the threads in tasks, every target is summed by one thread in the
+	// same order as without threads, so the result does not depend on the number of threads.
+	for(size_t targetStart = 0; targetStart < numParticles; targetStart += targetTileLength){
+		targetEnd = std::min(targetStart + targetTileLength, numParticles);
+		if(scheduler){
+			scheduler->parallelFor(targetStart, targetEnd, NBodySim::NBodySystemSpace::taskLength, [this](size_t first, size_t last, unsigned thread){
+				accelerateRange<P>(first, last, scheduler->getThreadNode(thread));
+			});
+		}
+		else{
+			accelerateRange<P>(targetStart, targetEnd, 0);
+		}
+	}
+}
+
+template <class T>
+template <NBodySim::forcePrecision P>
+void NBodySim::NBodySystem<T>::accelerateBalanced(void){
+	size_t numParticles = system.size();
+	unsigned numThreads = scheduler->getNumThreads();
+	double threadCost;
+	double maximum = 0;
+	double total = 0;
+	
+	// Until a step has been timed every particle is assumed to cost the same
+	if(particleCost.size() != numParticles || partition.size() != numThreads + 1){
+		particleCost.assign(numParticles, 1);
+		partitionByCost();
+	}
+	
+	// Every target is still summed by one thread in the same order, only which thread does it depends on the costs
+	scheduler->parallelForRanges(partition, [this](size_t first, size_t last, unsigned thread){
+		size_t end;
+		double elapsed;
+		for(size_t start = first; start < last; start += NBodySim::NBodySystemSpace::taskLength){
+			end = std::min(start + NBodySim::NBodySystemSpace::taskLength, last);
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			accelerateRange<P>(start, end, scheduler->getThreadNode(thread));
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			for(size_t i = start; i < end; i++){
+				particleCost[i] = elapsed / (end - start);
+			}
+		}
+	});
+	
+	for(unsigned thread = 0; thread < numThreads; thread++){
+		threadCost = std::accumulate(particleCost.begin() + partition[thread], particleCost.begin() + partition[thread + 1], 0.0);
+		maximum = std::max(maximum, threadCost);
+		total += threadCost;
+	}
+	imbalance = (total > 0) ? static_cast<T>(maximum * numThreads / total) : 1;
+	if(imbalance > imbalanceThreshold){
+		partitionByCost();
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::shareOut(size_t numParticles, const NBodySim::TaskScheduler::rangeFunction & body){
+	// Waking the threads costs more than a few tasks of work
+	if(scheduler && numParticles >= scheduler->getNumThreads() * NBodySim::NBodySystemSpace::taskLength){
+		scheduler->parallelForStatic(0, numParticles, body);
+	}
+	else{
+		body(0, numParticles);
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::replicate(void){
+	size_t numParticles = sourceX.size();
+	unsigned numNodes = scheduler ? scheduler->getNumNodes() : 1;
+	
+	replicaX.resize(numNodes);
+	replicaY.resize(numNodes);
+	replicaZ.resize(numNodes);
+	replicaGM.resize(numNodes);
+	if(numNodes == 1){
+		return;
+	}
+	// The first thread of every other node copies the sources, so the copy is first written, and placed, on that node
+	scheduler->parallelForThreads([this, numParticles](unsigned thread){
+		unsigned node = scheduler->getThreadNode(thread);
+		if(node == 0 || (thread > 0 && scheduler->getThreadNode(thread - 1) == node)){
+			return;
+		}
+		replicaX[node].resize(numParticles);
+		replicaY[node].resize(numParticles);
+		replicaZ[node].resize(numParticles);
+		replicaGM[node].resize(numParticles);
+		std::copy(sourceX.begin(), sourceX.end(), replicaX[node].begin());
+		std::copy(sourceY.begin(), sourceY.end(), replicaY[node].begin());
+		std::copy(sourceZ.begin(), sourceZ.end(), replicaZ[node].begin());
+		std::copy(sourceGM.begin(), sourceGM.end(), replicaGM[node].begin());
+	});
+}
+
+template <class T>
+template <NBodySim::forcePrecision P>
+void NBodySim::NBodySystem<T>::stepDirect(T deltaT){
+	size_t numParticles = system.size();
+	
+	// Gather the state of the system at the start of the step into contiguous arrays
+	sourceX.resize(numParticles);
+	sourceY.resize(numParticles);
+	sourceZ.resize(numParticles);
+	sourceGM.resize(numParticles);
+	// In deterministic mode, and for an exchange, the sources are laid out by id, so they are summed in the same order
+	// however system is sorted
+	targetIndex.resize((deterministic || sourceExchange) ? numParticles : 0);
+	shareOut(numParticles, [this](size_t first, size_t last){
+		NBodySim::ThreeVector <T> position;
+		size_t source;
+		for(size_t i = first; i < last; i++){
+			source = targetIndex.empty() ? i : system[i].getId();
+			position = system[i].getPos();
+			sourceX[source] = position.x;
+			sourceY[source] = position.y;
+			sourceZ[source] = position.z;
+			sourceGM[source] = G * system[i].getMass();
+			if(!targetIndex.empty()){
+				targetIndex[i] = source;
+			}
+		}
+	});
+	if(sourceExchange){
+		// The particles of this process stay the targets while every block of sources takes the place of their own
+		exchangeTargetX.assign(sourceX.begin(), sourceX.end());
+		exchangeTargetY.assign(sourceY.begin(), sourceY.end());
+		exchangeTargetZ.assign(sourceZ.begin(), sourceZ.end());
+		exchanging = true;
+		blocksSummed = 0;
+		sourceExchange(sourceX, sourceY, sourceZ, sourceGM, [this](){
+			accelerate<P>();
+			blocksSummed++;
+		});
+		exchanging = false;
+		blocksSummed = 0;
+	}
+	else{
+		accelerate<P>();
+	}
+	
+	shareOut(numParticles, [this, deltaT](size_t first, size_t last){
+		NBodySim::ThreeVector <T> position;
+		NBodySim::ThreeVector <T> velocity;
+		for(size_t i = first; i < last; i++){
+			// Calculate new velocity of the particle first, then its new position from the new velocity
+			velocity = system[i].getVel();
+			velocity.x += accelerationX[i] * deltaT;
+			velocity.y += accelerationY[i] * deltaT;
+			velocity.z += accelerationZ[i] * deltaT;
+			system[i].setVel(velocity);
+			position = system[i].getPos();
+			position.x += velocity.x * deltaT;
+			position.y += velocity.y * deltaT;
+			position.z += velocity.z * deltaT;
+			system[i].setPos(position);
+		}
+	});
+}
+
 template <class T>
 std::string NBodySim::NBodySystem<T>::errorToString(NBodySim::NBodySystemSpace::error errorCode){
 	switch(errorCode){
@@ -115,94 +671,500 @@ std::string NBodySim::NBodySystem<T>::errorToString(NBodySim::NBodySystemSpace::
 		case NBodySim::NBodySystemSpace::NO_VELZ: return "no VelZ attribute found for a particle"; break;
 		case NBodySim::NBodySystemSpace::NO_MASS: return "no Mass attribute found for a particle"; break;
 		case NBodySim::NBodySystemSpace::NO_NAME: return "no Name attribute found for a particle"; break;
+		case NBodySim::NBodySystemSpace::BAD_ROW: return "a row has too few columns or a value that is not a number"; break;
+		case NBodySim::NBodySystemSpace::NOT_INGESTING: return "particles were appended without beginning to load them"; break;
+		case NBodySim::NBodySystemSpace::WRONG_LENGTH: return "the number of values does not match the number of particles"; break;
 		default: return "unknown error"; break;
 	}
 }
 
+template <class T>
+unsigned NBodySim::NBodySystem<T>::attributeIndex(const char * name, size_t length){
+	// Every particle attribute name has four letters, anything else is the optional radius or unknown
+	if(length == 4){
+		for(unsigned i = 0; i < NBodySim::NBodySystemSpace::particleAttributeListLength; i++){
+			if(std::memcmp(name, NBodySim::NBodySystemSpace::particleAttributeList[i], 4) == 0){
+				return i;
+			}
+		}
+	}
+	else if(length == 6 && std::memcmp(name, "radius", 6) == 0){
+		return NBodySim::NBodySystemSpace::RADIUS;
+	}
+	return NBodySim::NBodySystemSpace::UNKNOWN_ATTRIBUTE;
+}
+
+template <class T>
+T NBodySim::NBodySystem<T>::parseNumber(const char * first, const char * last){
+	T value = 0;
+
+	// from_chars takes neither the leading spaces nor the plus sign atof allows
+	while(first < last && (*first == ' ' || *first == '\t' || *first == '\n' || *first == '\r')){
+		first++;
+	}
+	if(first < last && *first == '+'){
+		first++;
+	}
+	std::from_chars(first, last, value);
+	return value;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::parseParticles(rapidxml::xml_node<char> * node, std::vector<NBodySim::Particle<T> > & out, rapidxml::xml_node<char> ** failed){
+	const unsigned allAttributes = (1u << NBodySim::NBodySystemSpace::particleAttributeListLength) - 1;
+	rapidxml::xml_attribute<> *attr;
+	NBodySim::Particle<T> p;
+	size_t numParticles = 0;
+	unsigned seen;
+	unsigned index;
+	
+	for(rapidxml::xml_node<> *counted = node; counted != NULL; counted = counted->next_sibling()){
+		numParticles++;
+	}
+	out.reserve(out.size() + numParticles);
+	
+	while(node != NULL){
+		// One walk over the attributes, in whatever order they are written
+		seen = 0;
+		p.setRadius(0);
+		for(attr = node->first_attribute(); attr != NULL; attr = attr->next_attribute()){
+			index = attributeIndex(attr->name(), attr->name_size());
+			// The first of a repeated attribute is the one that counts, as with a lookup by name
+			if(index < NBodySim::NBodySystemSpace::particleAttributeListLength){
+				if((seen & (1u << index)) != 0){
+					continue;
+				}
+				seen |= 1u << index;
+			}
+			switch(index){
+				case NBodySim::NBodySystemSpace::POSX: p.setPosX(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::POSY: p.setPosY(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::POSZ: p.setPosZ(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::VELX: p.setVelX(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::VELY: p.setVelY(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::VELZ: p.setVelZ(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::MASS: p.setMass(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				case NBodySim::NBodySystemSpace::NAME: p.setName(std::string(attr->value(), attr->value_size())); break;
+				// Particles without a radius never collide
+				case NBodySim::NBodySystemSpace::RADIUS: p.setRadius(parseNumber(attr->value(), attr->value() + attr->value_size())); break;
+				default: break;
+			}
+		}
+		if(seen != allAttributes){
+			// Report the first missing attribute in list order
+			for(index = 0; (seen & (1u << index)) != 0; index++){
+			}
+			*failed = node;
+			return static_cast<NBodySim::NBodySystemSpace::error>(NBodySim::NBodySystemSpace::NO_POSX + index);
+		}
+		out.push_back(p);
+		node = node->next_sibling();
+	}
+	return NBodySim::NBodySystemSpace::SUCCESS;
+}
+
+template <class T>
+bool NBodySim::NBodySystem<T>::parseChunks(const std::string & xmlText, NBodySim::NBodySystemSpace::error * result){
+	size_t systemStart;
+	size_t tagEnd;
+	size_t bodyStart;
+	size_t bodyEnd;
+	size_t numChunks;
+	size_t first = system.size();
+	size_t failedChunk;
+	size_t total = 0;
+	std::string systemTag;
+	rapidxml::xml_document<> systemDoc;
+	rapidxml::xml_attribute<> *attr;
+	std::atomic<bool> unsplittable(false);
+	
+	// The particles lie between the end of the system tag and the closing tag, anything else goes to the serial parse
+	systemStart = xmlText.find("<system");
+	tagEnd = (systemStart == std::string::npos) ? std::string::npos : xmlText.find('>', systemStart);
+	bodyEnd = xmlText.rfind("</system>");
+	if(tagEnd == std::string::npos || bodyEnd == std::string::npos || bodyEnd < tagEnd || xmlText[tagEnd - 1] == '/'){
+		return false;
+	}
+	bodyStart = xmlText.find("<particle", tagEnd);
+	if(bodyStart >= bodyEnd || xmlText.find("<!") < bodyStart){
+		return false;
+	}
+	// The system tag is parsed alone for the gravitation constant
+	systemTag = xmlText.substr(systemStart, tagEnd + 1 - systemStart) + "</system>";
+	try{
+		systemDoc.parse<0>(&systemTag[0]);
+	}
+	catch(rapidxml::parse_error &){
+		return false;
+	}
+	if(systemDoc.first_node("system") == NULL){
+		return false;
+	}
+	
+	// Chunks start at particle tags, attribute values can not hold a '<' so a tag boundary is never inside a value
+	numChunks = std::max<size_t>(1, std::min<size_t>(scheduler->getNumThreads() * 4, (bodyEnd - bodyStart) / NBodySim::NBodySystemSpace::parseChunkLength));
+	std::vector<size_t> bounds(numChunks + 1, bodyEnd);
+	bounds[0] = bodyStart;
+	for(size_t chunk = 1; chunk < numChunks; chunk++){
+		bounds[chunk] = std::min(bodyEnd, xmlText.find("<particle", std::max(bounds[chunk - 1], bodyStart + (bodyEnd - bodyStart) * chunk / numChunks)));
+	}
+	std::vector<std::vector<NBodySim::Particle<T> > > particles(numChunks);
+	std::vector<NBodySim::NBodySystemSpace::error> errors(numChunks, NBodySim::NBodySystemSpace::SUCCESS);
+	std::vector<size_t> errorLines(numChunks, 0);
+	std::vector<size_t> newlines(numChunks, 0);
+	
+	scheduler->parallelFor(0, numChunks, 1, [&](size_t begin, size_t end){
+		for(size_t chunk = begin; chunk < end; chunk++){
+			std::string buffer(xmlText, bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+			rapidxml::xml_document<> doc;
+			rapidxml::xml_node<> *failed = NULL;
+			size_t tag;
+			
+			// Comments, declarations and nested systems need the whole document, as does text rapidxml rejects
+			for(tag = buffer.find('<'); tag != std::string::npos; tag = buffer.find('<', tag + 1)){
+				if(buffer.compare(tag, 2, "<!") == 0 || buffer.compare(tag, 7, "<system") == 0 || buffer.compare(tag, 8, "</system") == 0){
+					unsplittable = true;
+					return;
+				}
+			}
+			try{
+				doc.parse<rapidxml::parse_no_string_terminators>(&buffer[0]);
+			}
+			catch(rapidxml::parse_error &){
+				unsplittable = true;
+				return;
+			}
+			newlines[chunk] = std::count(buffer.begin(), buffer.end(), '\n');
+			errors[chunk] = parseParticles(doc.first_node(), particles[chunk], &failed);
+			if(failed != NULL){
+				errorLines[chunk] = std::count(&buffer[0], failed->name(), '\n');
+			}
+		}
+	});
+	if(unsplittable){
+		return false;
+	}
+	
+	// Implements Req NF.SystemsProvideG
+	attr = systemDoc.first_node("system")->first_attribute("G");
+	if(attr != NULL){
+		this->setGravitation(parseNumber(attr->value(), attr->value() + attr->value_size()));
+	}
+	
+	// As on one thread, the particles before the first one missing an attribute are kept
+	for(failedChunk = 0; failedChunk < numChunks && errors[failedChunk] == NBodySim::NBodySystemSpace::SUCCESS; failedChunk++){
+	}
+	std::vector<size_t> offsets(std::min(failedChunk + 1, numChunks) + 1, first);
+	for(size_t chunk = 0; chunk + 1 < offsets.size(); chunk++){
+		offsets[chunk + 1] = offsets[chunk] + particles[chunk].size();
+	}
+	total = offsets.back() - first;
+	system.resize(first + total);
+	slotOf.resize(first + total);
+	scheduler->parallelFor(0, offsets.size() - 1, 1, [&](size_t begin, size_t end){
+		for(size_t chunk = begin; chunk < end; chunk++){
+			for(size_t i = 0; i < particles[chunk].size(); i++){
+				system[offsets[chunk] + i] = particles[chunk][i];
+				system[offsets[chunk] + i].setId(offsets[chunk] + i);
+				slotOf[offsets[chunk] + i] = offsets[chunk] + i;
+			}
+		}
+	});
+	selectKernel();
+	
+	*result = (failedChunk < numChunks) ? errors[failedChunk] : NBodySim::NBodySystemSpace::SUCCESS;
+	if(failedChunk < numChunks){
+		parseErrorLine = 1 + std::count(xmlText.begin(), xmlText.begin() + bodyStart, '\n') + errorLines[failedChunk];
+		for(size_t chunk = 0; chunk < failedChunk; chunk++){
+			parseErrorLine += newlines[chunk];
+		}
+	}
+	return true;
+}
+
 template <class T>
 NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::parse(std::string xmlText){
-	char * buffer = NULL;
 	rapidxml::xml_node<> *node;
 	rapidxml::xml_node<> *secondNode;
+	rapidxml::xml_node<> *failed = NULL;
 	rapidxml::xml_attribute<> *attr;
 	rapidxml::xml_document<> doc;
+	NBodySim::NBodySystemSpace::error result;
+	size_t first = system.size();
 	
-	buffer = new char[xmlText.size() + 1];
-	if(buffer == NULL){
-		return NBodySim::NBodySystemSpace::FAILED_TO_ALLOCATE_MEMORY;
+	parseErrorLine = 0;
+	if(scheduler && xmlText.size() >= NBodySim::NBodySystemSpace::parallelParseLength && parseChunks(xmlText, &result)){
+		return result;
 	}
-
-	std::strcpy(buffer, xmlText.c_str());
 	
-	// Parse the file
-	doc.parse<0>(buffer);
+	// xmlText is already a copy, so it is parsed in place, values are read by length instead of being terminated
+	doc.parse<rapidxml::parse_no_string_terminators>(&xmlText[0]);
 	
 	node = doc.first_node("system");
 	if(node != NULL){
 		if(node->next_sibling("system") != NULL){
-			delete [] buffer;
 			return NBodySim::NBodySystemSpace::MORE_THAN_ONE_SYSTEM;
 		}
 	}
 	else{
-		delete [] buffer;
 		return NBodySim::NBodySystemSpace::NO_SYSTEM;
 	}
 	// Get the gravitation constant of the system if it is given
 	// Implements Req NF.SystemsProvideG
-	if(node->first_attribute("G") != NULL){
-		this->setGravitation(atof(node->first_attribute("G")->value()));
+	attr = node->first_attribute("G");
+	if(attr != NULL){
+		this->setGravitation(parseNumber(attr->value(), attr->value() + attr->value_size()));
 	}
 	
 	secondNode = node->first_node("particle");
 	if(secondNode == NULL){
-		delete [] buffer;
 		return NBodySim::NBodySystemSpace::NO_PARTICLES;
 	}
 	
-	while(secondNode != NULL){
-		NBodySim::Particle<T> p;
-		for(unsigned i = 0; i < NBodySim::NBodySystemSpace::particleAttributeListLength; i++){
-			attr = secondNode->first_attribute(NBodySim::NBodySystemSpace::particleAttributeList[i]);
-			if(attr == NULL){
-				delete [] buffer;
-				switch(i){
-					case NBodySim::NBodySystemSpace::POSX: return NBodySim::NBodySystemSpace::NO_POSX; break;
-					case NBodySim::NBodySystemSpace::POSY: return NBodySim::NBodySystemSpace::NO_POSY; break;
-					case NBodySim::NBodySystemSpace::POSZ: return NBodySim::NBodySystemSpace::NO_POSZ; break;
-					case NBodySim::NBodySystemSpace::VELX: return NBodySim::NBodySystemSpace::NO_VELX; break;
-					case NBodySim::NBodySystemSpace::VELY: return NBodySim::NBodySystemSpace::NO_VELY; break;
-					case NBodySim::NBodySystemSpace::VELZ: return NBodySim::NBodySystemSpace::NO_VELZ; break;
-					case NBodySim::NBodySystemSpace::MASS: return NBodySim::NBodySystemSpace::NO_MASS; break;
-					case NBodySim::NBodySystemSpace::NAME: return NBodySim::NBodySystemSpace::NO_NAME; break;
-					default: return NBodySim::NBodySystemSpace::INDEX_EXCEEDED;
+	result = parseParticles(secondNode, system, &failed);
+	if(failed != NULL){
+		parseErrorLine = 1 + std::count(&xmlText[0], failed->name(), '\n');
+	}
+	slotOf.resize(system.size());
+	for(size_t i = first; i < system.size(); i++){
+		system[i].setId(i);
+		slotOf[i] = i;
+	}
+	// The kernel depends on the number of particles, so it is chosen once they are all added
+	selectKernel();
+	
+	return result;
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::splitColumns(const std::string & line, char delimiter, std::vector<std::string> & fields){
+	size_t numFields = 0;
+	size_t i = 0;
+	size_t length = line.size();
+	
+	// A carriage return left by a file written on Windows is not part of the last field
+	if(length > 0 && line[length - 1] == '\r'){
+		length--;
+	}
+	while(i < length){
+		if(delimiter == 0){
+			while(i < length && (line[i] == ' ' || line[i] == '\t')){
+				i++;
+			}
+			if(i == length){
+				break;
+			}
+		}
+		if(numFields == fields.size()){
+			fields.push_back(std::string());
+		}
+		fields[numFields].clear();
+		if(line[i] == '"'){
+			// A quoted field runs to the next lone quote, a doubled quote stands for one quote
+			for(i++; i < length; i++){
+				if(line[i] == '"'){
+					if(i + 1 < length && line[i + 1] == '"'){
+						i++;
+					}
+					else{
+						i++;
+						break;
+					}
 				}
+				fields[numFields].push_back(line[i]);
 			}
-			switch(i){
-				case NBodySim::NBodySystemSpace::POSX: p.setPosX(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::POSY: p.setPosY(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::POSZ: p.setPosZ(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::VELX: p.setVelX(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::VELY: p.setVelY(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::VELZ: p.setVelZ(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::MASS: p.setMass(atof(attr->value())); break;
-				case NBodySim::NBodySystemSpace::NAME: p.setName(std::string(attr->value())); break;
-				default: return NBodySim::NBodySystemSpace::INDEX_EXCEEDED;
+		}
+		while(i < length && !((delimiter == 0) ? (line[i] == ' ' || line[i] == '\t') : line[i] == delimiter)){
+			fields[numFields].push_back(line[i]);
+			i++;
+		}
+		numFields++;
+		// Skip the delimiter, a comma at the end of a line starts one last, empty field
+		if(delimiter != 0 && i < length){
+			i++;
+			if(i == length){
+				if(numFields == fields.size()){
+					fields.push_back(std::string());
+				}
+				fields[numFields].clear();
+				numFields++;
+			}
+		}
+	}
+	return numFields;
+}
+
+template <class T>
+bool NBodySim::NBodySystem<T>::readNumber(const std::string & field, T * value){
+	const char * first = field.c_str();
+	const char * last = first + field.size();
+	std::from_chars_result result;
+	
+	while(first < last && (*first == ' ' || *first == '\t')){
+		first++;
+	}
+	while(last > first && (last[-1] == ' ' || last[-1] == '\t')){
+		last--;
+	}
+	if(first < last && *first == '+'){
+		first++;
+	}
+	result = std::from_chars(first, last, *value);
+	return result.ec == std::errc() && result.ptr == last;
+}
+
+template <class T>
+NBodySim::NBodySystemSpace::error NBodySim::NBodySystem<T>::parseColumns(std::istream & in){
+	const size_t noColumn = static_cast<size_t>(-1);
+	std::string line;
+	std::vector<std::string> fields;
+	std::vector<unsigned> columns;
+	size_t columnOf[NBodySim::NBodySystemSpace::UNKNOWN_ATTRIBUTE];
+	size_t numFields;
+	size_t lineNumber = 0;
+	size_t first = system.size();
+	bool header = false;
+	char delimiter = 0;
+	T value;
+	NBodySim::Particle<T> p;
+	
+	parseErrorLine = 0;
+	while(std::getline(in, line)){
+		lineNumber++;
+		if(line.find_first_not_of(" \t\r") == std::string::npos){
+			continue;
+		}
+		if(line[0] == '#'){
+			if(line.compare(0, 4, "# G ") == 0){
+				this->setGravitation(parseNumber(line.c_str() + 4, line.c_str() + line.size()));
+			}
+			continue;
+		}
+		
+		if(!header){
+			// The header decides the delimiter and which column holds which attribute
+			delimiter = (line.find(',') != std::string::npos) ? ',' : 0;
+			numFields = splitColumns(line, delimiter, fields);
+			std::fill(columnOf, columnOf + NBodySim::NBodySystemSpace::UNKNOWN_ATTRIBUTE, noColumn);
+			columns.resize(numFields);
+			for(size_t column = 0; column < numFields; column++){
+				columns[column] = attributeIndex(fields[column].c_str(), fields[column].size());
+				if(columns[column] < NBodySim::NBodySystemSpace::UNKNOWN_ATTRIBUTE && columnOf[columns[column]] == noColumn){
+					columnOf[columns[column]] = column;
+				}
+			}
+			for(unsigned i = 0; i < NBodySim::NBodySystemSpace::NAME; i++){
+				if(columnOf[i] == noColumn){
+					parseErrorLine = lineNumber;
+					return static_cast<NBodySim::NBodySystemSpace::error>(NBodySim::NBodySystemSpace::NO_POSX + i);
+				}
 			}
+			header = true;
+			continue;
 		}
 		
-		secondNode = secondNode->next_sibling();
-		this->addParticle(p);
+		numFields = splitColumns(line, delimiter, fields);
+		if(numFields < columns.size()){
+			parseErrorLine = lineNumber;
+			break;
+		}
+		p.setRadius(0);
+		p.setNameId(NBodySim::NameTable::generated(system.size()));
+		for(unsigned i = 0; i < NBodySim::NBodySystemSpace::UNKNOWN_ATTRIBUTE && parseErrorLine == 0; i++){
+			if(columnOf[i] == noColumn){
+				continue;
+			}
+			if(i == NBodySim::NBodySystemSpace::NAME){
+				p.setName(fields[columnOf[i]]);
+				continue;
+			}
+			// Unlike an xml attribute an empty or misspelled number is an error, it is most likely a shifted column
+			if(!readNumber(fields[columnOf[i]], &value)){
+				parseErrorLine = lineNumber;
+				continue;
+			}
+			switch(i){
+				case NBodySim::NBodySystemSpace::POSX: p.setPosX(value); break;
+				case NBodySim::NBodySystemSpace::POSY: p.setPosY(value); break;
+				case NBodySim::NBodySystemSpace::POSZ: p.setPosZ(value); break;
+				case NBodySim::NBodySystemSpace::VELX: p.setVelX(value); break;
+				case NBodySim::NBodySystemSpace::VELY: p.setVelY(value); break;
+				case NBodySim::NBodySystemSpace::VELZ: p.setVelZ(value); break;
+				case NBodySim::NBodySystemSpace::MASS: p.setMass(value); break;
+				default: p.setRadius(value); break;
+			}
+		}
+		if(parseErrorLine != 0){
+			break;
+		}
+		p.setId(system.size());
+		slotOf.push_back(system.size());
+		system.push_back(p);
 	}
+	selectKernel();
 	
-	delete [] buffer;
+	if(!header){
+		return NBodySim::NBodySystemSpace::NO_PARTICLES;
+	}
+	if(parseErrorLine != 0){
+		return NBodySim::NBodySystemSpace::BAD_ROW;
+	}
+	return (system.size() > first) ? NBodySim::NBodySystemSpace::SUCCESS : NBodySim::NBodySystemSpace::NO_PARTICLES;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::writeColumns(std::ostream & out, const std::vector<NBodySim::Particle<T> > & particles, char delimiter, bool header){
+	std::string name;
+	bool quote;
 	
-	return NBodySim::NBodySystemSpace::SUCCESS;
+	if(header){
+		out << "posX" << delimiter << "posY" << delimiter << "posZ" << delimiter << "velX" << delimiter << "velY" << delimiter << "velZ";
+		out << delimiter << "mass" << delimiter << "radius" << delimiter << "name" << '\n';
+	}
+	// Seventeen digits give back every double exactly
+	out.precision(17);
+	for(size_t i = 0; i < particles.size(); i++){
+		const NBodySim::Particle<T> & p = particles[i];
+		out << p.getPos().x << delimiter << p.getPos().y << delimiter << p.getPos().z << delimiter;
+		out << p.getVel().x << delimiter << p.getVel().y << delimiter << p.getVel().z << delimiter;
+		out << p.getMass() << delimiter << p.getRadius() << delimiter;
+		name = p.getName();
+		quote = name.empty() || name.find_first_of(",\" \t#") != std::string::npos;
+		if(!quote){
+			out << name << '\n';
+			continue;
+		}
+		out << '"';
+		for(size_t k = 0; k < name.size(); k++){
+			if(name[k] == '"'){
+				out << '"';
+			}
+			out << name[k];
+		}
+		out << '"' << '\n';
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::writeColumns(std::ostream & out, char delimiter){
+	std::vector<NBodySim::Particle<T> > particles;
+	
+	out.precision(17);
+	out << "# G " << G << '\n';
+	copyParticles(particles);
+	writeColumns(out, particles, delimiter);
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::getParseErrorLine(void){
+	return parseErrorLine;
 }
 
 template <class T>
 void NBodySim::NBodySystem<T>::setGravitation(T gravitationConstant){
 	G = gravitationConstant;
+	hermite.reset();
+	gaussRadau.reset();
 }
 
 template <class T>
@@ -210,5 +1172,295 @@ T NBodySim::NBodySystem<T>::getGravitation(void){
 	return G;
 }
 
+template <class T>
+T NBodySim::NBodySystem<T>::energy(void){
+	T kinetic = 0;
+	T potential = 0;
+	NBodySim::ThreeVector<T> vel;
+	NBodySim::ThreeVector<T> dr;
+	
+	for(size_t i = 0; i < system.size(); i++){
+		vel = system[i].getVel();
+		kinetic += system[i].getMass() * (vel.x * vel.x + vel.y * vel.y + vel.z * vel.z) / 2;
+		for(size_t j = i + 1; j < system.size(); j++){
+			dr.x = system[j].getPos().x - system[i].getPos().x;
+			dr.y = system[j].getPos().y - system[i].getPos().y;
+			dr.z = system[j].getPos().z - system[i].getPos().z;
+			potential -= G * system[i].getMass() * system[j].getMass() / std::sqrt(dr.x * dr.x + dr.y * dr.y + dr.z * dr.z);
+		}
+	}
+	return kinetic + potential;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setFixedKernel(bool enable){
+	fixedKernelEnabled = enable;
+	selectKernel();
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setForcePrecision(NBodySim::forcePrecision newPrecision){
+	precision = newPrecision;
+	selectKernel();
+}
+
+template <class T>
+NBodySim::forcePrecision NBodySim::NBodySystem<T>::getForcePrecision(void){
+	return precision;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setTileLengths(size_t targetLength, size_t sourceLength){
+	targetTileLength = (targetLength == 0) ? defaultTargetTileLength() : targetLength;
+	sourceTileLength = (sourceLength == 0) ? defaultSourceTileLength() : sourceLength;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setDeterministic(bool enable){
+	deterministic = enable;
+	selectKernel();
+}
+
+template <class T>
+bool NBodySim::NBodySystem<T>::getDeterministic(void){
+	return deterministic;
+}
+
+template <class T>
+uint64_t NBodySim::NBodySystem<T>::hashParticle(uint64_t hash, const NBodySim::Particle<T> & p){
+	double values[7] = {p.getPos().x, p.getPos().y, p.getPos().z, p.getVel().x, p.getVel().y, p.getVel().z, p.getMass()};
+	unsigned char bytes[sizeof(values)];
+	
+	std::memcpy(bytes, values, sizeof(values));
+	for(size_t b = 0; b < sizeof(bytes); b++){
+		hash = (hash ^ bytes[b]) * NBodySim::NBodySystemSpace::hashPrime;
+	}
+	return hash;
+}
+
+template <class T>
+uint64_t NBodySim::NBodySystem<T>::stateHash(void){
+	uint64_t hash = NBodySim::NBodySystemSpace::hashBasis;
+	
+	for(size_t i = 0; i < slotOf.size(); i++){
+		hash = hashParticle(hash, system[slotOf[i]]);
+	}
+	return hash;
+}
+
+template <class T>
+uint64_t NBodySim::NBodySystem<T>::stateHash(const std::vector<NBodySim::Particle<T> > & particles){
+	uint64_t hash = NBodySim::NBodySystemSpace::hashBasis;
+	
+	for(size_t i = 0; i < particles.size(); i++){
+		hash = hashParticle(hash, particles[i]);
+	}
+	return hash;
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::getTargetTileLength(void){
+	return targetTileLength;
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::getSourceTileLength(void){
+	return sourceTileLength;
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::defaultTargetTileLength(void){
+	size_t cacheSize = NBodySim::NBodySystemSpace::defaultL2CacheSize;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	if(sysconf(_SC_LEVEL2_CACHE_SIZE) > 0){
+		cacheSize = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	}
+#endif
+	// A target needs its position and its acceleration
+	return std::max<size_t>(1, cacheSize / (2 * 6 * sizeof(T)));
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::defaultSourceTileLength(void){
+	size_t cacheSize = NBodySim::NBodySystemSpace::defaultL1CacheSize;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+	if(sysconf(_SC_LEVEL1_DCACHE_SIZE) > 0){
+		cacheSize = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+	}
+#endif
+	// A source needs its position and G times its mass, round down to whole chunks
+	return std::max(NBodySim::NBodySystemSpace::chunkLength, (cacheSize / (2 * 4 * sizeof(T))) / NBodySim::NBodySystemSpace::chunkLength * NBodySim::NBodySystemSpace::chunkLength);
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setIntegrator(NBodySim::integratorType newIntegrator){
+	integrator = newIntegrator;
+	hermite.reset();
+	gaussRadau.reset();
+}
+
+template <class T>
+NBodySim::integratorType NBodySim::NBodySystem<T>::getIntegrator(void){
+	return integrator;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::accelerations(const std::vector<NBodySim::ThreeVector<T> > & positions, std::vector<NBodySim::ThreeVector<T> > & out){
+	size_t numParticles = positions.size();
+	
+	sourceX.resize(numParticles);
+	sourceY.resize(numParticles);
+	sourceZ.resize(numParticles);
+	sourceGM.resize(numParticles);
+	targetIndex.resize(deterministic ? numParticles : 0);
+	shareOut(numParticles, [this, &positions](size_t first, size_t last){
+		size_t source;
+		for(size_t i = first; i < last; i++){
+			source = targetIndex.empty() ? i : system[i].getId();
+			sourceX[source] = positions[i].x;
+			sourceY[source] = positions[i].y;
+			sourceZ[source] = positions[i].z;
+			sourceGM[source] = G * system[i].getMass();
+			if(!targetIndex.empty()){
+				targetIndex[i] = source;
+			}
+		}
+	});
+	switch(precision){
+		case NBodySim::REFINED: accelerate<NBodySim::REFINED>(); break;
+		case NBodySim::FAST: accelerate<NBodySim::FAST>(); break;
+		default: accelerate<NBodySim::ACCURATE>(); break;
+	}
+	out.resize(numParticles);
+	for(size_t i = 0; i < numParticles; i++){
+		out[i].x = accelerationX[i];
+		out[i].y = accelerationY[i];
+		out[i].z = accelerationZ[i];
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setErrorTolerance(T epsilon){
+	gaussRadau.setTolerance(epsilon);
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setNumThreads(unsigned threads, bool pin){
+	imbalance = 1;
+	if(threads == 1){
+		scheduler.reset();
+	}
+	else if(!scheduler || threads == 0 || scheduler->getNumThreads() != threads || scheduler->getPinned() != pin){
+		scheduler = std::make_shared<NBodySim::TaskScheduler>(threads, pin);
+	}
+}
+
+template <class T>
+unsigned NBodySim::NBodySystem<T>::getNumThreads(void){
+	return scheduler ? scheduler->getNumThreads() : 1;
+}
+
+template <class T>
+unsigned NBodySim::NBodySystem<T>::getNumNodes(void){
+	return scheduler ? scheduler->getNumNodes() : 1;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::partitionByCost(void){
+	size_t numParticles = particleCost.size();
+	unsigned numThreads = scheduler ? scheduler->getNumThreads() : 1;
+	std::vector<double> prefix(numParticles);
+	double total;
+	
+	std::partial_sum(particleCost.begin(), particleCost.end(), prefix.begin());
+	total = prefix.empty() ? 0 : prefix.back();
+	partition.assign(numThreads + 1, numParticles);
+	partition[0] = 0;
+	// Each boundary is the first particle whose running cost reaches the thread's equal share of the total
+	for(unsigned thread = 1; thread < numThreads; thread++){
+		partition[thread] = std::lower_bound(prefix.begin(), prefix.end(), total * thread / numThreads) - prefix.begin();
+		partition[thread] = std::max(partition[thread], partition[thread - 1]);
+	}
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setCostBalancing(bool enable, T threshold){
+	costBalancingEnabled = enable;
+	imbalanceThreshold = threshold;
+	imbalance = 1;
+	particleCost.clear();
+}
+
+template <class T>
+bool NBodySim::NBodySystem<T>::getCostBalancing(void){
+	return costBalancingEnabled;
+}
+
+template <class T>
+T NBodySim::NBodySystem<T>::getImbalance(void){
+	return imbalance;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setSourceExchange(exchangeFunction exchange){
+	sourceExchange = exchange;
+	targetIndex.clear();
+	selectKernel();
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setReorderInterval(size_t steps, NBodySim::curveType curveIn){
+	reorderInterval = steps;
+	reorderCurve = curveIn;
+	stepsSinceReorder = 0;
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::getReorderInterval(void){
+	return reorderInterval;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setRegularization(bool enable){
+	regularizationEnabled = enable;
+	regularizer.reset();
+}
+
+template <class T>
+bool NBodySim::NBodySystem<T>::getRegularization(void){
+	return regularizationEnabled;
+}
+
+template <class T>
+size_t NBodySim::NBodySystem<T>::numRegularizedPairs(void){
+	return regularizer.numPairs();
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setCollisions(bool enable){
+	collisionsEnabled = enable;
+}
+
+template <class T>
+bool NBodySim::NBodySystem<T>::getCollisions(void){
+	return collisionsEnabled;
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::setTimestepAccuracy(T eta){
+	hermite.setAccuracy(eta);
+}
+
+template <class T>
+void NBodySim::NBodySystem<T>::selectKernel(void){
+	nameIndexValid = false;
+	hermite.reset();
+	gaussRadau.reset();
+	regularizer.reset();
+	particleCost.clear();
+	// A specialized kernel only sees the particles of this process, and sums them in the order they are stored
+	fixedStep = (fixedKernelEnabled && !sourceExchange && !deterministic) ? NBodySim::FixedStepSpace::lookup<T>(system.size(), precision) : NULL;
+}
+
 template class NBodySim::NBodySystem<NBodySim::FloatingType>;
 
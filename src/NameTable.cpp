@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <string>
+#include <cstdint>
+
+#include <boost/thread.hpp>
+
+#include "NameTable.h"
+
+NBodySim::NameTable & NBodySim::NameTable::instance(void){
+	static NBodySim::NameTable table;
+	return table;
+}
+
+uint32_t NBodySim::NameTable::intern(const std::string & name){
+	if(name.empty()){
+		return NBodySim::NameTableSpace::emptyName;
+	}
+	NBodySim::NameTable & table = instance();
+	boost::lock_guard<boost::mutex> lock(table.tableMutex);
+	std::unordered_map<std::string, uint32_t>::iterator found = table.ids.find(name);
+	if(found != table.ids.end()){
+		return found->second;
+	}
+	table.names.push_back(name);
+	table.ids.emplace(name, table.names.size());
+	return table.names.size();
+}
+
+bool NBodySim::NameTable::find(const std::string & name, uint32_t * id){
+	if(name.empty()){
+		*id = NBodySim::NameTableSpace::emptyName;
+		return true;
+	}
+	NBodySim::NameTable & table = instance();
+	boost::lock_guard<boost::mutex> lock(table.tableMutex);
+	std::unordered_map<std::string, uint32_t>::iterator found = table.ids.find(name);
+	if(found == table.ids.end()){
+		return false;
+	}
+	*id = found->second;
+	return true;
+}
+
+uint32_t NBodySim::NameTable::generated(size_t index){
+	return NBodySim::NameTableSpace::generatedName | static_cast<uint32_t>(index);
+}
+
+bool NBodySim::NameTable::findGenerated(const std::string & name, uint32_t * id){
+	size_t index = 0;
+
+	if(name.empty() || name.size() > 10 || (name[0] == '0' && name.size() > 1)){
+		return false;
+	}
+	for(size_t i = 0; i < name.size(); i++){
+		if(name[i] < '0' || name[i] > '9'){
+			return false;
+		}
+		index = index * 10 + (name[i] - '0');
+	}
+	if(index >= NBodySim::NameTableSpace::generatedName){
+		return false;
+	}
+	*id = generated(index);
+	return true;
+}
+
+std::string NBodySim::NameTable::name(uint32_t id){
+	if(id == NBodySim::NameTableSpace::emptyName){
+		return std::string();
+	}
+	if(id & NBodySim::NameTableSpace::generatedName){
+		return std::to_string(id & ~NBodySim::NameTableSpace::generatedName);
+	}
+	NBodySim::NameTable & table = instance();
+	boost::lock_guard<boost::mutex> lock(table.tableMutex);
+	return (id <= table.names.size()) ? table.names[id - 1] : std::string();
+}
+
+size_t NBodySim::NameTable::size(void){
+	NBodySim::NameTable & table = instance();
+	boost::lock_guard<boost::mutex> lock(table.tableMutex);
+	return table.names.size();
+}
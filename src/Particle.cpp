@@ -22,6 +22,7 @@
 
 #include "NBodyTypes.h"
 #include "Particle.h"
+#include "NameTable.h"
 
 template <class T>
 NBodySim::Particle<T>::Particle(void){
@@ -47,7 +48,9 @@ void NBodySim::Particle<T>::particle(T xPos, T yPos, T zPos, T xVel, T yVel, T z
 	velocity.y = yVel;
 	velocity.z = zVel;
 	mass = massIn;
-	name = nameIn;
+	nameId = NBodySim::NameTable::intern(nameIn);
+	radius = 0;
+	id = 0;
 }
 
 template <class T>
@@ -56,23 +59,38 @@ NBodySim::Particle<T>::~Particle(void){
 }
 
 template <class T>
-NBodySim::ThreeVector <T> NBodySim::Particle<T>::getPos(void){
+NBodySim::ThreeVector <T> NBodySim::Particle<T>::getPos(void) const{
 	return position;
 }
 
 template <class T>
-NBodySim::ThreeVector<T> NBodySim::Particle<T>::getVel(void){
+NBodySim::ThreeVector<T> NBodySim::Particle<T>::getVel(void) const{
 	return velocity;
 }
 
 template <class T>
-T NBodySim::Particle<T>::getMass(void){
+T NBodySim::Particle<T>::getMass(void) const{
 	return mass;
 }
 
 template <class T>
-std::string NBodySim::Particle<T>::getName(void){
-	return name;
+std::string NBodySim::Particle<T>::getName(void) const{
+	return NBodySim::NameTable::name(nameId);
+}
+
+template <class T>
+uint32_t NBodySim::Particle<T>::getNameId(void) const{
+	return nameId;
+}
+
+template <class T>
+T NBodySim::Particle<T>::getRadius(void) const{
+	return radius;
+}
+
+template <class T>
+size_t NBodySim::Particle<T>::getId(void) const{
+	return id;
 }
 
 template <class T>
@@ -122,7 +140,22 @@ void NBodySim::Particle<T>::setVelZ(T newVelocity){
 
 template <class T>
 void NBodySim::Particle<T>::setName(std::string nameIn){
-	name = nameIn;
+	nameId = NBodySim::NameTable::intern(nameIn);
+}
+
+template <class T>
+void NBodySim::Particle<T>::setNameId(uint32_t newNameId){
+	nameId = newNameId;
+}
+
+template <class T>
+void NBodySim::Particle<T>::setRadius(T newRadius){
+	radius = newRadius;
+}
+
+template <class T>
+void NBodySim::Particle<T>::setId(size_t newId){
+	id = newId;
 }
 
 template class NBodySim::Particle<NBodySim::FloatingType>;
@@ -96,7 +96,7 @@ void NBodySim::ParticlePlotter<T>::setAngle(T az, T el){
 }
 
 template <class T>
-boost::numeric::ublas::vector<T> NBodySim::ParticlePlotter<T>::calculateProjection(NBodySim::Particle<T> particle){
+boost::numeric::ublas::vector<T> NBodySim::ParticlePlotter<T>::calculateProjection(const NBodySim::Particle<T> & particle){
 	boost::numeric::ublas::vector<NBodySim::FloatingType> particlePoints(3);
 	boost::numeric::ublas::vector<NBodySim::FloatingType> projectedPoints(3);
 	boost::numeric::ublas::vector<NBodySim::FloatingType> returnVal(2);
@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "SnapshotFile.h"
+
+template <class T>
+NBodySim::SnapshotFile<T>::SnapshotFile(void){
+	particleCount = 0;
+	step = 0;
+	time = 0;
+	G = 0;
+	mapping = NULL;
+	mappingLength = 0;
+}
+
+template <class T>
+NBodySim::SnapshotFile<T>::~SnapshotFile(void){
+#if defined(__unix__) || defined(__APPLE__)
+	if(mapping != NULL){
+		munmap(mapping, mappingLength);
+	}
+#endif
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::write(const std::string & fileName, const std::vector<NBodySim::Particle<T> > & particles, size_t step, T time, T G){
+	std::ofstream out(fileName.c_str(), std::ios::binary | std::ios::trunc);
+	NBodySim::SnapshotFileSpace::error result;
+
+	if(!out){
+		return NBodySim::SnapshotFileSpace::COULD_NOT_OPEN;
+	}
+	result = write([&out](const char * data, size_t length){
+		out.write(data, length);
+		return static_cast<bool>(out);
+	}, particles, step, time, G);
+	out.close();
+	return (result == NBodySim::SnapshotFileSpace::SUCCESS && !out) ? NBodySim::SnapshotFileSpace::COULD_NOT_WRITE : result;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::write(sinkFunction sink, const std::vector<NBodySim::Particle<T> > & particles, size_t step, T time, T G){
+	const char * names[] = {"posX", "posY", "posZ", "velX", "velY", "velZ", "mass", "radius", "id", "nameOffsets", "nameData"};
+	const size_t numColumns = sizeof(names) / sizeof(names[0]);
+	const size_t numFloatColumns = 8;
+	const size_t count = particles.size();
+	std::vector<uint64_t> nameOffsets(count + 1, 0);
+	std::vector<double> values(count);
+	std::vector<uint64_t> ids(count);
+	std::vector<char> header;
+	uint64_t offsets[numColumns];
+	uint64_t lengths[numColumns];
+	uint64_t end;
+	size_t at = 0;
+	bool written;
+	static const char padding[NBodySim::SnapshotFileSpace::columnAlignment] = {};
+
+	// Lay the columns out on page boundaries after the header
+	std::vector<std::string> particleNames(count);
+	for(size_t i = 0; i < count; i++){
+		particleNames[i] = particles[i].getName();
+		nameOffsets[i + 1] = nameOffsets[i] + particleNames[i].length();
+	}
+	for(size_t c = 0; c < numColumns; c++){
+		lengths[c] = c == numColumns - 1 ? nameOffsets[count] : (c == numColumns - 2 ? count + 1 : count) * sizeof(uint64_t);
+	}
+	end = NBodySim::SnapshotFileSpace::headerLength + numColumns * NBodySim::SnapshotFileSpace::columnEntryLength;
+	for(size_t c = 0; c < numColumns; c++){
+		offsets[c] = (end + NBodySim::SnapshotFileSpace::columnAlignment - 1) / NBodySim::SnapshotFileSpace::columnAlignment * NBodySim::SnapshotFileSpace::columnAlignment;
+		end = offsets[c] + lengths[c];
+	}
+
+	// The fixed header and the column table
+	header.assign(offsets[0], 0);
+	uint64_t count64 = count;
+	uint64_t step64 = step;
+	double time64 = time;
+	double G64 = G;
+	uint32_t numColumns32 = numColumns;
+	std::memcpy(&header[0], NBodySim::SnapshotFileSpace::magic, NBodySim::SnapshotFileSpace::magicLength);
+	std::memcpy(&header[8], &NBodySim::SnapshotFileSpace::byteOrderMark, sizeof(uint32_t));
+	std::memcpy(&header[12], &NBodySim::SnapshotFileSpace::version, sizeof(uint32_t));
+	std::memcpy(&header[16], &count64, sizeof(uint64_t));
+	std::memcpy(&header[24], &step64, sizeof(uint64_t));
+	std::memcpy(&header[32], &time64, sizeof(double));
+	std::memcpy(&header[40], &G64, sizeof(double));
+	std::memcpy(&header[48], &numColumns32, sizeof(uint32_t));
+	for(size_t c = 0; c < numColumns; c++){
+		char * entry = &header[NBodySim::SnapshotFileSpace::headerLength + c * NBodySim::SnapshotFileSpace::columnEntryLength];
+		uint32_t type = c < numFloatColumns ? NBodySim::SnapshotFileSpace::FLOAT64 : (c == numColumns - 1 ? NBodySim::SnapshotFileSpace::BYTES : NBodySim::SnapshotFileSpace::UINT64);
+		uint32_t width = type == NBodySim::SnapshotFileSpace::BYTES ? 1 : 8;
+		std::strncpy(entry, names[c], NBodySim::SnapshotFileSpace::columnNameLength - 1);
+		std::memcpy(entry + 24, &type, sizeof(uint32_t));
+		std::memcpy(entry + 28, &width, sizeof(uint32_t));
+		std::memcpy(entry + 32, &offsets[c], sizeof(uint64_t));
+		std::memcpy(entry + 40, &lengths[c], sizeof(uint64_t));
+	}
+	written = sink(&header[0], header.size());
+	at = header.size();
+
+	// Every column in turn, padded to the start of the next
+	for(size_t c = 0; c < numColumns && written; c++){
+		if(offsets[c] > at){
+			written = sink(padding, offsets[c] - at);
+		}
+		if(c < numFloatColumns){
+			for(size_t i = 0; i < count; i++){
+				NBodySim::ThreeVector<T> position = particles[i].getPos();
+				NBodySim::ThreeVector<T> velocity = particles[i].getVel();
+				switch(c){
+					case 0: values[i] = position.x; break;
+					case 1: values[i] = position.y; break;
+					case 2: values[i] = position.z; break;
+					case 3: values[i] = velocity.x; break;
+					case 4: values[i] = velocity.y; break;
+					case 5: values[i] = velocity.z; break;
+					case 6: values[i] = particles[i].getMass(); break;
+					default: values[i] = particles[i].getRadius(); break;
+				}
+			}
+			written = written && sink(reinterpret_cast<const char *>(values.data()), lengths[c]);
+		}
+		else if(c == numFloatColumns){
+			for(size_t i = 0; i < count; i++){
+				ids[i] = particles[i].getId();
+			}
+			written = written && sink(reinterpret_cast<const char *>(ids.data()), lengths[c]);
+		}
+		else if(c == numColumns - 2){
+			written = written && sink(reinterpret_cast<const char *>(nameOffsets.data()), lengths[c]);
+		}
+		else{
+			for(size_t i = 0; i < count && written; i++){
+				written = sink(particleNames[i].data(), particleNames[i].length());
+			}
+		}
+		at = offsets[c] + lengths[c];
+	}
+	return written ? NBodySim::SnapshotFileSpace::SUCCESS : NBodySim::SnapshotFileSpace::COULD_NOT_WRITE;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::open(const std::string & fileNameIn){
+	char header[NBodySim::SnapshotFileSpace::headerLength];
+	uint32_t byteOrder;
+	uint32_t fileVersion;
+	uint64_t count64;
+	uint64_t step64;
+	double time64;
+	double G64;
+	uint32_t numColumns;
+	std::streamoff fileLength;
+
+	if(file.is_open()){
+		file.close();
+	}
+	columns.clear();
+	file.open(fileNameIn.c_str(), std::ios::binary);
+	if(!file){
+		return NBodySim::SnapshotFileSpace::COULD_NOT_OPEN;
+	}
+	fileName = fileNameIn;
+	file.seekg(0, std::ios::end);
+	fileLength = file.tellg();
+	file.seekg(0, std::ios::beg);
+	if(!file.read(header, sizeof(header)) || std::memcmp(header, NBodySim::SnapshotFileSpace::magic, NBodySim::SnapshotFileSpace::magicLength) != 0){
+		return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+	}
+	std::memcpy(&byteOrder, &header[8], sizeof(uint32_t));
+	std::memcpy(&fileVersion, &header[12], sizeof(uint32_t));
+	if(byteOrder != NBodySim::SnapshotFileSpace::byteOrderMark || fileVersion > NBodySim::SnapshotFileSpace::version){
+		return NBodySim::SnapshotFileSpace::UNSUPPORTED;
+	}
+	std::memcpy(&count64, &header[16], sizeof(uint64_t));
+	std::memcpy(&step64, &header[24], sizeof(uint64_t));
+	std::memcpy(&time64, &header[32], sizeof(double));
+	std::memcpy(&G64, &header[40], sizeof(double));
+	std::memcpy(&numColumns, &header[48], sizeof(uint32_t));
+
+	// Read the column table, a column running past the end of the file means the file was cut short
+	for(uint32_t c = 0; c < numColumns; c++){
+		char entry[NBodySim::SnapshotFileSpace::columnEntryLength];
+		Column column;
+		if(!file.read(entry, sizeof(entry))){
+			columns.clear();
+			return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+		}
+		entry[NBodySim::SnapshotFileSpace::columnNameLength - 1] = '\0';
+		column.name = entry;
+		std::memcpy(&column.type, entry + 24, sizeof(uint32_t));
+		std::memcpy(&column.width, entry + 28, sizeof(uint32_t));
+		std::memcpy(&column.offset, entry + 32, sizeof(uint64_t));
+		std::memcpy(&column.length, entry + 40, sizeof(uint64_t));
+		if(column.offset + column.length > static_cast<uint64_t>(fileLength)){
+			columns.clear();
+			return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+		}
+		columns.push_back(column);
+	}
+	particleCount = count64;
+	step = step64;
+	time = time64;
+	G = G64;
+	return NBodySim::SnapshotFileSpace::SUCCESS;
+}
+
+template <class T>
+size_t NBodySim::SnapshotFile<T>::numParticles(void){
+	return particleCount;
+}
+
+template <class T>
+size_t NBodySim::SnapshotFile<T>::getStep(void){
+	return step;
+}
+
+template <class T>
+T NBodySim::SnapshotFile<T>::getTime(void){
+	return time;
+}
+
+template <class T>
+T NBodySim::SnapshotFile<T>::getGravitation(void){
+	return G;
+}
+
+template <class T>
+std::vector<std::string> NBodySim::SnapshotFile<T>::columnNames(void){
+	std::vector<std::string> names;
+	for(size_t c = 0; c < columns.size(); c++){
+		names.push_back(columns[c].name);
+	}
+	return names;
+}
+
+template <class T>
+const typename NBodySim::SnapshotFile<T>::Column * NBodySim::SnapshotFile<T>::find(const std::string & name, NBodySim::SnapshotFileSpace::columnType type){
+	for(size_t c = 0; c < columns.size(); c++){
+		if(columns[c].name == name && columns[c].type == static_cast<uint32_t>(type)){
+			return &columns[c];
+		}
+	}
+	return NULL;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::readRange(const Column * column, size_t first, size_t count, void * out){
+	if(first > particleCount || count > particleCount - first){
+		return NBodySim::SnapshotFileSpace::OUT_OF_RANGE;
+	}
+	if(count == 0){
+		return NBodySim::SnapshotFileSpace::SUCCESS;
+	}
+	file.clear();
+	file.seekg(column->offset + first * column->width);
+	if(!file.read(static_cast<char *>(out), count * column->width)){
+		return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+	}
+	return NBodySim::SnapshotFileSpace::SUCCESS;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::readColumn(const std::string & name, size_t first, size_t count, std::vector<T> & out){
+	const Column * column = find(name, NBodySim::SnapshotFileSpace::FLOAT64);
+	std::vector<double> values;
+	NBodySim::SnapshotFileSpace::error result;
+
+	if(column == NULL){
+		return NBodySim::SnapshotFileSpace::NO_COLUMN;
+	}
+	values.resize(count);
+	result = readRange(column, first, count, values.data());
+	if(result == NBodySim::SnapshotFileSpace::SUCCESS){
+		out.assign(values.begin(), values.end());
+	}
+	return result;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::readNames(size_t first, size_t count, std::vector<std::string> & out){
+	const Column * offsetColumn = find("nameOffsets", NBodySim::SnapshotFileSpace::UINT64);
+	const Column * dataColumn = find("nameData", NBodySim::SnapshotFileSpace::BYTES);
+	std::vector<uint64_t> offsets(count + 1);
+	std::vector<char> data;
+	NBodySim::SnapshotFileSpace::error result;
+
+	if(offsetColumn == NULL || dataColumn == NULL){
+		return NBodySim::SnapshotFileSpace::NO_COLUMN;
+	}
+	if(first > particleCount || count > particleCount - first){
+		return NBodySim::SnapshotFileSpace::OUT_OF_RANGE;
+	}
+
+	// The offsets of the range and of the name after it bound the bytes to read
+	file.clear();
+	file.seekg(offsetColumn->offset + first * sizeof(uint64_t));
+	if(!file.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(uint64_t))){
+		return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+	}
+	if(offsets[count] < offsets[0] || offsets[count] > dataColumn->length){
+		return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+	}
+	data.resize(offsets[count] - offsets[0]);
+	result = NBodySim::SnapshotFileSpace::SUCCESS;
+	if(data.size() > 0){
+		file.seekg(dataColumn->offset + offsets[0]);
+		if(!file.read(data.data(), data.size())){
+			result = NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+		}
+	}
+	if(result == NBodySim::SnapshotFileSpace::SUCCESS){
+		out.resize(count);
+		for(size_t i = 0; i < count; i++){
+			if(offsets[i + 1] < offsets[i]){
+				return NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT;
+			}
+			out[i].assign(data.data() + (offsets[i] - offsets[0]), offsets[i + 1] - offsets[i]);
+		}
+	}
+	return result;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::readParticles(size_t first, size_t count, std::vector<NBodySim::Particle<T> > & out){
+	const char * names[] = {"posX", "posY", "posZ", "velX", "velY", "velZ", "mass", "radius"};
+	const size_t numFloatColumns = sizeof(names) / sizeof(names[0]);
+	std::vector<T> values[numFloatColumns];
+	std::vector<std::string> particleNames;
+	NBodySim::SnapshotFileSpace::error result = NBodySim::SnapshotFileSpace::SUCCESS;
+
+	for(size_t c = 0; c < numFloatColumns && result == NBodySim::SnapshotFileSpace::SUCCESS; c++){
+		result = readColumn(names[c], first, count, values[c]);
+	}
+	if(result == NBodySim::SnapshotFileSpace::SUCCESS){
+		result = readNames(first, count, particleNames);
+	}
+	if(result != NBodySim::SnapshotFileSpace::SUCCESS){
+		return result;
+	}
+	out.clear();
+	out.reserve(count);
+	for(size_t i = 0; i < count; i++){
+		out.push_back(NBodySim::Particle<T>(values[0][i], values[1][i], values[2][i], values[3][i], values[4][i], values[5][i], values[6][i], particleNames[i]));
+		out.back().setRadius(values[7][i]);
+		out.back().setId(first + i);
+	}
+	return NBodySim::SnapshotFileSpace::SUCCESS;
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotFile<T>::map(void){
+#if defined(__unix__) || defined(__APPLE__)
+	struct stat status;
+	int descriptor;
+
+	if(mapping != NULL){
+		return NBodySim::SnapshotFileSpace::SUCCESS;
+	}
+	if(columns.empty()){
+		return NBodySim::SnapshotFileSpace::COULD_NOT_MAP;
+	}
+	descriptor = ::open(fileName.c_str(), O_RDONLY);
+	if(descriptor < 0){
+		return NBodySim::SnapshotFileSpace::COULD_NOT_MAP;
+	}
+	if(fstat(descriptor, &status) != 0 || status.st_size == 0){
+		close(descriptor);
+		return NBodySim::SnapshotFileSpace::COULD_NOT_MAP;
+	}
+	mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if(mapping == MAP_FAILED){
+		mapping = NULL;
+		return NBodySim::SnapshotFileSpace::COULD_NOT_MAP;
+	}
+	mappingLength = status.st_size;
+	return NBodySim::SnapshotFileSpace::SUCCESS;
+#else
+	return NBodySim::SnapshotFileSpace::COULD_NOT_MAP;
+#endif
+}
+
+template <class T>
+const double * NBodySim::SnapshotFile<T>::mappedColumn(const std::string & name){
+	const Column * column = find(name, NBodySim::SnapshotFileSpace::FLOAT64);
+	if(mapping == NULL || column == NULL || column->offset + column->length > mappingLength){
+		return NULL;
+	}
+	return reinterpret_cast<const double *>(static_cast<const char *>(mapping) + column->offset);
+}
+
+template <class T>
+std::string NBodySim::SnapshotFile<T>::errorToString(NBodySim::SnapshotFileSpace::error errorCode){
+	switch(errorCode){
+		case NBodySim::SnapshotFileSpace::SUCCESS:
+			return "Success";
+		case NBodySim::SnapshotFileSpace::COULD_NOT_OPEN:
+			return "Could not open the snapshot file";
+		case NBodySim::SnapshotFileSpace::COULD_NOT_WRITE:
+			return "Could not write the whole snapshot file";
+		case NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT:
+			return "The file is not a snapshot file or is cut short";
+		case NBodySim::SnapshotFileSpace::UNSUPPORTED:
+			return "The snapshot file was written by a machine of another byte order or a newer version";
+		case NBodySim::SnapshotFileSpace::NO_COLUMN:
+			return "The snapshot file has no such column";
+		case NBodySim::SnapshotFileSpace::OUT_OF_RANGE:
+			return "The particles asked for are past the end of the snapshot";
+		case NBodySim::SnapshotFileSpace::COULD_NOT_MAP:
+			return "Could not map the snapshot file";
+		default:
+			return "Unknown error";
+	}
+}
+
+template class NBodySim::SnapshotFile<NBodySim::FloatingType>;
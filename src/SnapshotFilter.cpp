@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "SnapshotFilter.h"
+
+template <class T>
+NBodySim::SnapshotFilter<T>::SnapshotFilter(void){
+	region = NBodySim::SnapshotFilterSpace::NO_REGION;
+	low.x = low.y = low.z = 0;
+	high = low;
+	center = low;
+	radius = 0;
+	stride = 1;
+	fraction = 1;
+	seed = 0;
+	cellsPerAxis = 1;
+	indexedParticles = NULL;
+	indexedLength = 0;
+	for(unsigned axis = 0; axis < 3; axis++){
+		gridLow[axis] = 0;
+		cellSize[axis] = 1;
+	}
+}
+
+template <class T>
+NBodySim::SnapshotFilter<T>::~SnapshotFilter(void){
+	// Do nothing
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::setBox(NBodySim::ThreeVector<T> lowIn, NBodySim::ThreeVector<T> highIn){
+	region = NBodySim::SnapshotFilterSpace::BOX;
+	low = lowIn;
+	high = highIn;
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::setSphere(NBodySim::ThreeVector<T> centerIn, T radiusIn){
+	region = NBodySim::SnapshotFilterSpace::SPHERE;
+	center = centerIn;
+	radius = radiusIn;
+	// The box bounding the sphere limits the cells that are visited
+	low.x = center.x - radius;
+	low.y = center.y - radius;
+	low.z = center.z - radius;
+	high.x = center.x + radius;
+	high.y = center.y + radius;
+	high.z = center.z + radius;
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::setStride(size_t k){
+	stride = std::max<size_t>(k, 1);
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::setFraction(double fractionIn, uint64_t seedIn){
+	fraction = fractionIn;
+	seed = seedIn;
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::setNamePattern(const std::string & pattern){
+	namePattern = pattern;
+	nameMatches.clear();
+}
+
+template <class T>
+bool NBodySim::SnapshotFilter<T>::selectsAll(void){
+	return region == NBodySim::SnapshotFilterSpace::NO_REGION && stride == 1 && fraction >= 1 && namePattern.empty();
+}
+
+template <class T>
+double NBodySim::SnapshotFilter<T>::hashIndex(size_t index){
+	// splitmix64, whose output bits are all well mixed even for consecutive inputs
+	uint64_t z = seed + (static_cast<uint64_t>(index) + 1) * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z = z ^ (z >> 31);
+	return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+template <class T>
+bool NBodySim::SnapshotFilter<T>::passes(const std::vector<NBodySim::Particle<T> > & particles, size_t index){
+	if(fraction < 1 && hashIndex(index) >= fraction){
+		return false;
+	}
+	if(!namePattern.empty()){
+		uint32_t nameId = particles[index].getNameId();
+		std::unordered_map<uint32_t, bool>::iterator found = nameMatches.find(nameId);
+		if(found == nameMatches.end()){
+			found = nameMatches.emplace(nameId, matchName(particles[index].getName(), namePattern)).first;
+		}
+		return found->second;
+	}
+	return true;
+}
+
+template <class T>
+bool NBodySim::SnapshotFilter<T>::inRegion(const NBodySim::ThreeVector<T> & position){
+	T dx;
+	T dy;
+	T dz;
+
+	if(region == NBodySim::SnapshotFilterSpace::BOX){
+		return position.x >= low.x && position.x <= high.x && position.y >= low.y && position.y <= high.y && position.z >= low.z && position.z <= high.z;
+	}
+	dx = position.x - center.x;
+	dy = position.y - center.y;
+	dz = position.z - center.z;
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+template <class T>
+size_t NBodySim::SnapshotFilter<T>::cellIndex(unsigned axis, T coordinate){
+	T cell = (coordinate - gridLow[axis]) / cellSize[axis];
+	if(!(cell > 0)){
+		return 0;
+	}
+	return std::min(static_cast<size_t>(std::min(cell, static_cast<T>(cellsPerAxis))), cellsPerAxis - 1);
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::buildIndex(const std::vector<NBodySim::Particle<T> > & particles){
+	const size_t unplaced = std::numeric_limits<size_t>::max();
+	const size_t numParticles = particles.size();
+	T gridHigh[3];
+	T coordinates[3];
+	size_t numCells;
+	size_t cell;
+
+	for(unsigned axis = 0; axis < 3; axis++){
+		gridLow[axis] = std::numeric_limits<T>::max();
+		gridHigh[axis] = std::numeric_limits<T>::lowest();
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		NBodySim::ThreeVector<T> position = particles[i].getPos();
+		coordinates[0] = position.x;
+		coordinates[1] = position.y;
+		coordinates[2] = position.z;
+		for(unsigned axis = 0; axis < 3; axis++){
+			if(std::isfinite(coordinates[axis])){
+				gridLow[axis] = std::min(gridLow[axis], coordinates[axis]);
+				gridHigh[axis] = std::max(gridHigh[axis], coordinates[axis]);
+			}
+		}
+	}
+	cellsPerAxis = static_cast<size_t>(std::cbrt(static_cast<double>(numParticles / NBodySim::SnapshotFilterSpace::particlesPerCell)));
+	cellsPerAxis = std::min(std::max<size_t>(cellsPerAxis, 1), NBodySim::SnapshotFilterSpace::maxCellsPerAxis);
+	for(unsigned axis = 0; axis < 3; axis++){
+		cellSize[axis] = (gridHigh[axis] > gridLow[axis]) ? (gridHigh[axis] - gridLow[axis]) / cellsPerAxis : 1;
+	}
+	numCells = cellsPerAxis * cellsPerAxis * cellsPerAxis;
+
+	// Count the particles of every cell, then place them, a particle with a coordinate that is not finite is in no cell
+	cellStart.assign(numCells + 1, 0);
+	cellOf.resize(numParticles);
+	cellBounds.resize(numCells * 6);
+	for(cell = 0; cell < numCells; cell++){
+		for(unsigned axis = 0; axis < 3; axis++){
+			cellBounds[6 * cell + axis] = std::numeric_limits<T>::max();
+			cellBounds[6 * cell + 3 + axis] = std::numeric_limits<T>::lowest();
+		}
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		NBodySim::ThreeVector<T> position = particles[i].getPos();
+		coordinates[0] = position.x;
+		coordinates[1] = position.y;
+		coordinates[2] = position.z;
+		if(!std::isfinite(coordinates[0]) || !std::isfinite(coordinates[1]) || !std::isfinite(coordinates[2])){
+			cellOf[i] = unplaced;
+			continue;
+		}
+		cell = (cellIndex(2, coordinates[2]) * cellsPerAxis + cellIndex(1, coordinates[1])) * cellsPerAxis + cellIndex(0, coordinates[0]);
+		cellOf[i] = cell;
+		cellStart[cell + 1]++;
+		for(unsigned axis = 0; axis < 3; axis++){
+			cellBounds[6 * cell + axis] = std::min(cellBounds[6 * cell + axis], coordinates[axis]);
+			cellBounds[6 * cell + 3 + axis] = std::max(cellBounds[6 * cell + 3 + axis], coordinates[axis]);
+		}
+	}
+	for(cell = 0; cell < numCells; cell++){
+		cellStart[cell + 1] += cellStart[cell];
+	}
+	cellParticles.resize(cellStart[numCells]);
+	std::vector<size_t> next(cellStart.begin(), cellStart.end() - 1);
+	for(size_t i = 0; i < numParticles; i++){
+		if(cellOf[i] != unplaced){
+			cellParticles[next[cellOf[i]]++] = i;
+		}
+	}
+	indexedParticles = particles.data();
+	indexedLength = numParticles;
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::dropIndex(void){
+	indexedParticles = NULL;
+	indexedLength = 0;
+}
+
+template <class T>
+int NBodySim::SnapshotFilter<T>::cellOverlap(size_t cell){
+	const T * cellLow = &cellBounds[6 * cell];
+	const T * cellHigh = &cellBounds[6 * cell + 3];
+	T regionLow[3] = {low.x, low.y, low.z};
+	T regionHigh[3] = {high.x, high.y, high.z};
+	T centerCoordinates[3] = {center.x, center.y, center.z};
+	T nearest = 0;
+	T farthest = 0;
+	T distance;
+	bool inside = true;
+
+	for(unsigned axis = 0; axis < 3; axis++){
+		if(cellHigh[axis] < regionLow[axis] || cellLow[axis] > regionHigh[axis]){
+			return 0;
+		}
+		inside = inside && cellLow[axis] >= regionLow[axis] && cellHigh[axis] <= regionHigh[axis];
+	}
+	if(region == NBodySim::SnapshotFilterSpace::BOX){
+		return inside ? 2 : 1;
+	}
+	// The nearest and farthest points of the box around the cell's particles decide for a sphere
+	for(unsigned axis = 0; axis < 3; axis++){
+		distance = std::max(std::max(cellLow[axis] - centerCoordinates[axis], centerCoordinates[axis] - cellHigh[axis]), static_cast<T>(0));
+		nearest += distance * distance;
+		distance = std::max(std::abs(cellLow[axis] - centerCoordinates[axis]), std::abs(cellHigh[axis] - centerCoordinates[axis]));
+		farthest += distance * distance;
+	}
+	if(nearest > radius * radius){
+		return 0;
+	}
+	return (farthest <= radius * radius) ? 2 : 1;
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::select(const std::vector<NBodySim::Particle<T> > & particles, std::vector<size_t> & selected){
+	size_t first[3];
+	size_t last[3];
+	T regionLow[3] = {low.x, low.y, low.z};
+	T regionHigh[3] = {high.x, high.y, high.z};
+	size_t cell;
+	size_t index;
+	int overlap;
+
+	selected.clear();
+	if(region == NBodySim::SnapshotFilterSpace::NO_REGION || particles.data() != indexedParticles || particles.size() != indexedLength){
+		for(index = 0; index < particles.size(); index += stride){
+			if((region == NBodySim::SnapshotFilterSpace::NO_REGION || inRegion(particles[index].getPos())) && passes(particles, index)){
+				selected.push_back(index);
+			}
+		}
+		return;
+	}
+
+	for(unsigned axis = 0; axis < 3; axis++){
+		if(!(regionHigh[axis] >= regionLow[axis])){
+			return;
+		}
+		first[axis] = cellIndex(axis, regionLow[axis]);
+		last[axis] = cellIndex(axis, regionHigh[axis]);
+	}
+	for(size_t z = first[2]; z <= last[2]; z++){
+		for(size_t y = first[1]; y <= last[1]; y++){
+			for(size_t x = first[0]; x <= last[0]; x++){
+				cell = (z * cellsPerAxis + y) * cellsPerAxis + x;
+				if(cellStart[cell] == cellStart[cell + 1] || (overlap = cellOverlap(cell)) == 0){
+					continue;
+				}
+				for(size_t k = cellStart[cell]; k < cellStart[cell + 1]; k++){
+					index = cellParticles[k];
+					if(index % stride != 0 || (overlap == 1 && !inRegion(particles[index].getPos())) || !passes(particles, index)){
+						continue;
+					}
+					selected.push_back(index);
+				}
+			}
+		}
+	}
+	std::sort(selected.begin(), selected.end());
+}
+
+template <class T>
+void NBodySim::SnapshotFilter<T>::apply(const std::vector<NBodySim::Particle<T> > & particles, std::vector<NBodySim::Particle<T> > & out){
+	std::vector<size_t> selected;
+
+	select(particles, selected);
+	// The next snapshot may arrive in the same buffer, where the grid would find the particles of this one
+	dropIndex();
+	out.resize(selected.size());
+	for(size_t i = 0; i < selected.size(); i++){
+		out[i] = particles[selected[i]];
+	}
+}
+
+template <class T>
+bool NBodySim::SnapshotFilter<T>::matchName(const std::string & name, const std::string & pattern){
+	size_t n = 0;
+	size_t p = 0;
+	size_t starPattern = std::string::npos;
+	size_t starName = 0;
+
+	// Greedy matching, going back to the last * on a mismatch, which is enough as * matches any run
+	while(n < name.size()){
+		if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])){
+			n++;
+			p++;
+		}
+		else if(p < pattern.size() && pattern[p] == '*'){
+			starPattern = p++;
+			starName = n;
+		}
+		else if(starPattern != std::string::npos){
+			p = starPattern + 1;
+			n = ++starName;
+		}
+		else{
+			return false;
+		}
+	}
+	while(p < pattern.size() && pattern[p] == '*'){
+		p++;
+	}
+	return p == pattern.size();
+}
+
+template class NBodySim::SnapshotFilter<NBodySim::FloatingType>;
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <boost/thread.hpp>
+#include <boost/bind/bind.hpp>
+
+#include "SnapshotWriter.h"
+
+template <class T>
+NBodySim::SnapshotWriter<T>::SnapshotWriter(size_t bufferLengthIn, size_t numBuffers){
+	const size_t block = NBodySim::SnapshotWriterSpace::blockLength;
+	uintptr_t base;
+
+	bufferLength = std::max<size_t>(1, (bufferLengthIn + block - 1) / block) * block;
+	numBuffers = std::max<size_t>(2, numBuffers);
+	storage.resize(numBuffers * bufferLength + block);
+	base = (reinterpret_cast<uintptr_t>(storage.data()) + block - 1) / block * block;
+	for(size_t i = 0; i < numBuffers; i++){
+		buffers.push_back(reinterpret_cast<char *>(base) + i * bufferLength);
+		freeBuffers.push_back(i);
+	}
+	closing = false;
+	failed = false;
+	direct = false;
+	ioThread = boost::thread(boost::bind(&NBodySim::SnapshotWriter<T>::ioLoop, this));
+}
+
+template <class T>
+NBodySim::SnapshotWriter<T>::~SnapshotWriter(void){
+	{
+		boost::unique_lock<boost::mutex> lock(writerMutex);
+		closing = true;
+	}
+	submitted.notify_all();
+	ioThread.join();
+}
+
+template <class T>
+void NBodySim::SnapshotWriter<T>::ioLoop(void){
+	Request request;
+	bool skip;
+
+	while(true){
+		{
+			boost::unique_lock<boost::mutex> lock(writerMutex);
+			while(!closing && requests.empty()){
+				submitted.wait(lock);
+			}
+			if(requests.empty()){
+				return;
+			}
+			request = requests.front();
+			requests.pop_front();
+			// Once a buffer of a file fails the rest of it is not worth writing
+			skip = failed;
+		}
+#if defined(__unix__) || defined(__APPLE__)
+		const char * data = buffers[request.buffer];
+		size_t done = 0;
+		while(!skip && done < request.length){
+			ssize_t written = ::pwrite(request.file, data + done, request.length - done, request.offset + done);
+			if(written > 0){
+				done += written;
+			}
+			else if(written < 0 && errno == EINTR){
+				continue;
+			}
+#if defined(__linux__)
+			else if(written < 0 && errno == EINVAL && (::fcntl(request.file, F_GETFL) & O_DIRECT)){
+				// Some file systems open files for direct writes and then refuse them, so go through the page cache
+				::fcntl(request.file, F_SETFL, ::fcntl(request.file, F_GETFL) & ~O_DIRECT);
+				boost::unique_lock<boost::mutex> lock(writerMutex);
+				direct = false;
+			}
+#endif
+			else{
+				skip = true;
+			}
+		}
+#else
+		skip = true;
+#endif
+		{
+			boost::unique_lock<boost::mutex> lock(writerMutex);
+			failed = failed || skip;
+			freeBuffers.push_back(request.buffer);
+		}
+		completed.notify_all();
+	}
+}
+
+template <class T>
+size_t NBodySim::SnapshotWriter<T>::acquire(void){
+	boost::unique_lock<boost::mutex> lock(writerMutex);
+	size_t buffer;
+
+	while(freeBuffers.empty()){
+		completed.wait(lock);
+	}
+	buffer = freeBuffers.front();
+	freeBuffers.pop_front();
+	return buffer;
+}
+
+template <class T>
+void NBodySim::SnapshotWriter<T>::submit(const Request & request){
+	{
+		boost::unique_lock<boost::mutex> lock(writerMutex);
+		requests.push_back(request);
+	}
+	submitted.notify_all();
+}
+
+template <class T>
+void NBodySim::SnapshotWriter<T>::drain(void){
+	boost::unique_lock<boost::mutex> lock(writerMutex);
+
+	while(freeBuffers.size() < buffers.size()){
+		completed.wait(lock);
+	}
+}
+
+template <class T>
+NBodySim::SnapshotFileSpace::error NBodySim::SnapshotWriter<T>::write(const std::string & fileName, const std::vector<NBodySim::Particle<T> > & particles, size_t step, T time, T G){
+#if defined(__unix__) || defined(__APPLE__)
+	boost::unique_lock<boost::mutex> fileLock(fileMutex);
+	const size_t block = NBodySim::SnapshotWriterSpace::blockLength;
+	NBodySim::SnapshotFileSpace::error result;
+	Request request;
+	size_t filled = 0;
+	size_t offset = 0;
+	size_t length;
+	bool written;
+	bool directFile = false;
+	int file = -1;
+
+#if defined(__linux__)
+	file = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	directFile = file >= 0;
+#endif
+	if(file < 0){
+		file = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if(file < 0){
+		return NBodySim::SnapshotFileSpace::COULD_NOT_OPEN;
+	}
+#if defined(__APPLE__)
+	directFile = ::fcntl(file, F_NOCACHE, 1) == 0;
+#endif
+	{
+		boost::unique_lock<boost::mutex> lock(writerMutex);
+		failed = false;
+		direct = directFile;
+	}
+
+	// Fill the buffers in turn, handing each to the writer's thread as soon as it is full
+	request.file = file;
+	request.buffer = acquire();
+	result = NBodySim::SnapshotFile<T>::write([&](const char * data, size_t count){
+		size_t part;
+		while(count > 0){
+			part = std::min(count, bufferLength - filled);
+			std::memcpy(buffers[request.buffer] + filled, data, part);
+			filled += part;
+			data += part;
+			count -= part;
+			if(filled == bufferLength){
+				request.offset = offset;
+				request.length = filled;
+				submit(request);
+				offset += filled;
+				filled = 0;
+				request.buffer = acquire();
+			}
+		}
+		boost::unique_lock<boost::mutex> lock(writerMutex);
+		return !failed;
+	}, particles, step, time, G);
+
+	// A direct write must cover whole blocks, so the last buffer is padded and the file cut back afterwards
+	length = offset + filled;
+	if(filled > 0){
+		request.offset = offset;
+		request.length = (filled + block - 1) / block * block;
+		std::memset(buffers[request.buffer] + filled, 0, request.length - filled);
+		submit(request);
+	}
+	else{
+		boost::unique_lock<boost::mutex> lock(writerMutex);
+		freeBuffers.push_back(request.buffer);
+	}
+	drain();
+	{
+		boost::unique_lock<boost::mutex> lock(writerMutex);
+		written = !failed;
+		directFile = direct;
+	}
+	written = written && ::ftruncate(file, length) == 0;
+#if defined(__linux__)
+	// Pages written through the cache can only be dropped once they are on the disk
+	if(written && !directFile){
+		written = ::fdatasync(file) == 0;
+		::posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+	}
+#endif
+	written = ::close(file) == 0 && written;
+	if(result == NBodySim::SnapshotFileSpace::SUCCESS && !written){
+		result = NBodySim::SnapshotFileSpace::COULD_NOT_WRITE;
+	}
+	return result;
+#else
+	return NBodySim::SnapshotFile<T>::write(fileName, particles, step, time, G);
+#endif
+}
+
+template <class T>
+bool NBodySim::SnapshotWriter<T>::isDirect(void){
+	boost::unique_lock<boost::mutex> lock(writerMutex);
+
+	return direct;
+}
+
+template class NBodySim::SnapshotWriter<NBodySim::FloatingType>;
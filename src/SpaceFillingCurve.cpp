@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "TaskScheduler.h"
+#include "SpaceFillingCurve.h"
+
+template <class T>
+NBodySim::SpaceFillingCurve<T>::SpaceFillingCurve(void){
+
+}
+
+template <class T>
+NBodySim::SpaceFillingCurve<T>::~SpaceFillingCurve(void){
+
+}
+
+template <class T>
+uint64_t NBodySim::SpaceFillingCurve<T>::spread(uint32_t coordinate){
+	uint64_t bits = coordinate & 0x1fffff;
+
+	bits = (bits | bits << 32) & 0x1f00000000ffffULL;
+	bits = (bits | bits << 16) & 0x1f0000ff0000ffULL;
+	bits = (bits | bits << 8) & 0x100f00f00f00f00fULL;
+	bits = (bits | bits << 4) & 0x10c30c30c30c30c3ULL;
+	bits = (bits | bits << 2) & 0x1249249249249249ULL;
+	return bits;
+}
+
+template <class T>
+uint64_t NBodySim::SpaceFillingCurve<T>::key(uint32_t x, uint32_t y, uint32_t z, NBodySim::curveType curve){
+	uint32_t axes[3] = {x, y, z};
+	uint32_t flip;
+	uint32_t swap;
+
+	if(curve == NBodySim::HILBERT){
+		// Skilling's transform of the coordinates into the transposed Hilbert index, whose bits interleave like Morton's
+		for(uint32_t bit = 1u << (NBodySim::SpaceFillingCurveSpace::bitsPerAxis - 1); bit > 1; bit >>= 1){
+			for(unsigned axis = 0; axis < 3; axis++){
+				if(axes[axis] & bit){
+					axes[0] ^= bit - 1;
+				}
+				else{
+					swap = (axes[0] ^ axes[axis]) & (bit - 1);
+					axes[0] ^= swap;
+					axes[axis] ^= swap;
+				}
+			}
+		}
+		// Gray code
+		axes[1] ^= axes[0];
+		axes[2] ^= axes[1];
+		flip = 0;
+		for(uint32_t bit = 1u << (NBodySim::SpaceFillingCurveSpace::bitsPerAxis - 1); bit > 1; bit >>= 1){
+			if(axes[2] & bit){
+				flip ^= bit - 1;
+			}
+		}
+		for(unsigned axis = 0; axis < 3; axis++){
+			axes[axis] ^= flip;
+		}
+	}
+	return spread(axes[0]) << 2 | spread(axes[1]) << 1 | spread(axes[2]);
+}
+
+template <class T>
+void NBodySim::SpaceFillingCurve<T>::radixSort(NBodySim::TaskScheduler * scheduler){
+	const size_t numDigits = static_cast<size_t>(1) << NBodySim::SpaceFillingCurveSpace::radixBits;
+	const uint64_t mask = numDigits - 1;
+	size_t numKeys = keys.size();
+	size_t numBlocks = (numKeys + NBodySim::SpaceFillingCurveSpace::blockLength - 1) / NBodySim::SpaceFillingCurveSpace::blockLength;
+	unsigned shift;
+	size_t total;
+	size_t offset;
+	bool sorted;
+
+	keyBuffer.resize(numKeys);
+	indexBuffer.resize(numKeys);
+	counts.resize(numBlocks * numDigits);
+
+	// Each task is a run of whole blocks, a block is counted and scattered by one thread in index order, keeping the sort stable
+	auto forBlocks = [scheduler, numBlocks](const NBodySim::TaskScheduler::rangeFunction & body){
+		if(scheduler){
+			scheduler->parallelFor(0, numBlocks, 1, body);
+		}
+		else{
+			body(0, numBlocks);
+		}
+	};
+
+	for(shift = 0; shift < 3 * NBodySim::SpaceFillingCurveSpace::bitsPerAxis; shift += NBodySim::SpaceFillingCurveSpace::radixBits){
+		forBlocks([this, shift, mask, numDigits, numKeys](size_t first, size_t last){
+			for(size_t block = first; block < last; block++){
+				size_t * count = &counts[block * numDigits];
+				std::fill(count, count + numDigits, 0);
+				for(size_t i = block * NBodySim::SpaceFillingCurveSpace::blockLength; i < std::min((block + 1) * NBodySim::SpaceFillingCurveSpace::blockLength, numKeys); i++){
+					count[(keys[i] >> shift) & mask]++;
+				}
+			}
+		});
+
+		// Turn the counts into the first output position of every digit in every block, digit by digit then block by block
+		offset = 0;
+		sorted = false;
+		for(size_t digit = 0; digit < numDigits; digit++){
+			total = 0;
+			for(size_t block = 0; block < numBlocks; block++){
+				total += counts[block * numDigits + digit];
+				counts[block * numDigits + digit] = offset + total - counts[block * numDigits + digit];
+			}
+			// Every key has the same digit, the pass would not move anything
+			sorted = sorted || total == numKeys;
+			offset += total;
+		}
+		if(sorted){
+			continue;
+		}
+
+		forBlocks([this, shift, mask, numDigits, numKeys](size_t first, size_t last){
+			for(size_t block = first; block < last; block++){
+				size_t * position = &counts[block * numDigits];
+				for(size_t i = block * NBodySim::SpaceFillingCurveSpace::blockLength; i < std::min((block + 1) * NBodySim::SpaceFillingCurveSpace::blockLength, numKeys); i++){
+					size_t target = position[(keys[i] >> shift) & mask]++;
+					keyBuffer[target] = keys[i];
+					indexBuffer[target] = indices[i];
+				}
+			}
+		});
+		keys.swap(keyBuffer);
+		indices.swap(indexBuffer);
+	}
+}
+
+template <class T>
+void NBodySim::SpaceFillingCurve<T>::order(const std::vector<NBodySim::Particle<T> > & system, NBodySim::curveType curve, NBodySim::TaskScheduler * scheduler, std::vector<size_t> & permutation){
+	size_t numParticles = system.size();
+	const T numCells = static_cast<T>((static_cast<uint32_t>(1) << NBodySim::SpaceFillingCurveSpace::bitsPerAxis) - 1);
+	NBodySim::ThreeVector<T> minimum;
+	NBodySim::ThreeVector<T> maximum;
+	NBodySim::ThreeVector<T> position;
+	T extent;
+	T scale;
+
+	permutation.resize(numParticles);
+	if(numParticles == 0){
+		return;
+	}
+
+	// The bounding cube, so the cells are cubes and the curve keeps its locality along every axis
+	minimum = system[0].getPos();
+	maximum = minimum;
+	for(size_t i = 1; i < numParticles; i++){
+		position = system[i].getPos();
+		minimum.x = std::min(minimum.x, position.x);
+		minimum.y = std::min(minimum.y, position.y);
+		minimum.z = std::min(minimum.z, position.z);
+		maximum.x = std::max(maximum.x, position.x);
+		maximum.y = std::max(maximum.y, position.y);
+		maximum.z = std::max(maximum.z, position.z);
+	}
+	extent = std::max(maximum.x - minimum.x, std::max(maximum.y - minimum.y, maximum.z - minimum.z));
+	scale = (extent > 0) ? numCells / extent : 0;
+
+	keys.resize(numParticles);
+	indices.resize(numParticles);
+	for(size_t i = 0; i < numParticles; i++){
+		position = system[i].getPos();
+		keys[i] = key(static_cast<uint32_t>((position.x - minimum.x) * scale), static_cast<uint32_t>((position.y - minimum.y) * scale), static_cast<uint32_t>((position.z - minimum.z) * scale), curve);
+		indices[i] = i;
+	}
+	radixSort(scheduler);
+	std::copy(indices.begin(), indices.end(), permutation.begin());
+}
+
+template class NBodySim::SpaceFillingCurve<NBodySim::FloatingType>;
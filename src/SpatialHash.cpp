@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "SpatialHash.h"
+
+template <class T>
+NBodySim::SpatialHash<T>::SpatialHash(void){
+	cellSize = 0;
+	bucketMask = 0;
+}
+
+template <class T>
+NBodySim::SpatialHash<T>::~SpatialHash(void){
+
+}
+
+template <class T>
+T NBodySim::SpatialHash<T>::getCellSize(void){
+	return cellSize;
+}
+
+template <class T>
+int64_t NBodySim::SpatialHash<T>::cellOf(T position){
+	// 2^62 cells either way leaves room for the neighbouring cells, a position past them or not a number shares an end cell
+	const T limit = 4611686018427387904.0;
+	T cell = std::floor(position / cellSize);
+
+	if(!(cell > -limit)){
+		return static_cast<int64_t>(-limit);
+	}
+	return static_cast<int64_t>(std::min(cell, limit));
+}
+
+template <class T>
+size_t NBodySim::SpatialHash<T>::hashCell(int64_t x, int64_t y, int64_t z){
+	return static_cast<size_t>((static_cast<uint64_t>(x) * 73856093) ^ (static_cast<uint64_t>(y) * 19349663) ^ (static_cast<uint64_t>(z) * 83492791)) & bucketMask;
+}
+
+template <class T>
+size_t NBodySim::SpatialHash<T>::bucketBegin(size_t b){
+	return bucketStart[b];
+}
+
+template <class T>
+size_t NBodySim::SpatialHash<T>::bucketEnd(size_t b){
+	return bucketStart[b + 1];
+}
+
+template <class T>
+size_t NBodySim::SpatialHash<T>::particleAt(size_t k){
+	return sorted[k];
+}
+
+template <class T>
+void NBodySim::SpatialHash<T>::build(const std::vector<NBodySim::Particle<T> > & system, T cellSizeIn){
+	size_t numParticles = system.size();
+	size_t numBuckets = 1;
+
+	cellSize = cellSizeIn;
+	while(numBuckets < numParticles){
+		numBuckets *= 2;
+	}
+	bucketMask = numBuckets - 1;
+
+	// Counting sort of the particles by bucket
+	bucket.resize(numParticles);
+	sorted.resize(numParticles);
+	bucketStart.assign(numBuckets + 1, 0);
+	for(size_t i = 0; i < numParticles; i++){
+		bucket[i] = hashCell(cellOf(system[i].getPos().x), cellOf(system[i].getPos().y), cellOf(system[i].getPos().z));
+		bucketStart[bucket[i] + 1]++;
+	}
+	for(size_t i = 0; i < numBuckets; i++){
+		bucketStart[i + 1] += bucketStart[i];
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		sorted[bucketStart[bucket[i]]++] = i;
+	}
+	// Filling moved every start to the start of the next bucket, shift them back
+	for(size_t i = numBuckets; i > 0; i--){
+		bucketStart[i] = bucketStart[i - 1];
+	}
+	bucketStart[0] = 0;
+}
+
+template class NBodySim::SpatialHash<NBodySim::FloatingType>;
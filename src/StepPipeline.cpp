@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <algorithm>
+
+#include <boost/thread.hpp>
+#include <boost/bind/bind.hpp>
+
+#include "StepPipeline.h"
+
+template <class T>
+NBodySim::StepPipeline<T>::StepPipeline(NBodySim::NBodySystem<T> * systemIn, size_t intervalIn, size_t depth) :
+	buffers(std::max<size_t>(1, depth)),
+	pending(std::max<size_t>(1, depth), 0){
+	system = systemIn;
+	interval = std::max<size_t>(1, intervalIn);
+	stepCount = 0;
+	time = 0;
+	closing = false;
+	stalls = 0;
+	for(size_t slot = 0; slot < buffers.size(); slot++){
+		freeBuffers.push_back(slot);
+	}
+}
+
+template <class T>
+NBodySim::StepPipeline<T>::~StepPipeline(void){
+	flush();
+	{
+		boost::unique_lock<boost::mutex> lock(pipelineMutex);
+		closing = true;
+	}
+	published.notify_all();
+	stages.join_all();
+}
+
+template <class T>
+void NBodySim::StepPipeline<T>::addStage(stageFunction body, size_t stageInterval){
+	size_t stage;
+
+	{
+		boost::unique_lock<boost::mutex> lock(pipelineMutex);
+		stage = queues.size();
+		queues.resize(stage + 1);
+		intervals.push_back((stageInterval == 0) ? interval : stageInterval);
+	}
+	stages.create_thread(boost::bind(&NBodySim::StepPipeline<T>::stageLoop, this, stage, body));
+}
+
+template <class T>
+void NBodySim::StepPipeline<T>::stageLoop(size_t stage, stageFunction body){
+	size_t slot;
+
+	while(true){
+		{
+			boost::unique_lock<boost::mutex> lock(pipelineMutex);
+			while(!closing && queues[stage].empty()){
+				published.wait(lock);
+			}
+			if(queues[stage].empty()){
+				return;
+			}
+			slot = queues[stage].front();
+			queues[stage].pop_front();
+		}
+		// Only stages read a published buffer, so it is used without the lock
+		body(buffers[slot]);
+		{
+			boost::unique_lock<boost::mutex> lock(pipelineMutex);
+			pending[slot]--;
+			if(pending[slot] == 0){
+				freeBuffers.push_back(slot);
+				released.notify_all();
+			}
+		}
+	}
+}
+
+template <class T>
+void NBodySim::StepPipeline<T>::publish(void){
+	size_t slot;
+
+	{
+		boost::unique_lock<boost::mutex> lock(pipelineMutex);
+		if(freeBuffers.empty()){
+			stalls++;
+		}
+		while(freeBuffers.empty()){
+			released.wait(lock);
+		}
+		slot = freeBuffers.front();
+		freeBuffers.pop_front();
+	}
+	// A free buffer belongs to the stepping thread alone, and still holds the particles of an earlier snapshot to copy over
+	buffers[slot].step = stepCount;
+	buffers[slot].time = time;
+	system->copyParticles(buffers[slot].particles);
+	{
+		boost::unique_lock<boost::mutex> lock(pipelineMutex);
+		pending[slot] = dueStages.size();
+		for(size_t d = 0; d < dueStages.size(); d++){
+			queues[dueStages[d]].push_back(slot);
+		}
+	}
+	published.notify_all();
+}
+
+template <class T>
+void NBodySim::StepPipeline<T>::step(T deltaT){
+	system->step(deltaT);
+	stepCount++;
+	time += deltaT;
+	dueStages.clear();
+	{
+		boost::unique_lock<boost::mutex> lock(pipelineMutex);
+		for(size_t stage = 0; stage < intervals.size(); stage++){
+			if(stepCount % intervals[stage] == 0){
+				dueStages.push_back(stage);
+			}
+		}
+	}
+	if(!dueStages.empty()){
+		publish();
+	}
+}
+
+template <class T>
+void NBodySim::StepPipeline<T>::flush(void){
+	boost::unique_lock<boost::mutex> lock(pipelineMutex);
+
+	while(freeBuffers.size() < buffers.size()){
+		released.wait(lock);
+	}
+}
+
+template <class T>
+size_t NBodySim::StepPipeline<T>::getStepCount(void){
+	return stepCount;
+}
+
+template <class T>
+size_t NBodySim::StepPipeline<T>::getStalls(void){
+	boost::unique_lock<boost::mutex> lock(pipelineMutex);
+
+	return stalls;
+}
+
+template <class T>
+size_t NBodySim::StepPipeline<T>::numStages(void){
+	boost::unique_lock<boost::mutex> lock(pipelineMutex);
+
+	return queues.size();
+}
+
+template class NBodySim::StepPipeline<NBodySim::FloatingType>;
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <boost/thread.hpp>
+#include <boost/bind/bind.hpp>
+
+#include "TaskScheduler.h"
+
+NBodySim::TaskScheduler::TaskScheduler(unsigned threads, bool pinThreads) :
+	numThreads((threads == 0) ? std::max(1u, boost::thread::hardware_concurrency()) : threads),
+	deques(numThreads),
+	dequeMutexes(numThreads){
+	std::vector<std::vector<unsigned> > nodes;
+	size_t node;
+	size_t rank;
+
+	body = NULL;
+	stealing = true;
+	generation = 0;
+	remaining = 0;
+	busy = 0;
+	closing = false;
+	pinned = pinThreads;
+	cpuOfThread.assign(numThreads, 0);
+	nodeOfThread.assign(numThreads, 0);
+	numNodes = 1;
+
+	if(pinned){
+		// Contiguous blocks of threads per node, so the threads sharing a node also share neighbouring indices
+		readNodes(nodes);
+		numNodes = std::min<size_t>(nodes.size(), numThreads);
+		rank = 0;
+		for(unsigned thread = 0; thread < numThreads; thread++){
+			node = static_cast<size_t>(thread) * numNodes / numThreads;
+			rank = (thread > 0 && nodeOfThread[thread - 1] == node) ? rank + 1 : 0;
+			nodeOfThread[thread] = node;
+			cpuOfThread[thread] = nodes[node][rank % nodes[node].size()];
+		}
+	}
+	for(unsigned thread = 1; thread < numThreads; thread++){
+		workers.create_thread(boost::bind(&NBodySim::TaskScheduler::workerLoop, this, thread));
+	}
+}
+
+NBodySim::TaskScheduler::~TaskScheduler(void){
+	{
+		boost::unique_lock<boost::mutex> lock(wakeMutex);
+		closing = true;
+	}
+	wake.notify_all();
+	workers.join_all();
+}
+
+unsigned NBodySim::TaskScheduler::getNumThreads(void){
+	return numThreads;
+}
+
+bool NBodySim::TaskScheduler::getPinned(void){
+	return pinned;
+}
+
+unsigned NBodySim::TaskScheduler::getNumNodes(void){
+	return numNodes;
+}
+
+unsigned NBodySim::TaskScheduler::getThreadNode(unsigned thread){
+	return nodeOfThread.at(thread);
+}
+
+void NBodySim::TaskScheduler::parseList(const std::string & list, std::vector<unsigned> & values){
+	std::stringstream stream(list);
+	std::string range;
+	size_t dash;
+	unsigned first;
+	unsigned last;
+
+	while(std::getline(stream, range, ',')){
+		if(range.find_first_of("0123456789") == std::string::npos){
+			continue;
+		}
+		dash = range.find('-');
+		first = std::strtoul(range.c_str(), NULL, 10);
+		last = (dash == std::string::npos) ? first : std::strtoul(range.c_str() + dash + 1, NULL, 10);
+		for(unsigned value = first; value <= last; value++){
+			values.push_back(value);
+		}
+	}
+}
+
+void NBodySim::TaskScheduler::readNodes(std::vector<std::vector<unsigned> > & nodes){
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string list;
+	std::vector<unsigned> nodeIds;
+
+	nodes.clear();
+	if(online && std::getline(online, list)){
+		parseList(list, nodeIds);
+	}
+	for(size_t i = 0; i < nodeIds.size(); i++){
+		std::ifstream cpus("/sys/devices/system/node/node" + std::to_string(nodeIds[i]) + "/cpulist");
+		std::vector<unsigned> cpuList;
+		if(cpus && std::getline(cpus, list)){
+			parseList(list, cpuList);
+		}
+		// Nodes holding only memory have no CPUs to run threads on
+		if(!cpuList.empty()){
+			nodes.push_back(cpuList);
+		}
+	}
+	if(nodes.empty()){
+		nodes.resize(1);
+		for(unsigned cpu = 0; cpu < std::max(1u, boost::thread::hardware_concurrency()); cpu++){
+			nodes[0].push_back(cpu);
+		}
+	}
+}
+
+void NBodySim::TaskScheduler::pin(unsigned cpu){
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+void NBodySim::TaskScheduler::workerLoop(unsigned thread){
+	size_t seen = 0;
+
+	if(pinned){
+		pin(cpuOfThread[thread]);
+	}
+	while(true){
+		{
+			boost::unique_lock<boost::mutex> lock(wakeMutex);
+			while(!closing && generation == seen){
+				wake.wait(lock);
+			}
+			if(closing){
+				return;
+			}
+			seen = generation;
+		}
+		work(thread);
+		{
+			boost::unique_lock<boost::mutex> lock(wakeMutex);
+			busy--;
+			if(busy == 0){
+				done.notify_all();
+			}
+		}
+	}
+}
+
+bool NBodySim::TaskScheduler::pop(unsigned owner, bool back, std::pair<size_t, size_t> * chunk){
+	boost::unique_lock<boost::mutex> lock(dequeMutexes[owner]);
+
+	if(deques[owner].empty()){
+		return false;
+	}
+	if(back){
+		*chunk = deques[owner].back();
+		deques[owner].pop_back();
+	}
+	else{
+		*chunk = deques[owner].front();
+		deques[owner].pop_front();
+	}
+	return true;
+}
+
+void NBodySim::TaskScheduler::work(unsigned thread){
+	std::pair<size_t, size_t> chunk;
+	bool stolen;
+
+	while(remaining > 0){
+		// The own deque is worked from the front, in index order, so neighbouring chunks share cache
+		if(pop(thread, false, &chunk)){
+			(*body)(chunk.first, chunk.second, thread);
+			remaining--;
+			continue;
+		}
+		if(!stealing){
+			return;
+		}
+		// Thieves take from the back, the chunks the owner would reach last
+		stolen = false;
+		for(unsigned k = 1; k < numThreads && !stolen; k++){
+			if(pop((thread + k) % numThreads, true, &chunk)){
+				(*body)(chunk.first, chunk.second, thread);
+				remaining--;
+				stolen = true;
+			}
+		}
+		// Every deque is empty, the chunks left are already being run by other threads
+		if(!stolen){
+			return;
+		}
+	}
+}
+
+void NBodySim::TaskScheduler::run(const threadRangeFunction & loopBody, bool steal){
+	// The calling thread works as thread 0, so it is pinned the first time it calls a loop
+	if(pinned && pinnedCaller != boost::this_thread::get_id()){
+		pin(cpuOfThread[0]);
+		pinnedCaller = boost::this_thread::get_id();
+	}
+	{
+		boost::unique_lock<boost::mutex> lock(wakeMutex);
+		body = &loopBody;
+		stealing = steal;
+		busy = numThreads - 1;
+		generation++;
+	}
+	wake.notify_all();
+	work(0);
+	{
+		boost::unique_lock<boost::mutex> lock(wakeMutex);
+		while(busy > 0){
+			done.wait(lock);
+		}
+		body = NULL;
+	}
+}
+
+void NBodySim::TaskScheduler::parallelFor(size_t begin, size_t end, size_t grain, const rangeFunction & loopBody){
+	parallelFor(begin, end, grain, threadRangeFunction([&loopBody](size_t first, size_t last, unsigned){
+		loopBody(first, last);
+	}));
+}
+
+void NBodySim::TaskScheduler::parallelFor(size_t begin, size_t end, size_t grain, const threadRangeFunction & loopBody){
+	size_t numChunks;
+	size_t first;
+	size_t last;
+	boost::unique_lock<boost::mutex> lock(loopMutex);
+
+	if(end <= begin){
+		return;
+	}
+	if(grain == 0){
+		grain = 1;
+	}
+	numChunks = (end - begin + grain - 1) / grain;
+
+	// One thread, or one chunk, has nothing to share
+	if(numThreads == 1 || numChunks == 1){
+		for(size_t start = begin; start < end; start += grain){
+			loopBody(start, std::min(start + grain, end), 0);
+		}
+		return;
+	}
+
+	// Every thread starts with an equal, contiguous run of chunks
+	remaining = numChunks;
+	for(unsigned thread = 0; thread < numThreads; thread++){
+		first = numChunks * thread / numThreads;
+		last = numChunks * (thread + 1) / numThreads;
+		for(size_t chunk = first; chunk < last; chunk++){
+			deques[thread].push_back(std::make_pair(begin + chunk * grain, std::min(begin + (chunk + 1) * grain, end)));
+		}
+	}
+	run(loopBody, true);
+}
+
+void NBodySim::TaskScheduler::parallelForStatic(size_t begin, size_t end, const rangeFunction & loopBody){
+	std::vector<size_t> bounds(numThreads + 1);
+
+	if(end <= begin){
+		return;
+	}
+	for(unsigned thread = 0; thread <= numThreads; thread++){
+		bounds[thread] = begin + (end - begin) * thread / numThreads;
+	}
+	parallelForRanges(bounds, loopBody);
+}
+
+void NBodySim::TaskScheduler::parallelForRanges(const std::vector<size_t> & bounds, const rangeFunction & loopBody){
+	parallelForRanges(bounds, threadRangeFunction([&loopBody](size_t first, size_t last, unsigned){
+		loopBody(first, last);
+	}));
+}
+
+void NBodySim::TaskScheduler::parallelForRanges(const std::vector<size_t> & bounds, const threadRangeFunction & loopBody){
+	size_t numChunks = 0;
+	boost::unique_lock<boost::mutex> lock(loopMutex);
+
+	// Ranges that do not match the threads, drawn for another number of them, still all run, on the calling thread
+	if(numThreads == 1 || bounds.size() != numThreads + 1){
+		for(size_t range = 0; range + 1 < bounds.size(); range++){
+			if(bounds[range] < bounds[range + 1]){
+				loopBody(bounds[range], bounds[range + 1], 0);
+			}
+		}
+		return;
+	}
+
+	for(unsigned thread = 0; thread < numThreads; thread++){
+		if(bounds[thread] < bounds[thread + 1]){
+			deques[thread].push_back(std::make_pair(bounds[thread], bounds[thread + 1]));
+			numChunks++;
+		}
+	}
+	remaining = numChunks;
+	run(loopBody, false);
+}
+
+void NBodySim::TaskScheduler::parallelForThreads(const std::function<void(unsigned)> & loopBody){
+	std::vector<size_t> bounds(numThreads + 1);
+
+	// One index per thread, each held by its own thread since nothing is stolen
+	for(unsigned thread = 0; thread <= numThreads; thread++){
+		bounds[thread] = thread;
+	}
+	parallelForRanges(bounds, threadRangeFunction([&loopBody](size_t, size_t, unsigned thread){
+		loopBody(thread);
+	}));
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include <cmath>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "Kepler.h"
+#include "WisdomHolmanIntegrator.h"
+
+template <class T>
+NBodySim::WisdomHolmanIntegrator<T>::WisdomHolmanIntegrator(void){
+	centralMass = 0;
+}
+
+template <class T>
+NBodySim::WisdomHolmanIntegrator<T>::~WisdomHolmanIntegrator(void){
+
+}
+
+template <class T>
+void NBodySim::WisdomHolmanIntegrator<T>::interactionKick(T dt){
+	NBodySim::ThreeVector<T> dr;
+	T distanceSquared;
+	T inverseCube;
+
+	for(size_t i = 0; i < pos.size(); i++){
+		for(size_t j = i + 1; j < pos.size(); j++){
+			dr.x = pos[j].x - pos[i].x;
+			dr.y = pos[j].y - pos[i].y;
+			dr.z = pos[j].z - pos[i].z;
+			distanceSquared = dr.x * dr.x + dr.y * dr.y + dr.z * dr.z;
+			if(distanceSquared == 0){
+				continue;
+			}
+			inverseCube = dt / (distanceSquared * std::sqrt(distanceSquared));
+			vel[i].x += gm[j] * inverseCube * dr.x;
+			vel[i].y += gm[j] * inverseCube * dr.y;
+			vel[i].z += gm[j] * inverseCube * dr.z;
+			vel[j].x -= gm[i] * inverseCube * dr.x;
+			vel[j].y -= gm[i] * inverseCube * dr.y;
+			vel[j].z -= gm[i] * inverseCube * dr.z;
+		}
+	}
+}
+
+template <class T>
+void NBodySim::WisdomHolmanIntegrator<T>::jump(T dt){
+	NBodySim::ThreeVector<T> momentum;
+
+	momentum.x = momentum.y = momentum.z = 0;
+	for(size_t i = 0; i < pos.size(); i++){
+		momentum.x += mass[i] * vel[i].x;
+		momentum.y += mass[i] * vel[i].y;
+		momentum.z += mass[i] * vel[i].z;
+	}
+	for(size_t i = 0; i < pos.size(); i++){
+		pos[i].x += momentum.x * dt / centralMass;
+		pos[i].y += momentum.y * dt / centralMass;
+		pos[i].z += momentum.z * dt / centralMass;
+	}
+}
+
+template <class T>
+void NBodySim::WisdomHolmanIntegrator<T>::step(std::vector<NBodySim::Particle<T> > & system, T G, T deltaT){
+	size_t numParticles = system.size();
+	size_t central = 0;
+	size_t k;
+	T totalMass = 0;
+	NBodySim::ThreeVector<T> centerPos;
+	NBodySim::ThreeVector<T> centerVel;
+	NBodySim::ThreeVector<T> centralPos;
+	NBodySim::ThreeVector<T> centralVel;
+	NBodySim::ThreeVector<T> p;
+	NBodySim::ThreeVector<T> v;
+	NBodySim::ThreeVector<T> weighted;
+
+	if(numParticles == 0){
+		return;
+	}
+
+	// The most massive particle is the central body, find the barycenter and its velocity
+	centerPos.x = centerPos.y = centerPos.z = 0;
+	centerVel.x = centerVel.y = centerVel.z = 0;
+	for(size_t i = 0; i < numParticles; i++){
+		if(system[i].getMass() > system[central].getMass()){
+			central = i;
+		}
+		p = system[i].getPos();
+		v = system[i].getVel();
+		totalMass += system[i].getMass();
+		centerPos.x += system[i].getMass() * p.x;
+		centerPos.y += system[i].getMass() * p.y;
+		centerPos.z += system[i].getMass() * p.z;
+		centerVel.x += system[i].getMass() * v.x;
+		centerVel.y += system[i].getMass() * v.y;
+		centerVel.z += system[i].getMass() * v.z;
+	}
+	centralMass = system[central].getMass();
+	if(totalMass <= 0 || centralMass <= 0){
+		return;
+	}
+	centerPos.x /= totalMass;
+	centerPos.y /= totalMass;
+	centerPos.z /= totalMass;
+	centerVel.x /= totalMass;
+	centerVel.y /= totalMass;
+	centerVel.z /= totalMass;
+
+	// Convert to democratic heliocentric coordinates
+	centralPos = system[central].getPos();
+	gm.resize(numParticles - 1);
+	mass.resize(numParticles - 1);
+	pos.resize(numParticles - 1);
+	vel.resize(numParticles - 1);
+	k = 0;
+	for(size_t i = 0; i < numParticles; i++){
+		if(i == central){
+			continue;
+		}
+		p = system[i].getPos();
+		v = system[i].getVel();
+		mass[k] = system[i].getMass();
+		gm[k] = G * mass[k];
+		pos[k].x = p.x - centralPos.x;
+		pos[k].y = p.y - centralPos.y;
+		pos[k].z = p.z - centralPos.z;
+		vel[k].x = v.x - centerVel.x;
+		vel[k].y = v.y - centerVel.y;
+		vel[k].z = v.z - centerVel.z;
+		k++;
+	}
+
+	// Kick, jump, Kepler drift, jump, kick
+	interactionKick(deltaT / 2);
+	jump(deltaT / 2);
+	for(size_t i = 0; i < pos.size(); i++){
+		NBodySim::Kepler<T>::drift(G * centralMass, &pos[i], &vel[i], deltaT);
+	}
+	jump(deltaT / 2);
+	interactionKick(deltaT / 2);
+
+	// The barycenter moves in a straight line
+	centerPos.x += centerVel.x * deltaT;
+	centerPos.y += centerVel.y * deltaT;
+	centerPos.z += centerVel.z * deltaT;
+
+	// Convert back to barycentric coordinates
+	weighted.x = weighted.y = weighted.z = 0;
+	for(size_t i = 0; i < pos.size(); i++){
+		weighted.x += mass[i] * pos[i].x;
+		weighted.y += mass[i] * pos[i].y;
+		weighted.z += mass[i] * pos[i].z;
+	}
+	centralPos.x = centerPos.x - weighted.x / totalMass;
+	centralPos.y = centerPos.y - weighted.y / totalMass;
+	centralPos.z = centerPos.z - weighted.z / totalMass;
+	weighted.x = weighted.y = weighted.z = 0;
+	for(size_t i = 0; i < pos.size(); i++){
+		weighted.x += mass[i] * vel[i].x;
+		weighted.y += mass[i] * vel[i].y;
+		weighted.z += mass[i] * vel[i].z;
+	}
+	centralVel.x = centerVel.x - weighted.x / centralMass;
+	centralVel.y = centerVel.y - weighted.y / centralMass;
+	centralVel.z = centerVel.z - weighted.z / centralMass;
+	system[central].setPos(centralPos);
+	system[central].setVel(centralVel);
+
+	k = 0;
+	for(size_t i = 0; i < numParticles; i++){
+		if(i == central){
+			continue;
+		}
+		p.x = centralPos.x + pos[k].x;
+		p.y = centralPos.y + pos[k].y;
+		p.z = centralPos.z + pos[k].z;
+		v.x = centerVel.x + vel[k].x;
+		v.y = centerVel.y + vel[k].y;
+		v.z = centerVel.z + vel[k].z;
+		system[i].setPos(p);
+		system[i].setVel(v);
+		k++;
+	}
+}
+
+template class NBodySim::WisdomHolmanIntegrator<NBodySim::FloatingType>;
@@ -22,6 +22,7 @@
 #include <iostream>
 #include <string.h>
 #include <sstream>
+#include <iomanip>
 #include <fstream>
 #include <streambuf>
 #include <getopt.h>
@@ -40,6 +41,7 @@
 #include <cmath>
 #include <errno.h>
 #include <algorithm>
+#include <memory>
 
 #include <boost/thread.hpp>
 #include <boost/functional.hpp>
@@ -54,6 +56,12 @@
 #include "NBodyTypes.h"
 #include "Particle.h"
 #include "NBodySystem.h"
+#include "TaskScheduler.h"
+#include "Ensemble.h"
+#include "StepPipeline.h"
+#include "SnapshotFile.h"
+#include "SnapshotWriter.h"
+#include "SnapshotFilter.h"
 #include "threads.h"
 #include "ParticlePlotter.h"
 
@@ -74,6 +82,62 @@ int main(int argc, char* argv[]);
  */
 std::string readFile(std::string fileName);
 
+/**
+ * @brief columnDelimiter returns the delimiter of a column file from its extension
+ *
+ * @param fileName is the path of the file
+ * @return ',' for .csv, a tab for .tsv, a space for .txt and .dat, and 0 for anything else, which is read as xml
+ */
+char columnDelimiter(std::string fileName);
+
+/**
+ * @brief isSnapshotFile tells whether a file is a columnar snapshot file from its extension
+ *
+ * @param fileName is the path of the file
+ * @return true for .nbs
+ */
+bool isSnapshotFile(std::string fileName);
+
+/**
+ * @brief snapshotFileName returns the path a snapshot file of one step is written to, the step before the extension
+ *
+ * @param fileName is the path given by the user
+ * @param step is the step of the snapshot
+ * @return the path
+ */
+std::string snapshotFileName(std::string fileName, size_t step);
+
+/**
+ * @brief writeSnapshot writes a line with the step and time of a snapshot, then one line per particle, as columns if a
+ * delimiter is given and with the name, position, velocity and mass otherwise
+ *
+ * @param out is the stream to write to
+ * @param snapshot is the snapshot to write
+ * @param delimiter separates the columns, 0 for the plain format
+ * @param header is true to write the column names before the particles
+ */
+void writeSnapshot(std::ostream & out, const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot, char delimiter, bool header);
+
+/**
+ * @brief filterSnapshot applies the output filter to a snapshot
+ *
+ * @param filter is the output filter
+ * @param snapshot is the snapshot of every particle
+ * @param filtered receives the selected particles, unless the filter selects every particle
+ * @return snapshot if the filter selects every particle, filtered otherwise
+ */
+const NBodySim::Snapshot<NBodySim::FloatingType> & filterSnapshot(NBodySim::SnapshotFilter<NBodySim::FloatingType> & filter, const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot, NBodySim::Snapshot<NBodySim::FloatingType> & filtered);
+
+/**
+ * @brief parseValues parses a comma separated list of numbers
+ *
+ * @param text is the list
+ * @param count is the number of numbers the list must hold
+ * @param values receives the numbers
+ * @return true if the list holds count numbers and nothing else
+ */
+bool parseValues(const char * text, size_t count, std::vector<NBodySim::FloatingType> & values);
+
 /**
  * @brief This structure contains a list of options a user can control on the command line
  */
@@ -84,6 +148,39 @@ typedef struct {
 	NBodySim::FloatingType resolution; /**< resolution in meters per pixel */
 	unsigned width; /**< width of window in pixels */
 	unsigned length; /**< length of window in pixels */
+	NBodySim::forcePrecision precision; /**< How the inverse cube of the distance between particles is calculated */
+	bool badPrecision;               /**< Indicates the force precision given by the user was not recognized */
+	unsigned targetTile; /**< Number of target particles per tile of the direct summation, 0 sizes it from the cache */
+	unsigned sourceTile; /**< Number of source particles per tile of the direct summation, 0 sizes it from the cache */
+	bool badTile;                    /**< Indicates a tile length given by the user was not a positive number */
+	NBodySim::integratorType integrator; /**< How the system is advanced through time */
+	bool badIntegrator;              /**< Indicates the integrator given by the user was not recognized */
+	NBodySim::FloatingType accuracy; /**< Accuracy parameter of the integrators which choose their own substeps */
+	bool collisions;                 /**< Indicates whether overlapping particles are merged */
+	NBodySim::FloatingType tolerance; /**< Error tolerance of the Gauss-Radau integrator */
+	bool regularize;                 /**< Indicates whether tight binaries are advanced analytically */
+	unsigned threads;                /**< Number of threads sharing the force calculation, 0 uses one per hardware thread */
+	bool pinThreads;                 /**< Indicates whether the threads are bound to CPUs spread over the NUMA nodes */
+	NBodySim::FloatingType balance;  /**< Imbalance threshold of the cost balanced partition, 0 balances by work stealing */
+	unsigned reorder;                /**< Steps between sorts of the particles along a space filling curve, 0 never sorts */
+	NBodySim::curveType curve;       /**< Space filling curve the particles are sorted along */
+	bool badCurve;                   /**< Indicates the curve given by the user was not recognized */
+	unsigned ensemble;               /**< Number of perturbed replicas to step without the GUI, 0 opens the GUI */
+	unsigned steps;                  /**< Number of steps every replica of the ensemble is advanced */
+	NBodySim::FloatingType perturbation; /**< Relative spread of the positions and velocities of the replicas */
+	bool badPerturbation;            /**< Indicates the spread given by the user was negative or not a number */
+	unsigned seed;                   /**< Seed of the perturbations of the replicas */
+	std::string summaryFile;         /**< Path the summary of the replicas is written to, standard output when empty */
+	std::string outputFile;          /**< Path snapshots of the system are written to while it runs, none when empty */
+	unsigned outputInterval;         /**< Steps between the snapshots written to the output file */
+	std::vector<NBodySim::FloatingType> outputBox; /**< Lower and upper corner of the box output is limited to, empty for none */
+	std::vector<NBodySim::FloatingType> outputSphere; /**< Center and radius of the sphere output is limited to, empty for none */
+	unsigned outputEvery;            /**< Only every this many particles are written */
+	NBodySim::FloatingType outputFraction; /**< Share of the particles written, chosen at random with the seed */
+	std::string outputNames;         /**< Pattern the names of the particles written must match, empty for any */
+	bool badFilter;                  /**< Indicates an output filter given by the user could not be read */
+	bool deterministic;              /**< Indicates whether the force sums give the same bits whatever the threads */
+	unsigned hashInterval;           /**< Steps between the state hashes printed, 0 prints none */
 } argsList;
 
 /**
@@ -269,6 +366,81 @@ std::string guiInitErrorsToString(guiInitErrors error);
 void drawTriangle(SDL_Renderer * gRenderer, int x, int y, int height, int width, unsigned char fillIn);
 
 
+char columnDelimiter(std::string fileName){
+	std::string extension = fileName.substr(std::min(fileName.size(), fileName.rfind('.')));
+	
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if(extension == ".csv"){
+		return ',';
+	}
+	if(extension == ".tsv"){
+		return '\t';
+	}
+	if(extension == ".txt" || extension == ".dat"){
+		return ' ';
+	}
+	return 0;
+}
+
+bool isSnapshotFile(std::string fileName){
+	std::string extension = fileName.substr(std::min(fileName.size(), fileName.rfind('.')));
+	
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".nbs";
+}
+
+std::string snapshotFileName(std::string fileName, size_t step){
+	std::ostringstream name;
+	size_t dot = fileName.rfind('.');
+	
+	name << fileName.substr(0, dot) << "." << step << fileName.substr(dot);
+	return name.str();
+}
+
+void writeSnapshot(std::ostream & out, const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot, char delimiter, bool header){
+	out.precision(17);
+	out << "# step " << snapshot.step << " time " << snapshot.time << '\n';
+	if(delimiter != 0){
+		NBodySim::NBodySystem<NBodySim::FloatingType>::writeColumns(out, snapshot.particles, delimiter, header);
+		return;
+	}
+	for(size_t i = 0; i < snapshot.particles.size(); i++){
+		const NBodySim::Particle<NBodySim::FloatingType> & p = snapshot.particles[i];
+		out << p.getName() << " " << p.getPos().x << " " << p.getPos().y << " " << p.getPos().z << " ";
+		out << p.getVel().x << " " << p.getVel().y << " " << p.getVel().z << " " << p.getMass() << '\n';
+	}
+}
+
+const NBodySim::Snapshot<NBodySim::FloatingType> & filterSnapshot(NBodySim::SnapshotFilter<NBodySim::FloatingType> & filter, const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot, NBodySim::Snapshot<NBodySim::FloatingType> & filtered){
+	if(filter.selectsAll()){
+		return snapshot;
+	}
+	filtered.step = snapshot.step;
+	filtered.time = snapshot.time;
+	filter.apply(snapshot.particles, filtered.particles);
+	return filtered;
+}
+
+bool parseValues(const char * text, size_t count, std::vector<NBodySim::FloatingType> & values){
+	char * end;
+	
+	values.clear();
+	while(values.size() < count){
+		values.push_back(strtod(text, &end));
+		if(end == text){
+			return false;
+		}
+		text = end;
+		if(values.size() < count){
+			if(*text != ','){
+				return false;
+			}
+			text++;
+		}
+	}
+	return *text == '\0';
+}
+
 std::string readFile(std::string fileName, std::string programName){
 	std::string scenarioText;
 	std::ifstream scenarioFile(fileName.c_str());
@@ -299,6 +471,33 @@ argsList parseArgs(int argc, char* argv[]){
 		{"resolution",  required_argument, 0, 'r'},
 		{"width",       required_argument, 0, 'w'},
 		{"length",      required_argument, 0, 'l'},
+		{"force-precision", required_argument, 0, 'p'},
+		{"target-tile", required_argument, 0, 'T'},
+		{"source-tile", required_argument, 0, 'S'},
+		{"integrator",  required_argument, 0, 'I'},
+		{"timestep-accuracy", required_argument, 0, 'a'},
+		{"collisions",  no_argument,       0, 'c'},
+		{"error-tolerance", required_argument, 0, 'e'},
+		{"regularize",  no_argument,       0, 'R'},
+		{"threads",     required_argument, 0, 'j'},
+		{"pin-threads", no_argument,       0, 'P'},
+		{"balance",     required_argument, 0, 'b'},
+		{"reorder",     required_argument, 0, 'o'},
+		{"curve",       required_argument, 0, 'k'},
+		{"ensemble",    required_argument, 0, 'E'},
+		{"steps",       required_argument, 0, 'n'},
+		{"perturbation", required_argument, 0, 'x'},
+		{"seed",        required_argument, 0, 'u'},
+		{"summary-file", required_argument, 0, 'f'},
+		{"output-file", required_argument, 0, 'O'},
+		{"output-interval", required_argument, 0, 'K'},
+		{"output-box",  required_argument, 0, 'B'},
+		{"output-sphere", required_argument, 0, 'V'},
+		{"output-every", required_argument, 0, 'X'},
+		{"output-fraction", required_argument, 0, 'F'},
+		{"output-names", required_argument, 0, 'N'},
+		{"deterministic", no_argument,     0, 'D'},
+		{"hash-interval", required_argument, 0, 'H'},
 		{0, 0, 0, 0}
 	};
 	argsList output;
@@ -309,8 +508,39 @@ argsList parseArgs(int argc, char* argv[]){
 	output.resolution = 0.1;
 	output.length = 480;
 	output.width = 640;
+	output.precision = NBodySim::ACCURATE;
+	output.badPrecision = false;
+	output.targetTile = 0;
+	output.sourceTile = 0;
+	output.badTile = false;
+	output.integrator = NBodySim::SYMPLECTIC_EULER;
+	output.badIntegrator = false;
+	output.accuracy = NBodySim::HermiteIntegratorSpace::defaultAccuracy;
+	output.collisions = false;
+	output.tolerance = NBodySim::GaussRadauIntegratorSpace::defaultTolerance;
+	output.regularize = false;
+	output.threads = 1;
+	output.pinThreads = false;
+	output.balance = 0;
+	output.reorder = 0;
+	output.curve = NBodySim::HILBERT;
+	output.badCurve = false;
+	output.ensemble = 0;
+	output.steps = 1000;
+	output.perturbation = NBodySim::EnsembleSpace::defaultPerturbation;
+	output.badPerturbation = false;
+	output.seed = 1;
+	output.summaryFile = "";
+	output.outputFile = "";
+	output.outputInterval = 100;
+	output.outputEvery = 1;
+	output.outputFraction = 1;
+	output.outputNames = "";
+	output.badFilter = false;
+	output.deterministic = false;
+	output.hashInterval = 0;
 	
-	while ((c = getopt_long(argc, argv, "hi:s:r:w:l:", long_options, &option_index)) != -1){
+	while ((c = getopt_long(argc, argv, "hi:s:r:w:l:p:T:S:I:a:ce:Rj:Pb:o:k:E:n:x:u:f:O:K:B:V:X:F:N:DH:", long_options, &option_index)) != -1){
 		switch (c)
 		{
 			case 'h':
@@ -333,6 +563,125 @@ argsList parseArgs(int argc, char* argv[]){
 			case 'w':
 				output.width = atoi(optarg);
 				break;
+			case 'p':
+				if(strcmp(optarg, "accurate") == 0){
+					output.precision = NBodySim::ACCURATE;
+				}
+				else if(strcmp(optarg, "refined") == 0){
+					output.precision = NBodySim::REFINED;
+				}
+				else if(strcmp(optarg, "fast") == 0){
+					output.precision = NBodySim::FAST;
+				}
+				else{
+					output.badPrecision = true;
+				}
+				break;
+			case 'T':
+				output.targetTile = atoi(optarg);
+				output.badTile = output.badTile || atoi(optarg) <= 0;
+				break;
+			case 'S':
+				output.sourceTile = atoi(optarg);
+				output.badTile = output.badTile || atoi(optarg) <= 0;
+				break;
+			case 'I':
+				if(strcmp(optarg, "euler") == 0){
+					output.integrator = NBodySim::SYMPLECTIC_EULER;
+				}
+				else if(strcmp(optarg, "hermite") == 0){
+					output.integrator = NBodySim::HERMITE;
+				}
+				else if(strcmp(optarg, "wisdom-holman") == 0){
+					output.integrator = NBodySim::WISDOM_HOLMAN;
+				}
+				else if(strcmp(optarg, "gauss-radau") == 0){
+					output.integrator = NBodySim::GAUSS_RADAU;
+				}
+				else{
+					output.badIntegrator = true;
+				}
+				break;
+			case 'a':
+				output.accuracy = atof(optarg);
+				break;
+			case 'c':
+				output.collisions = true;
+				break;
+			case 'e':
+				output.tolerance = atof(optarg);
+				break;
+			case 'R':
+				output.regularize = true;
+				break;
+			case 'j':
+				output.threads = atoi(optarg);
+				break;
+			case 'P':
+				output.pinThreads = true;
+				break;
+			case 'b':
+				output.balance = atof(optarg);
+				break;
+			case 'o':
+				output.reorder = atoi(optarg);
+				break;
+			case 'k':
+				if(strcmp(optarg, "morton") == 0){
+					output.curve = NBodySim::MORTON;
+				}
+				else if(strcmp(optarg, "hilbert") == 0){
+					output.curve = NBodySim::HILBERT;
+				}
+				else{
+					output.badCurve = true;
+				}
+				break;
+			case 'E':
+				output.ensemble = atoi(optarg);
+				break;
+			case 'n':
+				output.steps = atoi(optarg);
+				break;
+			case 'x':
+				output.perturbation = atof(optarg);
+				output.badPerturbation = !(output.perturbation >= 0);
+				break;
+			case 'u':
+				output.seed = atoi(optarg);
+				break;
+			case 'f':
+				output.summaryFile = optarg;
+				break;
+			case 'O':
+				output.outputFile = optarg;
+				break;
+			case 'K':
+				output.outputInterval = atoi(optarg);
+				break;
+			case 'B':
+				output.badFilter = output.badFilter || !parseValues(optarg, 6, output.outputBox);
+				break;
+			case 'V':
+				output.badFilter = output.badFilter || !parseValues(optarg, 4, output.outputSphere);
+				break;
+			case 'X':
+				output.outputEvery = atoi(optarg);
+				output.badFilter = output.badFilter || output.outputEvery == 0;
+				break;
+			case 'F':
+				output.outputFraction = atof(optarg);
+				output.badFilter = output.badFilter || !(output.outputFraction >= 0 && output.outputFraction <= 1);
+				break;
+			case 'N':
+				output.outputNames = optarg;
+				break;
+			case 'D':
+				output.deterministic = true;
+				break;
+			case 'H':
+				output.hashInterval = atoi(optarg);
+				break;
 			default:
 				abort ();
 				break;
@@ -483,6 +832,9 @@ int main(int argc, char* argv[]){
 	const unsigned numTimingSems = 2;
 	argsList inputArgs = parseArgs(argc, argv);
 	std::string inputScenario;
+	std::ifstream columnFile;
+	NBodySim::SnapshotFile<NBodySim::FloatingType> restartFile;
+	NBodySim::SnapshotFileSpace::error restartResult = NBodySim::SnapshotFileSpace::COULD_NOT_OPEN;
 	NBodySim::NBodySystem<NBodySim::FloatingType> solarSystem;
 	NBodySim::NBodySystemSpace::error solarSystemParseResult;
 	volatile bool quit = false;
@@ -524,24 +876,210 @@ int main(int argc, char* argv[]){
 		std::cout << "\t-r, --resolution [float]   : Scale in meters per pixel" << std::endl;
 		std::cout << "\t-l, --length     [int]     : Length of window in pixels" << std::endl;
 		std::cout << "\t-w, --width      [int]     : Width of window in pixels" << std::endl;
+		std::cout << "\t-p, --force-precision [fast|refined|accurate] : Accuracy of the force calculation, accurate by default" << std::endl;
+		std::cout << "\t-T, --target-tile [int]    : Target particles per tile of the force calculation, sized from the cache by default" << std::endl;
+		std::cout << "\t-S, --source-tile [int]    : Source particles per tile of the force calculation, sized from the cache by default" << std::endl;
+		std::cout << "\t-I, --integrator [euler|hermite|wisdom-holman|gauss-radau] : How the system is advanced through time, euler by default, wisdom-holman suits systems dominated by one central mass, gauss-radau chooses its own substeps to the error tolerance" << std::endl;
+		std::cout << "\t-a, --timestep-accuracy [float] : Accuracy parameter of the hermite integrator's substeps" << std::endl;
+		std::cout << "\t-e, --error-tolerance [float] : Error tolerance of the gauss-radau integrator, 1e-9 by default" << std::endl;
+		std::cout << "\t-R, --regularize           : Advance tight binaries along their exact two body orbits" << std::endl;
+		std::cout << "\t-j, --threads    [int]     : Threads sharing the force calculation, 1 by default, 0 uses one per hardware thread" << std::endl;
+		std::cout << "\t-P, --pin-threads          : Bind the threads to CPUs spread over the NUMA nodes, each node keeping its own copy of the particles" << std::endl;
+		std::cout << "\t-b, --balance    [float]   : Give each thread particles of equal measured cost, redrawn when the busiest thread does this many times the mean work, work stealing by default" << std::endl;
+		std::cout << "\t-o, --reorder    [int]     : Steps between sorts of the particles in memory along a space filling curve, never by default" << std::endl;
+		std::cout << "\t-k, --curve [morton|hilbert] : Space filling curve the particles are sorted along, hilbert by default" << std::endl;
+		std::cout << "\t-E, --ensemble   [int]     : Step this many perturbed copies of the system without the GUI and write a summary of each, with the euler integrator and none of -c, -R, -D, -b, -o, -O, -T, -S or -H" << std::endl;
+		std::cout << "\t-n, --steps      [int]     : Steps every copy of the ensemble is advanced, 1000 by default" << std::endl;
+		std::cout << "\t-x, --perturbation [float] : Relative spread of the positions and velocities of the copies, 1e-8 by default, 0 makes exact copies" << std::endl;
+		std::cout << "\t-u, --seed       [int]     : Seed of the perturbations of the copies" << std::endl;
+		std::cout << "\t-f, --summary-file [Filename] : File the ensemble summary is written to, standard output by default" << std::endl;
+		std::cout << "\t-O, --output-file [Filename] : File snapshots of the system are written to by a thread of their own while it runs, one .nbs file per snapshot that -i can restart from" << std::endl;
+		std::cout << "\t-K, --output-interval [int] : Steps between the snapshots written to the output file, 100 by default" << std::endl;
+		std::cout << "\t-B, --output-box [x0,y0,z0,x1,y1,z1] : Only write the particles inside this box" << std::endl;
+		std::cout << "\t-V, --output-sphere [x,y,z,r] : Only write the particles inside this sphere" << std::endl;
+		std::cout << "\t-X, --output-every [int]   : Only write every this many particles" << std::endl;
+		std::cout << "\t-F, --output-fraction [float] : Only write this share of the particles, the same ones every time for a seed" << std::endl;
+		std::cout << "\t-N, --output-names [pattern] : Only write the particles whose names match, * matches any characters and ? one" << std::endl;
+		std::cout << "\t-c, --collisions           : Merge particles whose radii overlap" << std::endl;
+		std::cout << "\t-D, --deterministic        : Sum the forces in particle order with compensation, so runs give the same bits whatever the threads, balancing or reordering" << std::endl;
+		std::cout << "\t-H, --hash-interval [int]  : Print a hash of the exact state every this many steps, so runs are compared cheaply" << std::endl;
 		std::cout << "\t-h, --help                 : Shows this help option" << std::endl;
 		return EXIT_SUCCESS;
 	}
+	
+	if(inputArgs.badPrecision){
+		std::cerr << programName << ": Error: force precision must be one of fast, refined or accurate" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	if(inputArgs.badTile){
+		std::cerr << programName << ": Error: tile lengths must be positive" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	if(inputArgs.badIntegrator){
+		std::cerr << programName << ": Error: integrator must be one of euler, hermite, wisdom-holman or gauss-radau" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	if(inputArgs.badCurve){
+		std::cerr << programName << ": Error: curve must be one of morton or hilbert" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	if(inputArgs.badFilter){
+		std::cerr << programName << ": Error: an output box takes six numbers, a sphere four, every must be positive and the fraction between 0 and 1" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	if(inputArgs.badPerturbation){
+		std::cerr << programName << ": Error: perturbation must be zero or positive" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	// The ensemble steps its copies with a symplectic Euler kernel of its own, which none of these options reach
+	if(inputArgs.ensemble > 0 && (inputArgs.integrator != NBodySim::SYMPLECTIC_EULER || inputArgs.collisions || inputArgs.regularize || inputArgs.deterministic || inputArgs.balance > 0 || inputArgs.reorder > 0 || inputArgs.targetTile > 0 || inputArgs.sourceTile > 0 || inputArgs.outputFile.length() > 0 || inputArgs.hashInterval > 0)){
+		std::cerr << programName << ": Error: an ensemble is only stepped with the euler integrator, without -c, -R, -D, -b, -o, -O, -T, -S or -H" << std::endl;
+		return EXIT_FAILURE;
+	}
 
 	if(inputArgs.fileName.length() == 0){
 		inputScenario = "<?xml version=\"1.0\"?><system G=\"5.483e-10\"><particle posX=\"0\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0\" velZ=\"0\" mass=\"1e10\" name=\"Sun\"/><particle posX=\"0\" posY=\"-10\" posZ=\"0\" velX=\"-0.5\" velY=\"0\" velZ=\"0\" mass=\"100\" name=\"Comet1\"/><particle posX=\"7\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"-0.55\" velZ=\"0\" mass=\"100\" name=\"Comet2\"/><particle posX=\"-6\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0.6\" velZ=\"0\" mass=\"400\" name=\"Comet3\"/><particle posX=\"-3.5\" posY=\"3.6\" posZ=\"0\" velX=\"0.7\" velY=\"0.7\" velZ=\"0\" mass=\"900\" name=\"Comet4\"/><particle posX=\"0\" posY=\"-5\" posZ=\"0\" velX=\"-1\" velY=\"0\" velZ=\"0\" mass=\"300\" name=\"Commet5\"/><particle posX=\"-5.2\" posY=\"3\" posZ=\"0\" velX=\"0.6\" velY=\"0.9\" velZ=\"0\" mass=\"700\" name=\"Commet6\"/><particle posX=\"5.2\" posY=\"3\" posZ=\"0\" velX=\"0.3\" velY=\"-0.7\" velZ=\"0\" mass=\"500\" name=\"Commet7\"/><particle posX=\"0\" posY=\"8\" posZ=\"0\" velX=\"0.4\" velY=\"0\" velZ=\"0\" mass=\"300\" name=\"Commet8\"/><particle posX=\"7\" posY=\"-7\" posZ=\"0\" velX=\"-0.4\" velY=\"-0.5\" velZ=\"0\" mass=\"200\" name=\"Commet9\"/><particle posX=\"-1\" posY=\"-1\" posZ=\"0\" velX=\"-1.6\" velY=\"1.8\" velZ=\"0\" mass=\"200\" name=\"Commet10\"/><particle posX=\"-8.5\" posY=\"-8.5\" posZ=\"0\" velX=\"-0.3\" velY=\"0.3\" velZ=\"0\" mass=\"700\" name=\"Commet11\"/><particle posX=\"0.7\" posY=\"0.7\" posZ=\"0\" velX=\"2\" velY=\"-2\" velZ=\"0\" mass=\"100\" name=\"Commet12\"/><particle posX=\"1.1\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"-2.2\" velZ=\"0\" mass=\"100\" name=\"Commet13\"/><particle posX=\"2.7\" posY=\"2.7\" posZ=\"0\" velX=\"0.9\" velY=\"-0.8\" velZ=\"0\" mass=\"100\" name=\"Commet14\"/><particle posX=\"8\" posY=\"8\" posZ=\"0\" velX=\"0.4\" velY=\"-0.4\" velZ=\"0\" mass=\"150\" name=\"Commet15\"/><particle posX=\"20\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"-0.3\" velZ=\"0\" mass=\"750\" name=\"Commet16\"/><particle posX=\"1\" posY=\"-1\" posZ=\"0\" velX=\"-1.7\" velY=\"-1.9\" velZ=\"0\" mass=\"450\" name=\"Commet17\"/><particle posX=\"-18\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0.35\" velZ=\"0\" mass=\"750\" name=\"Commet18\"/><particle posX=\"14\" posY=\"-14\" posZ=\"0\" velX=\"-0.13\" velY=\"-0.11\" velZ=\"0\" mass=\"150\" name=\"Commet19\"/><particle posX=\"0\" posY=\"25\" posZ=\"0\" velX=\"0.22\" velY=\"-0\" velZ=\"0\" mass=\"1000\" name=\"Commet20\"/></system>";
 	}
+	else if(isSnapshotFile(inputArgs.fileName)){
+		// Restart from a snapshot the simulator wrote
+		restartResult = restartFile.open(inputArgs.fileName);
+		if(restartResult != NBodySim::SnapshotFileSpace::SUCCESS){
+			std::cerr << programName << ": Error: " << NBodySim::SnapshotFile<NBodySim::FloatingType>::errorToString(restartResult) << " :" << inputArgs.fileName << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	else if(columnDelimiter(inputArgs.fileName) != 0){
+		// Column files are parsed a line at a time as they are read
+		columnFile.open(inputArgs.fileName.c_str());
+		if(!columnFile){
+			std::cerr << programName << ": Error: Could not open file :" << inputArgs.fileName << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
 	else {
 		inputScenario = readFile(inputArgs.fileName, programName);
 	}
 	
+	solarSystem.setForcePrecision(inputArgs.precision);
+	solarSystem.setTileLengths(inputArgs.targetTile, inputArgs.sourceTile);
+	solarSystem.setIntegrator(inputArgs.integrator);
+	solarSystem.setTimestepAccuracy(inputArgs.accuracy);
+	solarSystem.setCollisions(inputArgs.collisions);
+	solarSystem.setErrorTolerance(inputArgs.tolerance);
+	solarSystem.setRegularization(inputArgs.regularize);
+	// The ensemble shares out whole replicas, so the system itself needs no threads of its own
+	solarSystem.setNumThreads((inputArgs.ensemble > 0) ? 1 : inputArgs.threads, inputArgs.pinThreads);
+	solarSystem.setCostBalancing(inputArgs.balance > 0, inputArgs.balance);
+	solarSystem.setReorderInterval(inputArgs.reorder, inputArgs.curve);
+	solarSystem.setDeterministic(inputArgs.deterministic);
+	
 	// Implements Req FR.Initiate
-	solarSystemParseResult = solarSystem.parse(inputScenario);
+	if(restartResult == NBodySim::SnapshotFileSpace::SUCCESS){
+		// The particles are streamed in a batch at a time, so only one batch is held besides the system
+		const size_t restartBatchLength = 65536;
+		std::vector<NBodySim::Particle<NBodySim::FloatingType> > restartParticles;
+		
+		solarSystem.setGravitation(restartFile.getGravitation());
+		solarSystem.beginParticles(restartFile.numParticles());
+		for(size_t first = 0; first < restartFile.numParticles(); first += restartBatchLength){
+			restartResult = restartFile.readParticles(first, std::min(restartBatchLength, restartFile.numParticles() - first), restartParticles);
+			if(restartResult != NBodySim::SnapshotFileSpace::SUCCESS){
+				std::cerr << programName << ": Error: " << NBodySim::SnapshotFile<NBodySim::FloatingType>::errorToString(restartResult) << " :" << inputArgs.fileName << std::endl;
+				return EXIT_FAILURE;
+			}
+			solarSystem.appendParticles(restartParticles.data(), restartParticles.size());
+		}
+		solarSystemParseResult = solarSystem.commitParticles();
+	}
+	else {
+		solarSystemParseResult = columnFile.is_open() ? solarSystem.parseColumns(columnFile) : solarSystem.parse(inputScenario);
+	}
 	if(solarSystemParseResult != NBodySim::NBodySystemSpace::SUCCESS){
-		std::cerr << programName << ": Error: " << NBodySim::NBodySystem<NBodySim::FloatingType>::errorToString(solarSystemParseResult) << std::endl;
+		std::cerr << programName << ": Error: " << NBodySim::NBodySystem<NBodySim::FloatingType>::errorToString(solarSystemParseResult);
+		if(solarSystem.getParseErrorLine() > 0){
+			std::cerr << " on line " << solarSystem.getParseErrorLine();
+		}
+		std::cerr << std::endl;
 		return EXIT_FAILURE;
 	}
 	
+	if(inputArgs.ensemble > 0){
+		NBodySim::Ensemble<NBodySim::FloatingType> ensemble;
+		NBodySim::TaskScheduler scheduler(inputArgs.threads, inputArgs.pinThreads);
+		std::ofstream summary;
+		
+		ensemble.setForcePrecision(inputArgs.precision);
+		ensemble.generate(solarSystem, inputArgs.ensemble, inputArgs.perturbation, inputArgs.seed);
+		ensemble.run(inputArgs.steps, inputArgs.stepSize, &scheduler);
+		if(inputArgs.summaryFile.length() == 0){
+			ensemble.writeSummary(std::cout);
+			return EXIT_SUCCESS;
+		}
+		summary.open(inputArgs.summaryFile.c_str());
+		if(!summary){
+			std::cerr << programName << ": Error: Could not open file :" << inputArgs.summaryFile << std::endl;
+			return EXIT_FAILURE;
+		}
+		ensemble.writeSummary(summary);
+		return EXIT_SUCCESS;
+	}
+	
+	// Snapshots are written by a stage of the pipeline, so writing them costs the stepping thread only a copy
+	std::ofstream snapshotFile;
+	std::unique_ptr<NBodySim::SnapshotWriter<NBodySim::FloatingType> > snapshotWriter;
+	NBodySim::StepPipeline<NBodySim::FloatingType> pipeline(&solarSystem, inputArgs.outputInterval);
+	// Only the particles the filter selects are written, the stage that writes is the only one using it
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> outputFilter;
+	if(inputArgs.outputBox.size() == 6){
+		NBodySim::ThreeVector<NBodySim::FloatingType> low = {inputArgs.outputBox[0], inputArgs.outputBox[1], inputArgs.outputBox[2]};
+		NBodySim::ThreeVector<NBodySim::FloatingType> high = {inputArgs.outputBox[3], inputArgs.outputBox[4], inputArgs.outputBox[5]};
+		outputFilter.setBox(low, high);
+	}
+	if(inputArgs.outputSphere.size() == 4){
+		NBodySim::ThreeVector<NBodySim::FloatingType> center = {inputArgs.outputSphere[0], inputArgs.outputSphere[1], inputArgs.outputSphere[2]};
+		outputFilter.setSphere(center, inputArgs.outputSphere[3]);
+	}
+	outputFilter.setStride(inputArgs.outputEvery);
+	outputFilter.setFraction(inputArgs.outputFraction, inputArgs.seed);
+	outputFilter.setNamePattern(inputArgs.outputNames);
+	if(inputArgs.outputFile.length() > 0 && isSnapshotFile(inputArgs.outputFile)){
+		// Every snapshot gets a file of its own, which a later run can restart from, written past the page cache
+		snapshotWriter.reset(new NBodySim::SnapshotWriter<NBodySim::FloatingType>());
+		pipeline.addStage([&inputArgs, &programName, &outputFilter, &snapshotWriter, G = solarSystem.getGravitation(), filtered = NBodySim::Snapshot<NBodySim::FloatingType>()](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot) mutable{
+			const NBodySim::Snapshot<NBodySim::FloatingType> & selected = filterSnapshot(outputFilter, snapshot, filtered);
+			std::string name = snapshotFileName(inputArgs.outputFile, selected.step);
+			NBodySim::SnapshotFileSpace::error result = snapshotWriter->write(name, selected.particles, selected.step, selected.time, G);
+			if(result != NBodySim::SnapshotFileSpace::SUCCESS){
+				std::cerr << programName << ": Error: " << NBodySim::SnapshotFile<NBodySim::FloatingType>::errorToString(result) << " :" << name << std::endl;
+			}
+		});
+	}
+	else if(inputArgs.outputFile.length() > 0){
+		snapshotFile.open(inputArgs.outputFile.c_str());
+		if(!snapshotFile){
+			std::cerr << programName << ": Error: Could not open file :" << inputArgs.outputFile << std::endl;
+			return EXIT_FAILURE;
+		}
+		// The column names are written once, above the first snapshot
+		pipeline.addStage([&snapshotFile, &inputArgs, &outputFilter, header = true, filtered = NBodySim::Snapshot<NBodySim::FloatingType>()](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot) mutable{
+			writeSnapshot(snapshotFile, filterSnapshot(outputFilter, snapshot, filtered), columnDelimiter(inputArgs.outputFile), header);
+			header = false;
+		});
+	}
+	
+	if(inputArgs.hashInterval > 0){
+		// Snapshots hold the particles in index order, so the hash is that of the system at the step
+		pipeline.addStage([](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot){
+			std::cout << "step " << snapshot.step << " hash " << std::hex << std::setw(16) << std::setfill('0') << NBodySim::NBodySystem<NBodySim::FloatingType>::stateHash(snapshot.particles) << std::dec << std::setfill(' ') << std::endl;
+		}, inputArgs.hashInterval);
+	}
+	
 	// Start the GUI
 	guiErrorReturn = guiInit(&gWindow, &gRenderer, &timeAccelSurf, &timeAccelTex, &gButtons, inputArgs.length, inputArgs.width, sizeof(timeWarpFactors) / sizeof(const size_t),  triangleMargin, triangleWidth, triangleHeight);
 	if(guiErrorReturn != SUCCESS){
@@ -551,8 +1089,10 @@ int main(int argc, char* argv[]){
 	
 	// Create a thread for the timer
 	boost::thread timingThread(timingFunction, inputArgs.stepSize, numTimingSems, timingSemaphores, &quit);
-	// Create a thread for the worker
-	boost::thread workerThread(workThread, inputArgs.stepSize, timingSemaphores[1], &quit, &solarSystem, &stepsPerTime);
+	// Create a thread for the worker, the render loop reads the system between its steps
+	boost::mutex stepMutex;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > frame;
+	boost::thread workerThread(pipelineWorkThread, inputArgs.stepSize, timingSemaphores[1], &quit, &pipeline, &stepsPerTime, &stepMutex);
 	
 	//While application is running
 	while( !quit )
@@ -641,10 +1181,19 @@ int main(int argc, char* argv[]){
 		}
 		
 		SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
+		// The view is only valid between steps, so the particles are copied out under the lock the worker steps under
+		{
+			boost::unique_lock<boost::mutex> lock(stepMutex);
+			NBodySim::ParticleView<NBodySim::FloatingType> particles = solarSystem.viewParticles();
+			frame.resize(particles.size());
+			for(size_t i = 0; i < particles.size(); i++){
+				frame[i] = particles[i];
+			}
+		}
 		// Draw all the particles as points
-		for(unsigned i = 0; i < solarSystem.numParticles(); i++){
+		for(size_t i = 0; i < frame.size(); i++){
 			
-			projectedPoints = graphicsMatrix.calculateProjection(solarSystem.getParticle(i));
+			projectedPoints = graphicsMatrix.calculateProjection(frame[i]);
 			
 			SDL_RenderDrawPoint(gRenderer, (projectedPoints(0)/inputArgs.resolution) + (inputArgs.width/2), (projectedPoints(1)/inputArgs.resolution) + (inputArgs.length/2));
 		}
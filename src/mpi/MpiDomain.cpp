@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+#include <mpi.h>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+#include "NameTable.h"
+#include "SpaceFillingCurve.h"
+#include "MpiDomain.h"
+
+namespace NBodySim {
+	namespace MpiDomainSpace {
+		/**
+		 * sourceLength is how many values one particle takes in the source exchange, its position and G times its mass
+		 */
+		const int sourceLength = 4;
+		/**
+		 * stateLength is how many values one particle takes in a gathered snapshot, its position, velocity, mass and radius
+		 */
+		const int stateLength = 8;
+	}
+}
+
+template <class T>
+NBodySim::MpiDomain<T>::MpiDomain(void){
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+}
+
+template <class T>
+NBodySim::MpiDomain<T>::~MpiDomain(void){
+
+}
+
+template <class T>
+int NBodySim::MpiDomain<T>::getRank(void){
+	return rank;
+}
+
+template <class T>
+int NBodySim::MpiDomain<T>::getNumRanks(void){
+	return numRanks;
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::cut(size_t numParticles){
+	counts.resize(numRanks);
+	displacements.resize(numRanks);
+	for(int r = 0; r < numRanks; r++){
+		displacements[r] = numParticles * r / numRanks;
+		counts[r] = numParticles * (r + 1) / numRanks - displacements[r];
+	}
+}
+
+template <class T>
+size_t NBodySim::MpiDomain<T>::getFirst(void){
+	return displacements.at(rank);
+}
+
+template <class T>
+size_t NBodySim::MpiDomain<T>::getCount(void){
+	return counts.at(rank);
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::pack(const NBodySim::Particle<T> & p, T * values){
+	values[0] = p.getPos().x;
+	values[1] = p.getPos().y;
+	values[2] = p.getPos().z;
+	values[3] = p.getVel().x;
+	values[4] = p.getVel().y;
+	values[5] = p.getVel().z;
+	values[6] = p.getMass();
+	values[7] = p.getRadius();
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::unpack(const T * values, NBodySim::Particle<T> & p){
+	NBodySim::ThreeVector<T> position;
+	NBodySim::ThreeVector<T> velocity;
+
+	position.x = values[0];
+	position.y = values[1];
+	position.z = values[2];
+	velocity.x = values[3];
+	velocity.y = values[4];
+	velocity.z = values[5];
+	p.setPos(position);
+	p.setVel(velocity);
+	p.setMass(values[6]);
+	p.setRadius(values[7]);
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::scatter(const std::vector<NBodySim::Particle<T> > & all, std::vector<NBodySim::Particle<T> > & mine, NBodySim::curveType curve){
+	size_t numLocal = counts[rank];
+	NBodySim::SpaceFillingCurve<T> sorter;
+	MPI_Datatype state;
+
+	// Names are interned per process, the first process keeps them to label what it gathers
+	nameIds.clear();
+	curveOrder.clear();
+	sendBuffer.clear();
+	if(rank == 0){
+		// Ids follow the curve, so the contiguous run of ids of every process is a stretch of the curve
+		sorter.order(all, curve, NULL, curveOrder);
+		sendBuffer.resize(all.size() * NBodySim::MpiDomainSpace::stateLength);
+		for(size_t k = 0; k < all.size(); k++){
+			pack(all[curveOrder[k]], &sendBuffer[NBodySim::MpiDomainSpace::stateLength * k]);
+			nameIds.push_back(all[k].getNameId());
+		}
+	}
+	receiveBuffer.resize(numLocal * NBodySim::MpiDomainSpace::stateLength);
+
+	MPI_Type_contiguous(NBodySim::MpiDomainSpace::stateLength * sizeof(T), MPI_BYTE, &state);
+	MPI_Type_commit(&state);
+	MPI_Scatterv(sendBuffer.data(), counts.data(), displacements.data(), state, receiveBuffer.data(), numLocal, state, 0, MPI_COMM_WORLD);
+	MPI_Type_free(&state);
+
+	mine.resize(numLocal);
+	for(size_t i = 0; i < numLocal; i++){
+		unpack(&receiveBuffer[NBodySim::MpiDomainSpace::stateLength * i], mine[i]);
+		mine[i].setNameId((rank == 0) ? nameIds[curveOrder[i]] : NBodySim::NameTableSpace::emptyName);
+	}
+	// The first process holds every particle only until it has sent them
+	std::vector<T>().swap(sendBuffer);
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::decompose(const std::vector<NBodySim::Particle<T> > & mine, NBodySim::NBodySystem<T> & local){
+	for(size_t i = 0; i < mine.size(); i++){
+		local.addParticle(mine[i]);
+	}
+	local.setSourceExchange([this](typename NBodySim::NBodySystem<T>::sourceArray & x, typename NBodySim::NBodySystem<T>::sourceArray & y, typename NBodySim::NBodySystem<T>::sourceArray & z, typename NBodySim::NBodySystem<T>::sourceArray & gm, const std::function<void(void)> & sumBlock){
+		exchange(x, y, z, gm, sumBlock);
+	});
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::exchange(typename NBodySim::NBodySystem<T>::sourceArray & x, typename NBodySim::NBodySystem<T>::sourceArray & y, typename NBodySim::NBodySystem<T>::sourceArray & z, typename NBodySim::NBodySystem<T>::sourceArray & gm, const std::function<void(void)> & sumBlock){
+	size_t numLocal = counts[rank];
+	size_t blockLength = *std::max_element(counts.begin(), counts.end());
+	MPI_Datatype source;
+	MPI_Request request;
+	T * block[2];
+	const T * values;
+
+	sendBuffer.resize(numLocal * NBodySim::MpiDomainSpace::sourceLength);
+	for(size_t i = 0; i < numLocal; i++){
+		sendBuffer[NBodySim::MpiDomainSpace::sourceLength * i] = x[i];
+		sendBuffer[NBodySim::MpiDomainSpace::sourceLength * i + 1] = y[i];
+		sendBuffer[NBodySim::MpiDomainSpace::sourceLength * i + 2] = z[i];
+		sendBuffer[NBodySim::MpiDomainSpace::sourceLength * i + 3] = gm[i];
+	}
+	for(int k = 0; k < 2; k++){
+		blockBuffers[k].resize(blockLength * NBodySim::MpiDomainSpace::sourceLength);
+		block[k] = blockBuffers[k].data();
+	}
+
+	// One element per particle keeps the counts in particles, far from the limit of an int
+	MPI_Type_contiguous(NBodySim::MpiDomainSpace::sourceLength * sizeof(T), MPI_BYTE, &source);
+	MPI_Type_commit(&source);
+	// Every process broadcasts its own sources straight from its send buffer and receives the others in turn
+	MPI_Ibcast((rank == 0) ? sendBuffer.data() : block[0], counts[0], source, 0, MPI_COMM_WORLD, &request);
+	for(int r = 0; r < numRanks; r++){
+		MPI_Wait(&request, MPI_STATUS_IGNORE);
+		// The next block travels while this one is summed, into the buffer the block before this one was summed from
+		if(r + 1 < numRanks){
+			MPI_Ibcast((rank == r + 1) ? sendBuffer.data() : block[(r + 1) % 2], counts[r + 1], source, r + 1, MPI_COMM_WORLD, &request);
+		}
+		values = (rank == r) ? sendBuffer.data() : block[r % 2];
+		x.resize(counts[r]);
+		y.resize(counts[r]);
+		z.resize(counts[r]);
+		gm.resize(counts[r]);
+		for(int k = 0; k < counts[r]; k++){
+			x[k] = values[NBodySim::MpiDomainSpace::sourceLength * k];
+			y[k] = values[NBodySim::MpiDomainSpace::sourceLength * k + 1];
+			z[k] = values[NBodySim::MpiDomainSpace::sourceLength * k + 2];
+			gm[k] = values[NBodySim::MpiDomainSpace::sourceLength * k + 3];
+		}
+		sumBlock();
+	}
+	MPI_Type_free(&source);
+}
+
+template <class T>
+void NBodySim::MpiDomain<T>::gather(NBodySim::NBodySystem<T> & local, std::vector<NBodySim::Particle<T> > & all){
+	size_t numLocal = local.numParticles();
+	size_t numParticles = displacements.back() + counts.back();
+	NBodySim::ParticleView<T> particles = local.viewParticles();
+	MPI_Datatype state;
+
+	sendBuffer.resize(numLocal * NBodySim::MpiDomainSpace::stateLength);
+	for(size_t i = 0; i < numLocal; i++){
+		pack(particles[i], &sendBuffer[NBodySim::MpiDomainSpace::stateLength * i]);
+	}
+	receiveBuffer.resize((rank == 0) ? numParticles * NBodySim::MpiDomainSpace::stateLength : 0);
+
+	MPI_Type_contiguous(NBodySim::MpiDomainSpace::stateLength * sizeof(T), MPI_BYTE, &state);
+	MPI_Type_commit(&state);
+	MPI_Gatherv(sendBuffer.data(), numLocal, state, receiveBuffer.data(), counts.data(), displacements.data(), state, 0, MPI_COMM_WORLD);
+	MPI_Type_free(&state);
+
+	all.clear();
+	if(rank != 0){
+		return;
+	}
+	// The runs arrive in id order, every particle goes back to the index it was given at
+	all.resize(numParticles);
+	for(size_t k = 0; k < numParticles; k++){
+		unpack(&receiveBuffer[NBodySim::MpiDomainSpace::stateLength * k], all[curveOrder[k]]);
+		all[curveOrder[k]].setNameId(nameIds[curveOrder[k]]);
+		all[curveOrder[k]].setId(curveOrder[k]);
+	}
+}
+
+template class NBodySim::MpiDomain<NBodySim::FloatingType>;
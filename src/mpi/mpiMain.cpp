@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <getopt.h>
+#include <mpi.h>
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+#include "MpiDomain.h"
+
+/**
+ * List of arguments of the distributed simulation
+ */
+typedef struct {
+	bool help;                       /**< Indicates the user asked for help */
+	std::string fileName;            /**< Input xml file with the initial conditions */
+	std::string outputName;          /**< File the final snapshot is written to, empty writes it to standard output */
+	NBodySim::FloatingType stepSize; /**< Simulation step size in seconds */
+	unsigned numSteps;               /**< Number of steps to simulate */
+	unsigned threads;                /**< Number of threads sharing the force calculation of every process */
+	NBodySim::curveType curve;       /**< Space filling curve the particles are cut along */
+	bool badCurve;                   /**< Indicates the curve given by the user was not recognized */
+	bool deterministic;              /**< Indicates whether the force sums are compensated */
+	unsigned hashInterval;           /**< Steps between the state hashes printed, 0 prints none */
+} mpiArgsList;
+
+/**
+ * @brief parseArgs parses input arguments from the user
+ *
+ * @param argc the number of space separated words in the command
+ * @param argv an array of words in the input
+ * @return a list of arguments selected by the user
+ */
+mpiArgsList parseArgs(int argc, char* argv[]){
+	int c;
+	int option_index = 0;
+	static struct option long_options[] =
+	{
+		{"help",        no_argument,       0, 'h'},
+		{"input-file",  required_argument, 0, 'i'},
+		{"output-file", required_argument, 0, 'o'},
+		{"step-size",   required_argument, 0, 's'},
+		{"steps",       required_argument, 0, 'n'},
+		{"threads",     required_argument, 0, 'j'},
+		{"curve",       required_argument, 0, 'k'},
+		{"deterministic", no_argument,     0, 'D'},
+		{"hash-interval", required_argument, 0, 'H'},
+		{0, 0, 0, 0}
+	};
+	mpiArgsList output;
+
+	output.help = false;
+	output.fileName = "";
+	output.outputName = "";
+	output.stepSize = 0.033;
+	output.numSteps = 1;
+	output.threads = 1;
+	output.curve = NBodySim::HILBERT;
+	output.badCurve = false;
+	output.deterministic = false;
+	output.hashInterval = 0;
+
+	while ((c = getopt_long(argc, argv, "hi:o:s:n:j:k:DH:", long_options, &option_index)) != -1){
+		switch (c)
+		{
+			case 'h':
+				output.help = true;
+				break;
+			case 'i':
+				output.fileName = optarg;
+				break;
+			case 'o':
+				output.outputName = optarg;
+				break;
+			case 's':
+				output.stepSize = atof(optarg);
+				break;
+			case 'n':
+				output.numSteps = atoi(optarg);
+				break;
+			case 'j':
+				output.threads = atoi(optarg);
+				break;
+			case 'k':
+				if(strcmp(optarg, "morton") == 0){
+					output.curve = NBodySim::MORTON;
+				}
+				else if(strcmp(optarg, "hilbert") == 0){
+					output.curve = NBodySim::HILBERT;
+				}
+				else{
+					output.badCurve = true;
+				}
+				break;
+			case 'D':
+				output.deterministic = true;
+				break;
+			case 'H':
+				output.hashInterval = atoi(optarg);
+				break;
+			default:
+				output.help = true;
+				break;
+		}
+	}
+	return output;
+}
+
+/**
+ * @brief writeSnapshot writes one line per particle with its name, position, velocity and mass
+ *
+ * @param out is the stream to write to
+ * @param all is every particle of the simulation
+ */
+void writeSnapshot(std::ostream & out, std::vector<NBodySim::Particle<NBodySim::FloatingType> > & all){
+	out.precision(17);
+	for(size_t i = 0; i < all.size(); i++){
+		out << all[i].getName() << " " << all[i].getPos().x << " " << all[i].getPos().y << " " << all[i].getPos().z << " ";
+		out << all[i].getVel().x << " " << all[i].getVel().y << " " << all[i].getVel().z << " " << all[i].getMass() << std::endl;
+	}
+}
+
+int main(int argc, char* argv[]){
+	std::string programName = argv[0];
+	mpiArgsList inputArgs;
+	std::string scenarioText;
+	NBodySim::NBodySystem<NBodySim::FloatingType> local;
+	NBodySim::NBodySystemSpace::error parseResult = NBodySim::NBodySystemSpace::SUCCESS;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > all;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > mine;
+	unsigned long numParticles = 0;
+	NBodySim::FloatingType G = 0;
+	int parseCode;
+	int status = EXIT_SUCCESS;
+
+	MPI_Init(&argc, &argv);
+	NBodySim::MpiDomain<NBodySim::FloatingType> domain;
+	inputArgs = parseArgs(argc, argv);
+
+	if(inputArgs.help || inputArgs.fileName.length() == 0 || inputArgs.badCurve){
+		if(domain.getRank() == 0){
+			std::cout << "Usage: mpirun -np [processes] " << programName << " -i [Filename] [flags]" << std::endl;
+			std::cout << "\t-i, --input-file [Filename]: Input xml file with initial conditions" << std::endl;
+			std::cout << "\t-o, --output-file [Filename]: File the final particles are written to, standard output by default" << std::endl;
+			std::cout << "\t-s, --step-size  [float]   : Simulation step size in seconds" << std::endl;
+			std::cout << "\t-n, --steps      [int]     : Number of steps to simulate" << std::endl;
+			std::cout << "\t-j, --threads    [int]     : Threads sharing the force calculation of every process" << std::endl;
+			std::cout << "\t-k, --curve [morton|hilbert] : Space filling curve the particles are cut along, hilbert by default" << std::endl;
+			std::cout << "\t-D, --deterministic        : Sum the forces with compensation" << std::endl;
+			std::cout << "\t-H, --hash-interval [int]  : Print a hash of the exact state every this many steps, equal to that of a single process run" << std::endl;
+			std::cout << "\t-h, --help                 : Shows this help option" << std::endl;
+		}
+		MPI_Finalize();
+		return inputArgs.help ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Only the first process reads the scenario, the others learn how it went and receive their stretch of the curve
+	if(domain.getRank() == 0){
+		NBodySim::NBodySystem<NBodySim::FloatingType> scenario;
+		std::ifstream scenarioFile(inputArgs.fileName.c_str());
+		scenarioText.assign((std::istreambuf_iterator<char>(scenarioFile)), std::istreambuf_iterator<char>());
+		scenario.setNumThreads(inputArgs.threads);
+		parseResult = scenario.parse(scenarioText);
+		std::string().swap(scenarioText);
+		if(parseResult != NBodySim::NBodySystemSpace::SUCCESS){
+			std::cerr << programName << ": Error: " << NBodySim::NBodySystem<NBodySim::FloatingType>::errorToString(parseResult);
+			if(scenario.getParseErrorLine() > 0){
+				std::cerr << " on line " << scenario.getParseErrorLine();
+			}
+			std::cerr << std::endl;
+		}
+		scenario.copyParticles(all);
+		numParticles = all.size();
+		G = scenario.getGravitation();
+	}
+	parseCode = parseResult;
+	MPI_Bcast(&parseCode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if(parseCode != NBodySim::NBodySystemSpace::SUCCESS){
+		MPI_Finalize();
+		return EXIT_FAILURE;
+	}
+	MPI_Bcast(&numParticles, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&G, sizeof(G), MPI_BYTE, 0, MPI_COMM_WORLD);
+	domain.cut(numParticles);
+	domain.scatter(all, mine, inputArgs.curve);
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> >().swap(all);
+	local.setGravitation(G);
+	local.setNumThreads(inputArgs.threads);
+	local.setDeterministic(inputArgs.deterministic);
+	domain.decompose(mine, local);
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> >().swap(mine);
+
+	for(unsigned step = 1; step <= inputArgs.numSteps; step++){
+		local.step(inputArgs.stepSize);
+		// The particles are gathered in id order, so the hash is that of one process stepping them all
+		if(inputArgs.hashInterval > 0 && step % inputArgs.hashInterval == 0){
+			domain.gather(local, all);
+			if(domain.getRank() == 0){
+				std::cout << "step " << step << " hash " << std::hex << std::setw(16) << std::setfill('0') << NBodySim::NBodySystem<NBodySim::FloatingType>::stateHash(all) << std::dec << std::setfill(' ') << std::endl;
+			}
+		}
+	}
+
+	domain.gather(local, all);
+	if(domain.getRank() == 0){
+		if(inputArgs.outputName.length() == 0){
+			writeSnapshot(std::cout, all);
+		}
+		else{
+			std::ofstream outputFile(inputArgs.outputName.c_str());
+			if(outputFile.is_open()){
+				writeSnapshot(outputFile, all);
+			}
+			else{
+				std::cerr << programName << ": Error: Could not open file :" << inputArgs.outputName << std::endl;
+				status = EXIT_FAILURE;
+			}
+		}
+	}
+	MPI_Finalize();
+	return status;
+}
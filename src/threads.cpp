@@ -76,3 +76,36 @@ void * workThread(NBodySim::FloatingType stepSize, boost::interprocess::interpro
 	return NULL;
 	
 }
+
+void * pipelineWorkThread(NBodySim::FloatingType stepSize, boost::interprocess::interprocess_semaphore * timingSem, volatile bool * quitTiming, NBodySim::StepPipeline<NBodySim::FloatingType> * pipeline, volatile size_t * stepsPerTime, boost::mutex * stepMutex){
+	
+	if(timingSem == NULL){
+		return NULL;
+	}
+	if(quitTiming == NULL){
+		return NULL;
+	}
+	if(pipeline == NULL){
+		return NULL;
+	}
+	if(stepsPerTime == NULL){
+		return NULL;
+	}
+	if(stepMutex == NULL){
+		return NULL;
+	}
+	
+	// For each iteration, wait on a semaphore
+	while(!(*quitTiming)){
+		timingSem->wait();
+		// Implements Req FR.Calculate
+		for(size_t i = 0; i < *stepsPerTime && !(*quitTiming); i++){
+			// The lock is taken per step, so a reader waits for at most one step
+			boost::unique_lock<boost::mutex> lock(*stepMutex);
+			pipeline->step(stepSize);
+		}
+	}
+	
+	return NULL;
+	
+}
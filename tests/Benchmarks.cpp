@@ -0,0 +1,875 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "rapidxml.hpp"
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+#include "TaskScheduler.h"
+#include "Ensemble.h"
+#include "StepPipeline.h"
+#include "SnapshotFile.h"
+#include "SnapshotWriter.h"
+#include "SnapshotFilter.h"
+
+/**
+ * @brief makeCluster fills a system with particles spread uniformly through a cube
+ *
+ * @param sys is the system the particles are added to
+ * @param numParticles is the number of particles to add
+ * @param seed seeds the random number generator so every run produces the same system
+ */
+void makeCluster(NBodySim::NBodySystem<NBodySim::FloatingType> * sys, size_t numParticles, unsigned seed){
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<NBodySim::FloatingType> position(-1e3, 1e3);
+	std::uniform_real_distribution<NBodySim::FloatingType> mass(1e5, 1e7);
+	NBodySim::Particle<NBodySim::FloatingType> p;
+
+	for(size_t i = 0; i < numParticles; i++){
+		p.setPosX(position(generator));
+		p.setPosY(position(generator));
+		p.setPosZ(position(generator));
+		p.setMass(mass(generator));
+		sys->addParticle(p);
+	}
+}
+
+/**
+ * @brief timeSteps returns the average wall clock time of one call to step
+ *
+ * @param sys is the system to step
+ * @param numSteps is the number of steps to average over
+ * @return the average time of a step in nanoseconds
+ */
+double timeSteps(NBodySim::NBodySystem<NBodySim::FloatingType> * sys, size_t numSteps){
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for(size_t i = 0; i < numSteps; i++){
+		sys->step(1e-3);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numSteps;
+}
+
+/**
+ * @brief benchmarkForcePrecision compares each force precision against the std::sqrt path for several system sizes
+ */
+void benchmarkForcePrecision(void){
+	const size_t sizes[] = {8, 32, 512, 2048};
+	const NBodySim::forcePrecision precisions[] = {NBodySim::ACCURATE, NBodySim::REFINED, NBodySim::FAST};
+	const char * names[] = {"accurate", "refined", "fast"};
+	double accurateTime;
+	double time;
+
+	std::cout << "Force precision (ns per step)" << std::endl;
+	std::cout << std::setw(8) << "N" << std::setw(12) << "precision" << std::setw(16) << "ns/step" << std::setw(10) << "speedup" << std::endl;
+	for(size_t i = 0; i < sizeof(sizes) / sizeof(size_t); i++){
+		// Keep roughly the same number of interactions for every size
+		size_t numSteps = 1 + 20000000 / (sizes[i] * sizes[i]);
+		accurateTime = 0;
+		for(size_t j = 0; j < sizeof(precisions) / sizeof(NBodySim::forcePrecision); j++){
+			NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+			makeCluster(&sys, sizes[i], 1);
+			sys.setForcePrecision(precisions[j]);
+			time = timeSteps(&sys, numSteps);
+			if(precisions[j] == NBodySim::ACCURATE){
+				accurateTime = time;
+			}
+			std::cout << std::setw(8) << sizes[i] << std::setw(12) << names[j] << std::setw(16) << std::fixed << std::setprecision(0) << time;
+			std::cout << std::setw(10) << std::setprecision(2) << accurateTime / time << std::endl;
+		}
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkTiling compares the tiled direct summation against one target per tile, which streams every source for every target
+ */
+void benchmarkTiling(void){
+	const size_t sizes[] = {2048, 8192};
+	double untiledTime;
+	double tiledTime;
+
+	std::cout << "Tiled direct summation (ns per step)" << std::endl;
+	std::cout << std::setw(8) << "N" << std::setw(10) << "tiles" << std::setw(16) << "ns/step" << std::setw(10) << "speedup" << std::endl;
+	for(size_t i = 0; i < sizeof(sizes) / sizeof(size_t); i++){
+		NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+		makeCluster(&sys, sizes[i], 1);
+
+		sys.setTileLengths(1, sizes[i]);
+		untiledTime = timeSteps(&sys, 1);
+		std::cout << std::setw(8) << sizes[i] << std::setw(10) << "1x" + std::to_string(sizes[i]) << std::setw(16) << std::fixed << std::setprecision(0) << untiledTime;
+		std::cout << std::setw(10) << std::setprecision(2) << 1.0 << std::endl;
+
+		sys.setTileLengths(0, 0);
+		tiledTime = timeSteps(&sys, 1);
+		std::cout << std::setw(8) << sizes[i] << std::setw(10) << std::to_string(sys.getTargetTileLength()) + "x" + std::to_string(sys.getSourceTileLength());
+		std::cout << std::setw(16) << std::setprecision(0) << tiledTime << std::setw(10) << std::setprecision(2) << untiledTime / tiledTime << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkScheduler compares work stealing against static partitioning on a neighbour search over a clustered
+ * distribution, where the particles in the cluster cost far more than the ones around it
+ */
+void benchmarkScheduler(void){
+	const size_t numParticles = 100000;
+	const size_t numClustered = numParticles / 5;
+	const double radius = 0.5;
+	const double halfWidth = 50;
+	const unsigned threadCounts[] = {1, 2, 4, 8};
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	std::vector<double> x(numParticles);
+	std::vector<double> y(numParticles);
+	std::vector<double> z(numParticles);
+	std::vector<std::pair<int64_t, size_t> > cells(numParticles);
+	std::vector<unsigned> neighbours(numParticles);
+	double r;
+	double cosTheta;
+	double phi;
+	double staticTime;
+	double stealingTime;
+	size_t staticSum;
+	size_t stealingSum;
+	
+	// A Plummer sphere first, then a uniform background, so a static split hands the whole cluster to the first threads
+	for(size_t i = 0; i < numParticles; i++){
+		if(i < numClustered){
+			r = std::min(halfWidth, 1 / std::sqrt(std::pow(uniform(generator), -2.0 / 3) - 1));
+			cosTheta = 2 * uniform(generator) - 1;
+			phi = 2 * M_PI * uniform(generator);
+			x[i] = r * std::sqrt(1 - cosTheta * cosTheta) * std::cos(phi);
+			y[i] = r * std::sqrt(1 - cosTheta * cosTheta) * std::sin(phi);
+			z[i] = r * cosTheta;
+		}
+		else{
+			x[i] = halfWidth * (2 * uniform(generator) - 1);
+			y[i] = halfWidth * (2 * uniform(generator) - 1);
+			z[i] = halfWidth * (2 * uniform(generator) - 1);
+		}
+	}
+	
+	// Sort the particles by grid cell, one radius wide, so the neighbours of a particle are in 27 runs of the list
+	const int64_t cellsPerSide = static_cast<int64_t>(2 * halfWidth / radius) + 2;
+	auto cellKey = [cellsPerSide](int64_t cx, int64_t cy, int64_t cz){
+		return (cx * cellsPerSide + cy) * cellsPerSide + cz;
+	};
+	auto cellOf = [radius, halfWidth](double position){
+		return static_cast<int64_t>((position + halfWidth) / radius) + 1;
+	};
+	for(size_t i = 0; i < numParticles; i++){
+		cells[i] = std::make_pair(cellKey(cellOf(x[i]), cellOf(y[i]), cellOf(z[i])), i);
+	}
+	std::sort(cells.begin(), cells.end());
+	
+	NBodySim::TaskScheduler::rangeFunction countNeighbours = [&](size_t first, size_t last){
+		for(size_t i = first; i < last; i++){
+			unsigned count = 0;
+			for(int64_t dx = -1; dx <= 1; dx++){
+				for(int64_t dy = -1; dy <= 1; dy++){
+					for(int64_t dz = -1; dz <= 1; dz++){
+						int64_t key = cellKey(cellOf(x[i]) + dx, cellOf(y[i]) + dy, cellOf(z[i]) + dz);
+						auto run = std::equal_range(cells.begin(), cells.end(), std::make_pair(key, static_cast<size_t>(0)), [](const std::pair<int64_t, size_t> & a, const std::pair<int64_t, size_t> & b){
+							return a.first < b.first;
+						});
+						for(auto k = run.first; k != run.second; k++){
+							double ddx = x[k->second] - x[i];
+							double ddy = y[k->second] - y[i];
+							double ddz = z[k->second] - z[i];
+							count += (ddx * ddx + ddy * ddy + ddz * ddz < radius * radius) ? 1 : 0;
+						}
+					}
+				}
+			}
+			neighbours[i] = count;
+		}
+	};
+	
+	std::cout << "Scheduler on a clustered neighbour search of " << numParticles << " particles (ms per pass, " << boost::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(12) << "static" << std::setw(12) << "stealing" << std::setw(10) << "speedup" << std::endl;
+	for(size_t t = 0; t < sizeof(threadCounts) / sizeof(unsigned); t++){
+		NBodySim::TaskScheduler scheduler(threadCounts[t]);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		scheduler.parallelForStatic(0, numParticles, countNeighbours);
+		staticTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		staticSum = 0;
+		for(size_t i = 0; i < numParticles; i++){
+			staticSum += neighbours[i];
+		}
+		
+		start = std::chrono::steady_clock::now();
+		scheduler.parallelFor(0, numParticles, 256, countNeighbours);
+		stealingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stealingSum = 0;
+		for(size_t i = 0; i < numParticles; i++){
+			stealingSum += neighbours[i];
+		}
+		
+		std::cout << std::setw(8) << threadCounts[t] << std::setw(12) << std::fixed << std::setprecision(1) << staticTime << std::setw(12) << stealingTime;
+		std::cout << std::setw(10) << std::setprecision(2) << staticTime / stealingTime << ((staticSum == stealingSum) ? "" : "  mismatch") << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkNumaScaling times the threaded direct summation with free threads and with threads pinned over the
+ * NUMA nodes, where every node reads its own copy of the sources
+ */
+void benchmarkNumaScaling(void){
+	const size_t numParticles = 8192;
+	const unsigned hardwareThreads = std::max(1u, boost::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	double serialTime;
+	double freeTime;
+	double pinnedTime;
+	unsigned numNodes;
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	makeCluster(&sys, numParticles, 1);
+
+	for(unsigned threads = 1; threads < hardwareThreads; threads *= 2){
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+	if(hardwareThreads == 1){
+		threadCounts.push_back(2);
+	}
+
+	sys.setNumThreads(1);
+	serialTime = timeSteps(&sys, 1);
+	std::cout << "Threaded direct summation of " << numParticles << " particles (" << hardwareThreads << " hardware threads)" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(8) << "nodes" << std::setw(16) << "free ns/step" << std::setw(10) << "speedup";
+	std::cout << std::setw(18) << "pinned ns/step" << std::setw(10) << "speedup" << std::endl;
+	for(size_t i = 0; i < threadCounts.size(); i++){
+		sys.setNumThreads(threadCounts[i], false);
+		freeTime = timeSteps(&sys, 1);
+		sys.setNumThreads(threadCounts[i], true);
+		numNodes = sys.getNumNodes();
+		pinnedTime = timeSteps(&sys, 1);
+		std::cout << std::setw(8) << threadCounts[i] << std::setw(8) << numNodes << std::setw(16) << std::fixed << std::setprecision(0) << freeTime;
+		std::cout << std::setw(10) << std::setprecision(2) << serialTime / freeTime << std::setw(18) << std::setprecision(0) << pinnedTime;
+		std::cout << std::setw(10) << std::setprecision(2) << serialTime / pinnedTime << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkEnsemble compares stepping many perturbed copies of a small system in lane batches against stepping one
+ * system per copy
+ */
+void benchmarkEnsemble(void){
+	const size_t numParticles = 8;
+	const size_t numSteps = 200;
+	const size_t replicaCounts[] = {64, 512, 4096};
+	double separateTime;
+	double ensembleTime;
+	NBodySim::NBodySystem<NBodySim::FloatingType> scenario;
+	NBodySim::TaskScheduler scheduler(0);
+	makeCluster(&scenario, numParticles, 3);
+
+	std::cout << "Ensembles of " << numParticles << " particles for " << numSteps << " steps (" << scheduler.getNumThreads() << " threads)" << std::endl;
+	std::cout << std::setw(10) << "replicas" << std::setw(20) << "separate ns/step" << std::setw(20) << "ensemble ns/step" << std::setw(10) << "speedup" << std::endl;
+	for(size_t i = 0; i < sizeof(replicaCounts) / sizeof(size_t); i++){
+		NBodySim::Ensemble<NBodySim::FloatingType> ensemble;
+		std::vector<NBodySim::NBodySystem<NBodySim::FloatingType> > systems(replicaCounts[i]);
+		for(size_t replica = 0; replica < replicaCounts[i]; replica++){
+			makeCluster(&systems[replica], numParticles, 3);
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(size_t replica = 0; replica < replicaCounts[i]; replica++){
+			timeSteps(&systems[replica], numSteps);
+		}
+		separateTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numSteps;
+
+		ensemble.generate(scenario, replicaCounts[i], 1e-8, 1);
+		start = std::chrono::steady_clock::now();
+		ensemble.run(numSteps, 1e-3, &scheduler);
+		ensembleTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numSteps;
+		std::cout << std::setw(10) << replicaCounts[i] << std::setw(20) << std::fixed << std::setprecision(0) << separateTime;
+		std::cout << std::setw(20) << ensembleTime << std::setw(10) << std::setprecision(2) << separateTime / ensembleTime << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * @brief analyseSnapshot stands in for the diagnostics of a run, it writes every particle as text and sums the kinetic
+ * energy and momentum
+ *
+ * @param snapshot is the snapshot to analyse
+ * @return the length of the text written, so the work is not optimized away
+ */
+size_t analyseSnapshot(const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot){
+	std::ostringstream out;
+	NBodySim::FloatingType kinetic = 0;
+	NBodySim::ThreeVector<NBodySim::FloatingType> momentum;
+
+	out.precision(17);
+	momentum.x = 0;
+	momentum.y = 0;
+	momentum.z = 0;
+	for(size_t i = 0; i < snapshot.particles.size(); i++){
+		const NBodySim::Particle<NBodySim::FloatingType> & p = snapshot.particles[i];
+		out << p.getName() << " " << p.getPos().x << " " << p.getPos().y << " " << p.getPos().z << " ";
+		out << p.getVel().x << " " << p.getVel().y << " " << p.getVel().z << " " << p.getMass() << '\n';
+		kinetic += p.getMass() * (p.getVel().x * p.getVel().x + p.getVel().y * p.getVel().y + p.getVel().z * p.getVel().z) / 2;
+		momentum.x += p.getMass() * p.getVel().x;
+		momentum.y += p.getMass() * p.getVel().y;
+		momentum.z += p.getMass() * p.getVel().z;
+	}
+	out << kinetic << " " << momentum.x << " " << momentum.y << " " << momentum.z << '\n';
+	return out.str().size();
+}
+
+/**
+ * @brief benchmarkPipeline compares steps with no diagnostics, with the diagnostics run between steps and with the
+ * diagnostics run by a stage of a StepPipeline
+ */
+void benchmarkPipeline(void){
+	const size_t numParticles = 4096;
+	const size_t numSteps = 20;
+	double plainTime;
+	double inlineTime;
+	double pipelinedTime;
+	size_t written = 0;
+	size_t stalls;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	NBodySim::Snapshot<NBodySim::FloatingType> snapshot;
+	makeCluster(&sys, numParticles, 5);
+	sys.setNumThreads(0);
+
+	plainTime = timeSteps(&sys, numSteps);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < numSteps; i++){
+		sys.step(1e-3);
+		sys.copyParticles(snapshot.particles);
+		written += analyseSnapshot(snapshot);
+	}
+	inlineTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numSteps;
+
+	{
+		NBodySim::StepPipeline<NBodySim::FloatingType> pipeline(&sys);
+		pipeline.addStage([&written](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot){
+			written += analyseSnapshot(snapshot);
+		});
+		start = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < numSteps; i++){
+			pipeline.step(1e-3);
+		}
+		pipeline.flush();
+		pipelinedTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numSteps;
+		stalls = pipeline.getStalls();
+	}
+
+	std::cout << "Diagnostics every step of " << numParticles << " particles (" << sys.getNumThreads() << " threads, " << written << " bytes written)" << std::endl;
+	std::cout << std::setw(12) << "none ns" << std::setw(16) << "inline ns" << std::setw(16) << "pipelined ns" << std::setw(10) << "stalls" << std::endl;
+	std::cout << std::setw(12) << std::fixed << std::setprecision(0) << plainTime << std::setw(16) << inlineTime << std::setw(16) << pipelinedTime;
+	std::cout << std::setw(10) << stalls << std::endl;
+	std::cout << std::endl;
+}
+
+/**
+ * @brief makeScenario writes the xml text of a system of particles spread uniformly through a cube
+ *
+ * @param numParticles is the number of particles
+ * @param seed seeds the random number generator so every run produces the same text
+ * @return the xml text
+ */
+std::string makeScenario(size_t numParticles, unsigned seed){
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<NBodySim::FloatingType> position(-1e12, 1e12);
+	std::uniform_real_distribution<NBodySim::FloatingType> velocity(-3e4, 3e4);
+	std::uniform_real_distribution<NBodySim::FloatingType> mass(1e20, 1e30);
+	std::ostringstream out;
+
+	out.precision(17);
+	out << "<?xml version=\"1.0\"?>\n<system G=\"6.67408e-11\">\n";
+	for(size_t i = 0; i < numParticles; i++){
+		out << "\t<particle posX=\"" << position(generator) << "\" posY=\"" << position(generator) << "\" posZ=\"" << position(generator);
+		out << "\" velX=\"" << velocity(generator) << "\" velY=\"" << velocity(generator) << "\" velZ=\"" << velocity(generator);
+		out << "\" mass=\"" << mass(generator) << "\" name=\"p" << i << "\"/>\n";
+	}
+	out << "</system>\n";
+	return out.str();
+}
+
+/**
+ * @brief parseByName loads particles the way NBodySystem::parse used to, from a copy of the text, looking up every
+ * attribute by name and converting it with atof
+ *
+ * @param xmlText is the xml text of a system
+ * @param particles receives the particles
+ */
+void parseByName(const std::string & xmlText, std::vector<NBodySim::Particle<NBodySim::FloatingType> > & particles){
+	const char * names[] = {"posX", "posY", "posZ", "velX", "velY", "velZ", "mass", "name"};
+	std::vector<char> buffer(xmlText.c_str(), xmlText.c_str() + xmlText.size() + 1);
+	rapidxml::xml_document<> doc;
+	rapidxml::xml_attribute<> *attr;
+
+	doc.parse<0>(buffer.data());
+	for(rapidxml::xml_node<> *node = doc.first_node("system")->first_node("particle"); node != NULL; node = node->next_sibling()){
+		NBodySim::Particle<NBodySim::FloatingType> p;
+		for(unsigned i = 0; i < 8; i++){
+			attr = node->first_attribute(names[i]);
+			switch(i){
+				case 0: p.setPosX(atof(attr->value())); break;
+				case 1: p.setPosY(atof(attr->value())); break;
+				case 2: p.setPosZ(atof(attr->value())); break;
+				case 3: p.setVelX(atof(attr->value())); break;
+				case 4: p.setVelY(atof(attr->value())); break;
+				case 5: p.setVelZ(atof(attr->value())); break;
+				case 6: p.setMass(atof(attr->value())); break;
+				default: p.setName(std::string(attr->value())); break;
+			}
+		}
+		particles.push_back(p);
+	}
+}
+
+/**
+ * @brief timeParse returns the wall clock time of NBodySystem::parse
+ *
+ * @param xmlText is the xml text to parse
+ * @param threads is the number of threads the system parses on
+ * @param numParticles is the number of particles the text holds, reported if the parse loads another number
+ * @return the time of the parse in seconds
+ */
+double timeParse(const std::string & xmlText, unsigned threads, size_t numParticles){
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	double elapsed;
+
+	sys.setNumThreads(threads);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	sys.parse(xmlText);
+	elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if(sys.numParticles() != numParticles){
+		std::cout << "parse loaded " << sys.numParticles() << " particles" << std::endl;
+	}
+	return elapsed;
+}
+
+/**
+ * @brief benchmarkParse compares NBodySystem::parse, on one thread and on every thread, against looking every attribute
+ * up by name on a large scenario
+ */
+void benchmarkParse(void){
+	const size_t numParticles = 1000000;
+	const unsigned threads = std::max(2u, boost::thread::hardware_concurrency());
+	std::string xmlText = makeScenario(numParticles, 9);
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	double byNameTime;
+	double parseTime;
+	double threadedTime;
+	double columnTime;
+	size_t columnLength;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	parseByName(xmlText, particles);
+	byNameTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	particles.clear();
+	particles.shrink_to_fit();
+
+	parseTime = timeParse(xmlText, 1, numParticles);
+	threadedTime = timeParse(xmlText, threads, numParticles);
+
+	// The same particles as a csv file, parsed a line at a time
+	{
+		NBodySim::NBodySystem<NBodySim::FloatingType> xmlSys;
+		NBodySim::NBodySystem<NBodySim::FloatingType> columnSys;
+		std::stringstream columns;
+		xmlSys.parse(xmlText);
+		xmlSys.writeColumns(columns, ',');
+		columnLength = columns.str().size();
+		start = std::chrono::steady_clock::now();
+		columnSys.parseColumns(columns);
+		columnTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::cout << "Loading " << numParticles << " particles from " << xmlText.size() / 1048576 << " MiB of xml (" << threads << " threads)" << std::endl;
+	std::cout << std::setw(12) << "by name s" << std::setw(10) << "MiB/s" << std::setw(12) << "parse s" << std::setw(10) << "MiB/s";
+	std::cout << std::setw(12) << "threaded s" << std::setw(10) << "MiB/s" << std::endl;
+	std::cout << std::setw(12) << std::fixed << std::setprecision(3) << byNameTime << std::setw(10) << std::setprecision(0) << xmlText.size() / 1048576.0 / byNameTime;
+	std::cout << std::setw(12) << std::setprecision(3) << parseTime << std::setw(10) << std::setprecision(0) << xmlText.size() / 1048576.0 / parseTime;
+	std::cout << std::setw(12) << std::setprecision(3) << threadedTime << std::setw(10) << std::setprecision(0) << xmlText.size() / 1048576.0 / threadedTime << std::endl;
+	std::cout << "The same particles as " << columnLength / 1048576 << " MiB of csv: " << std::setprecision(3) << columnTime << " s" << std::endl;
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkSnapshotFile times reading a large snapshot back whole, one column of it, and one mapped column,
+ * against parsing the same particles from csv, then loading it into a system a particle at a time with addParticle and
+ * in batches with appendParticles
+ */
+void benchmarkSnapshotFile(void){
+	const size_t numParticles = 1000000;
+	const std::string fileName = "BenchmarkSnapshot.nbs";
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	NBodySim::NBodySystem<NBodySim::FloatingType> columnSys;
+	NBodySim::SnapshotFile<NBodySim::FloatingType> snapshot;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	std::vector<NBodySim::FloatingType> column;
+	std::stringstream columns;
+	double writeTime;
+	double wholeTime;
+	double columnTime;
+	double mappedTime;
+	double csvTime;
+	double addTime;
+	double appendTime;
+	double sum = 0;
+
+	makeCluster(&sys, numParticles, 13);
+	sys.copyParticles(particles);
+	sys.writeColumns(columns, ',');
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	NBodySim::SnapshotFile<NBodySim::FloatingType>::write(fileName, particles, 0, 0, sys.getGravitation());
+	writeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	particles.clear();
+
+	start = std::chrono::steady_clock::now();
+	snapshot.open(fileName);
+	snapshot.readParticles(0, snapshot.numParticles(), particles);
+	wholeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	snapshot.readColumn("mass", 0, snapshot.numParticles(), column);
+	columnTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	if(snapshot.map() == NBodySim::SnapshotFileSpace::SUCCESS){
+		const double * mass = snapshot.mappedColumn("mass");
+		for(size_t i = 0; i < snapshot.numParticles(); i++){
+			sum += mass[i];
+		}
+	}
+	mappedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	columnSys.parseColumns(columns);
+	csvTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	{
+		NBodySim::NBodySystem<NBodySim::FloatingType> added;
+		start = std::chrono::steady_clock::now();
+		snapshot.readParticles(0, snapshot.numParticles(), particles);
+		for(size_t i = 0; i < particles.size(); i++){
+			added.addParticle(particles[i]);
+		}
+		addTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	{
+		const size_t batchLength = 65536;
+		NBodySim::NBodySystem<NBodySim::FloatingType> appended;
+		start = std::chrono::steady_clock::now();
+		appended.beginParticles(snapshot.numParticles());
+		for(size_t first = 0; first < snapshot.numParticles(); first += batchLength){
+			snapshot.readParticles(first, std::min(batchLength, snapshot.numParticles() - first), particles);
+			appended.appendParticles(particles.data(), particles.size());
+		}
+		appended.commitParticles();
+		appendTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	std::remove(fileName.c_str());
+
+	std::cout << "Snapshot of " << numParticles << " particles (mass sum " << std::scientific << std::setprecision(6) << sum << ")" << std::endl;
+	std::cout << std::setw(10) << "write s" << std::setw(10) << "whole s" << std::setw(10) << "column s" << std::setw(10) << "mapped s" << std::setw(10) << "csv s" << std::setw(10) << "add s" << std::setw(10) << "append s" << std::endl;
+	std::cout << std::fixed << std::setprecision(3) << std::setw(10) << writeTime << std::setw(10) << wholeTime << std::setw(10) << columnTime;
+	std::cout << std::setw(10) << mappedTime << std::setw(10) << csvTime << std::setw(10) << addTime << std::setw(10) << appendTime << std::endl;
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkBulkAccess compares reading every position of a large system a particle at a time with getParticle,
+ * through viewParticles and with getPositions
+ */
+void benchmarkBulkAccess(void){
+	const size_t numParticles = 1000000;
+	const size_t repeats = 10;
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	std::vector<NBodySim::ThreeVector<NBodySim::FloatingType> > positions;
+	double getParticleTime;
+	double viewTime;
+	double bulkTime;
+	double sum = 0;
+
+	makeCluster(&sys, numParticles, 17);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t r = 0; r < repeats; r++){
+		for(size_t i = 0; i < sys.numParticles(); i++){
+			sum += sys.getParticle(i).getPos().x;
+		}
+	}
+	getParticleTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+	start = std::chrono::steady_clock::now();
+	for(size_t r = 0; r < repeats; r++){
+		NBodySim::ParticleView<NBodySim::FloatingType> view = sys.viewParticles();
+		for(size_t i = 0; i < view.size(); i++){
+			sum += view[i].getPos().x;
+		}
+	}
+	viewTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+	start = std::chrono::steady_clock::now();
+	for(size_t r = 0; r < repeats; r++){
+		sys.getPositions(positions);
+		for(size_t i = 0; i < positions.size(); i++){
+			sum += positions[i].x;
+		}
+	}
+	bulkTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+	std::cout << "Reading " << numParticles << " positions (sum " << std::scientific << std::setprecision(3) << sum << ")" << std::endl;
+	std::cout << std::setw(16) << "getParticle ms" << std::setw(10) << "view ms" << std::setw(16) << "getPositions ms" << std::endl;
+	std::cout << std::fixed << std::setprecision(2) << std::setw(16) << getParticleTime << std::setw(10) << viewTime << std::setw(16) << bulkTime << std::endl;
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkSnapshotFilter times selecting the particles in boxes holding about 1% of a large cluster, by a scan of
+ * every particle and with a grid built once for ten boxes, and writing the selected particles as csv against writing
+ * all of them
+ */
+void benchmarkSnapshotFilter(void){
+	const size_t numParticles = 1000000;
+	const size_t numBoxes = 10;
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> filter;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > selected;
+	std::vector<size_t> indices;
+	NBodySim::ThreeVector<NBodySim::FloatingType> low;
+	NBodySim::ThreeVector<NBodySim::FloatingType> high;
+	std::stringstream allText;
+	std::stringstream selectedText;
+	double scanTime;
+	double buildTime;
+	double gridTime;
+	double writeAllTime;
+	double writeSelectedTime;
+
+	makeCluster(&sys, numParticles, 19);
+	sys.copyParticles(particles);
+
+	// Ten boxes of a tenth of the cluster's width along a diagonal
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t b = 0; b < numBoxes; b++){
+		low.x = low.y = low.z = -1e3 + 200.0 * b;
+		high.x = high.y = high.z = low.x + 216;
+		filter.setBox(low, high);
+		filter.select(particles, indices);
+	}
+	scanTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numBoxes;
+
+	start = std::chrono::steady_clock::now();
+	filter.buildIndex(particles);
+	buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for(size_t b = 0; b < numBoxes; b++){
+		low.x = low.y = low.z = -1e3 + 200.0 * b;
+		high.x = high.y = high.z = low.x + 216;
+		filter.setBox(low, high);
+		filter.select(particles, indices);
+	}
+	gridTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numBoxes;
+
+	start = std::chrono::steady_clock::now();
+	NBodySim::NBodySystem<NBodySim::FloatingType>::writeColumns(allText, particles, ',');
+	writeAllTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	filter.apply(particles, selected);
+	NBodySim::NBodySystem<NBodySim::FloatingType>::writeColumns(selectedText, selected, ',');
+	writeSelectedTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Selecting about " << indices.size() << " of " << numParticles << " particles in a box" << std::endl;
+	std::cout << std::setw(12) << "scan ms" << std::setw(12) << "build ms" << std::setw(12) << "grid ms" << std::setw(16) << "write all ms" << std::setw(20) << "filter+write ms" << std::endl;
+	std::cout << std::fixed << std::setprecision(1) << std::setw(12) << scanTime << std::setw(12) << buildTime << std::setw(12) << gridTime;
+	std::cout << std::setw(16) << writeAllTime << std::setw(20) << writeSelectedTime << std::endl;
+	std::cout << std::endl;
+}
+
+/**
+ * @brief benchmarkDeterministic times a step of the direct summation with and without deterministic sums, and hashing
+ * the state
+ */
+void benchmarkDeterministic(void){
+	const size_t numParticles = 8192;
+	const size_t numSteps = 3;
+	NBodySim::NBodySystem<NBodySim::FloatingType> plainSys;
+	NBodySim::NBodySystem<NBodySim::FloatingType> deterministicSys;
+	double plainTime;
+	double deterministicTime;
+	double hashTime;
+	uint64_t hash;
+
+	makeCluster(&plainSys, numParticles, 29);
+	makeCluster(&deterministicSys, numParticles, 29);
+	plainSys.setNumThreads(1);
+	deterministicSys.setNumThreads(1);
+	deterministicSys.setDeterministic(true);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < numSteps; i++){
+		plainSys.step(1);
+	}
+	plainTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numSteps;
+
+	start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < numSteps; i++){
+		deterministicSys.step(1);
+	}
+	deterministicTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numSteps;
+
+	start = std::chrono::steady_clock::now();
+	hash = deterministicSys.stateHash();
+	hashTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Step of " << numParticles << " particles on one thread (hash " << std::hex << hash << std::dec << ")" << std::endl;
+	std::cout << std::setw(12) << "plain ms" << std::setw(20) << "deterministic ms" << std::setw(12) << "hash ms" << std::endl;
+	std::cout << std::fixed << std::setprecision(2) << std::setw(12) << plainTime << std::setw(20) << deterministicTime << std::setw(12) << hashTime << std::endl;
+	std::cout << std::endl;
+}
+
+/**
+ * @brief cachedFraction returns the share of a file's pages in the page cache, or -1 where that cannot be told
+ *
+ * @param fileName is the path of the file
+ * @return the share of its pages in the page cache
+ */
+double cachedFraction(const std::string & fileName){
+	double fraction = -1;
+#if defined(__linux__)
+	struct stat status;
+	int file = open(fileName.c_str(), O_RDONLY);
+	if(file >= 0 && fstat(file, &status) == 0 && status.st_size > 0){
+		size_t pageLength = sysconf(_SC_PAGESIZE);
+		size_t numPages = (status.st_size + pageLength - 1) / pageLength;
+		std::vector<unsigned char> resident(numPages);
+		void * mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+		if(mapping != MAP_FAILED){
+			if(mincore(mapping, status.st_size, resident.data()) == 0){
+				fraction = 0;
+				for(size_t i = 0; i < numPages; i++){
+					fraction += resident[i] & 1;
+				}
+				fraction /= numPages;
+			}
+			munmap(mapping, status.st_size);
+		}
+	}
+	if(file >= 0){
+		close(file);
+	}
+#endif
+	return fraction;
+}
+
+/**
+ * @brief benchmarkSnapshotWriter times writing a large snapshot file through the page cache, through it and then to
+ * the disk, and with SnapshotWriter, and how much of each file is left in the page cache
+ */
+void benchmarkSnapshotWriter(void){
+	const size_t numParticles = 2000000;
+	const std::string fileName = "BenchmarkWriter.nbs";
+	NBodySim::NBodySystem<NBodySim::FloatingType> sys;
+	NBodySim::SnapshotWriter<NBodySim::FloatingType> writer;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	double bufferedTime;
+	double syncedTime;
+	double writerTime;
+	double bufferedCached;
+	double syncedCached;
+	double writerCached;
+
+	makeCluster(&sys, numParticles, 23);
+	sys.copyParticles(particles);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	NBodySim::SnapshotFile<NBodySim::FloatingType>::write(fileName, particles, 0, 0, sys.getGravitation());
+	bufferedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	bufferedCached = cachedFraction(fileName);
+	std::remove(fileName.c_str());
+
+	start = std::chrono::steady_clock::now();
+	NBodySim::SnapshotFile<NBodySim::FloatingType>::write(fileName, particles, 0, 0, sys.getGravitation());
+#if defined(__unix__) || defined(__APPLE__)
+	int file = open(fileName.c_str(), O_RDONLY);
+	fsync(file);
+	close(file);
+#endif
+	syncedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	syncedCached = cachedFraction(fileName);
+	std::remove(fileName.c_str());
+
+	start = std::chrono::steady_clock::now();
+	writer.write(fileName, particles, 0, 0, sys.getGravitation());
+	writerTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	writerCached = cachedFraction(fileName);
+	std::remove(fileName.c_str());
+
+	std::cout << "Writing a snapshot of " << numParticles << " particles" << (writer.isDirect() ? ", directly" : ", through the page cache") << std::endl;
+	std::cout << std::setw(12) << "buffered s" << std::setw(12) << "synced s" << std::setw(12) << "writer s";
+	std::cout << std::setw(16) << "buffered cached" << std::setw(14) << "synced cached" << std::setw(14) << "writer cached" << std::endl;
+	std::cout << std::fixed << std::setprecision(3) << std::setw(12) << bufferedTime << std::setw(12) << syncedTime << std::setw(12) << writerTime;
+	std::cout << std::setprecision(2) << std::setw(16) << bufferedCached << std::setw(14) << syncedCached << std::setw(14) << writerCached << std::endl;
+	std::cout << std::endl;
+}
+
+int main(void){
+	benchmarkForcePrecision();
+	benchmarkTiling();
+	benchmarkScheduler();
+	benchmarkNumaScaling();
+	benchmarkEnsemble();
+	benchmarkPipeline();
+	benchmarkParse();
+	benchmarkSnapshotFile();
+	benchmarkBulkAccess();
+	benchmarkSnapshotFilter();
+	benchmarkSnapshotWriter();
+	benchmarkDeterministic();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016 - 2017 W.A. Garrett Weaver
+ *
+ * This file is part of n-body-sim.
+ *
+ * n-body-sim is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * n-body-sim is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with n-body-sim.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "gtest/gtest.h"
+
+#include "NBodyTypes.h"
+#include "Particle.h"
+#include "NBodySystem.h"
+#include "SpaceFillingCurve.h"
+#include "MpiDomain.h"
+
+// Implements Req FR.Calculate across processes
+TEST(FR_Distributed, RanksMatchSingleProcess){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> local;
+	NBodySim::MpiDomain <NBodySim::FloatingType> domain;
+	NBodySim::SpaceFillingCurve <NBodySim::FloatingType> sorter;
+	std::vector<size_t> curveOrder;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > all;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > mine;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > gathered;
+	size_t numParticles = 301;
+	size_t numSteps = 5;
+	size_t localCount;
+	size_t totalCount;
+	
+	// Only the first process holds every particle, the others receive their run
+	for(size_t i = 0; i < numParticles && domain.getRank() == 0; i++){
+		p.setPosX((i + 1) * std::cos(i * 0.7));
+		p.setPosY((i + 1) * std::sin(i * 1.3));
+		p.setPosZ(0.1 * i * std::cos(i * 0.2));
+		p.setVelX(0.01 * std::sin(i * 0.4));
+		p.setMass(1e9 * (1 + i % 5));
+		p.setName("p" + std::to_string(i));
+		all.push_back(p);
+	}
+	domain.cut(numParticles);
+	domain.scatter(all, mine, NBodySim::HILBERT);
+	ASSERT_EQ(mine.size(), domain.getCount());
+	sorter.order(all, NBodySim::HILBERT, NULL, curveOrder);
+	// The first process steps the first stretch of the curve
+	for(size_t i = 0; i < mine.size() && domain.getRank() == 0; i++){
+		EXPECT_EQ(mine[i].getName(), all[curveOrder[i]].getName());
+	}
+	domain.decompose(mine, local);
+	// Sorting the particles of a process in memory leaves the order they are summed in alone
+	local.setReorderInterval(2);
+	
+	// Every particle belongs to exactly one process
+	localCount = local.numParticles();
+	MPI_Allreduce(&localCount, &totalCount, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+	EXPECT_EQ(totalCount, numParticles);
+	
+	for(size_t i = 0; i < numSteps; i++){
+		local.step(1);
+	}
+	domain.gather(local, gathered);
+	
+	if(domain.getRank() == 0){
+		for(size_t i = 0; i < numParticles; i++){
+			serialSys.addParticle(all[curveOrder[i]]);
+		}
+		for(size_t i = 0; i < numSteps; i++){
+			serialSys.step(1);
+		}
+		// The sources are summed in id order on every process, so the result is that of one process stepping the
+		// particles in curve order exactly, gathered back in the order they were given
+		ASSERT_EQ(gathered.size(), numParticles);
+		for(size_t i = 0; i < numParticles; i++){
+			EXPECT_EQ(gathered[curveOrder[i]].getName(), serialSys.getParticle(i).getName());
+			EXPECT_EQ(gathered[curveOrder[i]].getPos().x, serialSys.getParticle(i).getPos().x);
+			EXPECT_EQ(gathered[curveOrder[i]].getPos().y, serialSys.getParticle(i).getPos().y);
+			EXPECT_EQ(gathered[curveOrder[i]].getPos().z, serialSys.getParticle(i).getPos().z);
+			EXPECT_EQ(gathered[curveOrder[i]].getVel().x, serialSys.getParticle(i).getVel().x);
+			EXPECT_EQ(gathered[curveOrder[i]].getMass(), serialSys.getParticle(i).getMass());
+		}
+	}
+	else{
+		EXPECT_TRUE(gathered.empty());
+	}
+}
+
+int main(int argc, char* argv[]){
+	int result;
+	int worst;
+	
+	MPI_Init(&argc, &argv);
+	::testing::InitGoogleTest(&argc, argv);
+	result = RUN_ALL_TESTS();
+	// A failure on any process fails the run
+	MPI_Allreduce(&result, &worst, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Finalize();
+	return worst;
+}
@@ -21,6 +21,15 @@
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
 
 #include <boost/thread.hpp>
 #include <boost/functional.hpp>
@@ -33,9 +42,37 @@
 #include "NBodyTypes.h"
 #include "Particle.h"
 #include "NBodySystem.h"
+#include "InverseCube.h"
+#include "TaskScheduler.h"
+#include "SpaceFillingCurve.h"
+#include "Ensemble.h"
+#include "StepPipeline.h"
+#include "SnapshotFile.h"
+#include "SnapshotWriter.h"
+#include "NameTable.h"
+#include "SnapshotFilter.h"
 #include "threads.h"
 #include "ParticlePlotter.h"
 
+/**
+ * @brief makeSpiral adds particles on a tilted spiral, at rest, with masses cycling through five values
+ *
+ * @param sys is the system the particles are added to
+ * @param numParticles is the number of particles to add
+ * @param turn is the angle in radians between neighbouring particles
+ */
+void makeSpiral(NBodySim::NBodySystem<NBodySim::FloatingType> * sys, size_t numParticles, double turn){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+
+	for(size_t i = 0; i < numParticles; i++){
+		p.setPosX((i + 1) * std::cos(i * turn));
+		p.setPosY((i + 1) * std::sin(i * turn));
+		p.setPosZ(0.1 * i);
+		p.setMass(1e9 * (1 + i % 5));
+		sys->addParticle(p);
+	}
+}
+
 
 TEST(FR_Initiate, EarthMoonSun) {
 	std::string xmlString = "<?xml version=\"1.0\"?>\n<system G=\"1.00\">\n\t<particle posX=\"0\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0\" velZ=\"0\" mass=\"1.988500e30\" name=\"Sun\"/>\n\t<particle posX=\"0\" posY=\"1.5210e11\" posZ=\"0\" velX=\"-2.929e4\" velY=\"0\" velZ=\"0\" mass=\"5.972e24\" name=\"Earth\"/>\n\t<particle posX=\"4.054e8\" posY=\"1.5210e11\" posZ=\"0\" velX=\"-2.929e4\" velY=\"-964.0f\" velZ=\"0\" mass=\"7.34767309e22\" name=\"Moon\"/>\t</system>";
@@ -83,6 +120,906 @@ TEST(FR_Calculate, TwoMassCollide){
 	EXPECT_NEAR(sys.getParticle(1).getPos().x, newXPos, margin);
 }
 
+TEST(FR_Calculate, FixedKernelMatchesGeneric){
+	std::string xmlString = "<?xml version=\"1.0\"?>\n<system G=\"5.483e-10\">\n\t<particle posX=\"0\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0\" velZ=\"0\" mass=\"1e10\" name=\"Sun\"/>\n\t<particle posX=\"0\" posY=\"5\" posZ=\"0\" velX=\"1.047197551\" velY=\"0\" velZ=\"0\" mass=\"1e5\" name=\"Planet\"/>\n\t<particle posX=\"0\" posY=\"-10\" posZ=\"0\" velX=\"-0.5\" velY=\"0\" velZ=\"0\" mass=\"0.001\" name=\"Comet1\"/>\n\t<particle posX=\"7\" posY=\"0\" posZ=\"1\" velX=\"0\" velY=\"-0.55\" velZ=\"0\" mass=\"0.001\" name=\"Comet2\"/>\n</system>";
+	NBodySim::NBodySystem <NBodySim::FloatingType> fixedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> genericSys;
+	NBodySim::FloatingType stepSize = 0.033;
+	NBodySim::FloatingType margin = 1e-9;
+	size_t numSteps = 1000;
+	
+	EXPECT_EQ(fixedSys.parse(xmlString), 0);
+	EXPECT_EQ(genericSys.parse(xmlString), 0);
+	genericSys.setFixedKernel(false);
+	
+	for(size_t i = 0; i < numSteps; i++){
+		fixedSys.step(stepSize);
+		genericSys.step(stepSize);
+	}
+	
+	for(size_t i = 0; i < fixedSys.numParticles(); i++){
+		EXPECT_NEAR(fixedSys.getParticle(i).getPos().x, genericSys.getParticle(i).getPos().x, margin);
+		EXPECT_NEAR(fixedSys.getParticle(i).getPos().y, genericSys.getParticle(i).getPos().y, margin);
+		EXPECT_NEAR(fixedSys.getParticle(i).getPos().z, genericSys.getParticle(i).getPos().z, margin);
+		EXPECT_NEAR(fixedSys.getParticle(i).getVel().x, genericSys.getParticle(i).getVel().x, margin);
+		EXPECT_NEAR(fixedSys.getParticle(i).getVel().y, genericSys.getParticle(i).getVel().y, margin);
+		EXPECT_NEAR(fixedSys.getParticle(i).getVel().z, genericSys.getParticle(i).getVel().z, margin);
+	}
+}
+
+TEST(FR_Calculate, ForcePrecisionRelativeError){
+	NBodySim::FloatingType fastBound = 1e-6;
+	NBodySim::FloatingType refinedBound = 1e-12;
+	NBodySim::FloatingType exact;
+	NBodySim::FloatingType fast;
+	NBodySim::FloatingType refined;
+	
+	// Sweep the squared distance over a wide range, including values outside of single precision
+	for(NBodySim::FloatingType distanceSquared = 1e-50; distanceSquared < 1e50; distanceSquared *= 1.37){
+		exact = NBodySim::InverseCube<NBodySim::FloatingType, NBodySim::ACCURATE>::calculate(distanceSquared);
+		fast = NBodySim::InverseCube<NBodySim::FloatingType, NBodySim::FAST>::calculate(distanceSquared);
+		refined = NBodySim::InverseCube<NBodySim::FloatingType, NBodySim::REFINED>::calculate(distanceSquared);
+		EXPECT_NEAR(fast / exact, 1, fastBound);
+		EXPECT_NEAR(refined / exact, 1, refinedBound);
+	}
+}
+
+TEST(FR_Calculate, FastForcePrecisionStep){
+	NBodySim::NBodySystem <NBodySim::FloatingType> accurateSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> fastSys;
+	NBodySim::FloatingType relativeBound = 1e-5;
+	NBodySim::ThreeVector <NBodySim::FloatingType> accurateVel;
+	NBodySim::ThreeVector <NBodySim::FloatingType> fastVel;
+	NBodySim::FloatingType magnitude;
+	size_t numParticles = 64;
+	
+	// Particles on a tilted spiral, more than fit the fixed size kernel so the direct summation is used
+	makeSpiral(&accurateSys, numParticles, 0.7);
+	makeSpiral(&fastSys, numParticles, 0.7);
+	fastSys.setForcePrecision(NBodySim::FAST);
+	EXPECT_EQ(fastSys.getForcePrecision(), NBodySim::FAST);
+	
+	accurateSys.step(1);
+	fastSys.step(1);
+	
+	for(size_t i = 0; i < numParticles; i++){
+		accurateVel = accurateSys.getParticle(i).getVel();
+		fastVel = fastSys.getParticle(i).getVel();
+		magnitude = std::sqrt(accurateVel.x * accurateVel.x + accurateVel.y * accurateVel.y + accurateVel.z * accurateVel.z);
+		EXPECT_NEAR(fastVel.x, accurateVel.x, relativeBound * magnitude);
+		EXPECT_NEAR(fastVel.y, accurateVel.y, relativeBound * magnitude);
+		EXPECT_NEAR(fastVel.z, accurateVel.z, relativeBound * magnitude);
+	}
+}
+
+TEST(FR_Calculate, TiledSummationMatchesUntiled){
+	NBodySim::NBodySystem <NBodySim::FloatingType> tiledSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> untiledSys;
+	size_t numParticles = 150;
+	size_t numSteps = 10;
+	
+	makeSpiral(&tiledSys, numParticles, 0.7);
+	makeSpiral(&untiledSys, numParticles, 0.7);
+	// Tiles which do not divide the system or the chunk length evenly
+	tiledSys.setTileLengths(7, 37);
+	untiledSys.setTileLengths(numParticles, numParticles);
+	EXPECT_EQ(tiledSys.getTargetTileLength(), 7);
+	EXPECT_EQ(tiledSys.getSourceTileLength(), 37);
+	
+	for(size_t i = 0; i < numSteps; i++){
+		tiledSys.step(1);
+		untiledSys.step(1);
+	}
+	
+	// Every target still sums its sources in the same order, so the results are identical
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_DOUBLE_EQ(tiledSys.getParticle(i).getPos().x, untiledSys.getParticle(i).getPos().x);
+		EXPECT_DOUBLE_EQ(tiledSys.getParticle(i).getPos().y, untiledSys.getParticle(i).getPos().y);
+		EXPECT_DOUBLE_EQ(tiledSys.getParticle(i).getPos().z, untiledSys.getParticle(i).getPos().z);
+	}
+}
+
+TEST(FR_Calculate, TaskSchedulerRunsEveryIndexOnce){
+	NBodySim::TaskScheduler scheduler(4);
+	size_t numIndices = 10007;
+	std::vector<int> visits(numIndices, 0);
+	
+	EXPECT_EQ(scheduler.getNumThreads(), 4);
+	// Uneven work, the last indices cost far more than the first, so idle threads have to steal
+	scheduler.parallelFor(0, numIndices, 13, [&visits](size_t first, size_t last){
+		for(size_t i = first; i < last; i++){
+			volatile double sink = 0;
+			for(size_t k = 0; k < i / 100; k++){
+				sink += std::sqrt(static_cast<double>(k));
+			}
+			visits[i]++;
+		}
+	});
+	scheduler.parallelForStatic(0, numIndices, [&visits](size_t first, size_t last){
+		for(size_t i = first; i < last; i++){
+			visits[i]++;
+		}
+	});
+	// Ranges drawn for another number of threads are still all run
+	scheduler.parallelForRanges(std::vector<size_t>({0, 5000, numIndices}), [&visits](size_t first, size_t last){
+		for(size_t i = first; i < last; i++){
+			visits[i]++;
+		}
+	});
+	
+	for(size_t i = 0; i < numIndices; i++){
+		EXPECT_EQ(visits[i], 3);
+	}
+}
+
+TEST(FR_Calculate, ThreadedStepMatchesSerial){
+	NBodySim::NBodySystem <NBodySim::FloatingType> threadedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialSys;
+	size_t numParticles = 300;
+	size_t numSteps = 5;
+	
+	makeSpiral(&threadedSys, numParticles, 0.7);
+	makeSpiral(&serialSys, numParticles, 0.7);
+	threadedSys.setNumThreads(4);
+	EXPECT_EQ(threadedSys.getNumThreads(), 4);
+	EXPECT_EQ(serialSys.getNumThreads(), 1);
+	threadedSys.setTileLengths(100, 64);
+	serialSys.setTileLengths(100, 64);
+	
+	for(size_t i = 0; i < numSteps; i++){
+		threadedSys.step(1);
+		serialSys.step(1);
+	}
+	
+	// Every target is summed by one thread in the serial order, so the results are identical
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(threadedSys.getParticle(i).getPos().x, serialSys.getParticle(i).getPos().x);
+		EXPECT_EQ(threadedSys.getParticle(i).getPos().y, serialSys.getParticle(i).getPos().y);
+		EXPECT_EQ(threadedSys.getParticle(i).getPos().z, serialSys.getParticle(i).getPos().z);
+	}
+}
+
+TEST(FR_Calculate, PinnedStepMatchesSerial){
+	NBodySim::NBodySystem <NBodySim::FloatingType> pinnedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialSys;
+	size_t numParticles = 700;
+	size_t numSteps = 3;
+	
+	makeSpiral(&pinnedSys, numParticles, 0.3);
+	makeSpiral(&serialSys, numParticles, 0.3);
+	// Pinning and the copies of the sources on other nodes leave every sum as it was
+	pinnedSys.setNumThreads(4, true);
+	EXPECT_GE(pinnedSys.getNumNodes(), 1);
+	EXPECT_EQ(serialSys.getNumNodes(), 1);
+	
+	for(size_t i = 0; i < numSteps; i++){
+		pinnedSys.step(1);
+		serialSys.step(1);
+	}
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(pinnedSys.getParticle(i).getPos().x, serialSys.getParticle(i).getPos().x);
+		EXPECT_EQ(pinnedSys.getParticle(i).getVel().y, serialSys.getParticle(i).getVel().y);
+		EXPECT_EQ(pinnedSys.getParticle(i).getPos().z, serialSys.getParticle(i).getPos().z);
+	}
+}
+
+TEST(FR_Calculate, CostBalancedStepMatchesSerial){
+	NBodySim::NBodySystem <NBodySim::FloatingType> balancedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialSys;
+	size_t numParticles = 300;
+	size_t numSteps = 5;
+	
+	makeSpiral(&balancedSys, numParticles, 0.7);
+	makeSpiral(&serialSys, numParticles, 0.7);
+	// A threshold of 1 redraws the partition from the measured costs after every step
+	balancedSys.setNumThreads(3);
+	balancedSys.setCostBalancing(true, 1);
+	EXPECT_TRUE(balancedSys.getCostBalancing());
+	EXPECT_FALSE(serialSys.getCostBalancing());
+	
+	for(size_t i = 0; i < numSteps; i++){
+		balancedSys.step(1);
+		serialSys.step(1);
+		EXPECT_GE(balancedSys.getImbalance(), 1);
+		EXPECT_LE(balancedSys.getImbalance(), 3);
+	}
+	
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(balancedSys.getParticle(i).getPos().x, serialSys.getParticle(i).getPos().x);
+		EXPECT_EQ(balancedSys.getParticle(i).getPos().y, serialSys.getParticle(i).getPos().y);
+		EXPECT_EQ(balancedSys.getParticle(i).getPos().z, serialSys.getParticle(i).getPos().z);
+	}
+}
+
+TEST(FR_Calculate, HilbertCurveStepsToNeighbours){
+	const uint32_t side = 4;
+	std::vector<uint64_t> cells(side * side * side);
+	std::vector<uint64_t> sorted;
+	
+	for(uint32_t x = 0; x < side; x++){
+		for(uint32_t y = 0; y < side; y++){
+			for(uint32_t z = 0; z < side; z++){
+				cells[(x * side + y) * side + z] = NBodySim::SpaceFillingCurve<NBodySim::FloatingType>::key(x, y, z, NBodySim::HILBERT);
+			}
+		}
+	}
+	sorted = cells;
+	std::sort(sorted.begin(), sorted.end());
+	
+	// The curve fills the corner cube before leaving it, every cell one step from the one before
+	for(uint64_t k = 0; k < sorted.size(); k++){
+		EXPECT_EQ(sorted[k], k);
+	}
+	for(uint64_t k = 1; k < sorted.size(); k++){
+		size_t a = std::find(cells.begin(), cells.end(), k - 1) - cells.begin();
+		size_t b = std::find(cells.begin(), cells.end(), k) - cells.begin();
+		int distance = std::abs(static_cast<int>(a / (side * side)) - static_cast<int>(b / (side * side)));
+		distance += std::abs(static_cast<int>(a / side % side) - static_cast<int>(b / side % side));
+		distance += std::abs(static_cast<int>(a % side) - static_cast<int>(b % side));
+		EXPECT_EQ(distance, 1);
+	}
+}
+
+TEST(FR_Calculate, CurveOrderSortsKeys){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > system;
+	NBodySim::SpaceFillingCurve<NBodySim::FloatingType> curve;
+	NBodySim::TaskScheduler scheduler(3);
+	std::vector<size_t> serialOrder;
+	std::vector<size_t> threadedOrder;
+	const uint32_t maxCell = (1u << NBodySim::SpaceFillingCurveSpace::bitsPerAxis) - 1;
+	size_t numParticles = 40000;
+	uint64_t previous = 0;
+	uint64_t key;
+	
+	// Whole numbers spanning every cell, so the cell of a particle is its position
+	std::mt19937 generator(7);
+	std::uniform_int_distribution<uint32_t> cell(0, maxCell);
+	for(size_t i = 0; i < numParticles; i++){
+		p.setPosX(cell(generator));
+		p.setPosY(cell(generator));
+		p.setPosZ(cell(generator));
+		system.push_back(p);
+	}
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	system[0] = p;
+	p.setPosX(maxCell);
+	p.setPosY(maxCell);
+	p.setPosZ(maxCell);
+	system[1] = p;
+	curve.order(system, NBodySim::MORTON, NULL, serialOrder);
+	curve.order(system, NBodySim::MORTON, &scheduler, threadedOrder);
+	
+	EXPECT_TRUE(serialOrder == threadedOrder);
+	for(size_t k = 0; k < numParticles; k++){
+		NBodySim::ThreeVector<NBodySim::FloatingType> pos = system[serialOrder[k]].getPos();
+		key = NBodySim::SpaceFillingCurve<NBodySim::FloatingType>::key(pos.x, pos.y, pos.z, NBodySim::MORTON);
+		EXPECT_LE(previous, key);
+		previous = key;
+	}
+	std::sort(serialOrder.begin(), serialOrder.end());
+	for(size_t k = 0; k < numParticles; k++){
+		EXPECT_EQ(serialOrder[k], k);
+	}
+}
+
+TEST(FR_Calculate, ReorderKeepsParticleIndices){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> reorderedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> plainSys;
+	size_t numParticles = 500;
+	size_t numSteps = 4;
+	NBodySim::FloatingType margin = 1e-9;
+	
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<NBodySim::FloatingType> uniform(-1e3, 1e3);
+	for(size_t i = 0; i < numParticles; i++){
+		p.setPosX(uniform(generator));
+		p.setPosY(uniform(generator));
+		p.setPosZ(uniform(generator));
+		p.setMass(1e6);
+		p.setName("p" + std::to_string(i));
+		reorderedSys.addParticle(p);
+		plainSys.addParticle(p);
+	}
+	reorderedSys.setReorderInterval(1);
+	EXPECT_EQ(reorderedSys.getReorderInterval(), 1);
+	
+	for(size_t i = 0; i < numSteps; i++){
+		reorderedSys.step(1);
+		plainSys.step(1);
+	}
+	
+	// The sources are summed in another order, so the positions agree to rounding
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(reorderedSys.getParticle(i).getName(), plainSys.getParticle(i).getName());
+		EXPECT_NEAR(reorderedSys.getParticle(i).getPos().x, plainSys.getParticle(i).getPos().x, margin * 1e3);
+		EXPECT_NEAR(reorderedSys.getParticle(i).getPos().y, plainSys.getParticle(i).getPos().y, margin * 1e3);
+	}
+	
+	// The last particle takes over the removed index, the others keep theirs wherever they are stored
+	EXPECT_EQ(reorderedSys.removeParticle(5), NBodySim::NBodySystemSpace::SUCCESS);
+	ASSERT_EQ(reorderedSys.numParticles(), numParticles - 1);
+	EXPECT_EQ(reorderedSys.removeParticle(numParticles - 1), NBodySim::NBodySystemSpace::INDEX_EXCEEDED);
+	ASSERT_EQ(reorderedSys.numParticles(), numParticles - 1);
+	EXPECT_EQ(reorderedSys.getParticle(5).getName(), "p" + std::to_string(numParticles - 1));
+	EXPECT_EQ(reorderedSys.findParticle("p10"), 10);
+	EXPECT_EQ(reorderedSys.findParticle("p5"), numParticles - 1);
+	for(size_t i = 0; i < reorderedSys.numParticles(); i++){
+		if(i != 5){
+			EXPECT_EQ(reorderedSys.getParticle(i).getName(), "p" + std::to_string(i));
+		}
+	}
+	reorderedSys.removeParticle(reorderedSys.numParticles() - 1);
+	EXPECT_EQ(reorderedSys.findParticle("p" + std::to_string(numParticles - 2)), reorderedSys.numParticles());
+	EXPECT_EQ(reorderedSys.getParticle(3).getName(), "p3");
+}
+
+TEST(FR_Calculate, BulkAccessorsFollowIndexOrder){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> setSys;
+	std::vector<NBodySim::ThreeVector<NBodySim::FloatingType> > positions;
+	std::vector<NBodySim::ThreeVector<NBodySim::FloatingType> > velocities;
+	std::vector<NBodySim::FloatingType> masses;
+	size_t numParticles = 200;
+	
+	std::mt19937 generator(5);
+	std::uniform_real_distribution<NBodySim::FloatingType> uniform(-1e3, 1e3);
+	for(size_t i = 0; i < numParticles; i++){
+		p.setPosX(uniform(generator));
+		p.setPosY(uniform(generator));
+		p.setPosZ(uniform(generator));
+		p.setVelX(1e-3 * uniform(generator));
+		p.setMass(1e6 + i);
+		sys.addParticle(p);
+		p.setPosX(0);
+		p.setVelX(0);
+		setSys.addParticle(p);
+	}
+	// Sorting the storage along a curve must not change what the bulk accessors report for an index
+	sys.setReorderInterval(1);
+	sys.step(1);
+	
+	NBodySim::ParticleView<NBodySim::FloatingType> view = sys.viewParticles();
+	sys.getPositions(positions);
+	sys.getVelocities(velocities);
+	sys.getMasses(masses);
+	ASSERT_EQ(view.size(), numParticles);
+	ASSERT_EQ(positions.size(), numParticles);
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(view[i].getId(), i);
+		EXPECT_EQ(view[i].getPos().x, sys.getParticle(i).getPos().x);
+		EXPECT_EQ(positions[i].y, sys.getParticle(i).getPos().y);
+		EXPECT_EQ(velocities[i].x, sys.getParticle(i).getVel().x);
+		EXPECT_EQ(masses[i], sys.getParticle(i).getMass());
+	}
+	
+	// A system given the same state in bulk steps like the original, to the rounding of its other summation order
+	EXPECT_EQ(setSys.setPositions(positions), NBodySim::NBodySystemSpace::SUCCESS);
+	EXPECT_EQ(setSys.setVelocities(velocities), NBodySim::NBodySystemSpace::SUCCESS);
+	EXPECT_EQ(setSys.setMasses(masses), NBodySim::NBodySystemSpace::SUCCESS);
+	sys.setReorderInterval(0);
+	sys.step(1);
+	setSys.step(1);
+	for(size_t i = 0; i < numParticles; i += 17){
+		EXPECT_NEAR(setSys.getParticle(i).getPos().x, sys.getParticle(i).getPos().x, 1e-9);
+	}
+	
+	masses.pop_back();
+	EXPECT_EQ(setSys.setMasses(masses), NBodySim::NBodySystemSpace::WRONG_LENGTH);
+	EXPECT_EQ(setSys.getParticle(0).getMass(), sys.getParticle(0).getMass());
+}
+
+TEST(FR_Calculate, EnsembleReferenceMatchesSystem){
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::Ensemble <NBodySim::FloatingType> ensemble;
+	size_t numParticles = 6;
+	size_t numReplicas = 11;
+	size_t numSteps = 20;
+	NBodySim::FloatingType initialEnergy;
+	
+	makeSpiral(&sys, numParticles, 0.9);
+	sys.setFixedKernel(false);
+	initialEnergy = sys.energy();
+	
+	// Eleven replicas leave five padding lanes in the second block
+	ensemble.generate(sys, numReplicas, 1e-6, 7);
+	EXPECT_EQ(ensemble.numReplicas(), numReplicas);
+	ensemble.run(numSteps, 1, NULL);
+	for(size_t i = 0; i < numSteps; i++){
+		sys.step(1);
+	}
+	
+	// The first replica is unperturbed and is summed in the same order as the system
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(ensemble.getParticle(0, i).getPos().x, sys.getParticle(i).getPos().x);
+		EXPECT_EQ(ensemble.getParticle(0, i).getPos().y, sys.getParticle(i).getPos().y);
+		EXPECT_EQ(ensemble.getParticle(0, i).getVel().z, sys.getParticle(i).getVel().z);
+		EXPECT_EQ(ensemble.getParticle(0, i).getName(), sys.getParticle(i).getName());
+		EXPECT_NE(ensemble.getParticle(numReplicas - 1, i).getPos().x, sys.getParticle(i).getPos().x);
+	}
+	EXPECT_GT(ensemble.getClosestApproach(0), 0);
+	EXPECT_DOUBLE_EQ(ensemble.getEnergyError(0), (sys.energy() - initialEnergy) / std::abs(initialEnergy));
+	
+	// Without a spread every replica is an exact copy of the scenario
+	ensemble.generate(sys, 3, 0, 7);
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(ensemble.getParticle(2, i).getPos().x, sys.getParticle(i).getPos().x);
+		EXPECT_EQ(ensemble.getParticle(2, i).getVel().y, sys.getParticle(i).getVel().y);
+	}
+}
+
+TEST(FR_Calculate, EnsembleThreadedMatchesSerial){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::Ensemble <NBodySim::FloatingType> threadedEnsemble;
+	NBodySim::Ensemble <NBodySim::FloatingType> serialEnsemble;
+	NBodySim::TaskScheduler scheduler(4);
+	size_t numParticles = 4;
+	size_t numReplicas = 37;
+	
+	for(size_t i = 0; i < numParticles; i++){
+		p.setPosX(i + 1);
+		p.setPosY(0.5 * i);
+		p.setVelY(0.02 * i);
+		p.setMass(1e8);
+		sys.addParticle(p);
+	}
+	
+	threadedEnsemble.generate(sys, numReplicas, 1e-3, 42);
+	serialEnsemble.generate(sys, numReplicas, 1e-3, 42);
+	threadedEnsemble.run(10, 1, &scheduler);
+	serialEnsemble.run(10, 1, NULL);
+	
+	// Replicas never interact, so the thread that steps a block does not change it
+	for(size_t replica = 0; replica < numReplicas; replica++){
+		for(size_t i = 0; i < numParticles; i++){
+			EXPECT_EQ(threadedEnsemble.getParticle(replica, i).getPos().x, serialEnsemble.getParticle(replica, i).getPos().x);
+			EXPECT_EQ(threadedEnsemble.getParticle(replica, i).getPos().y, serialEnsemble.getParticle(replica, i).getPos().y);
+		}
+		EXPECT_EQ(threadedEnsemble.getEnergyError(replica), serialEnsemble.getEnergyError(replica));
+	}
+	EXPECT_NE(serialEnsemble.getParticle(1, 0).getPos().x, serialEnsemble.getParticle(2, 0).getPos().x);
+}
+
+TEST(FR_Calculate, PipelineStagesSeeEverySnapshot){
+	NBodySim::NBodySystem <NBodySim::FloatingType> pipelinedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialSys;
+	std::vector<std::vector<NBodySim::FloatingType> > expectedX;
+	std::vector<std::vector<NBodySim::FloatingType> > seenX;
+	std::vector<size_t> seenSteps;
+	std::vector<size_t> countedSteps;
+	size_t numParticles = 50;
+	size_t numSteps = 24;
+	size_t interval = 3;
+	
+	makeSpiral(&pipelinedSys, numParticles, 0.4);
+	makeSpiral(&serialSys, numParticles, 0.4);
+	for(size_t i = 1; i <= numSteps; i++){
+		serialSys.step(1);
+		if(i % interval == 0){
+			expectedX.push_back(std::vector<NBodySim::FloatingType>());
+			for(size_t k = 0; k < numParticles; k++){
+				expectedX.back().push_back(serialSys.getParticle(k).getPos().x);
+			}
+		}
+	}
+	
+	{
+		// Two buffers and a slow stage make the stepping thread wait and reuse every buffer several times
+		NBodySim::StepPipeline <NBodySim::FloatingType> pipeline(&pipelinedSys, interval, 2);
+		pipeline.addStage([&seenX, &seenSteps](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot){
+			boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+			seenSteps.push_back(snapshot.step);
+			seenX.push_back(std::vector<NBodySim::FloatingType>());
+			for(size_t k = 0; k < snapshot.particles.size(); k++){
+				seenX.back().push_back(snapshot.particles[k].getPos().x);
+			}
+		});
+		pipeline.addStage([&countedSteps](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot){
+			countedSteps.push_back(snapshot.step);
+		});
+		for(size_t i = 0; i < numSteps; i++){
+			pipeline.step(1);
+		}
+		pipeline.flush();
+		EXPECT_EQ(pipeline.getStepCount(), numSteps);
+		EXPECT_EQ(pipeline.numStages(), 2);
+		EXPECT_GT(pipeline.getStalls(), 0);
+	}
+	
+	// Every stage sees every snapshot, in order, holding the state of the step it was taken at
+	ASSERT_EQ(seenSteps.size(), numSteps / interval);
+	EXPECT_EQ(countedSteps, seenSteps);
+	for(size_t k = 0; k < seenSteps.size(); k++){
+		EXPECT_EQ(seenSteps[k], (k + 1) * interval);
+		EXPECT_EQ(seenX[k], expectedX[k]);
+	}
+}
+
+TEST(FR_Calculate, DeterministicHashesMatchAcrossThreads){
+	const unsigned threadCounts[] = {1, 4, 16};
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	std::vector<std::vector<uint64_t> > hashes;
+	std::vector<std::vector<size_t> > hashedSteps;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > copied;
+	size_t numParticles = 700;
+	size_t numSteps = 6;
+	
+	for(size_t run = 0; run < 3; run++){
+		NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+		std::mt19937 generator(11);
+		std::uniform_real_distribution<NBodySim::FloatingType> uniform(-1e3, 1e3);
+		for(size_t i = 0; i < numParticles; i++){
+			p.setPosX(uniform(generator));
+			p.setPosY(uniform(generator));
+			p.setPosZ(uniform(generator));
+			p.setMass(1e6 * (1 + i % 3));
+			sys.addParticle(p);
+		}
+		// Every run shares the work out differently and only the last two sort the particles in memory
+		sys.setNumThreads(threadCounts[run]);
+		sys.setDeterministic(true);
+		sys.setCostBalancing(run == 1, 1);
+		sys.setTileLengths(run == 2 ? 96 : 0, run == 2 ? 200 : 0);
+		sys.setReorderInterval(run);
+		EXPECT_TRUE(sys.getDeterministic());
+		
+		hashes.push_back(std::vector<uint64_t>());
+		hashedSteps.push_back(std::vector<size_t>());
+		{
+			// The hash stage has an interval of its own, shorter than the pipeline's
+			NBodySim::StepPipeline <NBodySim::FloatingType> pipeline(&sys, 3);
+			pipeline.addStage([&hashes, &hashedSteps](const NBodySim::Snapshot<NBodySim::FloatingType> & snapshot){
+				hashes.back().push_back(NBodySim::NBodySystem<NBodySim::FloatingType>::stateHash(snapshot.particles));
+				hashedSteps.back().push_back(snapshot.step);
+			}, 2);
+			for(size_t i = 0; i < numSteps; i++){
+				pipeline.step(1);
+			}
+		}
+		sys.copyParticles(copied);
+		EXPECT_EQ(sys.stateHash(), NBodySim::NBodySystem<NBodySim::FloatingType>::stateHash(copied));
+		EXPECT_EQ(sys.stateHash(), hashes.back().back());
+	}
+	
+	EXPECT_EQ(hashedSteps[0], std::vector<size_t>({2, 4, 6}));
+	EXPECT_EQ(hashes[1], hashes[0]);
+	EXPECT_EQ(hashes[2], hashes[0]);
+	// The hash sees every bit, one last bit of one velocity changes it
+	copied[7].setVelX(std::nextafter(copied[7].getVel().x, 1.0));
+	EXPECT_NE(NBodySim::NBodySystem<NBodySim::FloatingType>::stateHash(copied), hashes[0].back());
+}
+
+TEST(FR_Calculate, HermiteCircularOrbit){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> hermiteSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> eulerSys;
+	NBodySim::FloatingType period = 2 * M_PI;
+	size_t numSteps = 10;
+	NBodySim::FloatingType margin = 1e-5;
+	
+	// A massless planet on a circular orbit of radius 1 around a unit mass, with G = 1 the period is 2 pi
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	p.setVelX(0);
+	p.setVelY(0);
+	p.setVelZ(0);
+	p.setMass(1);
+	p.setName("Sun");
+	hermiteSys.addParticle(p);
+	eulerSys.addParticle(p);
+	p.setPosX(1);
+	p.setVelY(1);
+	p.setMass(1e-12);
+	p.setName("Planet");
+	hermiteSys.addParticle(p);
+	eulerSys.addParticle(p);
+	hermiteSys.setGravitation(1);
+	eulerSys.setGravitation(1);
+	hermiteSys.setIntegrator(NBodySim::HERMITE);
+	EXPECT_EQ(hermiteSys.getIntegrator(), NBodySim::HERMITE);
+	hermiteSys.setTimestepAccuracy(0.001);
+	
+	// Ten steps per orbit, far too few for the symplectic Euler integrator
+	for(size_t i = 0; i < numSteps; i++){
+		hermiteSys.step(period / numSteps);
+		eulerSys.step(period / numSteps);
+	}
+	
+	EXPECT_NEAR(hermiteSys.getParticle(1).getPos().x, 1, margin);
+	EXPECT_NEAR(hermiteSys.getParticle(1).getPos().y, 0, margin);
+	EXPECT_NEAR(hermiteSys.getParticle(1).getVel().x, 0, margin);
+	EXPECT_NEAR(hermiteSys.getParticle(1).getVel().y, 1, margin);
+	EXPECT_GT(std::fabs(eulerSys.getParticle(1).getPos().y), 100 * margin);
+}
+
+TEST(FR_Calculate, WisdomHolmanEccentricOrbit){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::FloatingType period = 2 * M_PI;
+	size_t numSteps = 7;
+	NBodySim::FloatingType margin = 1e-9;
+
+	// A massless planet at perihelion of an orbit with semi-major axis 1 and eccentricity 0.5, with G = 1 the period is 2 pi
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	p.setVelX(0);
+	p.setVelY(0);
+	p.setVelZ(0);
+	p.setMass(1);
+	p.setName("Sun");
+	sys.addParticle(p);
+	p.setPosX(0.5);
+	p.setVelY(std::sqrt(3.0));
+	p.setMass(1e-15);
+	p.setName("Planet");
+	sys.addParticle(p);
+	sys.setGravitation(1);
+	sys.setIntegrator(NBodySim::WISDOM_HOLMAN);
+	EXPECT_EQ(sys.getIntegrator(), NBodySim::WISDOM_HOLMAN);
+
+	// The Kepler drift is exact, so a handful of steps per orbit bring the planet back to perihelion
+	for(size_t i = 0; i < numSteps; i++){
+		sys.step(period / numSteps);
+	}
+
+	EXPECT_NEAR(sys.getParticle(1).getPos().x - sys.getParticle(0).getPos().x, 0.5, margin);
+	EXPECT_NEAR(sys.getParticle(1).getPos().y - sys.getParticle(0).getPos().y, 0, margin);
+	EXPECT_NEAR(sys.getParticle(1).getVel().x - sys.getParticle(0).getVel().x, 0, margin);
+	EXPECT_NEAR(sys.getParticle(1).getVel().y - sys.getParticle(0).getVel().y, std::sqrt(3.0), margin);
+}
+
+TEST(FR_Calculate, WisdomHolmanPlanetaryEnergy){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::FloatingType period = 2 * M_PI;
+	size_t numOrbits = 1000;
+	size_t stepsPerOrbit = 20;
+	NBodySim::FloatingType startEnergy;
+
+	// A Sun with two giant planets, the inner one has a period of 2 pi
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	p.setVelX(0);
+	p.setVelY(0);
+	p.setVelZ(0);
+	p.setMass(1);
+	p.setName("Sun");
+	sys.addParticle(p);
+	p.setPosX(0.9);
+	p.setVelY(1.1);
+	p.setMass(1e-3);
+	p.setName("Jupiter");
+	sys.addParticle(p);
+	p.setPosX(-1.9);
+	p.setVelY(-0.7);
+	p.setPosZ(0.1);
+	p.setMass(3e-4);
+	p.setName("Saturn");
+	sys.addParticle(p);
+	sys.setGravitation(1);
+	sys.setIntegrator(NBodySim::WISDOM_HOLMAN);
+	startEnergy = sys.energy();
+
+	for(size_t i = 0; i < numOrbits * stepsPerOrbit; i++){
+		sys.step(period / stepsPerOrbit);
+	}
+
+	EXPECT_LT(std::fabs((sys.energy() - startEnergy) / startEnergy), 1e-5);
+}
+
+TEST(FR_Calculate, GaussRadauEccentricOrbit){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::FloatingType totalMass = 1.001;
+	NBodySim::FloatingType period = 2 * M_PI / std::sqrt(totalMass);
+	// Relative speed at perihelion of an orbit with semi-major axis 1 and eccentricity 0.9
+	NBodySim::FloatingType speed = std::sqrt(totalMass * 1.9 / 0.1);
+	size_t numOrbits = 10;
+	NBodySim::FloatingType startEnergy;
+
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	p.setVelX(0);
+	p.setVelY(-speed * 0.001 / totalMass);
+	p.setVelZ(0);
+	p.setMass(1);
+	p.setName("Sun");
+	sys.addParticle(p);
+	p.setPosX(0.1);
+	p.setVelY(speed / totalMass);
+	p.setMass(1e-3);
+	p.setName("Planet");
+	sys.addParticle(p);
+	sys.setGravitation(1);
+	sys.setIntegrator(NBodySim::GAUSS_RADAU);
+	sys.setErrorTolerance(1e-9);
+	startEnergy = sys.energy();
+
+	// One call per orbit, the integrator chooses its own substeps through every perihelion passage
+	for(size_t i = 0; i < numOrbits; i++){
+		sys.step(period);
+	}
+
+	EXPECT_NEAR(sys.getParticle(1).getPos().x - sys.getParticle(0).getPos().x, 0.1, 1e-9);
+	EXPECT_NEAR(sys.getParticle(1).getPos().y - sys.getParticle(0).getPos().y, 0, 1e-9);
+	EXPECT_LT(std::fabs((sys.energy() - startEnergy) / startEnergy), 1e-12);
+}
+
+TEST(FR_Calculate, RegularizedEccentricBinaryEnergy){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> regularizedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> plainSys;
+	NBodySim::FloatingType totalMass = 1.5;
+	// Relative speed at pericenter of an orbit with semi-major axis 1 and eccentricity 0.8, the period is about 5.1
+	NBodySim::FloatingType speed = std::sqrt(totalMass * 1.8 / 0.2);
+	NBodySim::FloatingType deltaT = 0.5;
+	size_t numSteps = 1000;
+	NBodySim::FloatingType startEnergy;
+	NBodySim::FloatingType separation;
+
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	p.setVelX(0);
+	p.setVelY(-speed * 0.5 / totalMass);
+	p.setVelZ(0);
+	p.setMass(1);
+	p.setName("Primary");
+	regularizedSys.addParticle(p);
+	plainSys.addParticle(p);
+	p.setPosX(0.2);
+	p.setVelY(speed / totalMass);
+	p.setMass(0.5);
+	p.setName("Secondary");
+	regularizedSys.addParticle(p);
+	plainSys.addParticle(p);
+	regularizedSys.setGravitation(1);
+	plainSys.setGravitation(1);
+	regularizedSys.setRegularization(true);
+	EXPECT_TRUE(regularizedSys.getRegularization());
+	startEnergy = regularizedSys.energy();
+
+	// About ten steps per orbit, far too few for the symplectic Euler integrator
+	for(size_t i = 0; i < numSteps; i++){
+		regularizedSys.step(deltaT);
+		plainSys.step(deltaT);
+		// Both bodies stay in place for callers, on the ellipse between pericenter and apocenter
+		separation = std::hypot(regularizedSys.getParticle(1).getPos().x - regularizedSys.getParticle(0).getPos().x, regularizedSys.getParticle(1).getPos().y - regularizedSys.getParticle(0).getPos().y);
+		EXPECT_GT(separation, 0.2 - 1e-9);
+		EXPECT_LT(separation, 1.8 + 1e-9);
+	}
+
+	EXPECT_EQ(regularizedSys.numRegularizedPairs(), 1);
+	EXPECT_EQ(regularizedSys.getParticle(1).getMass(), 0.5);
+	EXPECT_LT(std::fabs((regularizedSys.energy() - startEnergy) / startEnergy), 1e-10);
+	EXPECT_GT(std::fabs((plainSys.energy() - startEnergy) / startEnergy), 1e-2);
+}
+
+TEST(FR_Calculate, RegularizerPairsOnlyIsolatedBinaries){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	size_t numBinaries = 40;
+	// Circular orbits of separation 0.2 about a total mass of 1.5, the period is about 0.46
+	NBodySim::FloatingType speed = std::sqrt(1.5 / 0.2);
+
+	// Binaries far apart on a grid of their own, the last with a third particle within ten separations of it
+	for(size_t i = 0; i <= numBinaries; i++){
+		p.setPosX(100.0 * (i % 7));
+		p.setPosY(100.0 * (i / 7));
+		p.setPosZ(50.0 * (i % 3));
+		p.setVelX(0);
+		p.setVelY(-speed / 3);
+		p.setMass(1);
+		sys.addParticle(p);
+		p.setPosX(100.0 * (i % 7) + 0.2);
+		p.setVelY(speed * 2 / 3);
+		p.setMass(0.5);
+		sys.addParticle(p);
+	}
+	p.setPosX(100.0 * (numBinaries % 7) - 1.5);
+	p.setVelY(0);
+	p.setMass(1e-3);
+	sys.addParticle(p);
+	sys.setGravitation(1);
+	sys.setRegularization(true);
+
+	sys.step(0.5);
+
+	EXPECT_EQ(sys.numRegularizedPairs(), numBinaries);
+}
+
+TEST(FR_Calculate, CollisionMergeConservesMomentum){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+
+	p.setPosX(0);
+	p.setPosY(0);
+	p.setPosZ(0);
+	p.setVelX(1);
+	p.setVelY(0);
+	p.setVelZ(0);
+	p.setMass(3);
+	p.setRadius(1);
+	p.setName("Big");
+	sys.addParticle(p);
+	p.setPosX(1.5);
+	p.setVelX(-2);
+	p.setVelY(4);
+	p.setMass(1);
+	p.setName("Small");
+	sys.addParticle(p);
+	sys.setGravitation(0);
+	sys.setCollisions(true);
+	EXPECT_TRUE(sys.getCollisions());
+
+	sys.step(0.01);
+
+	ASSERT_EQ(sys.numParticles(), 1);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getMass(), 4);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getVel().x, 0.25);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getVel().y, 1);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getRadius(), std::cbrt(2.0));
+	EXPECT_EQ(sys.getParticle(0).getName(), "Big");
+}
+
+TEST(FR_Calculate, CollisionSpatialHashFindsEveryPair){
+	NBodySim::Particle <NBodySim::FloatingType> p;
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	size_t numPairs = 1000;
+	NBodySim::FloatingType mass = 0;
+	NBodySim::FloatingType momentum = 0;
+
+	// Pairs of touching particles along a diagonal, far from every other pair
+	for(size_t i = 0; i < numPairs; i++){
+		p.setPosX(10.0 * i);
+		p.setPosY(-10.0 * i);
+		p.setPosZ(5.0 * i);
+		p.setVelX(i % 7);
+		p.setMass(1 + i % 3);
+		p.setRadius(0.3);
+		sys.addParticle(p);
+		p.setPosX(10.0 * i + 0.5);
+		p.setVelX(-1.0 * (i % 5));
+		p.setRadius(0.25);
+		sys.addParticle(p);
+	}
+	// Particles far past the range of the cell coordinates share an end cell without merging
+	p.setPosX(1e30);
+	p.setPosY(-1e30);
+	p.setPosZ(1e30);
+	sys.addParticle(p);
+	p.setPosX(-1e30);
+	p.setPosY(1e30);
+	sys.addParticle(p);
+	for(size_t i = 0; i < sys.numParticles(); i++){
+		mass += sys.getParticle(i).getMass();
+		momentum += sys.getParticle(i).getMass() * sys.getParticle(i).getVel().x;
+	}
+	sys.setGravitation(0);
+	sys.setCollisions(true);
+
+	sys.step(1e-6);
+
+	ASSERT_EQ(sys.numParticles(), numPairs + 2);
+	// The survivors keep dense indices, each found where its index says
+	for(size_t i = 0; i < sys.numParticles(); i++){
+		EXPECT_EQ(sys.getParticle(i).getId(), i);
+		mass -= sys.getParticle(i).getMass();
+		momentum -= sys.getParticle(i).getMass() * sys.getParticle(i).getVel().x;
+	}
+	EXPECT_NEAR(mass, 0, 1e-9);
+	EXPECT_NEAR(momentum, 0, 1e-9);
+}
+
 TEST(FR_TimeAccelerate, TenStepsTest){
 	/* For the time acceleration test we shall use one paticle moving at 1 m/s and run it 
 	 * for 10 steps and test to see if it moved 10 meters.
@@ -168,6 +1105,390 @@ TEST(NF_UsersProvideFile, ParseXML) {
 	EXPECT_DOUBLE_EQ(sys.getParticle(1).getPos().z, 0);
 }
 
+TEST(NF_UsersProvideFile, NamesAreInternedOnce) {
+	std::stringstream unnamed("posX posY posZ velX velY velZ mass\n1 0 0 0 0 0 1\n2 0 0 0 0 0 1\n3 0 0 0 0 0 1\n");
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> columnSys;
+	NBodySim::Particle <NBodySim::FloatingType> a(0, 0, 0, 0, 0, 0, 1, "Interned");
+	NBodySim::Particle <NBodySim::FloatingType> b(1, 0, 0, 0, 0, 0, 1, "Interned");
+	size_t stored = NBodySim::NameTable::size();
+	
+	// The same name is stored once, copies of a particle share its id
+	EXPECT_EQ(a.getNameId(), b.getNameId());
+	EXPECT_EQ(NBodySim::NameTable::name(a.getNameId()), "Interned");
+	EXPECT_EQ(NBodySim::Particle<NBodySim::FloatingType>().getNameId(), NBodySim::NameTableSpace::emptyName);
+	
+	// Names generated from the index of an unnamed row are not stored but read and found like any other
+	EXPECT_EQ(columnSys.parseColumns(unnamed), NBodySim::NBodySystemSpace::SUCCESS);
+	EXPECT_EQ(NBodySim::NameTable::size(), stored);
+	EXPECT_EQ(columnSys.getParticle(2).getName(), "2");
+	EXPECT_EQ(columnSys.findParticle("2"), 2);
+	EXPECT_EQ(columnSys.findParticle("02"), columnSys.numParticles());
+	
+	sys.addParticle(a);
+	sys.addParticle(b);
+	sys.addParticle(NBodySim::Particle<NBodySim::FloatingType>(2, 0, 0, 0, 0, 0, 1, "1"));
+	EXPECT_EQ(sys.findParticle("Interned"), 0);
+	EXPECT_EQ(sys.findParticle("1"), 2);
+	EXPECT_EQ(sys.findParticle("Never stored"), sys.numParticles());
+	sys.removeParticle(0);
+	EXPECT_EQ(sys.findParticle("Interned"), 1);
+	EXPECT_EQ(sys.findParticle("1"), 0);
+}
+
+TEST(NF_UsersProvideFile, ParseAttributesInAnyOrder) {
+	std::string xmlString = "<?xml version=\"1.0\"?>\n<system>\n\t<particle name=\"A &amp; B\" mass=\" +2.5e3\" radius=\"4\" velZ=\"-1\" velY=\"0\" velX=\"0.5\" posZ=\"3\" posY=\"2\" posX=\"1\" color=\"red\"/>\n\t<particle posX=\"7\" posX=\"8\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0\" velZ=\"0\" mass=\"1\" name=\"C\"/>\n</system>";
+	std::string missingVelY = "<system><particle posX=\"0\" posY=\"0\" posZ=\"0\" velX=\"0\" velZ=\"0\" name=\"D\"/></system>";
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> missingSys;
+	
+	EXPECT_EQ(sys.parse(xmlString), NBodySim::NBodySystemSpace::SUCCESS);
+	ASSERT_EQ(sys.numParticles(), 2);
+	EXPECT_EQ(sys.getParticle(0).getName(), "A & B");
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getMass(), 2.5e3);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getRadius(), 4);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getPos().x, 1);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getPos().z, 3);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getVel().x, 0.5);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getVel().z, -1);
+	// The first of a repeated attribute counts and a particle without a radius gets none from the one before it
+	EXPECT_DOUBLE_EQ(sys.getParticle(1).getPos().x, 7);
+	EXPECT_DOUBLE_EQ(sys.getParticle(1).getRadius(), 0);
+	
+	// Missing attributes are reported in list order, velY before mass
+	EXPECT_EQ(missingSys.parse(missingVelY), NBodySim::NBodySystemSpace::NO_VELY);
+}
+
+TEST(NF_UsersProvideFile, ChunkedParseMatchesSerial) {
+	std::ostringstream text;
+	std::string xmlString;
+	std::string badString;
+	std::string commentString;
+	NBodySim::NBodySystem <NBodySim::FloatingType> chunkedSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> chunkedBadSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> serialBadSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> commentSys;
+	size_t numParticles = 12000;
+	size_t badParticle = 9001;
+	size_t badLine = 0;
+	size_t massStart;
+	
+	text.precision(17);
+	text << "<?xml version=\"1.0\"?>\n<system G=\"2.5\">\n";
+	for(size_t i = 0; i < numParticles; i++){
+		if(i == badParticle){
+			badLine = 3 + i;
+		}
+		// Alternate the attribute order so chunks see both
+		if(i % 2 == 0){
+			text << "\t<particle posX=\"" << std::cos(i * 0.1) * i << "\" posY=\"" << std::sin(i * 0.1) * i << "\" posZ=\"" << 0.5 * i;
+			text << "\" velX=\"" << 1e-3 * i << "\" velY=\"0\" velZ=\"-1\" mass=\"" << 1e9 + i << "\" name=\"p" << i << "\"/>\n";
+		}
+		else{
+			text << "\t<particle name=\"p" << i << "\" mass=\"" << 1e9 + i << "\" velZ=\"1\" velY=\"2\" velX=\"" << 1e-4 * i;
+			text << "\" posZ=\"" << -0.5 * i << "\" posY=\"" << std::cos(i * 0.3) << "\" posX=\"" << std::sin(i * 0.3) << "\" radius=\"3\"/>\n";
+		}
+	}
+	text << "</system>\n";
+	xmlString = text.str();
+	ASSERT_GE(xmlString.size(), NBodySim::NBodySystemSpace::parallelParseLength);
+	
+	chunkedSys.setNumThreads(4);
+	EXPECT_EQ(chunkedSys.parse(xmlString), NBodySim::NBodySystemSpace::SUCCESS);
+	EXPECT_EQ(serialSys.parse(xmlString), NBodySim::NBodySystemSpace::SUCCESS);
+	ASSERT_EQ(chunkedSys.numParticles(), numParticles);
+	ASSERT_EQ(serialSys.numParticles(), numParticles);
+	EXPECT_EQ(chunkedSys.getGravitation(), 2.5);
+	for(size_t i = 0; i < numParticles; i++){
+		EXPECT_EQ(chunkedSys.getParticle(i).getName(), serialSys.getParticle(i).getName());
+		EXPECT_EQ(chunkedSys.getParticle(i).getPos().x, serialSys.getParticle(i).getPos().x);
+		EXPECT_EQ(chunkedSys.getParticle(i).getVel().x, serialSys.getParticle(i).getVel().x);
+		EXPECT_EQ(chunkedSys.getParticle(i).getRadius(), serialSys.getParticle(i).getRadius());
+	}
+	
+	// A particle missing its mass stops both at the same particle and line
+	badString = xmlString;
+	massStart = badString.find(" mass=", badString.find("name=\"p" + std::to_string(badParticle) + "\""));
+	badString.erase(massStart, badString.find('"', massStart + 7) + 1 - massStart);
+	chunkedBadSys.setNumThreads(4);
+	EXPECT_EQ(chunkedBadSys.parse(badString), NBodySim::NBodySystemSpace::NO_MASS);
+	EXPECT_EQ(serialBadSys.parse(badString), NBodySim::NBodySystemSpace::NO_MASS);
+	EXPECT_EQ(chunkedBadSys.getParseErrorLine(), badLine);
+	EXPECT_EQ(serialBadSys.getParseErrorLine(), badLine);
+	EXPECT_EQ(chunkedBadSys.numParticles(), badParticle);
+	EXPECT_EQ(serialBadSys.numParticles(), badParticle);
+	
+	// A comment among the particles sends the whole text to the serial parse
+	commentString = xmlString;
+	commentString.insert(commentString.find("<particle", commentString.size() / 2), "<!-- <particle posX=\"1\"/> -->");
+	commentSys.setNumThreads(4);
+	EXPECT_EQ(commentSys.parse(commentString), NBodySim::NBodySystemSpace::SUCCESS);
+	EXPECT_EQ(commentSys.numParticles(), numParticles);
+	EXPECT_EQ(chunkedSys.parse("<system><particle posX=\"1\"/></system>"), NBodySim::NBodySystemSpace::NO_POSY);
+	EXPECT_EQ(chunkedSys.getParseErrorLine(), 1);
+}
+
+TEST(NF_UsersProvideFile, ColumnFileRoundTrip) {
+	std::string xmlString = "<?xml version=\"1.0\"?>\n<system G=\"1.25\">\n\t<particle posX=\"0.1\" posY=\"-2e30\" posZ=\"3\" velX=\"1e-7\" velY=\"5\" velZ=\"-6\" mass=\"7.123456789012345\" name=\"Sun, \\&quot;the\\&quot; star\" radius=\"2\"/>\n\t<particle posX=\"1\" posY=\"2\" posZ=\"3\" velX=\"4\" velY=\"5\" velZ=\"6\" mass=\"7\" name=\"Earth\"/>\n</system>";
+	NBodySim::NBodySystem <NBodySim::FloatingType> xmlSys;
+	
+	ASSERT_EQ(xmlSys.parse(xmlString), NBodySim::NBodySystemSpace::SUCCESS);
+	for(char delimiter : {',', ' ', '\t'}){
+		std::stringstream file;
+		NBodySim::NBodySystem <NBodySim::FloatingType> columnSys;
+		xmlSys.writeColumns(file, delimiter);
+		EXPECT_EQ(columnSys.parseColumns(file), NBodySim::NBodySystemSpace::SUCCESS);
+		ASSERT_EQ(columnSys.numParticles(), 2);
+		EXPECT_EQ(columnSys.getGravitation(), 1.25);
+		for(size_t i = 0; i < 2; i++){
+			EXPECT_EQ(columnSys.getParticle(i).getName(), xmlSys.getParticle(i).getName());
+			EXPECT_EQ(columnSys.getParticle(i).getPos().y, xmlSys.getParticle(i).getPos().y);
+			EXPECT_EQ(columnSys.getParticle(i).getVel().x, xmlSys.getParticle(i).getVel().x);
+			EXPECT_EQ(columnSys.getParticle(i).getMass(), xmlSys.getParticle(i).getMass());
+			EXPECT_EQ(columnSys.getParticle(i).getRadius(), xmlSys.getParticle(i).getRadius());
+		}
+	}
+}
+
+TEST(NF_UsersProvideFile, ColumnFileHeaderMapping) {
+	std::stringstream file("# from an upstream tool\nmass  id velZ velY velX posZ posY posX\n\n5 17 0 0 1 3 2 1\n6 18 0 0 -1 -3 -2 -1\r\n");
+	std::stringstream badFile("posX,posY,posZ,velX,velY,velZ,mass\n1,2,3,4,5,6,7\n1,2,3,,5,6,7\n");
+	std::stringstream missingFile("posX posY posZ velX velY mass\n1 2 3 4 5 6\n");
+	NBodySim::NBodySystem <NBodySim::FloatingType> sys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> badSys;
+	NBodySim::NBodySystem <NBodySim::FloatingType> missingSys;
+	
+	// Columns in any order, unknown columns ignored and particles without names named by their index
+	EXPECT_EQ(sys.parseColumns(file), NBodySim::NBodySystemSpace::SUCCESS);
+	ASSERT_EQ(sys.numParticles(), 2);
+	EXPECT_EQ(sys.getParticle(1).getName(), "1");
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getPos().x, 1);
+	EXPECT_DOUBLE_EQ(sys.getParticle(0).getPos().z, 3);
+	EXPECT_DOUBLE_EQ(sys.getParticle(1).getVel().x, -1);
+	EXPECT_DOUBLE_EQ(sys.getParticle(1).getMass(), 6);
+	
+	EXPECT_EQ(badSys.parseColumns(badFile), NBodySim::NBodySystemSpace::BAD_ROW);
+	EXPECT_EQ(badSys.getParseErrorLine(), 3);
+	EXPECT_EQ(badSys.numParticles(), 1);
+	EXPECT_EQ(missingSys.parseColumns(missingFile), NBodySim::NBodySystemSpace::NO_VELZ);
+}
+
+TEST(NF_UsersProvideFile, StreamParticlesInBatches) {
+	NBodySim::NBodySystem <NBodySim::FloatingType> streamed;
+	NBodySim::NBodySystem <NBodySim::FloatingType> added;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > batch(64);
+	size_t next = 0;
+	
+	EXPECT_EQ(streamed.appendParticles(batch.data(), batch.size()), NBodySim::NBodySystemSpace::NOT_INGESTING);
+	EXPECT_EQ(streamed.commitParticles(), NBodySim::NBodySystemSpace::NOT_INGESTING);
+	
+	// One reused batch at a time, the last one short
+	streamed.beginParticles(1000);
+	while(next < 1000){
+		size_t count = std::min(batch.size(), 1000 - next);
+		for(size_t i = 0; i < count; i++, next++){
+			batch[i] = NBodySim::Particle<NBodySim::FloatingType>(next, std::sin(next), 0, 0, 0.01 * next, 0, 1e3 + next, "b" + std::to_string(next));
+			added.addParticle(batch[i]);
+		}
+		EXPECT_EQ(streamed.appendParticles(batch.data(), count), NBodySim::NBodySystemSpace::SUCCESS);
+	}
+	EXPECT_EQ(streamed.commitParticles(), NBodySim::NBodySystemSpace::SUCCESS);
+	ASSERT_EQ(streamed.numParticles(), 1000);
+	EXPECT_EQ(streamed.getParticle(777).getId(), 777);
+	EXPECT_EQ(streamed.getParticle(777).getName(), "b777");
+	
+	for(size_t i = 0; i < 3; i++){
+		streamed.step(0.1);
+		added.step(0.1);
+	}
+	for(size_t i = 0; i < 1000; i += 111){
+		EXPECT_EQ(streamed.getParticle(i).getPos().y, added.getParticle(i).getPos().y);
+	}
+	
+	// A reader failing part way leaves the system as it was
+	streamed.beginParticles();
+	streamed.appendParticles(batch.data(), 10);
+	EXPECT_EQ(streamed.cancelParticles(), NBodySim::NBodySystemSpace::SUCCESS);
+	EXPECT_EQ(streamed.numParticles(), 1000);
+	streamed.beginParticles();
+	EXPECT_EQ(streamed.commitParticles(), NBodySim::NBodySystemSpace::NO_PARTICLES);
+}
+
+TEST(NF_UsersProvideFile, SnapshotFileColumnsAndRanges) {
+	const std::string fileName = "SnapshotFileTest.nbs";
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > readBack;
+	std::vector<NBodySim::FloatingType> column;
+	std::vector<std::string> names;
+	NBodySim::SnapshotFile<NBodySim::FloatingType> snapshot;
+	NBodySim::SnapshotFile<NBodySim::FloatingType> notSnapshot;
+	
+	for(size_t i = 0; i < 1000; i++){
+		particles.push_back(NBodySim::Particle<NBodySim::FloatingType>(i, 0.5 * i, -1.0 * i, 1e-3 * i, 2, 3, 1e20 + i, i % 7 == 0 ? "" : "p" + std::to_string(i)));
+		particles.back().setRadius(0.25 * i);
+	}
+	ASSERT_EQ(NBodySim::SnapshotFile<NBodySim::FloatingType>::write(fileName, particles, 300, 9.9, 6.674e-11), NBodySim::SnapshotFileSpace::SUCCESS);
+	ASSERT_EQ(snapshot.open(fileName), NBodySim::SnapshotFileSpace::SUCCESS);
+	EXPECT_EQ(snapshot.numParticles(), 1000);
+	EXPECT_EQ(snapshot.getStep(), 300);
+	EXPECT_DOUBLE_EQ(snapshot.getTime(), 9.9);
+	EXPECT_DOUBLE_EQ(snapshot.getGravitation(), 6.674e-11);
+	
+	// Every property comes back exactly
+	ASSERT_EQ(snapshot.readParticles(0, snapshot.numParticles(), readBack), NBodySim::SnapshotFileSpace::SUCCESS);
+	for(size_t i = 0; i < particles.size(); i++){
+		EXPECT_EQ(readBack[i].getPos().y, particles[i].getPos().y);
+		EXPECT_EQ(readBack[i].getVel().x, particles[i].getVel().x);
+		EXPECT_EQ(readBack[i].getMass(), particles[i].getMass());
+		EXPECT_EQ(readBack[i].getRadius(), particles[i].getRadius());
+		EXPECT_EQ(readBack[i].getName(), particles[i].getName());
+	}
+	
+	// One column or a range of particles without reading the rest
+	ASSERT_EQ(snapshot.readColumn("mass", 990, 10, column), NBodySim::SnapshotFileSpace::SUCCESS);
+	EXPECT_EQ(column[3], particles[993].getMass());
+	ASSERT_EQ(snapshot.readNames(698, 3, names), NBodySim::SnapshotFileSpace::SUCCESS);
+	EXPECT_EQ(names[0], "p698");
+	EXPECT_EQ(names[2], "");
+	EXPECT_EQ(snapshot.readColumn("mass", 995, 10, column), NBodySim::SnapshotFileSpace::OUT_OF_RANGE);
+	EXPECT_EQ(snapshot.readColumn("charge", 0, 1, column), NBodySim::SnapshotFileSpace::NO_COLUMN);
+	
+	// A mapped column is used in place
+	if(snapshot.map() == NBodySim::SnapshotFileSpace::SUCCESS){
+		const double * posZ = snapshot.mappedColumn("posZ");
+		ASSERT_TRUE(posZ != NULL);
+		EXPECT_EQ(posZ[500], particles[500].getPos().z);
+		EXPECT_TRUE(snapshot.mappedColumn("nameData") == NULL);
+	}
+	
+	std::ofstream(fileName.c_str()) << "posX,posY,posZ,velX,velY,velZ,mass\n1,2,3,4,5,6,7\n";
+	EXPECT_EQ(notSnapshot.open(fileName), NBodySim::SnapshotFileSpace::NOT_A_SNAPSHOT);
+	std::remove(fileName.c_str());
+}
+
+TEST(NF_UsersProvideFile, SnapshotWriterMatchesSnapshotFile) {
+	const std::string fileName = "SnapshotWriterTest.nbs";
+	const std::string referenceName = "SnapshotWriterReference.nbs";
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	// Small buffers, so every file spans many of them and the last one is partly filled
+	NBodySim::SnapshotWriter<NBodySim::FloatingType> writer(3 * NBodySim::SnapshotWriterSpace::blockLength, 2);
+	
+	for(size_t count = 0; count < 3000; count += 1499){
+		particles.clear();
+		for(size_t i = 0; i < count; i++){
+			particles.push_back(NBodySim::Particle<NBodySim::FloatingType>(i, -0.5 * i, 2.0 * i, 1, 1e-3 * i, 3, 1e10 + i, "w" + std::to_string(i)));
+		}
+		ASSERT_EQ(writer.write(fileName, particles, count, 0.5, 6.674e-11), NBodySim::SnapshotFileSpace::SUCCESS);
+		ASSERT_EQ(NBodySim::SnapshotFile<NBodySim::FloatingType>::write(referenceName, particles, count, 0.5, 6.674e-11), NBodySim::SnapshotFileSpace::SUCCESS);
+		
+		// Byte for byte the file SnapshotFile writes, whether or not it went past the page cache
+		std::ifstream written(fileName.c_str(), std::ios::binary);
+		std::ifstream reference(referenceName.c_str(), std::ios::binary);
+		std::string writtenBytes((std::istreambuf_iterator<char>(written)), std::istreambuf_iterator<char>());
+		std::string referenceBytes((std::istreambuf_iterator<char>(reference)), std::istreambuf_iterator<char>());
+		EXPECT_EQ(writtenBytes.size(), referenceBytes.size());
+		EXPECT_TRUE(writtenBytes == referenceBytes);
+	}
+	EXPECT_EQ(writer.write("no-such-directory/" + fileName, particles, 0, 0, 1), NBodySim::SnapshotFileSpace::COULD_NOT_OPEN);
+	std::remove(fileName.c_str());
+	std::remove(referenceName.c_str());
+}
+
+TEST(NF_UsersProvideFile, SnapshotFiltersMatchBruteForce) {
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > particles;
+	std::vector<size_t> selected;
+	std::vector<size_t> expected;
+	NBodySim::ThreeVector<NBodySim::FloatingType> low = {-200, -50, 0};
+	NBodySim::ThreeVector<NBodySim::FloatingType> high = {300, 400, 1000};
+	NBodySim::ThreeVector<NBodySim::FloatingType> center = {100, -100, 50};
+	NBodySim::FloatingType radius = 350;
+	size_t numParticles = 5000;
+	
+	std::mt19937 generator(11);
+	std::uniform_real_distribution<NBodySim::FloatingType> uniform(-1e3, 1e3);
+	for(size_t i = 0; i < numParticles; i++){
+		particles.push_back(NBodySim::Particle<NBodySim::FloatingType>(uniform(generator), uniform(generator), uniform(generator), 0, 0, 0, 1, (i % 10 == 3) ? "star" + std::to_string(i) : "dust"));
+	}
+	
+	// The grid finds exactly the particles a test of every particle finds
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> box;
+	std::vector<size_t> scanned;
+	box.setBox(low, high);
+	box.setStride(3);
+	box.select(particles, scanned);
+	box.buildIndex(particles);
+	box.select(particles, selected);
+	for(size_t i = 0; i < numParticles; i += 3){
+		NBodySim::ThreeVector<NBodySim::FloatingType> p = particles[i].getPos();
+		if(p.x >= low.x && p.x <= high.x && p.y >= low.y && p.y <= high.y && p.z >= low.z && p.z <= high.z){
+			expected.push_back(i);
+		}
+	}
+	EXPECT_EQ(selected, expected);
+	EXPECT_EQ(scanned, expected);
+	
+	// A grid serves later regions of the same particles
+	box.setSphere(center, radius);
+	box.setStride(1);
+	box.setNamePattern("st?r*");
+	box.select(particles, selected);
+	expected.clear();
+	for(size_t i = 0; i < numParticles; i++){
+		NBodySim::ThreeVector<NBodySim::FloatingType> p = particles[i].getPos();
+		NBodySim::FloatingType d2 = (p.x - center.x) * (p.x - center.x) + (p.y - center.y) * (p.y - center.y) + (p.z - center.z) * (p.z - center.z);
+		if(d2 <= radius * radius && i % 10 == 3){
+			expected.push_back(i);
+		}
+	}
+	ASSERT_FALSE(expected.empty());
+	EXPECT_EQ(selected, expected);
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> sphere;
+	sphere.setSphere(center, radius);
+	sphere.setNamePattern("st?r*");
+	sphere.select(particles, scanned);
+	EXPECT_EQ(scanned, expected);
+	
+	// The random fraction is the same for the same seed, and about the share asked for
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> sample;
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> again;
+	std::vector<NBodySim::Particle<NBodySim::FloatingType> > sampled;
+	sample.setFraction(0.1, 42);
+	again.setFraction(0.1, 42);
+	sample.select(particles, selected);
+	again.select(particles, expected);
+	EXPECT_EQ(selected, expected);
+	EXPECT_NEAR(selected.size(), numParticles / 10, numParticles / 50);
+	sample.apply(particles, sampled);
+	ASSERT_EQ(sampled.size(), selected.size());
+	EXPECT_EQ(sampled.back().getPos().x, particles[selected.back()].getPos().x);
+	
+	// A later snapshot in the same buffer is tested again once apply or dropIndex has let go of the grid
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> reused;
+	NBodySim::SnapshotFilter<NBodySim::FloatingType> fresh;
+	reused.setBox(low, high);
+	fresh.setBox(low, high);
+	for(size_t pass = 0; pass < 2; pass++){
+		reused.buildIndex(particles);
+		if(pass == 0){
+			reused.apply(particles, sampled);
+		}
+		else{
+			reused.dropIndex();
+		}
+		for(size_t i = 0; i < numParticles; i++){
+			particles[i].setPosX(-particles[i].getPos().x);
+		}
+		reused.select(particles, selected);
+		fresh.select(particles, expected);
+		EXPECT_EQ(selected, expected);
+	}
+	
+	EXPECT_TRUE(NBodySim::SnapshotFilter<NBodySim::FloatingType>::matchName("Commet12", "C*t1?"));
+	EXPECT_FALSE(NBodySim::SnapshotFilter<NBodySim::FloatingType>::matchName("Commet12", "C*t1"));
+	EXPECT_TRUE(NBodySim::SnapshotFilter<NBodySim::FloatingType>().selectsAll());
+}
+
 TEST(NF_SystemsProvideG, GetGofOne){
 	std::string xmlString = "<?xml version=\"1.0\"?>\n<system G=\"1.00\">\n\t<particle posX=\"0\" posY=\"0\" posZ=\"0\" velX=\"0\" velY=\"0\" velZ=\"0\" mass=\"1.988500e30\" name=\"Sun\"/>\n\t<particle posX=\"0\" posY=\"1.5210e11\" posZ=\"0\" velX=\"-2.929e4\" velY=\"0\" velZ=\"0\" mass=\"5.972e24\" name=\"Earth\"/>\n\t<particle posX=\"4.054e8\" posY=\"1.5210e11\" posZ=\"0\" velX=\"-2.929e4\" velY=\"-964.0f\" velZ=\"0\" mass=\"7.34767309e22\" name=\"Moon\"/>\t</system>";
 	NBodySim::NBodySystem <NBodySim::FloatingType> sys;